@@ -712,6 +712,9 @@ if [ $SRS_EXPORT_LIBRTMP_PROJECT = NO ]; then
         (cd ${SRS_WORKDIR}/research/hls && make ${SRS_JOBS} && mv ts_info ../../${SRS_OBJS_DIR}/research)
         ret=$?; if [[ $ret -ne 0 ]]; then echo "build research/hls failed, ret=$ret"; exit $ret; fi
 
+        (cd ${SRS_WORKDIR}/research/log && make ${SRS_JOBS} && mv srs_log_decoder ../../${SRS_OBJS_DIR}/research)
+        ret=$?; if [[ $ret -ne 0 ]]; then echo "build research/log failed, ret=$ret"; exit $ret; fi
+
         (cd research/ffempty && make ${SRS_JOBS} && mv ffempty ../../${SRS_OBJS_DIR}/research)
         ret=$?; if [[ $ret -ne 0 ]]; then echo "build research/ffempty failed, ret=$ret"; exit $ret; fi
     fi
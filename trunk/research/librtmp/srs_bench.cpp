@@ -0,0 +1,1480 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+the open-loop load generator and fan-out benchmark of SRS, which runs a publisher
+and lots of RTMP/HTTP-FLV/HLS players in st threads of one process, over the
+srs-librtmp with io hijacked by st, see SRS_HIJACK_IO of srs_librtmp.h.
+
+the publisher ingests a flv file in loop by the timestamps, and embeds its wallclock
+time in an SEI(user data unregistered) of each video frame, the players extract it
+to measure the end-to-end delivery latency, so the clock of publisher and players
+must be the same, that is, run them in one bench, or on hosts synced by NTP.
+
+the players are started by schedule, never wait for the others(open-loop), and the
+report is in json, about the throughput, cpu per viewer and p50/p99 latency.
+
+build by make in research/librtmp, which rebuild the simple socket with SRS_HIJACK_IO:
+    g++ -c ../../src/libs/srs_lib_simple_socket.cpp -DSRS_HIJACK_IO \
+        -I../../objs -I../../src/core -I../../src/kernel -I../../src/protocol -I../../src/libs \
+        -o objs/srs_lib_hijack_socket.o
+    g++ srs_bench.cpp -DSRS_HIJACK_IO -I../../objs/st objs/srs_lib_hijack_socket.o \
+        ../../objs/lib/srs_librtmp.a ../../objs/st/libst.a -g -O0 -ldl -o objs/srs_bench
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <string>
+#include <vector>
+#include <sstream>
+using namespace std;
+
+#include <st.h>
+
+#include "../../objs/include/srs_librtmp.h"
+
+// the error codes of hijack io, same to srs_kernel_error.hpp.
+#define ERROR_SUCCESS           0
+#define ERROR_SOCKET_CREATE     1000
+#define ERROR_SOCKET_READ       1007
+#define ERROR_SOCKET_WRITE      1009
+#define ERROR_SOCKET_TIMEOUT    1011
+#define ERROR_SOCKET_CONNECT    1012
+// the error codes of bench.
+#define ERROR_BENCH_HTTP_URL    2000
+#define ERROR_BENCH_HTTP_STATUS 2001
+#define ERROR_BENCH_HTTP_EOF    2002
+#define ERROR_BENCH_FLV_HEADER  2003
+#define ERROR_BENCH_QUIT        2004
+
+// the timeout for all sockets, the player quit when stream stalled.
+#define SRS_BENCH_TIMEOUT_MS 30000
+// the latency histogram in ms, the sample over it is counted in the last bucket.
+#define SRS_BENCH_HISTOGRAM_MS 60000
+// the msg is late when publisher sent it later than its schedule.
+#define SRS_BENCH_LATE_MS 100
+// the interval in ms to print the progress.
+#define SRS_BENCH_PRINT_MS 5000
+// the gap in ms between the last and first msg when loop the flv file.
+#define SRS_BENCH_LOOP_GAP_MS 40
+// the size of flv header and the previous tag size 0.
+#define SRS_BENCH_FLV_HEADER 13
+
+// the uuid of the SEI of bench, followed by the wallclock in 13 digits ms.
+// @remark use digits never contains the 0x000003, so no emulation prevention bytes.
+#define SRS_BENCH_SEI_UUID "SRSBENCHLATENCY1"
+#define SRS_BENCH_SEI_UUID_SIZE 16
+#define SRS_BENCH_SEI_TIME_SIZE 13
+// the SEI nalu: type(1B), payload type(1B), payload size(1B), uuid, time, rbsp trailing(1B).
+#define SRS_BENCH_SEI_SIZE (3 + SRS_BENCH_SEI_UUID_SIZE + SRS_BENCH_SEI_TIME_SIZE + 1)
+
+#define srs_bench_trace(msg, ...) fprintf(stderr, "[%s] ", srs_human_format_time());fprintf(stderr, msg, ##__VA_ARGS__);fprintf(stderr, "\n")
+
+/**
+* the histogram in ms, to get the percentile of latency.
+*/
+class SrsBenchHistogram
+{
+private:
+    int64_t* buckets;
+    int64_t count;
+    int64_t max;
+    double sum;
+public:
+    SrsBenchHistogram();
+    virtual ~SrsBenchHistogram();
+public:
+    virtual void add(int64_t ms);
+    virtual int64_t samples();
+    virtual int64_t percentile(double p);
+    virtual void dumps(stringstream& ss);
+};
+
+SrsBenchHistogram::SrsBenchHistogram()
+{
+    buckets = new int64_t[SRS_BENCH_HISTOGRAM_MS + 1];
+    memset(buckets, 0, sizeof(int64_t) * (SRS_BENCH_HISTOGRAM_MS + 1));
+    count = max = 0;
+    sum = 0;
+}
+
+SrsBenchHistogram::~SrsBenchHistogram()
+{
+    delete[] buckets;
+}
+
+void SrsBenchHistogram::add(int64_t ms)
+{
+    ms = (ms < 0)? 0 : ms;
+    buckets[(ms < SRS_BENCH_HISTOGRAM_MS)? ms : SRS_BENCH_HISTOGRAM_MS]++;
+
+    count++;
+    sum += ms;
+    max = (ms > max)? ms : max;
+}
+
+int64_t SrsBenchHistogram::samples()
+{
+    return count;
+}
+
+int64_t SrsBenchHistogram::percentile(double p)
+{
+    if (count <= 0) {
+        return 0;
+    }
+
+    // the rank of sample, at least the first one.
+    int64_t rank = (int64_t)(p * count + 0.999999);
+    rank = (rank < 1)? 1 : rank;
+
+    int64_t nb_samples = 0;
+    for (int i = 0; i < SRS_BENCH_HISTOGRAM_MS; i++) {
+        nb_samples += buckets[i];
+        if (nb_samples >= rank) {
+            return i;
+        }
+    }
+
+    return max;
+}
+
+void SrsBenchHistogram::dumps(stringstream& ss)
+{
+    ss << "{"
+        << "\"samples\":" << count << ","
+        << "\"avg\":" << (int64_t)(count > 0? sum / count : 0) << ","
+        << "\"p50\":" << percentile(0.5) << ","
+        << "\"p90\":" << percentile(0.9) << ","
+        << "\"p99\":" << percentile(0.99) << ","
+        << "\"max\":" << max
+        << "}";
+}
+
+/**
+* the stat of bench, all threads of bench update it.
+*/
+struct SrsBenchStat
+{
+    // the bytes of all sockets.
+    int64_t recv_bytes;
+    int64_t send_bytes;
+    // the publisher.
+    int64_t pub_msgs;
+    int64_t pub_late;
+    int pub_error;
+    // the players.
+    int nb_started;
+    int nb_connected;
+    int nb_failed;
+    int nb_dropped;
+    int64_t play_msgs;
+    SrsBenchHistogram startup;
+    SrsBenchHistogram latency;
+    // the snapshot when all players started, for the steady throughput and cpu.
+    int64_t snapshot_time;
+    int64_t snapshot_recv_bytes;
+    int64_t snapshot_server_cpu;
+    int64_t snapshot_bench_cpu;
+
+    SrsBenchStat() {
+        recv_bytes = send_bytes = 0;
+        pub_msgs = pub_late = 0;
+        pub_error = 0;
+        nb_started = nb_connected = nb_failed = nb_dropped = 0;
+        play_msgs = 0;
+        snapshot_time = -1;
+        snapshot_recv_bytes = snapshot_server_cpu = snapshot_bench_cpu = 0;
+    }
+};
+
+/**
+* the options of bench.
+*/
+struct SrsBenchOptions
+{
+    // the flv file and url to publish.
+    const char* input;
+    const char* publish_url;
+    // the url to play, and its type, rtmp, flv or hls.
+    const char* play_url;
+    const char* play_type;
+    // the players to start, and how many to start in a second, 0 to start all.
+    int nb_players;
+    double rate;
+    // the duration of bench in seconds.
+    int duration;
+    // ignore the latency in warmup ms of each player, for the gop cache.
+    int warmup;
+    // the pid of srs server to stat cpu, 0 to ignore.
+    int pid;
+    // the file to write report, NULL for stdout.
+    const char* output;
+
+    SrsBenchOptions() {
+        input = publish_url = play_url = play_type = output = NULL;
+        nb_players = 0;
+        rate = 0;
+        duration = 60;
+        warmup = 1000;
+        pid = 0;
+    }
+};
+
+SrsBenchStat* _srs_bench_stat = new SrsBenchStat();
+SrsBenchOptions* _srs_bench_opts = new SrsBenchOptions();
+bool _srs_bench_quit = false;
+
+// the wallclock in ms, all threads use it to measure the latency.
+int64_t srs_bench_time_ms()
+{
+    return (int64_t)(st_utime() / 1000);
+}
+
+/*************************************************************
+**************************************************************
+* the io hijacked by st, for srs-librtmp and http clients.
+**************************************************************
+*************************************************************/
+struct SrsBenchSocket
+{
+    st_netfd_t stfd;
+    int64_t recv_timeout;
+    int64_t send_timeout;
+    int64_t recv_bytes;
+    int64_t send_bytes;
+};
+
+srs_hijack_io_t srs_hijack_io_create()
+{
+    SrsBenchSocket* skt = new SrsBenchSocket();
+    skt->stfd = NULL;
+    skt->recv_timeout = skt->send_timeout = ST_UTIME_NO_TIMEOUT;
+    skt->recv_bytes = skt->send_bytes = 0;
+    return skt;
+}
+void srs_hijack_io_destroy(srs_hijack_io_t ctx)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+    if (skt->stfd) {
+        st_netfd_close(skt->stfd);
+    }
+    delete skt;
+}
+int srs_hijack_io_create_socket(srs_hijack_io_t ctx)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return ERROR_SOCKET_CREATE;
+    }
+
+    if ((skt->stfd = st_netfd_open_socket(fd)) == NULL) {
+        ::close(fd);
+        return ERROR_SOCKET_CREATE;
+    }
+
+    return ERROR_SUCCESS;
+}
+int srs_hijack_io_connect(srs_hijack_io_t ctx, const char* server_ip, int port)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr(server_ip);
+
+    if (st_connect(skt->stfd, (const struct sockaddr*)&addr, sizeof(sockaddr_in), SRS_BENCH_TIMEOUT_MS * 1000LL) == -1) {
+        return ERROR_SOCKET_CONNECT;
+    }
+
+    return ERROR_SUCCESS;
+}
+int srs_hijack_io_read(srs_hijack_io_t ctx, void* buf, size_t size, ssize_t* nread)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+
+    ssize_t nb_read = st_read(skt->stfd, buf, size, skt->recv_timeout);
+    if (nread) {
+        *nread = nb_read;
+    }
+
+    if (nb_read <= 0) {
+        if (nb_read < 0 && errno == ETIME) {
+            return ERROR_SOCKET_TIMEOUT;
+        }
+        if (nb_read == 0) {
+            errno = ECONNRESET;
+        }
+        return ERROR_SOCKET_READ;
+    }
+
+    skt->recv_bytes += nb_read;
+    _srs_bench_stat->recv_bytes += nb_read;
+
+    return ERROR_SUCCESS;
+}
+int srs_hijack_io_set_recv_timeout(srs_hijack_io_t ctx, int64_t timeout_us)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+    skt->recv_timeout = timeout_us;
+    return ERROR_SUCCESS;
+}
+int64_t srs_hijack_io_get_recv_timeout(srs_hijack_io_t ctx)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+    return skt->recv_timeout;
+}
+int64_t srs_hijack_io_get_recv_bytes(srs_hijack_io_t ctx)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+    return skt->recv_bytes;
+}
+int srs_hijack_io_set_send_timeout(srs_hijack_io_t ctx, int64_t timeout_us)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+    skt->send_timeout = timeout_us;
+    return ERROR_SUCCESS;
+}
+int64_t srs_hijack_io_get_send_timeout(srs_hijack_io_t ctx)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+    return skt->send_timeout;
+}
+int64_t srs_hijack_io_get_send_bytes(srs_hijack_io_t ctx)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+    return skt->send_bytes;
+}
+int srs_hijack_io_writev(srs_hijack_io_t ctx, const iovec *iov, int iov_size, ssize_t* nwrite)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+
+    ssize_t nb_write = st_writev(skt->stfd, iov, iov_size, skt->send_timeout);
+    if (nwrite) {
+        *nwrite = nb_write;
+    }
+
+    if (nb_write <= 0) {
+        if (nb_write < 0 && errno == ETIME) {
+            return ERROR_SOCKET_TIMEOUT;
+        }
+        return ERROR_SOCKET_WRITE;
+    }
+
+    skt->send_bytes += nb_write;
+    _srs_bench_stat->send_bytes += nb_write;
+
+    return ERROR_SUCCESS;
+}
+bool srs_hijack_io_is_never_timeout(srs_hijack_io_t ctx, int64_t timeout_us)
+{
+    return timeout_us == (int64_t)ST_UTIME_NO_TIMEOUT;
+}
+int srs_hijack_io_read_fully(srs_hijack_io_t ctx, void* buf, size_t size, ssize_t* nread)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+
+    ssize_t nb_read = st_read_fully(skt->stfd, buf, size, skt->recv_timeout);
+    if (nread) {
+        *nread = nb_read;
+    }
+
+    if (nb_read != (ssize_t)size) {
+        if (nb_read < 0 && errno == ETIME) {
+            return ERROR_SOCKET_TIMEOUT;
+        }
+        if (nb_read >= 0) {
+            errno = ECONNRESET;
+        }
+        return ERROR_SOCKET_READ;
+    }
+
+    skt->recv_bytes += nb_read;
+    _srs_bench_stat->recv_bytes += nb_read;
+
+    return ERROR_SUCCESS;
+}
+int srs_hijack_io_write(srs_hijack_io_t ctx, void* buf, size_t size, ssize_t* nwrite)
+{
+    SrsBenchSocket* skt = (SrsBenchSocket*)ctx;
+
+    ssize_t nb_write = st_write(skt->stfd, buf, size, skt->send_timeout);
+    if (nwrite) {
+        *nwrite = nb_write;
+    }
+
+    if (nb_write <= 0) {
+        if (nb_write < 0 && errno == ETIME) {
+            return ERROR_SOCKET_TIMEOUT;
+        }
+        return ERROR_SOCKET_WRITE;
+    }
+
+    skt->send_bytes += nb_write;
+    _srs_bench_stat->send_bytes += nb_write;
+
+    return ERROR_SUCCESS;
+}
+
+/*************************************************************
+**************************************************************
+* the SEI to embed the wallclock in video.
+**************************************************************
+*************************************************************/
+// parse the time in SEI of bench, return -1 if not found.
+int64_t srs_bench_sei_parse(const char* p)
+{
+    int64_t time = 0;
+    for (int i = 0; i < SRS_BENCH_SEI_TIME_SIZE; i++) {
+        if (p[i] < '0' || p[i] > '9') {
+            return -1;
+        }
+        time = time * 10 + (p[i] - '0');
+    }
+    return time;
+}
+
+// get the time in SEI of flv video tag, which is AVC NALUs with 4B length.
+int64_t srs_bench_sei_video(const char* data, int size)
+{
+    // frame type and codec id(1B), avc packet type(1B), cts(3B).
+    if (size <= 5 || (data[0] & 0x0f) != 7 || data[1] != 1) {
+        return -1;
+    }
+
+    for (int pos = 5; pos + 4 < size;) {
+        const u_int8_t* p = (const u_int8_t*)data + pos;
+        int nb_nalu = (int)(((u_int32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+        if (nb_nalu <= 0 || nb_nalu > size - pos - 4) {
+            break;
+        }
+
+        const char* nalu = data + pos + 4;
+        if ((nalu[0] & 0x1f) == 6 && nb_nalu >= SRS_BENCH_SEI_SIZE
+            && memcmp(nalu + 3, SRS_BENCH_SEI_UUID, SRS_BENCH_SEI_UUID_SIZE) == 0
+        ) {
+            return srs_bench_sei_parse(nalu + 3 + SRS_BENCH_SEI_UUID_SIZE);
+        }
+
+        pos += 4 + nb_nalu;
+    }
+
+    return -1;
+}
+
+// embed the SEI of time to flv video tag, before the first slice.
+// @return the new tag data to send, NULL if not embeded.
+char* srs_bench_sei_embed(const char* data, int size, int64_t time, int* pnb_data)
+{
+    if (size <= 5 || (data[0] & 0x0f) != 7 || data[1] != 1) {
+        return NULL;
+    }
+
+    // find the first slice, the non-IDR or IDR picture.
+    int pos = 5;
+    while (pos + 4 < size) {
+        const u_int8_t* p = (const u_int8_t*)data + pos;
+        int nb_nalu = (int)(((u_int32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+        if (nb_nalu <= 0 || nb_nalu > size - pos - 4) {
+            return NULL;
+        }
+
+        u_int8_t nal_unit_type = p[4] & 0x1f;
+        if (nal_unit_type >= 1 && nal_unit_type <= 5) {
+            break;
+        }
+
+        pos += 4 + nb_nalu;
+    }
+    if (pos + 4 >= size) {
+        return NULL;
+    }
+
+    int nb_data = size + 4 + SRS_BENCH_SEI_SIZE;
+    char* buf = (char*)malloc(nb_data);
+
+    memcpy(buf, data, pos);
+    char* p = buf + pos;
+
+    *p++ = 0; *p++ = 0; *p++ = 0; *p++ = SRS_BENCH_SEI_SIZE;
+    // SEI, user data unregistered.
+    *p++ = 0x06;
+    *p++ = 0x05;
+    *p++ = SRS_BENCH_SEI_UUID_SIZE + SRS_BENCH_SEI_TIME_SIZE;
+    memcpy(p, SRS_BENCH_SEI_UUID, SRS_BENCH_SEI_UUID_SIZE);
+    p += SRS_BENCH_SEI_UUID_SIZE;
+    snprintf(p, SRS_BENCH_SEI_TIME_SIZE + 1, "%013lld", (long long)time);
+    p += SRS_BENCH_SEI_TIME_SIZE;
+    // rbsp trailing bits, overwrite the NULL of snprintf.
+    *p++ = (char)0x80;
+
+    memcpy(p, data + pos, size - pos);
+
+    *pnb_data = nb_data;
+    return buf;
+}
+
+/*************************************************************
+**************************************************************
+* the http client over st, for HTTP-FLV and HLS.
+**************************************************************
+*************************************************************/
+class SrsBenchHttp
+{
+private:
+    srs_hijack_io_t io;
+    // the buffer of response.
+    char buf[4096];
+    int pos;
+    int end;
+    // the body is chunked, or left bytes of content-length, -1 for util closed.
+    bool chunked;
+    int nb_chunks;
+    int64_t left;
+    bool eof;
+public:
+    SrsBenchHttp();
+    virtual ~SrsBenchHttp();
+public:
+    /**
+    * send the GET request and read the response header.
+    */
+    virtual int get(string url);
+    /**
+    * read the body, the chunked is decoded.
+    */
+    virtual int read(char* data, int size, int* nread);
+    virtual int read_fully(char* data, int size);
+    virtual int read_all(string& body);
+private:
+    virtual int fill();
+    virtual int read_line(string& line);
+};
+
+SrsBenchHttp::SrsBenchHttp()
+{
+    io = NULL;
+    pos = end = 0;
+    chunked = false;
+    nb_chunks = 0;
+    left = -1;
+    eof = false;
+}
+
+SrsBenchHttp::~SrsBenchHttp()
+{
+    if (io) {
+        srs_hijack_io_destroy(io);
+    }
+}
+
+int SrsBenchHttp::get(string url)
+{
+    int ret = ERROR_SUCCESS;
+
+    // parse the http://host[:port]/path
+    if (url.find("http://") != 0) {
+        return ERROR_BENCH_HTTP_URL;
+    }
+    string host = url.substr(7);
+    string path = "/";
+    if (host.find("/") != string::npos) {
+        path = host.substr(host.find("/"));
+        host = host.substr(0, host.find("/"));
+    }
+    int port = 80;
+    if (host.find(":") != string::npos) {
+        port = ::atoi(host.substr(host.find(":") + 1).c_str());
+        host = host.substr(0, host.find(":"));
+    }
+
+    string ip = host;
+    if (inet_addr(host.c_str()) == INADDR_NONE) {
+        hostent* answer = gethostbyname(host.c_str());
+        if (!answer || answer->h_length <= 0) {
+            return ERROR_BENCH_HTTP_URL;
+        }
+        char ipv4[16];
+        inet_ntop(AF_INET, answer->h_addr_list[0], ipv4, sizeof(ipv4));
+        ip = ipv4;
+    }
+
+    io = srs_hijack_io_create();
+    srs_hijack_io_set_recv_timeout(io, SRS_BENCH_TIMEOUT_MS * 1000LL);
+    srs_hijack_io_set_send_timeout(io, SRS_BENCH_TIMEOUT_MS * 1000LL);
+    if ((ret = srs_hijack_io_create_socket(io)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = srs_hijack_io_connect(io, ip.c_str(), port)) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    stringstream ss;
+    ss << "GET " << path << " HTTP/1.1\r\n"
+        << "Host: " << host << "\r\n"
+        << "User-Agent: srs_bench\r\n"
+        << "Connection: close\r\n"
+        << "\r\n";
+    string req = ss.str();
+    if ((ret = srs_hijack_io_write(io, (void*)req.data(), req.length(), NULL)) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    // the status line, HTTP/1.1 200 OK
+    string line;
+    if ((ret = read_line(line)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if (line.find(" ") == string::npos || ::atoi(line.substr(line.find(" ") + 1).c_str()) != 200) {
+        srs_bench_trace("http get %s failed, status=%s", url.c_str(), line.c_str());
+        return ERROR_BENCH_HTTP_STATUS;
+    }
+
+    // the headers, util the empty line.
+    for (;;) {
+        if ((ret = read_line(line)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        if (line.empty()) {
+            break;
+        }
+
+        for (int i = 0; i < (int)line.length() && line.at(i) != ':'; i++) {
+            line.at(i) = (char)tolower(line.at(i));
+        }
+        if (line.find("content-length:") == 0) {
+            left = ::atoll(line.substr(15).c_str());
+        } else if (line.find("transfer-encoding:") == 0 && line.find("chunked") != string::npos) {
+            chunked = true;
+        }
+    }
+
+    if (chunked) {
+        left = 0;
+    }
+
+    return ret;
+}
+
+int SrsBenchHttp::read(char* data, int size, int* nread)
+{
+    int ret = ERROR_SUCCESS;
+
+    // the CRLF after the last chunk, and the size of next chunk.
+    if (chunked && left == 0 && !eof) {
+        string line;
+        if (nb_chunks++ > 0 && (ret = read_line(line)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        if ((ret = read_line(line)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        left = ::strtoll(line.c_str(), NULL, 16);
+        eof = (left == 0);
+    }
+
+    if (eof || left == 0) {
+        return ERROR_BENCH_HTTP_EOF;
+    }
+
+    if (pos >= end && (ret = fill()) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    int nb_read = end - pos;
+    nb_read = (nb_read < size)? nb_read : size;
+    if (left > 0) {
+        nb_read = (nb_read < left)? nb_read : (int)left;
+        left -= nb_read;
+    }
+
+    memcpy(data, buf + pos, nb_read);
+    pos += nb_read;
+    *nread = nb_read;
+
+    return ret;
+}
+
+int SrsBenchHttp::read_fully(char* data, int size)
+{
+    int ret = ERROR_SUCCESS;
+
+    for (int nb_read = 0; nb_read < size;) {
+        int nb = 0;
+        if ((ret = read(data + nb_read, size - nb_read, &nb)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        nb_read += nb;
+    }
+
+    return ret;
+}
+
+int SrsBenchHttp::read_all(string& body)
+{
+    int ret = ERROR_SUCCESS;
+
+    char data[4096];
+    for (;;) {
+        int nb = 0;
+        if ((ret = read(data, sizeof(data), &nb)) != ERROR_SUCCESS) {
+            break;
+        }
+        body.append(data, nb);
+    }
+
+    // the body completed when eof or closed.
+    if (ret == ERROR_BENCH_HTTP_EOF || (left < 0 && ret == ERROR_SOCKET_READ)) {
+        ret = ERROR_SUCCESS;
+    }
+
+    return ret;
+}
+
+int SrsBenchHttp::fill()
+{
+    int ret = ERROR_SUCCESS;
+
+    if (pos >= end) {
+        pos = end = 0;
+    }
+
+    ssize_t nb_read = 0;
+    if ((ret = srs_hijack_io_read(io, buf + end, sizeof(buf) - end, &nb_read)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    end += (int)nb_read;
+
+    return ret;
+}
+
+int SrsBenchHttp::read_line(string& line)
+{
+    int ret = ERROR_SUCCESS;
+
+    line = "";
+    for (;;) {
+        if (pos >= end && (ret = fill()) != ERROR_SUCCESS) {
+            return ret;
+        }
+
+        char ch = buf[pos++];
+        if (ch == '\n') {
+            break;
+        }
+        if (ch != '\r') {
+            line.append(1, ch);
+        }
+    }
+
+    return ret;
+}
+
+/*************************************************************
+**************************************************************
+* the publisher and players.
+**************************************************************
+*************************************************************/
+// the cpu time in ms of srs server by /proc, -1 if not available.
+int64_t srs_bench_server_cpu(int pid)
+{
+    if (pid <= 0) {
+        return -1;
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+
+    // the comm maybe contains space, so parse from the last ')'.
+    char line[1024];
+    memset(line, 0, sizeof(line));
+    size_t nb_line = fread(line, 1, sizeof(line) - 1, f);
+    fclose(f);
+    line[nb_line] = 0;
+
+    char* p = strrchr(line, ')');
+    if (!p) {
+        return -1;
+    }
+
+    // the state(3) to stime(15), @see man proc
+    unsigned long utime = 0, stime = 0;
+    if (sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) {
+        return -1;
+    }
+
+    return (int64_t)(utime + stime) * 1000 / sysconf(_SC_CLK_TCK);
+}
+
+// the cpu time in ms of bench self.
+int64_t srs_bench_self_cpu()
+{
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+
+    return (int64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000
+        + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000;
+}
+
+void srs_bench_snapshot()
+{
+    SrsBenchStat* stat = _srs_bench_stat;
+
+    stat->snapshot_time = srs_bench_time_ms();
+    stat->snapshot_recv_bytes = stat->recv_bytes;
+    stat->snapshot_server_cpu = srs_bench_server_cpu(_srs_bench_opts->pid);
+    stat->snapshot_bench_cpu = srs_bench_self_cpu();
+}
+
+int srs_bench_publish_flv(srs_rtmp_t rtmp, srs_flv_t flv)
+{
+    int ret = ERROR_SUCCESS;
+
+    SrsBenchStat* stat = _srs_bench_stat;
+
+    // the msgs are scheduled by timestamp from the start.
+    int64_t starttime = srs_bench_time_ms();
+    // the timestamp base of current loop, and the first time of file.
+    int64_t base = 0;
+    int64_t first = -1;
+    int64_t timestamp = 0;
+    // whether embed the SEI, the NALU length must be 4B.
+    bool embed = true;
+
+    while (!_srs_bench_quit) {
+        char type;
+        int size;
+        u_int32_t time;
+        if ((ret = srs_flv_read_tag_header(flv, &type, &size, &time)) != 0) {
+            if (!srs_flv_is_eof(ret)) {
+                return ret;
+            }
+
+            // loop the file, to publish in the duration of bench.
+            srs_flv_lseek(flv, SRS_BENCH_FLV_HEADER);
+            base = timestamp + SRS_BENCH_LOOP_GAP_MS;
+            first = -1;
+            continue;
+        }
+
+        char* data = (char*)malloc(size);
+        if ((ret = srs_flv_read_tag_data(flv, data, size)) != 0) {
+            free(data);
+            return ret;
+        }
+
+        if (first < 0) {
+            first = time;
+        }
+        timestamp = base + time - first;
+
+        // open-loop, send when the msg is due, never wait for the players.
+        int64_t due = starttime + timestamp;
+        int64_t now = srs_bench_time_ms();
+        if (due > now) {
+            st_usleep((due - now) * 1000);
+        } else if (now - due > SRS_BENCH_LATE_MS) {
+            stat->pub_late++;
+        }
+
+        if (srs_utils_flv_tag_is_video(type) && srs_flv_is_sequence_header(data, size)) {
+            // the lengthSizeMinusOne of AVCDecoderConfigurationRecord.
+            embed = (size > 9 && (data[9] & 0x03) == 3);
+            if (!embed) {
+                srs_bench_trace("the NALU length is not 4B, no latency measured");
+            }
+        } else if (srs_utils_flv_tag_is_video(type) && embed) {
+            int nb_sei_data = 0;
+            char* sei_data = srs_bench_sei_embed(data, size, srs_bench_time_ms(), &nb_sei_data);
+            if (sei_data) {
+                free(data);
+                data = sei_data;
+                size = nb_sei_data;
+            }
+        }
+
+        if ((ret = srs_rtmp_write_packet(rtmp, type, (u_int32_t)timestamp, data, size)) != 0) {
+            return ret;
+        }
+        stat->pub_msgs++;
+    }
+
+    return ret;
+}
+
+void* srs_bench_publisher(void* /*arg*/)
+{
+    int ret = ERROR_SUCCESS;
+
+    SrsBenchOptions* opts = _srs_bench_opts;
+
+    srs_flv_t flv = srs_flv_open_read(opts->input);
+    if (!flv) {
+        srs_bench_trace("open flv %s failed", opts->input);
+        _srs_bench_stat->pub_error = -1;
+        return NULL;
+    }
+
+    srs_rtmp_t rtmp = srs_rtmp_create(opts->publish_url);
+    srs_rtmp_set_timeout(rtmp, SRS_BENCH_TIMEOUT_MS, SRS_BENCH_TIMEOUT_MS);
+
+    char header[9];
+    if ((ret = srs_flv_read_header(flv, header)) != 0) {
+        srs_bench_trace("read flv header failed. ret=%d", ret);
+    } else if ((ret = srs_rtmp_handshake(rtmp)) != 0) {
+        srs_bench_trace("publisher handshake failed. ret=%d", ret);
+    } else if ((ret = srs_rtmp_connect_app(rtmp)) != 0) {
+        srs_bench_trace("publisher connect app failed. ret=%d", ret);
+    } else if ((ret = srs_rtmp_publish_stream(rtmp)) != 0) {
+        srs_bench_trace("publisher publish failed. ret=%d", ret);
+    } else {
+        srs_bench_trace("publish %s to %s", opts->input, opts->publish_url);
+        if ((ret = srs_bench_publish_flv(rtmp, flv)) != 0) {
+            srs_bench_trace("publisher stopped. ret=%d", ret);
+        }
+    }
+
+    _srs_bench_stat->pub_error = ret;
+
+    srs_rtmp_destroy(rtmp);
+    srs_flv_close(flv);
+
+    return NULL;
+}
+
+/**
+* the player of bench, play the stream in a st thread.
+*/
+class SrsBenchPlayer
+{
+private:
+    int id;
+    // the time when started, and got the first msg, -1 if not got yet.
+    int64_t starttime;
+    int64_t firsttime;
+public:
+    SrsBenchPlayer(int cid);
+    virtual ~SrsBenchPlayer();
+public:
+    virtual int cycle();
+private:
+    virtual int play_rtmp();
+    virtual int play_flv();
+    virtual int play_hls();
+    /**
+    * when got a msg, stat the startup and latency.
+    * @param time the time in SEI of msg, -1 for none.
+    */
+    virtual int on_msg(int64_t time);
+};
+
+SrsBenchPlayer::SrsBenchPlayer(int cid)
+{
+    id = cid;
+    starttime = srs_bench_time_ms();
+    firsttime = -1;
+}
+
+SrsBenchPlayer::~SrsBenchPlayer()
+{
+}
+
+int SrsBenchPlayer::cycle()
+{
+    int ret = ERROR_SUCCESS;
+
+    SrsBenchStat* stat = _srs_bench_stat;
+    string type = _srs_bench_opts->play_type;
+
+    stat->nb_started++;
+
+    if (type == "flv") {
+        ret = play_flv();
+    } else if (type == "hls") {
+        ret = play_hls();
+    } else {
+        ret = play_rtmp();
+    }
+
+    if (ret == ERROR_BENCH_QUIT) {
+        return ERROR_SUCCESS;
+    }
+
+    if (firsttime < 0) {
+        stat->nb_failed++;
+        srs_bench_trace("player %d failed. ret=%d", id, ret);
+    } else {
+        stat->nb_dropped++;
+        srs_bench_trace("player %d dropped. ret=%d", id, ret);
+    }
+
+    return ret;
+}
+
+int SrsBenchPlayer::play_rtmp()
+{
+    int ret = ERROR_SUCCESS;
+
+    srs_rtmp_t rtmp = srs_rtmp_create(_srs_bench_opts->play_url);
+    srs_rtmp_set_timeout(rtmp, SRS_BENCH_TIMEOUT_MS, SRS_BENCH_TIMEOUT_MS);
+
+    if ((ret = srs_rtmp_handshake(rtmp)) == 0 && (ret = srs_rtmp_connect_app(rtmp)) == 0
+        && (ret = srs_rtmp_play_stream(rtmp)) == 0
+    ) {
+        while (!_srs_bench_quit) {
+            char type;
+            u_int32_t timestamp;
+            char* data;
+            int size;
+            if ((ret = srs_rtmp_read_packet(rtmp, &type, &timestamp, &data, &size)) != 0) {
+                break;
+            }
+
+            if (srs_utils_flv_tag_is_av(type)) {
+                int64_t time = srs_utils_flv_tag_is_video(type)? srs_bench_sei_video(data, size) : -1;
+                on_msg(time);
+            }
+            free(data);
+        }
+    }
+
+    srs_rtmp_destroy(rtmp);
+
+    return _srs_bench_quit? ERROR_BENCH_QUIT : ret;
+}
+
+int SrsBenchPlayer::play_flv()
+{
+    int ret = ERROR_SUCCESS;
+
+    SrsBenchHttp http;
+    if ((ret = http.get(_srs_bench_opts->play_url)) != ERROR_SUCCESS) {
+        return ret;
+    }
+
+    char header[SRS_BENCH_FLV_HEADER];
+    if ((ret = http.read_fully(header, SRS_BENCH_FLV_HEADER)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if (header[0] != 'F' || header[1] != 'L' || header[2] != 'V') {
+        return ERROR_BENCH_FLV_HEADER;
+    }
+
+    vector<char> data;
+    while (!_srs_bench_quit) {
+        // tag header(11B), tag data, and previous tag size(4B).
+        char th[11];
+        if ((ret = http.read_fully(th, 11)) != ERROR_SUCCESS) {
+            break;
+        }
+
+        char type = th[0] & 0x1f;
+        int size = ((u_int8_t)th[1] << 16) | ((u_int8_t)th[2] << 8) | (u_int8_t)th[3];
+        if ((int)data.size() < size + 4) {
+            data.resize(size + 4);
+        }
+        if ((ret = http.read_fully(&data[0], size + 4)) != ERROR_SUCCESS) {
+            break;
+        }
+
+        if (srs_utils_flv_tag_is_av(type)) {
+            int64_t time = srs_utils_flv_tag_is_video(type)? srs_bench_sei_video(&data[0], size) : -1;
+            on_msg(time);
+        }
+    }
+
+    return _srs_bench_quit? ERROR_BENCH_QUIT : ret;
+}
+
+int SrsBenchPlayer::play_hls()
+{
+    int ret = ERROR_SUCCESS;
+
+    string url = _srs_bench_opts->play_url;
+    string base = url.substr(0, url.rfind("/") + 1);
+    // the last sequence got, -1 to start at the last segment.
+    int64_t last_seq = -1;
+
+    while (!_srs_bench_quit) {
+        string m3u8;
+        if (true) {
+            SrsBenchHttp http;
+            if ((ret = http.get(url)) != ERROR_SUCCESS || (ret = http.read_all(m3u8)) != ERROR_SUCCESS) {
+                return ret;
+            }
+        }
+
+        // parse the sequence and segments of m3u8.
+        int target = 10;
+        int64_t seq = 0;
+        vector<string> segments;
+
+        stringstream ss(m3u8);
+        string line;
+        while (getline(ss, line)) {
+            if (!line.empty() && line.at(line.length() - 1) == '\r') {
+                line.erase(line.length() - 1);
+            }
+            if (line.find("#EXT-X-TARGETDURATION:") == 0) {
+                target = ::atoi(line.substr(22).c_str());
+            } else if (line.find("#EXT-X-MEDIA-SEQUENCE:") == 0) {
+                seq = ::atoll(line.substr(22).c_str());
+            } else if (!line.empty() && line.at(0) != '#') {
+                segments.push_back(line.find("http://") == 0? line : base + line);
+            }
+        }
+
+        if (last_seq < 0) {
+            last_seq = seq + (int64_t)segments.size() - 2;
+        }
+
+        for (int i = 0; i < (int)segments.size() && !_srs_bench_quit; i++) {
+            if (seq + i <= last_seq) {
+                continue;
+            }
+
+            string ts;
+            if (true) {
+                SrsBenchHttp http;
+                if ((ret = http.get(segments.at(i))) != ERROR_SUCCESS || (ret = http.read_all(ts)) != ERROR_SUCCESS) {
+                    return ret;
+                }
+            }
+            last_seq = seq + i;
+
+            // join the payloads of ts packets, to find the SEI of each frame.
+            string es;
+            for (int pos = 0; pos + 188 <= (int)ts.length(); pos += 188) {
+                const u_int8_t* p = (const u_int8_t*)ts.data() + pos;
+                if (p[0] != 0x47) {
+                    continue;
+                }
+
+                int afc = (p[3] >> 4) & 0x03;
+                int offset = 4 + ((afc & 0x02)? 1 + p[4] : 0);
+                if ((afc & 0x01) && offset < 188) {
+                    es.append((const char*)p + offset, 188 - offset);
+                }
+            }
+
+            const char* start = es.data();
+            const char* end = start + es.length();
+            bool got_sei = false;
+            while (start < end) {
+                const char* p = (const char*)memmem(start, end - start, SRS_BENCH_SEI_UUID, SRS_BENCH_SEI_UUID_SIZE);
+                if (!p || p + SRS_BENCH_SEI_UUID_SIZE + SRS_BENCH_SEI_TIME_SIZE > end) {
+                    break;
+                }
+                on_msg(srs_bench_sei_parse(p + SRS_BENCH_SEI_UUID_SIZE));
+                got_sei = true;
+                start = p + SRS_BENCH_SEI_UUID_SIZE;
+            }
+            if (!got_sei) {
+                on_msg(-1);
+            }
+        }
+
+        // refresh the m3u8 in half of target duration.
+        st_usleep(((target > 1)? target : 1) * 500 * 1000LL);
+    }
+
+    return _srs_bench_quit? ERROR_BENCH_QUIT : ret;
+}
+
+int SrsBenchPlayer::on_msg(int64_t time)
+{
+    int ret = ERROR_SUCCESS;
+
+    SrsBenchStat* stat = _srs_bench_stat;
+    int64_t now = srs_bench_time_ms();
+
+    stat->play_msgs++;
+
+    if (firsttime < 0) {
+        firsttime = now;
+        stat->nb_connected++;
+        stat->startup.add(now - starttime);
+    }
+
+    // ignore the msgs of gop cache, which is dumped when start.
+    if (time > 0 && now - firsttime >= _srs_bench_opts->warmup) {
+        stat->latency.add(now - time);
+    }
+
+    return ret;
+}
+
+void* srs_bench_player(void* arg)
+{
+    SrsBenchPlayer* player = (SrsBenchPlayer*)arg;
+    player->cycle();
+    delete player;
+
+    return NULL;
+}
+
+void* srs_bench_starter(void* /*arg*/)
+{
+    SrsBenchOptions* opts = _srs_bench_opts;
+
+    // start the players by schedule, never wait for them.
+    int64_t starttime = srs_bench_time_ms();
+    for (int i = 0; i < opts->nb_players && !_srs_bench_quit; i++) {
+        if (opts->rate > 0) {
+            int64_t due = starttime + (int64_t)(i * 1000 / opts->rate);
+            int64_t now = srs_bench_time_ms();
+            if (due > now) {
+                st_usleep((due - now) * 1000);
+            }
+        }
+
+        if (st_thread_create(srs_bench_player, new SrsBenchPlayer(i), 0, 0) == NULL) {
+            srs_bench_trace("create player %d failed", i);
+            _srs_bench_stat->nb_failed++;
+        }
+    }
+
+    srs_bench_trace("all %d players started", opts->nb_players);
+    srs_bench_snapshot();
+
+    return NULL;
+}
+
+/*************************************************************
+**************************************************************
+* the main entrance and report.
+**************************************************************
+*************************************************************/
+void srs_bench_report(FILE* f)
+{
+    SrsBenchStat* stat = _srs_bench_stat;
+    SrsBenchOptions* opts = _srs_bench_opts;
+
+    // the throughput and cpu of steady state, when all players started.
+    int64_t now = srs_bench_time_ms();
+    int64_t elapsed = now - stat->snapshot_time;
+    elapsed = (elapsed > 0)? elapsed : 1;
+
+    int alive = stat->nb_connected - stat->nb_dropped;
+    int kbps = (int)((stat->recv_bytes - stat->snapshot_recv_bytes) * 8 / elapsed);
+
+    double server_cpu = -1;
+    int64_t server_cputime = srs_bench_server_cpu(opts->pid);
+    if (server_cputime >= 0 && stat->snapshot_server_cpu >= 0) {
+        server_cpu = (server_cputime - stat->snapshot_server_cpu) * 100.0 / elapsed;
+    }
+    double bench_cpu = (srs_bench_self_cpu() - stat->snapshot_bench_cpu) * 100.0 / elapsed;
+
+    stringstream ss;
+    ss << "{"
+        << "\"code\":0,"
+        << "\"elapsed\":" << elapsed << ","
+        << "\"publish\":{"
+            << "\"url\":\"" << (opts->publish_url? opts->publish_url : "") << "\","
+            << "\"msgs\":" << stat->pub_msgs << ","
+            << "\"late\":" << stat->pub_late << ","
+            << "\"error\":" << stat->pub_error
+        << "},"
+        << "\"play\":{"
+            << "\"url\":\"" << (opts->play_url? opts->play_url : "") << "\","
+            << "\"type\":\"" << opts->play_type << "\","
+            << "\"players\":" << opts->nb_players << ","
+            << "\"rate\":" << opts->rate << ","
+            << "\"started\":" << stat->nb_started << ","
+            << "\"connected\":" << stat->nb_connected << ","
+            << "\"failed\":" << stat->nb_failed << ","
+            << "\"dropped\":" << stat->nb_dropped << ","
+            << "\"alive\":" << alive << ","
+            << "\"msgs\":" << stat->play_msgs << ","
+            << "\"kbps\":" << kbps << ","
+            << "\"kbps_per_player\":" << (alive > 0? kbps / alive : 0) << ","
+            << "\"startup_ms\":";
+    stat->startup.dumps(ss);
+    ss      << ","
+            << "\"latency_ms\":";
+    stat->latency.dumps(ss);
+    ss  << "},"
+        << "\"cpu\":{"
+            << "\"pid\":" << opts->pid << ","
+            << "\"server\":" << server_cpu << ","
+            << "\"per_viewer\":" << ((server_cpu >= 0 && alive > 0)? server_cpu / alive : -1) << ","
+            << "\"bench\":" << bench_cpu
+        << "}"
+    << "}";
+
+    fprintf(f, "%s\n", ss.str().c_str());
+}
+
+void srs_bench_help(char** argv)
+{
+    printf("open-loop load generator and fan-out benchmark of SRS, by srs-librtmp and st.\n"
+        "Usage: %s [-i <in_flv_file> -p <publish_url>] [-u <play_url> -c <players>] [options]\n"
+        "   -i in_flv_file      the flv file to publish in loop, the AVC with 4B NALU length.\n"
+        "   -p publish_url      the rtmp url to publish, no publisher if not specified.\n"
+        "   -u play_url         the url to play, default to the publish url, which is:\n"
+        "                           rtmp://... for RTMP, http://....flv for HTTP-FLV, http://....m3u8 for HLS.\n"
+        "   -c players          the number of players, default 0.\n"
+        "   -r rate             the players to start per second, default 0 to start all at once.\n"
+        "   -d duration         the duration in seconds, default 60.\n"
+        "   -w warmup           ignore the latency in the first warmup ms of player, for gop cache. default 1000.\n"
+        "   -P pid              the pid of srs server to stat the cpu per viewer.\n"
+        "   -o output           write the json report to file, default to stdout.\n"
+        "Remark: the kbps and cpu are sampled after all players started, the elapsed of report.\n"
+        "Remark: the latency needs the publisher and players in the same host, or the clock synced.\n"
+        "Remark: run ulimit -HSn 65535 for lots of players.\n"
+        "For example:\n"
+        "   %s -i doc/source.200kbps.768x320.flv -p rtmp://127.0.0.1/live/bench -c 1000 -r 100 -d 60 -P `cat objs/srs.pid`\n"
+        "   %s -i doc/source.200kbps.768x320.flv -p rtmp://127.0.0.1/live/bench -u http://127.0.0.1:8080/live/bench.flv -c 1000\n"
+        "   %s -u http://127.0.0.1:8080/live/bench.m3u8 -c 100 -r 10\n",
+        argv[0], argv[0], argv[0], argv[0]);
+}
+
+int main(int argc, char** argv)
+{
+    SrsBenchOptions* opts = _srs_bench_opts;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:p:u:c:r:d:w:P:o:h")) != -1) {
+        switch (opt) {
+            case 'i': opts->input = optarg; break;
+            case 'p': opts->publish_url = optarg; break;
+            case 'u': opts->play_url = optarg; break;
+            case 'c': opts->nb_players = ::atoi(optarg); break;
+            case 'r': opts->rate = ::atof(optarg); break;
+            case 'd': opts->duration = ::atoi(optarg); break;
+            case 'w': opts->warmup = ::atoi(optarg); break;
+            case 'P': opts->pid = ::atoi(optarg); break;
+            case 'o': opts->output = optarg; break;
+            default: srs_bench_help(argv); exit(-1);
+        }
+    }
+
+    if (!opts->play_url) {
+        opts->play_url = opts->publish_url;
+    }
+    if ((opts->publish_url && !opts->input) || (!opts->publish_url && opts->nb_players <= 0)
+        || (opts->nb_players > 0 && !opts->play_url)
+    ) {
+        srs_bench_help(argv);
+        exit(-1);
+    }
+
+    string url = opts->play_url? opts->play_url : "";
+    if (url.find("http://") != 0) {
+        opts->play_type = "rtmp";
+    } else if (url.find(".m3u8") != string::npos) {
+        opts->play_type = "hls";
+    } else {
+        opts->play_type = "flv";
+    }
+
+    // lots of players, use all fds and ignore the SIGPIPE.
+    rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    // use epoll for lots of fds, ignore when not supported.
+    st_set_eventsys(ST_EVENTSYS_ALT);
+    if (st_init() != 0) {
+        srs_bench_trace("st init failed");
+        exit(-1);
+    }
+    srs_bench_trace("bench %s %d players of %s, rate=%.2f, duration=%ds, eventsys=%s",
+        opts->play_type, opts->nb_players, url.c_str(), opts->rate, opts->duration, st_get_eventsys_name());
+
+    srs_bench_snapshot();
+
+    if (opts->publish_url && st_thread_create(srs_bench_publisher, NULL, 0, 0) == NULL) {
+        srs_bench_trace("create publisher failed");
+        exit(-1);
+    }
+
+    // wait for publisher to publish the stream.
+    if (opts->publish_url && opts->nb_players > 0) {
+        st_usleep(1000 * 1000);
+    }
+    if (opts->nb_players > 0 && st_thread_create(srs_bench_starter, NULL, 0, 0) == NULL) {
+        srs_bench_trace("create starter failed");
+        exit(-1);
+    }
+
+    SrsBenchStat* stat = _srs_bench_stat;
+    int64_t starttime = srs_bench_time_ms();
+    int64_t endtime = starttime + opts->duration * 1000LL;
+    for (;;) {
+        int64_t now = srs_bench_time_ms();
+        if (now >= endtime) {
+            break;
+        }
+        st_usleep(((endtime - now < SRS_BENCH_PRINT_MS)? endtime - now : SRS_BENCH_PRINT_MS) * 1000);
+
+        srs_bench_trace("players=%d/%d/%d, failed=%d, dropped=%d, publish=%d/%d, latency p50=%dms, p99=%dms",
+            stat->nb_connected, stat->nb_started, opts->nb_players, stat->nb_failed, stat->nb_dropped,
+            (int)stat->pub_msgs, (int)stat->pub_late,
+            (int)stat->latency.percentile(0.5), (int)stat->latency.percentile(0.99));
+    }
+    _srs_bench_quit = true;
+
+    FILE* f = stdout;
+    if (opts->output && (f = fopen(opts->output, "w")) == NULL) {
+        srs_bench_trace("open %s failed", opts->output);
+        f = stdout;
+    }
+    srs_bench_report(f);
+    if (f != stdout) {
+        fclose(f);
+    }
+
+    // the threads are blocked in io, exit without cleanup.
+    exit(0);
+
+    return 0;
+}
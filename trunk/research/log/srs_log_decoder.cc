@@ -0,0 +1,397 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+/**
+g++ -o srs_log_decoder srs_log_decoder.cc -g -O0 -ansi
+*/
+/**
+decode the binary log of srs, @see srs_log_format of conf/full.conf
+usage:
+    ./srs_log_decoder [-u] <binary_log_file>
+        -u  use utc time, default to localtime.
+the binary log file is a sequence of chunks, each chunk is:
+    magic(4B, SRSB), pid(4B), size(4B), records(size bytes)
+the records of a pid is a stream, a record maybe in two chunks.
+each record is size(2B), type(1B), level(1B), then the payload by type:
+    log: time(8B), fmt_id(4B), tag_id(4B), cid(4B), errno(4B), args.
+    string: id(4B), the string to end of record.
+    dropped: time(8B), count(4B).
+all numbers are big-endian.
+*/
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#define SRS_BINARY_LOG_MAGIC 0x53525342
+#define SRS_BINARY_LOG_CHUNK_HEADER 12
+
+#define RECORD_LOG 0
+#define RECORD_STRING 1
+#define RECORD_DROPPED 2
+
+// the levels of SrsLogLevel.
+static const char* level_names[] = {"", "verb", "debug", "trace", "warn", "error"};
+
+static bool utc = false;
+
+struct Stream
+{
+    // the bytes not decoded, maybe a partial record.
+    std::string buf;
+    // the fmt and tag strings, key is id.
+    std::map<uint32_t, std::string> strings;
+};
+
+static uint64_t read_be(const char* p, int n)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < n; i++) {
+        v = (v << 8) | (uint8_t)p[i];
+    }
+    return v;
+}
+
+/**
+ * the args reader of log record.
+ */
+class Args
+{
+private:
+    const char* p;
+    const char* end;
+public:
+    Args(const char* b, const char* e) : p(b), end(e) {}
+public:
+    bool int32(int32_t& v) {
+        if (end - p < 4) return false;
+        v = (int32_t)read_be(p, 4); p += 4;
+        return true;
+    }
+    bool int64(int64_t& v) {
+        if (end - p < 8) return false;
+        v = (int64_t)read_be(p, 8); p += 8;
+        return true;
+    }
+    bool str(std::string& v) {
+        if (end - p < 2) return false;
+        int len = (int)read_be(p, 2); p += 2;
+        if (end - p < len) return false;
+        v.assign(p, len); p += len;
+        return true;
+    }
+};
+
+/**
+ * format the fmt with args, each spec is formatted by snprintf,
+ * the same rules as srs_binary_log_parse of srs_app_log.cpp.
+ */
+static std::string format(const std::string& fmt, Args& args)
+{
+    std::string out;
+    char buf[4096];
+    
+    const char* p = fmt.c_str();
+    while (*p) {
+        if (*p != '%') {
+            out += *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out += '%';
+            p += 2;
+            continue;
+        }
+        
+        std::string spec = "%";
+        p++;
+        
+        // flags.
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' || *p == '\'') {
+            spec += *p++;
+        }
+        
+        // width, the * is replaced by the arg.
+        int32_t v32 = 0;
+        if (*p == '*') {
+            if (!args.int32(v32)) return out + "<truncated>";
+            snprintf(buf, sizeof(buf), "%d", v32);
+            spec += buf;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            spec += *p++;
+        }
+        
+        // precision.
+        if (*p == '.') {
+            spec += *p++;
+            if (*p == '*') {
+                if (!args.int32(v32)) return out + "<truncated>";
+                snprintf(buf, sizeof(buf), "%d", v32);
+                spec += buf;
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') {
+                spec += *p++;
+            }
+        }
+        
+        // length, the int64 is always ll, and keep the h for int32.
+        int nb_long = 0;
+        bool is_int64 = false;
+        std::string shorts;
+        while (*p == 'h' || *p == 'l' || *p == 'j' || *p == 'z' || *p == 't' || *p == 'q') {
+            if (*p == 'h') shorts += 'h';
+            if (*p == 'l') nb_long++;
+            if (*p == 'j' || *p == 'q' || *p == 'z' || *p == 't') {
+                is_int64 = sizeof(size_t) == 8 || *p == 'j' || *p == 'q';
+            }
+            p++;
+        }
+        if (nb_long > 1 || (nb_long == 1 && sizeof(long) == 8)) {
+            is_int64 = true;
+        }
+        
+        char c = *p;
+        if (!c) {
+            break;
+        }
+        p++;
+        
+        int64_t v64 = 0;
+        std::string s;
+        switch (c) {
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+                if (is_int64) {
+                    if (!args.int64(v64)) return out + "<truncated>";
+                    spec += "ll";
+                    spec += c;
+                    snprintf(buf, sizeof(buf), spec.c_str(), (long long)v64);
+                } else {
+                    if (!args.int32(v32)) return out + "<truncated>";
+                    spec += shorts;
+                    spec += c;
+                    snprintf(buf, sizeof(buf), spec.c_str(), v32);
+                }
+                break;
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': {
+                if (!args.int64(v64)) return out + "<truncated>";
+                double d = 0;
+                memcpy(&d, &v64, 8);
+                spec += c;
+                snprintf(buf, sizeof(buf), spec.c_str(), d);
+                break;
+            }
+            case 's':
+                if (!args.str(s)) return out + "<truncated>";
+                spec += c;
+                snprintf(buf, sizeof(buf), spec.c_str(), s.c_str());
+                break;
+            case 'p':
+                if (!args.int64(v64)) return out + "<truncated>";
+                spec += c;
+                snprintf(buf, sizeof(buf), spec.c_str(), (void*)(intptr_t)v64);
+                break;
+            default:
+                snprintf(buf, sizeof(buf), "<unsupported %%%c>", c);
+                break;
+        }
+        out += buf;
+    }
+    
+    return out;
+}
+
+static std::string format_time(int64_t time)
+{
+    time_t sec = (time_t)(time / 1000000);
+    struct tm* tm = utc? gmtime(&sec) : localtime(&sec);
+    
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%d-%02d-%02d %02d:%02d:%02d.%03d", 
+        1900 + tm->tm_year, 1 + tm->tm_mon, tm->tm_mday, tm->tm_hour, tm->tm_min, tm->tm_sec, (int)((time % 1000000) / 1000));
+    return buf;
+}
+
+/**
+ * decode a record, print the log in the same format of text log.
+ */
+static void decode_record(uint32_t pid, Stream& stream, const char* p, int size)
+{
+    int type = (uint8_t)p[2];
+    int level = (uint8_t)p[3];
+    
+    if (type == RECORD_STRING && size >= 8) {
+        uint32_t id = (uint32_t)read_be(p + 4, 4);
+        stream.strings[id] = std::string(p + 8, size - 8);
+        return;
+    }
+    
+    if (type == RECORD_DROPPED && size >= 16) {
+        int64_t time = (int64_t)read_be(p + 4, 8);
+        int count = (int)read_be(p + 12, 4);
+        printf("[%s][warn][%u][0][0] binary log dropped %d logs, the ring is full\n", 
+            format_time(time).c_str(), pid, count);
+        return;
+    }
+    
+    if (type != RECORD_LOG || size < 28) {
+        fprintf(stderr, "invalid record, pid=%u, type=%d, size=%d\n", pid, type, size);
+        return;
+    }
+    
+    int64_t time = (int64_t)read_be(p + 4, 8);
+    uint32_t fmt_id = (uint32_t)read_be(p + 12, 4);
+    uint32_t tag_id = (uint32_t)read_be(p + 16, 4);
+    int cid = (int)read_be(p + 20, 4);
+    int err = (int)read_be(p + 24, 4);
+    
+    if (level <= 0 || level > 5) {
+        level = 3;
+    }
+    
+    std::string header = "[" + format_time(time) + "][" + level_names[level] + "]";
+    if (tag_id) {
+        header += "[" + stream.strings[tag_id] + "]";
+    }
+    
+    char buf[64];
+    if (level >= 4) {
+        snprintf(buf, sizeof(buf), "[%u][%d][%d] ", pid, cid, err);
+    } else {
+        snprintf(buf, sizeof(buf), "[%u][%d] ", pid, cid);
+    }
+    header += buf;
+    
+    std::map<uint32_t, std::string>::iterator it = stream.strings.find(fmt_id);
+    if (it == stream.strings.end()) {
+        printf("%s<undefined fmt %u>\n", header.c_str(), fmt_id);
+        return;
+    }
+    
+    Args args(p + 28, p + size);
+    std::string msg = format(it->second, args);
+    
+    // the error log appends the strerror.
+    if (level == 5 && err != 0) {
+        msg += "(";
+        msg += strerror(err);
+        msg += ")";
+    }
+    
+    printf("%s%s\n", header.c_str(), msg.c_str());
+}
+
+int main(int argc, char** argv)
+{
+    const char* file = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-u")) {
+            utc = true;
+        } else {
+            file = argv[i];
+        }
+    }
+    
+    if (!file) {
+        printf("decode the binary log of srs to text.\n"
+            "Usage: %s [-u] <binary_log_file>\n"
+            "       -u  use utc time, default to localtime.\n"
+            "For example:\n"
+            "       %s ./objs/srs.log\n", argv[0], argv[0]);
+        return -1;
+    }
+    
+    FILE* f = fopen(file, "rb");
+    if (!f) {
+        fprintf(stderr, "open file %s failed.\n", file);
+        return -1;
+    }
+    
+    std::vector<char> data;
+    char buf[64 * 1024];
+    size_t nread = 0;
+    while ((nread = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data.insert(data.end(), buf, buf + nread);
+    }
+    fclose(f);
+    
+    std::map<uint32_t, Stream> streams;
+    int64_t nb_skipped = 0;
+    
+    size_t pos = 0;
+    while (pos + SRS_BINARY_LOG_CHUNK_HEADER <= data.size()) {
+        const char* p = &data[pos];
+        
+        // skip the bytes not chunk, for example, the text log.
+        if (read_be(p, 4) != SRS_BINARY_LOG_MAGIC) {
+            pos++;
+            nb_skipped++;
+            continue;
+        }
+        
+        uint32_t pid = (uint32_t)read_be(p + 4, 4);
+        uint32_t size = (uint32_t)read_be(p + 8, 4);
+        if (pos + SRS_BINARY_LOG_CHUNK_HEADER + size > data.size()) {
+            fprintf(stderr, "chunk truncated, pid=%u, size=%u\n", pid, size);
+            break;
+        }
+        pos += SRS_BINARY_LOG_CHUNK_HEADER + size;
+        
+        Stream& stream = streams[pid];
+        stream.buf.append(p + SRS_BINARY_LOG_CHUNK_HEADER, size);
+        
+        // decode all the complete records.
+        size_t consumed = 0;
+        while (stream.buf.size() - consumed >= 4) {
+            const char* r = stream.buf.data() + consumed;
+            int nb_record = (int)read_be(r, 2);
+            if (nb_record < 4) {
+                fprintf(stderr, "invalid record size %d, pid=%u\n", nb_record, pid);
+                consumed = stream.buf.size();
+                break;
+            }
+            if (stream.buf.size() - consumed < (size_t)nb_record) {
+                break;
+            }
+            decode_record(pid, stream, r, nb_record);
+            consumed += nb_record;
+        }
+        stream.buf.erase(0, consumed);
+    }
+    
+    if (nb_skipped > 0) {
+        fprintf(stderr, "skipped %lld bytes not in chunk.\n", (long long)nb_skipped);
+    }
+    
+    return 0;
+}
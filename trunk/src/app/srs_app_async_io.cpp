@@ -0,0 +1,588 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <srs_app_async_io.hpp>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+using namespace std;
+
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+
+// whether current process is forked from the process which started the pool,
+// the native threads never exists in the child process.
+static bool _srs_async_io_forked = false;
+
+static void srs_async_io_on_fork()
+{
+    _srs_async_io_forked = true;
+}
+
+SrsAsyncIoFile::SrsAsyncIoFile(int f, SrsAsyncIoWorker* w)
+{
+    fd = f;
+    worker = w;
+    pending_bytes = 0;
+    pending_tasks = 0;
+    error = ERROR_SUCCESS;
+    nb_dropped = 0;
+    waiting = false;
+    cond = st_cond_new();
+}
+
+SrsAsyncIoFile::~SrsAsyncIoFile()
+{
+    st_cond_destroy(cond);
+}
+
+SrsAsyncIoTask::SrsAsyncIoTask(SrsAsyncIoTaskType t, SrsAsyncIoFile* f)
+{
+    type = t;
+    file = f;
+    buf = NULL;
+    size = 0;
+    offset = 0;
+    err = 0;
+}
+
+SrsAsyncIoTask::~SrsAsyncIoTask()
+{
+    srs_freepa(buf);
+}
+
+void SrsAsyncIoTask::execute()
+{
+    if (type == SrsAsyncIoTaskWrite) {
+        char* p = buf;
+        int left = size;
+        while (left > 0) {
+            ssize_t nwrite = ::write(file->fd, p, left);
+            if (nwrite < 0 && errno == EINTR) {
+                continue;
+            }
+            if (nwrite < 0) {
+                err = errno;
+                return;
+            }
+            p += nwrite;
+            left -= (int)nwrite;
+        }
+    } else if (type == SrsAsyncIoTaskSeek) {
+        if (::lseek(file->fd, (off_t)offset, SEEK_SET) < 0) {
+            err = errno;
+        }
+    } else if (type == SrsAsyncIoTaskReadahead) {
+#ifndef SRS_OSX
+        if (::readahead(file->fd, (off64_t)offset, (size_t)size) < 0) {
+            err = errno;
+        }
+#else
+        radvisory ra;
+        ra.ra_offset = (off_t)offset;
+        ra.ra_count = size;
+        if (::fcntl(file->fd, F_RDADVISE, &ra) < 0) {
+            err = errno;
+        }
+#endif
+    } else if (type == SrsAsyncIoTaskClose) {
+        if (::close(file->fd) < 0) {
+            err = errno;
+        }
+    }
+}
+
+SrsAsyncIoWorker::SrsAsyncIoWorker(SrsAsyncIo* p)
+{
+    pool = p;
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+}
+
+SrsAsyncIoWorker::~SrsAsyncIoWorker()
+{
+    // the worker is never stopped, for the native thread never quit.
+}
+
+int SrsAsyncIoWorker::start()
+{
+    int ret = ERROR_SUCCESS;
+    
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    
+    int r0 = pthread_create(&tid, &attr, worker_thread, this);
+    pthread_attr_destroy(&attr);
+    
+    if (r0 != 0) {
+        ret = ERROR_SYSTEM_ASYNC_IO_THREAD;
+        srs_error("create async io thread failed, r0=%d. ret=%d", r0, ret);
+        return ret;
+    }
+    
+    return ret;
+}
+
+void SrsAsyncIoWorker::submit(SrsAsyncIoTask* task)
+{
+    pthread_mutex_lock(&lock);
+    tasks.push_back(task);
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&lock);
+}
+
+void* SrsAsyncIoWorker::worker_thread(void* arg)
+{
+    // the signals are always handled by st.
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    
+    SrsAsyncIoWorker* worker = (SrsAsyncIoWorker*)arg;
+    worker->cycle();
+    
+    return NULL;
+}
+
+void SrsAsyncIoWorker::cycle()
+{
+    std::vector<SrsAsyncIoTask*> executing;
+    
+    for (;;) {
+        pthread_mutex_lock(&lock);
+        while (tasks.empty()) {
+            pthread_cond_wait(&cond, &lock);
+        }
+        executing.swap(tasks);
+        pthread_mutex_unlock(&lock);
+        
+        std::vector<SrsAsyncIoTask*>::iterator it;
+        for (it = executing.begin(); it != executing.end(); ++it) {
+            SrsAsyncIoTask* task = *it;
+            task->execute();
+        }
+        
+        pool->on_completed(executing);
+        executing.clear();
+    }
+}
+
+SrsAsyncIo* SrsAsyncIo::_instance = new SrsAsyncIo();
+
+SrsAsyncIo::SrsAsyncIo()
+{
+    next_worker = 0;
+    max_pending = 0;
+    started = false;
+    pending_tasks = 0;
+    drained = NULL;
+    
+    pthread_mutex_init(&lock, NULL);
+    pipes[0] = pipes[1] = -1;
+    read_stfd = NULL;
+    pthread = NULL;
+}
+
+SrsAsyncIo::~SrsAsyncIo()
+{
+    // the pool is never destroyed, for the native thread never quit.
+}
+
+SrsAsyncIo* SrsAsyncIo::instance()
+{
+    return _instance;
+}
+
+int SrsAsyncIo::initialize(int nb_threads, int max_pending_bytes)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if (started) {
+        return ret;
+    }
+    
+    srs_assert(nb_threads > 0);
+    max_pending = max_pending_bytes;
+    drained = st_cond_new();
+    
+    if (pipe(pipes) < 0) {
+        ret = ERROR_SYSTEM_CREATE_PIPE;
+        srs_error("create async io pipe failed. ret=%d", ret);
+        return ret;
+    }
+    
+    if ((read_stfd = st_netfd_open(pipes[0])) == NULL) {
+        ret = ERROR_SYSTEM_CREATE_PIPE;
+        srs_error("create async io st pipe failed. ret=%d", ret);
+        return ret;
+    }
+    
+    for (int i = 0; i < nb_threads; i++) {
+        SrsAsyncIoWorker* worker = new SrsAsyncIoWorker(this);
+        if ((ret = worker->start()) != ERROR_SUCCESS) {
+            srs_freep(worker);
+            return ret;
+        }
+        workers.push_back(worker);
+    }
+    
+    pthread = new SrsEndlessThread("aio", this);
+    if ((ret = pthread->start()) != ERROR_SUCCESS) {
+        srs_error("start async io st thread failed. ret=%d", ret);
+        return ret;
+    }
+    
+    pthread_atfork(NULL, NULL, srs_async_io_on_fork);
+    started = true;
+    
+    srs_trace("async io started, threads=%d, max_pending=%d", nb_threads, max_pending);
+    
+    return ret;
+}
+
+bool SrsAsyncIo::enabled()
+{
+    return started && !_srs_async_io_forked;
+}
+
+SrsAsyncIoFile* SrsAsyncIo::open(int fd)
+{
+    srs_assert(enabled());
+    
+    SrsAsyncIoWorker* worker = workers.at(next_worker++ % (int)workers.size());
+    return new SrsAsyncIoFile(fd, worker);
+}
+
+int SrsAsyncIo::writev(SrsAsyncIoFile* file, iovec* iov, int iovcnt, bool wait)
+{
+    int ret = ERROR_SUCCESS;
+    
+    int size = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        size += (int)iov[i].iov_len;
+    }
+    
+    // the backpressure, allow one write at least.
+    while (file->pending_bytes > 0 && file->pending_bytes + size > max_pending) {
+        if (!wait) {
+            file->nb_dropped++;
+            return ERROR_SYSTEM_ASYNC_IO_FULL;
+        }
+        st_cond_wait(file->cond);
+    }
+    
+    if (file->error != ERROR_SUCCESS) {
+        return file->error;
+    }
+    
+    SrsAsyncIoTask* task = new SrsAsyncIoTask(SrsAsyncIoTaskWrite, file);
+    task->buf = new char[size];
+    task->size = size;
+    
+    char* p = task->buf;
+    for (int i = 0; i < iovcnt; i++) {
+        memcpy(p, iov[i].iov_base, iov[i].iov_len);
+        p += iov[i].iov_len;
+    }
+    
+    file->pending_bytes += size;
+    submit(task);
+    
+    return ret;
+}
+
+int SrsAsyncIo::seek(SrsAsyncIoFile* file, int64_t offset)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if (file->error != ERROR_SUCCESS) {
+        return file->error;
+    }
+    
+    SrsAsyncIoTask* task = new SrsAsyncIoTask(SrsAsyncIoTaskSeek, file);
+    task->offset = offset;
+    submit(task);
+    
+    return ret;
+}
+
+void SrsAsyncIo::readahead(SrsAsyncIoFile* file, int64_t offset, int size)
+{
+    SrsAsyncIoTask* task = new SrsAsyncIoTask(SrsAsyncIoTaskReadahead, file);
+    task->offset = offset;
+    task->size = size;
+    submit(task);
+}
+
+void SrsAsyncIo::wait(SrsAsyncIoFile* file, int nb_tasks)
+{
+    while (file->pending_tasks > nb_tasks) {
+        st_cond_wait(file->cond);
+    }
+}
+
+int SrsAsyncIo::close(SrsAsyncIoFile* file, bool wait)
+{
+    int ret = ERROR_SUCCESS;
+    
+    file->waiting = wait;
+    submit(new SrsAsyncIoTask(SrsAsyncIoTaskClose, file));
+    
+    if (!wait) {
+        return ret;
+    }
+    
+    while (file->pending_tasks > 0) {
+        st_cond_wait(file->cond);
+    }
+    
+    ret = file->error;
+    srs_freep(file);
+    
+    return ret;
+}
+
+int SrsAsyncIo::drain(int64_t timeout)
+{
+    if (!enabled()) {
+        return 0;
+    }
+    
+    int64_t deadline = srs_update_system_time_ms() + timeout;
+    while (pending_tasks > 0) {
+        int64_t left = deadline - srs_update_system_time_ms();
+        if (left <= 0) {
+            break;
+        }
+        st_cond_timedwait(drained, left * 1000);
+    }
+    
+    return pending_tasks;
+}
+
+int SrsAsyncIo::cycle()
+{
+    int ret = ERROR_SUCCESS;
+    
+    char buf[64];
+    if (st_read(read_stfd, buf, sizeof(buf), ST_UTIME_NO_TIMEOUT) <= 0) {
+        ret = ERROR_SYSTEM_CREATE_PIPE;
+        srs_error("read async io pipe failed. ret=%d", ret);
+        return ret;
+    }
+    
+    std::vector<SrsAsyncIoTask*> tasks;
+    pthread_mutex_lock(&lock);
+    tasks.swap(completed);
+    pthread_mutex_unlock(&lock);
+    
+    std::vector<SrsAsyncIoTask*>::iterator it;
+    for (it = tasks.begin(); it != tasks.end(); ++it) {
+        SrsAsyncIoTask* task = *it;
+        SrsAsyncIoFile* file = task->file;
+        
+        file->pending_tasks--;
+        pending_tasks--;
+        if (task->type == SrsAsyncIoTaskWrite) {
+            file->pending_bytes -= task->size;
+        }
+        
+        // the readahead is only a hint, ignore the error.
+        if (task->err != 0 && task->type != SrsAsyncIoTaskReadahead && file->error == ERROR_SUCCESS) {
+            file->error = (task->type == SrsAsyncIoTaskClose)? ERROR_SYSTEM_FILE_CLOSE : ERROR_SYSTEM_FILE_WRITE;
+            srs_error("async io of fd=%d failed, type=%d, errno=%d. ret=%d", file->fd, task->type, task->err, file->error);
+        }
+        
+        // the close is the last task of file, free it when nobody wait.
+        if (task->type == SrsAsyncIoTaskClose && !file->waiting) {
+            srs_freep(file);
+        } else {
+            st_cond_signal(file->cond);
+        }
+        
+        srs_freep(task);
+    }
+    
+    if (pending_tasks <= 0) {
+        st_cond_signal(drained);
+    }
+    
+    return ret;
+}
+
+void SrsAsyncIo::on_completed(std::vector<SrsAsyncIoTask*>& tasks)
+{
+    pthread_mutex_lock(&lock);
+    
+    // only notify st when the completed is empty,
+    // for the st consume all completed tasks when wakeup.
+    bool notify = completed.empty();
+    completed.insert(completed.end(), tasks.begin(), tasks.end());
+    
+    if (notify) {
+        char v = 0;
+        while (::write(pipes[1], &v, 1) < 0 && errno == EINTR) {
+        }
+    }
+    
+    pthread_mutex_unlock(&lock);
+}
+
+void SrsAsyncIo::submit(SrsAsyncIoTask* task)
+{
+    task->file->pending_tasks++;
+    pending_tasks++;
+    task->file->worker->submit(task);
+}
+
+SrsAsyncFileWriter::SrsAsyncFileWriter()
+{
+    afile = NULL;
+    position = 0;
+}
+
+SrsAsyncFileWriter::~SrsAsyncFileWriter()
+{
+    close();
+}
+
+int SrsAsyncFileWriter::open(string p)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if ((ret = SrsFileWriter::open(p)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    position = 0;
+    attach();
+    
+    return ret;
+}
+
+int SrsAsyncFileWriter::open_append(string p)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if ((ret = SrsFileWriter::open_append(p)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    position = (int64_t)::lseek(fd, 0, SEEK_END);
+    attach();
+    
+    return ret;
+}
+
+void SrsAsyncFileWriter::close()
+{
+    int ret = ERROR_SUCCESS;
+    
+    if (!afile) {
+        SrsFileWriter::close();
+        return;
+    }
+    
+    // wait for all data written, for user may use the file after close,
+    // for example, rename the tmp file and notify the http hooks.
+    SrsAsyncIoFile* file = afile;
+    afile = NULL;
+    fd = -1;
+    
+    if ((ret = SrsAsyncIo::instance()->close(file, true)) != ERROR_SUCCESS) {
+        srs_error("async close file %s failed. ret=%d", path.c_str(), ret);
+        return;
+    }
+}
+
+void SrsAsyncFileWriter::lseek(int64_t offset)
+{
+    if (!afile) {
+        SrsFileWriter::lseek(offset);
+        return;
+    }
+    
+    position = offset;
+    SrsAsyncIo::instance()->seek(afile, offset);
+}
+
+int64_t SrsAsyncFileWriter::tellg()
+{
+    if (!afile) {
+        return SrsFileWriter::tellg();
+    }
+    
+    return position;
+}
+
+int SrsAsyncFileWriter::write(void* buf, size_t count, ssize_t* pnwrite)
+{
+    if (!afile) {
+        return SrsFileWriter::write(buf, count, pnwrite);
+    }
+    
+    iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = count;
+    
+    return writev(&iov, 1, pnwrite);
+}
+
+int SrsAsyncFileWriter::writev(iovec* iov, int iovcnt, ssize_t* pnwrite)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if (!afile) {
+        return SrsFileWriter::writev(iov, iovcnt, pnwrite);
+    }
+    
+    ssize_t nwrite = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        nwrite += iov[i].iov_len;
+    }
+    
+    if ((ret = SrsAsyncIo::instance()->writev(afile, iov, iovcnt, true)) != ERROR_SUCCESS) {
+        srs_error("async write to file %s failed. ret=%d", path.c_str(), ret);
+        return ret;
+    }
+    position += nwrite;
+    
+    if (pnwrite != NULL) {
+        *pnwrite = nwrite;
+    }
+    
+    return ret;
+}
+
+void SrsAsyncFileWriter::attach()
+{
+    if (SrsAsyncIo::instance()->enabled()) {
+        afile = SrsAsyncIo::instance()->open(fd);
+    }
+}
+
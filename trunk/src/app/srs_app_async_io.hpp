@@ -0,0 +1,273 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SRS_APP_ASYNC_IO_HPP
+#define SRS_APP_ASYNC_IO_HPP
+
+/*
+#include <srs_app_async_io.hpp>
+*/
+#include <srs_core.hpp>
+
+#include <pthread.h>
+#include <vector>
+#include <string>
+
+#include <srs_app_st.hpp>
+#include <srs_app_thread.hpp>
+#include <srs_kernel_file.hpp>
+
+class SrsAsyncIo;
+class SrsAsyncIoWorker;
+
+// the max time in ms to wait for the pending tasks when server quit.
+#define SRS_ASYNC_IO_DRAIN_TIMEOUT_MS 3000
+
+/**
+ * the type of async io task.
+ */
+enum SrsAsyncIoTaskType
+{
+    SrsAsyncIoTaskWrite = 0,
+    SrsAsyncIoTaskSeek,
+    SrsAsyncIoTaskClose,
+    SrsAsyncIoTaskReadahead
+};
+
+/**
+ * the file of async io, all io of a file is executed by
+ * the same native thread, so the io is in the order of submit.
+ * @remark the fields are only accessed in st, except the fd.
+ */
+class SrsAsyncIoFile
+{
+public:
+    int fd;
+    // the native thread to execute the io of file.
+    SrsAsyncIoWorker* worker;
+    // the bytes and tasks submitted but not completed.
+    int64_t pending_bytes;
+    int pending_tasks;
+    // the first error of async io, returned by the following io.
+    int error;
+    // the writes dropped for exceed the max pending, when not wait.
+    int64_t nb_dropped;
+    // whether the user wait for the close task, who free the file.
+    bool waiting;
+    // the cond to wait for tasks completed.
+    st_cond_t cond;
+public:
+    SrsAsyncIoFile(int f, SrsAsyncIoWorker* w);
+    virtual ~SrsAsyncIoFile();
+};
+
+/**
+ * the async io task, created and freed in st, executed in native thread.
+ */
+class SrsAsyncIoTask
+{
+public:
+    SrsAsyncIoTaskType type;
+    SrsAsyncIoFile* file;
+    // for write, the copy of data to write.
+    char* buf;
+    int size;
+    // for seek and readahead, the absolute offset.
+    int64_t offset;
+    // the errno when failed, 0 for success.
+    int err;
+public:
+    SrsAsyncIoTask(SrsAsyncIoTaskType t, SrsAsyncIoFile* f);
+    virtual ~SrsAsyncIoTask();
+public:
+    /**
+     * execute the task, in native thread.
+     */
+    virtual void execute();
+};
+
+/**
+ * the native thread to execute the blocking file io,
+ * to never block the st when disk is slow, for example, NFS stall.
+ */
+class SrsAsyncIoWorker
+{
+private:
+    SrsAsyncIo* pool;
+    pthread_t tid;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    // the tasks to execute, protected by lock.
+    std::vector<SrsAsyncIoTask*> tasks;
+public:
+    SrsAsyncIoWorker(SrsAsyncIo* p);
+    virtual ~SrsAsyncIoWorker();
+public:
+    /**
+     * start the native thread.
+     */
+    virtual int start();
+    /**
+     * submit the task to execute in native thread, in order.
+     */
+    virtual void submit(SrsAsyncIoTask* task);
+private:
+    static void* worker_thread(void* arg);
+    virtual void cycle();
+};
+
+/**
+ * the async io pool, a group of native threads to write file.
+ * the io of a file is submit in st and execute in native thread,
+ * when completed, the st thread of pool wakeup the st waiting for it.
+ * the write wait when pending bytes of file exceed the max pending,
+ * that is, the backpressure when disk is slow.
+ * @remark the native thread never use any st or log api.
+ */
+class SrsAsyncIo : public ISrsEndlessThreadHandler
+{
+private:
+    static SrsAsyncIo* _instance;
+private:
+    std::vector<SrsAsyncIoWorker*> workers;
+    // the next worker to bind file.
+    int next_worker;
+    // the max pending bytes of each file.
+    int max_pending;
+    // whether the native threads started.
+    bool started;
+    // the tasks submitted but not completed, of all files.
+    int pending_tasks;
+    // the cond to wait for all tasks completed.
+    st_cond_t drained;
+private:
+    // the tasks completed by native threads, protected by lock.
+    pthread_mutex_t lock;
+    std::vector<SrsAsyncIoTask*> completed;
+    // the native threads notify st by pipe.
+    int pipes[2];
+    st_netfd_t read_stfd;
+    SrsEndlessThread* pthread;
+private:
+    SrsAsyncIo();
+    virtual ~SrsAsyncIo();
+public:
+    static SrsAsyncIo* instance();
+public:
+    /**
+     * start the native threads of pool.
+     * @param nb_threads the number of native threads.
+     * @param max_pending_bytes the max pending bytes of each file.
+     */
+    virtual int initialize(int nb_threads, int max_pending_bytes);
+    /**
+     * whether the pool is started, user should use the sync io when not.
+     * @remark for the forked child process, the pool is never enabled.
+     */
+    virtual bool enabled();
+public:
+    /**
+     * bind the opened fd to a native thread.
+     * @remark the fd is owned by the file, user must close it by close().
+     */
+    virtual SrsAsyncIoFile* open(int fd);
+    /**
+     * write the data to file, the data is copied to one task.
+     * @param wait whether wait when exceed the max pending, otherwise return error.
+     * @return ERROR_SYSTEM_ASYNC_IO_FULL when exceed the max pending and not wait,
+     *       the write is dropped and counted in nb_dropped of file.
+     * @remark user can not know the result of this write, but the error of file.
+     */
+    virtual int writev(SrsAsyncIoFile* file, iovec* iov, int iovcnt, bool wait);
+    /**
+     * seek the file to absolute offset.
+     */
+    virtual int seek(SrsAsyncIoFile* file, int64_t offset);
+    /**
+     * read the size bytes from offset to page cache, for the reader
+     * to read or sendfile in st without blocking on disk.
+     * @remark the error of readahead is ignored, the reader read it again.
+     */
+    virtual void readahead(SrsAsyncIoFile* file, int64_t offset, int size);
+    /**
+     * wait until the pending tasks of file not exceed nb_tasks,
+     * for the tasks of file execute in order, it's used to wait for
+     * the task submitted before the last nb_tasks tasks.
+     */
+    virtual void wait(SrsAsyncIoFile* file, int nb_tasks);
+    /**
+     * close the file, user never use the file after close.
+     * @param wait whether wait for all tasks of file completed.
+     * @return the error of file when wait.
+     */
+    virtual int close(SrsAsyncIoFile* file, bool wait);
+    /**
+     * wait for the pending tasks of all files completed, when server quit,
+     * for the logs and files are written in native threads.
+     * @param timeout the max time in ms to wait.
+     * @return the number of tasks not completed.
+     */
+    virtual int drain(int64_t timeout);
+// interface ISrsEndlessThreadHandler
+public:
+    virtual int cycle();
+private:
+    friend class SrsAsyncIoWorker;
+    /**
+     * when native thread completed the tasks, notify st.
+     * @remark called in native thread.
+     */
+    virtual void on_completed(std::vector<SrsAsyncIoTask*>& tasks);
+    virtual void submit(SrsAsyncIoTask* task);
+};
+
+/**
+ * the file writer which write in native threads of async io pool,
+ * fallback to sync write when pool not started.
+ * @remark close() wait for all data written, so the file is ok after close.
+ */
+class SrsAsyncFileWriter : public SrsFileWriter
+{
+private:
+    SrsAsyncIoFile* afile;
+    // the logic position of file, for the write is async.
+    int64_t position;
+public:
+    SrsAsyncFileWriter();
+    virtual ~SrsAsyncFileWriter();
+public:
+    virtual int open(std::string p);
+    virtual int open_append(std::string p);
+    virtual void close();
+public:
+    virtual void lseek(int64_t offset);
+    virtual int64_t tellg();
+public:
+    virtual int write(void* buf, size_t count, ssize_t* pnwrite);
+    virtual int writev(iovec* iov, int iovcnt, ssize_t* pnwrite);
+private:
+    virtual void attach();
+};
+
+#endif
+
@@ -44,6 +44,7 @@ using namespace std;
 #include <srs_core_autofree.hpp>
 #include <srs_app_source.hpp>
 #include <srs_kernel_file.hpp>
+#include <srs_kernel_utility.hpp>
 #include <srs_app_utility.hpp>
 #include <srs_core_performance.hpp>
 
@@ -91,6 +92,11 @@ const char* _srs_version = "XCORE-"RTMP_SIG_SRS_SERVER;
 #define SRS_CONF_DEFAULT_HLS_CLEANUP true
 #define SRS_CONF_DEFAULT_HLS_WAIT_KEYFRAME true
 #define SRS_CONF_DEFAULT_HLS_NB_NOTIFY 64
+#define SRS_CONF_DEFAULT_HLS_STORAGE_DISK "disk"
+#define SRS_CONF_DEFAULT_HLS_STORAGE_RAM "ram"
+#define SRS_CONF_DEFAULT_HLS_STORAGE_BOTH "both"
+#define SRS_CONF_DEFAULT_HLS_STORAGE SRS_CONF_DEFAULT_HLS_STORAGE_DISK
+#define SRS_CONF_DEFAULT_HLS_RAM_BUDGET 256
 #define SRS_CONF_DEFAULT_DVR_PATH "./objs/nginx/html/[app]/[stream].[timestamp].flv"
 #define SRS_CONF_DEFAULT_DVR_PLAN_SESSION "session"
 #define SRS_CONF_DEFAULT_DVR_PLAN_SEGMENT "segment"
@@ -100,6 +106,8 @@ const char* _srs_version = "XCORE-"RTMP_SIG_SRS_SERVER;
 #define SRS_CONF_DEFAULT_TIME_JITTER "full"
 #define SRS_CONF_DEFAULT_ATC_AUTO true
 #define SRS_CONF_DEFAULT_MIX_CORRECT false
+#define SRS_CONF_DEFAULT_QUEUE_SHRINK_ALL "all"
+#define SRS_CONF_DEFAULT_QUEUE_SHRINK_SMART "smart"
 // in seconds, the paused queue length.
 #define SRS_CONF_DEFAULT_PAUSED_LENGTH 10
 // the interval in seconds for bandwidth check
@@ -130,6 +138,27 @@ const char* _srs_version = "XCORE-"RTMP_SIG_SRS_SERVER;
 
 #define SRS_CONF_DEFAULT_STATS_NETWORK_DEVICE_INDEX 0
 
+#define SRS_CONF_DEFAULT_WORKERS_ENABLED false
+#define SRS_CONF_DEFAULT_WORKERS_COUNT 4
+#define SRS_CONF_DEFAULT_WORKERS_PORT 19350
+#define SRS_CONF_DEFAULT_ASYNC_IO_ENABLED false
+#define SRS_CONF_DEFAULT_ASYNC_IO_THREADS 2
+#define SRS_CONF_DEFAULT_ASYNC_IO_MAX_PENDING 8192
+#define SRS_CONF_DEFAULT_ASYNC_IO_DVR true
+#define SRS_CONF_DEFAULT_ASYNC_IO_HLS true
+#define SRS_CONF_DEFAULT_ASYNC_IO_LOG true
+#define SRS_CONF_DEFAULT_ASYNC_IO_VOD true
+#define SRS_CONF_DEFAULT_HOOKS_POOL_MAX_CONNECTIONS 16
+#define SRS_CONF_DEFAULT_HOOKS_POOL_ASYNC_NOTIFY true
+#define SRS_CONF_DEFAULT_ON_PLAY_CACHE_TTL 0
+#define SRS_CONF_DEFAULT_DNS_RESOLVER_ENABLED true
+#define SRS_CONF_DEFAULT_DNS_RESOLVER_TIMEOUT 3000
+#define SRS_CONF_DEFAULT_DNS_RESOLVER_MAX_TTL 300
+#define SRS_CONF_DEFAULT_DNS_RESOLVER_NEGATIVE_TTL 5
+
+#define SRS_CONF_DEFAULT_HANDSHAKE_DH_POOL 512
+#define SRS_CONF_DEFAULT_HANDSHAKE_OVERLOAD false
+
 #define SRS_CONF_DEFAULT_PITHY_PRINT_MS 10000
 
 #define SRS_CONF_DEFAULT_INGEST_TYPE_FILE "file"
@@ -140,6 +169,10 @@ const char* _srs_version = "XCORE-"RTMP_SIG_SRS_SERVER;
 
 #define SRS_CONF_DEFAULT_EDGE_TOKEN_TRAVERSE false
 #define SRS_CONF_DEFAULT_EDGE_TRANSFORM_VHOST "[vhost]"
+#define SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT_LATENCY "latency"
+#define SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT_HASH "hash"
+#define SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT_ROUND_ROBIN "round_robin"
+#define SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT_LATENCY
 
 // hds default value
 #define SRS_CONF_DEFAULT_HDS_PATH       "./objs/nginx/html"
@@ -453,6 +486,36 @@ int SrsConfDirective::read_token(SrsConfigBuffer* buffer, vector<string>& args,
     return ret;
 }
 
+SrsVhostSettings::SrsVhostSettings(string v)
+{
+    vhost = v;
+    
+    enabled = false;
+    is_edge = false;
+    gop_cache = false;
+    atc = false;
+    atc_auto = false;
+    time_jitter = 0;
+    mix_correct = false;
+    queue_length = 0;
+    queue_smart_shrink = false;
+    reduce_sequence_header = false;
+    parse_sps = false;
+    
+    hls_enabled = false;
+    hls_dispose = 0;
+    
+    http_ts_enabled = false;
+    
+    dvr_enabled = false;
+    dvr_wait_keyframe = false;
+    dvr_time_jitter = 0;
+}
+
+SrsVhostSettings::~SrsVhostSettings()
+{
+}
+
 SrsConfig::SrsConfig()
 {
     dolphin = false;
@@ -469,6 +532,13 @@ SrsConfig::SrsConfig()
 SrsConfig::~SrsConfig()
 {
     srs_freep(root);
+    
+    std::map<std::string, SrsVhostSettings*>::iterator it;
+    for (it = vhost_settings.begin(); it != vhost_settings.end(); ++it) {
+        SrsVhostSettings* settings = it->second;
+        srs_freep(settings);
+    }
+    vhost_settings.clear();
 }
 
 bool SrsConfig::is_dolphin()
@@ -652,8 +722,10 @@ int SrsConfig::reload_vhost(SrsConfDirective* old_root)
                 }
                 srs_trace("vhost %s reload gop_cache success.", vhost.c_str());
             }
-            // queue_length, only one per vhost
-            if (!srs_directive_equals(new_vhost->get("queue_length"), old_vhost->get("queue_length"))) {
+            // queue_length and queue_shrink, only one per vhost
+            if (!srs_directive_equals(new_vhost->get("queue_length"), old_vhost->get("queue_length"))
+                || !srs_directive_equals(new_vhost->get("queue_shrink"), old_vhost->get("queue_shrink"))
+            ) {
                 for (it = subscribes.begin(); it != subscribes.end(); ++it) {
                     ISrsReloadHandler* subscribe = *it;
                     if ((ret = subscribe->on_reload_vhost_queue_length(vhost)) != ERROR_SUCCESS) {
@@ -755,7 +827,10 @@ int SrsConfig::reload_vhost(SrsConfDirective* old_root)
                 srs_trace("vhost %s reload chunk_size success.", vhost.c_str());
             }
             // mw, only one per vhost
-            if (!srs_directive_equals(new_vhost->get("mw_latency"), old_vhost->get("mw_latency"))) {
+            if (!srs_directive_equals(new_vhost->get("mw_latency"), old_vhost->get("mw_latency"))
+                || !srs_directive_equals(new_vhost->get("mw_aggregate"), old_vhost->get("mw_aggregate"))
+                || !srs_directive_equals(new_vhost->get("mw_adaptive"), old_vhost->get("mw_adaptive"))
+            ) {
                 for (it = subscribes.begin(); it != subscribes.end(); ++it) {
                     ISrsReloadHandler* subscribe = *it;
                     if ((ret = subscribe->on_reload_vhost_mw(vhost)) != ERROR_SUCCESS) {
@@ -881,6 +956,10 @@ int SrsConfig::reload_conf(SrsConfig* conf)
     root = conf->root;
     conf->root = NULL;
     
+    // the vhost index and settings must be updated before notify the subscribers,
+    // for the handlers may read the settings of new config.
+    compile_vhosts();
+    
     // merge config.
     std::vector<ISrsReloadHandler*>::iterator it;
 
@@ -1573,10 +1652,13 @@ int SrsConfig::check_config()
         std::string n = conf->name;
         if (n != "listen" && n != "pid" && n != "chunk_size" && n != "ff_log_dir" 
             && n != "srs_log_tank" && n != "srs_log_level" && n != "srs_log_file"
+            && n != "srs_log_format" && n != "srs_log_ring"
             && n != "max_connections" && n != "daemon" && n != "heartbeat"
             && n != "http_api" && n != "stats" && n != "vhost" && n != "pithy_print_ms"
             && n != "http_stream" && n != "http_server" && n != "stream_caster"
             && n != "utc_time" && n != "work_dir" && n != "asprocess"
+            && n != "workers" && n != "async_io" && n != "hooks_pool"
+            && n != "dns_resolver" && n != "handshake"
         ) {
             ret = ERROR_SYSTEM_CONFIG_INVALID;
             srs_error("unsupported directive %s, ret=%d", n.c_str(), ret);
@@ -1629,6 +1711,63 @@ int SrsConfig::check_config()
             }
         }
     }
+    if (true) {
+        SrsConfDirective* conf = get_workers();
+        for (int i = 0; conf && i < (int)conf->directives.size(); i++) {
+            string n = conf->at(i)->name;
+            if (n != "enabled" && n != "count" && n != "port") {
+                ret = ERROR_SYSTEM_CONFIG_INVALID;
+                srs_error("unsupported workers directive %s, ret=%d", n.c_str(), ret);
+                return ret;
+            }
+        }
+    }
+    if (true) {
+        SrsConfDirective* conf = get_async_io();
+        for (int i = 0; conf && i < (int)conf->directives.size(); i++) {
+            string n = conf->at(i)->name;
+            if (n != "enabled" && n != "threads" && n != "max_pending"
+                && n != "dvr" && n != "hls" && n != "log" && n != "vod"
+            ) {
+                ret = ERROR_SYSTEM_CONFIG_INVALID;
+                srs_error("unsupported async_io directive %s, ret=%d", n.c_str(), ret);
+                return ret;
+            }
+        }
+    }
+    if (true) {
+        SrsConfDirective* conf = get_hooks_pool();
+        for (int i = 0; conf && i < (int)conf->directives.size(); i++) {
+            string n = conf->at(i)->name;
+            if (n != "max_connections" && n != "async_notify") {
+                ret = ERROR_SYSTEM_CONFIG_INVALID;
+                srs_error("unsupported hooks_pool directive %s, ret=%d", n.c_str(), ret);
+                return ret;
+            }
+        }
+    }
+    if (true) {
+        SrsConfDirective* conf = get_dns_resolver();
+        for (int i = 0; conf && i < (int)conf->directives.size(); i++) {
+            string n = conf->at(i)->name;
+            if (n != "enabled" && n != "timeout" && n != "max_ttl" && n != "negative_ttl") {
+                ret = ERROR_SYSTEM_CONFIG_INVALID;
+                srs_error("unsupported dns_resolver directive %s, ret=%d", n.c_str(), ret);
+                return ret;
+            }
+        }
+    }
+    if (true) {
+        SrsConfDirective* conf = get_handshake();
+        for (int i = 0; conf && i < (int)conf->directives.size(); i++) {
+            string n = conf->at(i)->name;
+            if (n != "dh_pool" && n != "overload") {
+                ret = ERROR_SYSTEM_CONFIG_INVALID;
+                srs_error("unsupported handshake directive %s, ret=%d", n.c_str(), ret);
+                return ret;
+            }
+        }
+    }
     
     
     ////////////////////////////////////////////////////////////////////////
@@ -1816,15 +1955,15 @@ int SrsConfig::check_config()
             SrsConfDirective* conf = vhost->at(i);
             string n = conf->name;
             if (n != "enabled" && n != "chunk_size"
-                && n != "mode" && n != "origin" && n != "token_traverse" && n != "vhost"
+                && n != "mode" && n != "origin" && n != "origin_select" && n != "token_traverse" && n != "vhost"
                 && n != "dvr" && n != "ingest" && n != "hls" && n != "http_hooks"
-                && n != "gop_cache" && n != "queue_length"
+                && n != "gop_cache" && n != "queue_length" && n != "queue_shrink"
                 && n != "refer" && n != "refer_publish" && n != "refer_play"
                 && n != "forward" && n != "transcode" && n != "bandcheck"
                 && n != "time_jitter" && n != "mix_correct"
                 && n != "atc" && n != "atc_auto"
                 && n != "debug_srs_upnode"
-                && n != "mr" && n != "mw_latency" && n != "min_latency" && n != "publish"
+                && n != "mr" && n != "mw_latency" && n != "mw_aggregate" && n != "mw_adaptive" && n != "min_latency" && n != "publish"
                 && n != "tcp_nodelay" && n != "send_min_interval" && n != "reduce_sequence_header"
                 && n != "publish_1stpkt_timeout" && n != "publish_normal_timeout"
                 && n != "security" && n != "http_remux"
@@ -1902,7 +2041,7 @@ int SrsConfig::check_config()
                     if (m != "enabled" && m != "hls_entry_prefix" && m != "hls_path" && m != "hls_fragment" && m != "hls_window" && m != "hls_on_error"
                         && m != "hls_storage" && m != "hls_mount" && m != "hls_td_ratio" && m != "hls_aof_ratio" && m != "hls_acodec" && m != "hls_vcodec"
                         && m != "hls_m3u8_file" && m != "hls_ts_file" && m != "hls_ts_floor" && m != "hls_cleanup" && m != "hls_nb_notify"
-                        && m != "hls_wait_keyframe" && m != "hls_dispose"
+                        && m != "hls_wait_keyframe" && m != "hls_dispose" && m != "hls_ram_budget"
 #ifdef __INGEST_DYNAMIC__
                         && m != "hls_leave_tm" && m != "hls_time_out"
 #endif
@@ -1913,8 +2052,8 @@ int SrsConfig::check_config()
                     }
                     
                     // TODO: FIXME: remove it in future.
-                    if (m == "hls_storage" || m == "hls_mount") {
-                        srs_warn("HLS RAM is removed from SRS2 to SRS3+, please read https://github.com/ossrs/srs/issues/513.");
+                    if (m == "hls_mount") {
+                        srs_warn("hls_mount is removed, the hls in ram is served at the url of hls_m3u8_file and hls_ts_file.");
                     }
                 }
             } else if (n == "http_hooks") {
@@ -1923,6 +2062,7 @@ int SrsConfig::check_config()
                     if (m != "enabled" && m != "on_connect" && m != "on_close" && m != "on_publish"
                         && m != "on_unpublish" && m != "on_play" && m != "on_stop"
                         && m != "on_dvr" && m != "on_hls" && m != "on_hls_notify"
+                        && m != "on_play_cache_ttl"
                         ) {
                         ret = ERROR_SYSTEM_CONFIG_INVALID;
                         srs_error("unsupported vhost http_hooks directive %s, ret=%d", m.c_str(), ret);
@@ -2035,6 +2175,50 @@ int SrsConfig::check_config()
             return ret;
         }
     }
+    for (int i = 0; i < (int)vhosts.size(); i++) {
+        SrsConfDirective* conf = vhosts[i]->get("queue_shrink");
+        if (conf && conf->arg0() != SRS_CONF_DEFAULT_QUEUE_SHRINK_ALL
+            && conf->arg0() != SRS_CONF_DEFAULT_QUEUE_SHRINK_SMART
+        ) {
+            ret = ERROR_SYSTEM_CONFIG_INVALID;
+            srs_error("directive vhost %s queue_shrink invalid, queue_shrink=%s, must be %s or %s, ret=%d",
+                vhosts[i]->arg0().c_str(), conf->arg0().c_str(), SRS_CONF_DEFAULT_QUEUE_SHRINK_ALL,
+                SRS_CONF_DEFAULT_QUEUE_SHRINK_SMART, ret);
+            return ret;
+        }
+    }
+    for (int i = 0; i < (int)vhosts.size(); i++) {
+        std::string vhost = vhosts[i]->arg0();
+        std::string select = get_vhost_edge_origin_select(vhost);
+        if (select != SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT_LATENCY && select != SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT_HASH
+            && select != SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT_ROUND_ROBIN
+        ) {
+            ret = ERROR_SYSTEM_CONFIG_INVALID;
+            srs_error("directive vhost %s origin_select invalid, origin_select=%s, must be %s, %s or %s, ret=%d",
+                vhost.c_str(), select.c_str(), SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT_LATENCY, SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT_HASH,
+                SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT_ROUND_ROBIN, ret);
+            return ret;
+        }
+    }
+    for (int i = 0; i < (int)vhosts.size(); i++) {
+        std::string vhost = vhosts[i]->arg0();
+        std::string storage = get_hls_storage(vhost);
+        if (storage != SRS_CONF_DEFAULT_HLS_STORAGE_DISK && storage != SRS_CONF_DEFAULT_HLS_STORAGE_RAM
+            && storage != SRS_CONF_DEFAULT_HLS_STORAGE_BOTH
+        ) {
+            ret = ERROR_SYSTEM_CONFIG_INVALID;
+            srs_error("directive vhost %s hls_storage invalid, hls_storage=%s, must be %s, %s or %s, ret=%d",
+                vhost.c_str(), storage.c_str(), SRS_CONF_DEFAULT_HLS_STORAGE_DISK, SRS_CONF_DEFAULT_HLS_STORAGE_RAM,
+                SRS_CONF_DEFAULT_HLS_STORAGE_BOTH, ret);
+            return ret;
+        }
+        if (get_hls_ram_budget(vhost) <= 0) {
+            ret = ERROR_SYSTEM_CONFIG_INVALID;
+            srs_error("directive vhost %s hls_ram_budget invalid, hls_ram_budget=%d, ret=%d",
+                vhost.c_str(), get_hls_ram_budget(vhost), ret);
+            return ret;
+        }
+    }
     for (int i = 0; i < (int)vhosts.size(); i++) {
         SrsConfDirective* vhost = vhosts[i];
         srs_assert(vhost != NULL);
@@ -2079,6 +2263,74 @@ int SrsConfig::check_config()
         return ret;
     }
     
+    ////////////////////////////////////////////////////////////////////////
+    // check workers
+    ////////////////////////////////////////////////////////////////////////
+    if (get_workers_enabled()) {
+        if (get_workers_count() <= 0 || get_workers_count() > SRS_CONSTS_MAX_WORKERS) {
+            ret = ERROR_SYSTEM_CONFIG_INVALID;
+            srs_error("directive workers count invalid, count=%d, max=%d, ret=%d",
+                get_workers_count(), SRS_CONSTS_MAX_WORKERS, ret);
+            return ret;
+        }
+        if (get_workers_port() <= 0 || get_workers_port() + get_workers_count() > 65535) {
+            ret = ERROR_SYSTEM_CONFIG_INVALID;
+            srs_error("directive workers port invalid, port=%d, ret=%d", get_workers_port(), ret);
+            return ret;
+        }
+        if (get_asprocess()) {
+            ret = ERROR_SYSTEM_CONFIG_INVALID;
+            srs_error("workers conflict with asprocess, ret=%d", ret);
+            return ret;
+        }
+    }
+    
+    ////////////////////////////////////////////////////////////////////////
+    // check async io
+    ////////////////////////////////////////////////////////////////////////
+    if (get_async_io_enabled()) {
+        if (get_async_io_threads() <= 0 || get_async_io_threads() > SRS_CONSTS_MAX_ASYNC_IO_THREADS) {
+            ret = ERROR_SYSTEM_CONFIG_INVALID;
+            srs_error("directive async_io threads invalid, threads=%d, max=%d, ret=%d",
+                get_async_io_threads(), SRS_CONSTS_MAX_ASYNC_IO_THREADS, ret);
+            return ret;
+        }
+        if (get_async_io_max_pending() <= 0) {
+            ret = ERROR_SYSTEM_CONFIG_INVALID;
+            srs_error("directive async_io max_pending invalid, max_pending=%d, ret=%d", get_async_io_max_pending(), ret);
+            return ret;
+        }
+    }
+    
+    ////////////////////////////////////////////////////////////////////////
+    // check hooks pool
+    ////////////////////////////////////////////////////////////////////////
+    if (get_hooks_pool_max_connections() <= 0) {
+        ret = ERROR_SYSTEM_CONFIG_INVALID;
+        srs_error("directive hooks_pool max_connections invalid, max_connections=%d, ret=%d",
+            get_hooks_pool_max_connections(), ret);
+        return ret;
+    }
+    
+    ////////////////////////////////////////////////////////////////////////
+    // check dns resolver
+    ////////////////////////////////////////////////////////////////////////
+    if (get_dns_resolver_timeout() <= 0 || get_dns_resolver_max_ttl() < 0 || get_dns_resolver_negative_ttl() < 0) {
+        ret = ERROR_SYSTEM_CONFIG_INVALID;
+        srs_error("directive dns_resolver invalid, timeout=%d, max_ttl=%d, negative_ttl=%d, ret=%d",
+            get_dns_resolver_timeout(), get_dns_resolver_max_ttl(), get_dns_resolver_negative_ttl(), ret);
+        return ret;
+    }
+    
+    ////////////////////////////////////////////////////////////////////////
+    // check handshake
+    ////////////////////////////////////////////////////////////////////////
+    if (get_handshake_dh_pool() < 0) {
+        ret = ERROR_SYSTEM_CONFIG_INVALID;
+        srs_error("directive handshake dh_pool invalid, dh_pool=%d, ret=%d", get_handshake_dh_pool(), ret);
+        return ret;
+    }
+    
     return ret;
 }
 
@@ -2106,6 +2358,9 @@ int SrsConfig::parse_buffer(SrsConfigBuffer* buffer)
         set_config_directive(root, "daemon", "off");
         set_config_directive(root, "srs_log_tank", "console");
     }
+    
+    // build the vhost index and settings for the new root.
+    compile_vhosts();
 
     return ret;
 }
@@ -2314,6 +2569,47 @@ SrsConfDirective* SrsConfig::get_vhost(string vhost)
 {
     srs_assert(root);
     
+    std::map<std::string, SrsConfDirective*>::iterator it = vhost_index.find(vhost);
+    if (it != vhost_index.end()) {
+        return it->second;
+    }
+    
+    if (vhost != SRS_CONSTS_RTMP_DEFAULT_VHOST) {
+        return get_vhost(SRS_CONSTS_RTMP_DEFAULT_VHOST);
+    }
+    
+    return NULL;
+}
+
+SrsVhostSettings* SrsConfig::get_vhost_settings(string vhost)
+{
+    std::map<std::string, SrsVhostSettings*>::iterator it = vhost_settings.find(vhost);
+    if (it != vhost_settings.end()) {
+        return it->second;
+    }
+    
+    // the vhost not in config use the settings of default vhost, like get_vhost(),
+    // never compile for it, for the vhost maybe any host of client.
+    if (vhost != SRS_CONSTS_RTMP_DEFAULT_VHOST && vhost_index.find(vhost) == vhost_index.end()) {
+        return get_vhost_settings(SRS_CONSTS_RTMP_DEFAULT_VHOST);
+    }
+    
+    // the default vhost maybe not in config,
+    // compile it once and recompile when reload, like the configed vhost.
+    SrsVhostSettings* settings = new SrsVhostSettings(vhost);
+    compile_vhost_settings(settings);
+    vhost_settings[vhost] = settings;
+    
+    return settings;
+}
+
+void SrsConfig::compile_vhosts()
+{
+    srs_assert(root);
+    
+    // rebuild the index, the first vhost win when duplicated,
+    // which is the same to the linear search.
+    vhost_index.clear();
     for (int i = 0; i < (int)root->directives.size(); i++) {
         SrsConfDirective* conf = root->at(i);
         
@@ -2321,16 +2617,55 @@ SrsConfDirective* SrsConfig::get_vhost(string vhost)
             continue;
         }
         
-        if (conf->arg0() == vhost) {
-            return conf;
+        if (vhost_index.find(conf->arg0()) == vhost_index.end()) {
+            vhost_index[conf->arg0()] = conf;
         }
     }
     
-    if (vhost != SRS_CONSTS_RTMP_DEFAULT_VHOST) {
-        return get_vhost(SRS_CONSTS_RTMP_DEFAULT_VHOST);
+    // create settings for the new vhosts.
+    std::map<std::string, SrsConfDirective*>::iterator it;
+    for (it = vhost_index.begin(); it != vhost_index.end(); ++it) {
+        if (vhost_settings.find(it->first) == vhost_settings.end()) {
+            vhost_settings[it->first] = new SrsVhostSettings(it->first);
+        }
     }
     
-    return NULL;
+    // compile all settings in place, the removed vhost use the default vhost,
+    // for the pointer maybe cached by source, hls or dvr.
+    std::map<std::string, SrsVhostSettings*>::iterator sit;
+    for (sit = vhost_settings.begin(); sit != vhost_settings.end(); ++sit) {
+        compile_vhost_settings(sit->second);
+    }
+    
+    srs_info("compile %d vhosts, %d settings", (int)vhost_index.size(), (int)vhost_settings.size());
+}
+
+void SrsConfig::compile_vhost_settings(SrsVhostSettings* settings)
+{
+    std::string vhost = settings->vhost;
+    
+    settings->enabled = get_vhost_enabled(vhost);
+    settings->is_edge = get_vhost_is_edge(vhost);
+    settings->gop_cache = get_gop_cache(vhost);
+    settings->atc = get_atc(vhost);
+    settings->atc_auto = get_atc_auto(vhost);
+    settings->time_jitter = get_time_jitter(vhost);
+    settings->mix_correct = get_mix_correct(vhost);
+    settings->queue_length = get_queue_length(vhost);
+    settings->queue_smart_shrink = get_queue_smart_shrink(vhost);
+    settings->reduce_sequence_header = get_reduce_sequence_header(vhost);
+    settings->parse_sps = get_parse_sps(vhost);
+    
+    settings->hls_enabled = get_hls_enabled(vhost);
+    settings->hls_dispose = get_hls_dispose(vhost);
+    settings->hls_on_error = get_hls_on_error(vhost);
+    
+    settings->http_ts_enabled = get_vhost_http_remux_enabled(vhost)
+        && srs_string_ends_with(get_vhost_http_remux_mount(vhost), ".ts");
+    
+    settings->dvr_enabled = get_dvr_enabled(vhost);
+    settings->dvr_wait_keyframe = get_dvr_wait_keyframe(vhost);
+    settings->dvr_time_jitter = get_dvr_time_jitter(vhost);
 }
 
 void SrsConfig::get_vhosts(vector<SrsConfDirective*>& vhosts)
@@ -2482,6 +2817,22 @@ double SrsConfig::get_queue_length(string vhost)
     return ::atoi(conf->arg0().c_str());
 }
 
+bool SrsConfig::get_queue_smart_shrink(string vhost)
+{
+    SrsConfDirective* conf = get_vhost(vhost);
+    
+    if (!conf) {
+        return false;
+    }
+    
+    conf = conf->get("queue_shrink");
+    if (!conf || conf->arg0().empty()) {
+        return false;
+    }
+    
+    return conf->arg0() == SRS_CONF_DEFAULT_QUEUE_SHRINK_SMART;
+}
+
 SrsConfDirective* SrsConfig::get_refer(string vhost)
 {
     SrsConfDirective* conf = get_vhost(vhost);
@@ -2620,6 +2971,38 @@ int SrsConfig::get_mw_sleep_ms(string vhost)
     return ::atoi(conf->arg0().c_str());
 }
 
+bool SrsConfig::get_mw_aggregate(string vhost)
+{
+    static bool DEFAULT = false;
+    
+    SrsConfDirective* conf = get_vhost(vhost);
+    if (!conf) {
+        return DEFAULT;
+    }
+    
+    conf = conf->get("mw_aggregate");
+    if (!conf || conf->arg0().empty()) {
+        return DEFAULT;
+    }
+    
+    return SRS_CONF_PERFER_FALSE(conf->arg0());
+}
+
+bool SrsConfig::get_mw_adaptive(string vhost)
+{
+    SrsConfDirective* conf = get_vhost(vhost);
+    if (!conf) {
+        return SRS_PERF_MW_ADAPTIVE;
+    }
+    
+    conf = conf->get("mw_adaptive");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_PERF_MW_ADAPTIVE;
+    }
+    
+    return SRS_CONF_PERFER_FALSE(conf->arg0());
+}
+
 bool SrsConfig::get_realtime_enabled(string vhost)
 {
     SrsConfDirective* conf = get_vhost(vhost);
@@ -2872,6 +3255,22 @@ SrsConfDirective* SrsConfig::get_vhost_on_hls_notify(string vhost)
     return conf->get("on_hls_notify");
 }
 
+int SrsConfig::get_vhost_on_play_cache_ttl(string vhost)
+{
+    SrsConfDirective* conf = get_vhost_http_hooks(vhost);
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_ON_PLAY_CACHE_TTL;
+    }
+    
+    conf = conf->get("on_play_cache_ttl");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_ON_PLAY_CACHE_TTL;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
 bool SrsConfig::get_bw_check_enabled(string vhost)
 {
     SrsConfDirective* conf = get_vhost(vhost);
@@ -3006,6 +3405,22 @@ bool SrsConfig::get_vhost_edge_token_traverse(string vhost)
     return SRS_CONF_PERFER_FALSE(conf->arg0());
 }
 
+string SrsConfig::get_vhost_edge_origin_select(string vhost)
+{
+    SrsConfDirective* conf = get_vhost(vhost);
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT;
+    }
+    
+    conf = conf->get("origin_select");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_EDGE_ORIGIN_SELECT;
+    }
+    
+    return conf->arg0();
+}
+
 string SrsConfig::get_vhost_edge_transform_vhost(string vhost)
 {
     SrsConfDirective* conf = get_vhost(vhost);
@@ -3587,6 +4002,34 @@ string SrsConfig::get_log_file()
     return conf->arg0();
 }
 
+bool SrsConfig::get_log_binary()
+{
+    static bool DEFAULT = false;
+    
+    srs_assert(root);
+    
+    SrsConfDirective* conf = root->get("srs_log_format");
+    if (!conf || conf->arg0().empty()) {
+        return DEFAULT;
+    }
+    
+    return conf->arg0() == "binary";
+}
+
+int SrsConfig::get_log_ring_size()
+{
+    static int DEFAULT = 1024;
+    
+    srs_assert(root);
+    
+    SrsConfDirective* conf = root->get("srs_log_ring");
+    if (!conf || conf->arg0().empty()) {
+        return DEFAULT * 1024;
+    }
+    
+    return ::atoi(conf->arg0().c_str()) * 1024;
+}
+
 bool SrsConfig::get_ffmpeg_log_enabled()
 {
     string log = get_ffmpeg_log_dir();
@@ -3941,6 +4384,40 @@ bool SrsConfig::get_hls_wait_keyframe(string vhost)
     return SRS_CONF_PERFER_TRUE(conf->arg0());
 }
 
+string SrsConfig::get_hls_storage(string vhost)
+{
+    SrsConfDirective* hls = get_hls(vhost);
+    
+    if (!hls) {
+        return SRS_CONF_DEFAULT_HLS_STORAGE;
+    }
+    
+    SrsConfDirective* conf = hls->get("hls_storage");
+    
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_HLS_STORAGE;
+    }
+    
+    return conf->arg0();
+}
+
+int SrsConfig::get_hls_ram_budget(string vhost)
+{
+    SrsConfDirective* hls = get_hls(vhost);
+    
+    if (!hls) {
+        return SRS_CONF_DEFAULT_HLS_RAM_BUDGET;
+    }
+    
+    SrsConfDirective* conf = hls->get("hls_ram_budget");
+    
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_HLS_RAM_BUDGET;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
 SrsConfDirective *SrsConfig::get_hds(const string &vhost)
 {
     SrsConfDirective* conf = get_vhost(vhost);
@@ -4531,6 +5008,311 @@ SrsConfDirective* SrsConfig::get_stats_disk_device()
     return conf;
 }
 
+SrsConfDirective* SrsConfig::get_workers()
+{
+    return root->get("workers");
+}
+
+bool SrsConfig::get_workers_enabled()
+{
+    SrsConfDirective* conf = get_workers();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_WORKERS_ENABLED;
+    }
+    
+    conf = conf->get("enabled");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_WORKERS_ENABLED;
+    }
+    
+    return SRS_CONF_PERFER_FALSE(conf->arg0());
+}
+
+int SrsConfig::get_workers_count()
+{
+    SrsConfDirective* conf = get_workers();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_WORKERS_COUNT;
+    }
+    
+    conf = conf->get("count");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_WORKERS_COUNT;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
+int SrsConfig::get_workers_port()
+{
+    SrsConfDirective* conf = get_workers();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_WORKERS_PORT;
+    }
+    
+    conf = conf->get("port");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_WORKERS_PORT;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
+SrsConfDirective* SrsConfig::get_async_io()
+{
+    return root->get("async_io");
+}
+
+bool SrsConfig::get_async_io_enabled()
+{
+    SrsConfDirective* conf = get_async_io();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_ASYNC_IO_ENABLED;
+    }
+    
+    conf = conf->get("enabled");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_ASYNC_IO_ENABLED;
+    }
+    
+    return SRS_CONF_PERFER_FALSE(conf->arg0());
+}
+
+int SrsConfig::get_async_io_threads()
+{
+    SrsConfDirective* conf = get_async_io();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_ASYNC_IO_THREADS;
+    }
+    
+    conf = conf->get("threads");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_ASYNC_IO_THREADS;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
+int SrsConfig::get_async_io_max_pending()
+{
+    SrsConfDirective* conf = get_async_io();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_ASYNC_IO_MAX_PENDING;
+    }
+    
+    conf = conf->get("max_pending");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_ASYNC_IO_MAX_PENDING;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
+bool SrsConfig::get_async_io_dvr()
+{
+    if (!get_async_io_enabled()) {
+        return false;
+    }
+    
+    SrsConfDirective* conf = get_async_io()->get("dvr");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_ASYNC_IO_DVR;
+    }
+    
+    return SRS_CONF_PERFER_TRUE(conf->arg0());
+}
+
+bool SrsConfig::get_async_io_hls()
+{
+    if (!get_async_io_enabled()) {
+        return false;
+    }
+    
+    SrsConfDirective* conf = get_async_io()->get("hls");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_ASYNC_IO_HLS;
+    }
+    
+    return SRS_CONF_PERFER_TRUE(conf->arg0());
+}
+
+bool SrsConfig::get_async_io_log()
+{
+    if (!get_async_io_enabled()) {
+        return false;
+    }
+    
+    SrsConfDirective* conf = get_async_io()->get("log");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_ASYNC_IO_LOG;
+    }
+    
+    return SRS_CONF_PERFER_TRUE(conf->arg0());
+}
+
+bool SrsConfig::get_async_io_vod()
+{
+    if (!get_async_io_enabled()) {
+        return false;
+    }
+    
+    SrsConfDirective* conf = get_async_io()->get("vod");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_ASYNC_IO_VOD;
+    }
+    
+    return SRS_CONF_PERFER_TRUE(conf->arg0());
+}
+
+SrsConfDirective* SrsConfig::get_hooks_pool()
+{
+    return root->get("hooks_pool");
+}
+
+int SrsConfig::get_hooks_pool_max_connections()
+{
+    SrsConfDirective* conf = get_hooks_pool();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_HOOKS_POOL_MAX_CONNECTIONS;
+    }
+    
+    conf = conf->get("max_connections");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_HOOKS_POOL_MAX_CONNECTIONS;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
+bool SrsConfig::get_hooks_pool_async_notify()
+{
+    SrsConfDirective* conf = get_hooks_pool();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_HOOKS_POOL_ASYNC_NOTIFY;
+    }
+    
+    conf = conf->get("async_notify");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_HOOKS_POOL_ASYNC_NOTIFY;
+    }
+    
+    return SRS_CONF_PERFER_TRUE(conf->arg0());
+}
+
+SrsConfDirective* SrsConfig::get_dns_resolver()
+{
+    return root->get("dns_resolver");
+}
+
+bool SrsConfig::get_dns_resolver_enabled()
+{
+    SrsConfDirective* conf = get_dns_resolver();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_DNS_RESOLVER_ENABLED;
+    }
+    
+    conf = conf->get("enabled");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_DNS_RESOLVER_ENABLED;
+    }
+    
+    return SRS_CONF_PERFER_TRUE(conf->arg0());
+}
+
+int SrsConfig::get_dns_resolver_timeout()
+{
+    SrsConfDirective* conf = get_dns_resolver();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_DNS_RESOLVER_TIMEOUT;
+    }
+    
+    conf = conf->get("timeout");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_DNS_RESOLVER_TIMEOUT;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
+int SrsConfig::get_dns_resolver_max_ttl()
+{
+    SrsConfDirective* conf = get_dns_resolver();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_DNS_RESOLVER_MAX_TTL;
+    }
+    
+    conf = conf->get("max_ttl");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_DNS_RESOLVER_MAX_TTL;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
+int SrsConfig::get_dns_resolver_negative_ttl()
+{
+    SrsConfDirective* conf = get_dns_resolver();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_DNS_RESOLVER_NEGATIVE_TTL;
+    }
+    
+    conf = conf->get("negative_ttl");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_DNS_RESOLVER_NEGATIVE_TTL;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
+SrsConfDirective* SrsConfig::get_handshake()
+{
+    return root->get("handshake");
+}
+
+int SrsConfig::get_handshake_dh_pool()
+{
+    SrsConfDirective* conf = get_handshake();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_HANDSHAKE_DH_POOL;
+    }
+    
+    conf = conf->get("dh_pool");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_HANDSHAKE_DH_POOL;
+    }
+    
+    return ::atoi(conf->arg0().c_str());
+}
+
+bool SrsConfig::get_handshake_overload()
+{
+    SrsConfDirective* conf = get_handshake();
+    
+    if (!conf) {
+        return SRS_CONF_DEFAULT_HANDSHAKE_OVERLOAD;
+    }
+    
+    conf = conf->get("overload");
+    if (!conf || conf->arg0().empty()) {
+        return SRS_CONF_DEFAULT_HANDSHAKE_OVERLOAD;
+    }
+    
+    return SRS_CONF_PERFER_FALSE(conf->arg0());
+}
+
 namespace _srs_internal
 {
     SrsConfigBuffer::SrsConfigBuffer()
@@ -4634,6 +5416,16 @@ bool srs_config_hls_is_on_error_continue(string strategy)
     return strategy == SRS_CONF_DEFAULT_HLS_ON_ERROR_CONTINUE;
 }
 
+bool srs_config_hls_is_storage_disk(string storage)
+{
+    return storage == SRS_CONF_DEFAULT_HLS_STORAGE_DISK || storage == SRS_CONF_DEFAULT_HLS_STORAGE_BOTH;
+}
+
+bool srs_config_hls_is_storage_ram(string storage)
+{
+    return storage == SRS_CONF_DEFAULT_HLS_STORAGE_RAM || storage == SRS_CONF_DEFAULT_HLS_STORAGE_BOTH;
+}
+
 bool srs_config_ingest_is_file(string type)
 {
     return type == SRS_CONF_DEFAULT_INGEST_TYPE_FILE;
@@ -31,6 +31,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <vector>
 #include <string>
+#include <map>
 
 #include <srs_app_reload.hpp>
 
@@ -168,6 +169,55 @@ private:
     virtual int read_token(_srs_internal::SrsConfigBuffer* buffer, std::vector<std::string>& args, int& line_start);
 };
 
+/**
+* the compiled settings of vhost, for the hot path which use the config
+* for each message, for example, the source, hls and dvr.
+* the settings is compiled from the directives when config loaded and reloaded,
+* so read the fields never walk the directives.
+* @remark the settings is never freed util config disposed, and updated in place
+*       when reload, so user can keep the pointer cross st-thread.
+* @see SrsConfig::get_vhost_settings()
+*/
+class SrsVhostSettings
+{
+public:
+    /**
+    * the vhost name which the settings for.
+    * @remark when vhost not found, the settings use the default vhost or default values.
+    */
+    std::string vhost;
+// vhost
+public:
+    bool enabled;
+    bool is_edge;
+    bool gop_cache;
+    bool atc;
+    bool atc_auto;
+    int time_jitter;
+    bool mix_correct;
+    double queue_length;
+    bool queue_smart_shrink;
+    bool reduce_sequence_header;
+    bool parse_sps;
+// hls
+public:
+    bool hls_enabled;
+    int hls_dispose;
+    std::string hls_on_error;
+// http remux
+public:
+    // whether http remux in ts, which demux the frames.
+    bool http_ts_enabled;
+// dvr
+public:
+    bool dvr_enabled;
+    bool dvr_wait_keyframe;
+    int dvr_time_jitter;
+public:
+    SrsVhostSettings(std::string v);
+    virtual ~SrsVhostSettings();
+};
+
 /**
 * the config service provider.
 * for the config supports reload, so never keep the reference cross st-thread,
@@ -220,6 +270,16 @@ private:
     * the directive root.
     */
     SrsConfDirective* root;
+    /**
+    * the index of vhost directives in root, key is the vhost name.
+    * @remark rebuild when root changed, for the get_vhost is used by all vhost getters.
+    */
+    std::map<std::string, SrsConfDirective*> vhost_index;
+    /**
+    * the compiled vhost settings, key is the vhost name.
+    * @remark never remove any settings util config disposed, @see SrsVhostSettings
+    */
+    std::map<std::string, SrsVhostSettings*> vhost_settings;
 // reload section
 private:
     /**
@@ -423,6 +483,24 @@ public:
     * @param vhost, the name of vhost to get.
     */
     virtual SrsConfDirective*   get_vhost(std::string vhost);
+    /**
+    * get the compiled settings of vhost, which never walk the directives when read.
+    * @param vhost, the name of vhost to get, when not found, use the settings of default vhost.
+    * @remark user can cache the returned pointer, it's updated when config reload,
+    *       but the vhost not found keeps the default vhost even the vhost added by reload.
+    */
+    virtual SrsVhostSettings*   get_vhost_settings(std::string vhost);
+private:
+    /**
+    * rebuild the vhost index and compile all vhost settings,
+    * must be called when root changed, that is, parsed or reloaded.
+    */
+    virtual void compile_vhosts();
+    /**
+    * compile the settings from the vhost directives.
+    */
+    virtual void compile_vhost_settings(SrsVhostSettings* settings);
+public:
     /**
     * get all vhosts in config file.
     */
@@ -487,6 +565,12 @@ public:
     */
     virtual double              get_queue_length(std::string vhost);
     /**
+    * whether use the smart shrink when the queue overflow,
+    * which drops the disposable frames and whole gops, never the whole queue.
+    * @remark, default all, that is, drop all messages except sequence headers.
+    */
+    virtual bool                get_queue_smart_shrink(std::string vhost);
+    /**
     * get the refer antisuck directive.
     * each args of directive is a refer config.
     * when the client refer(pageUrl) not match the refer config,
@@ -533,6 +617,15 @@ public:
     // TODO: FIXME: add utest for mw config.
     virtual int                 get_mw_sleep_ms(std::string vhost);
     /**
+    * whether send the messages of mw in RTMP aggregate messages.
+    */
+    virtual bool                get_mw_aggregate(std::string vhost);
+    /**
+    * whether the mw adaptive to the stream and socket, which use the mw_latency
+    * as latency target, picks the wait time and msgs of each write.
+    */
+    virtual bool                get_mw_adaptive(std::string vhost);
+    /**
     * whether min latency mode enabled.
     * @param vhost, the vhost to get the min_latency.
     */
@@ -626,6 +719,11 @@ public:
      * @return the on_hls_notify callback directive, the args is the url to callback.
      */
     virtual SrsConfDirective*   get_vhost_on_hls_notify(std::string vhost);
+    /**
+     * get the ttl in seconds to cache the answer of on_play.
+     * @return 0 to disable the cache.
+     */
+    virtual int                 get_vhost_on_play_cache_ttl(std::string vhost);
 // bwct(bandwidth check tool) section
 public:
     /**
@@ -671,6 +769,10 @@ public:
     */
     virtual SrsConfDirective*   get_vhost_edge_origin(std::string vhost);
     /**
+    * get the strategy to select origin of edge, latency, hash or round_robin.
+    */
+    virtual std::string         get_vhost_edge_origin_select(std::string vhost);
+    /**
     * whether edge token tranverse is enabled,
     * if true, edge will send connect origin to verfy the token of client.
     * for example, we verify all clients on the origin FMS by server-side as,
@@ -850,6 +952,15 @@ public:
     */
     virtual std::string         get_log_file();
     /**
+    * whether write the binary log, which is formatted offline.
+    * @remark only for file tank.
+    */
+    virtual bool                get_log_binary();
+    /**
+    * get the size in bytes of ring for binary log.
+    */
+    virtual int                 get_log_ring_size();
+    /**
     * whether ffmpeg log enabled
     */
     virtual bool                get_ffmpeg_log_enabled();
@@ -938,6 +1049,14 @@ public:
      * whether reap the ts when got keyframe.
      */
     virtual bool                get_hls_wait_keyframe(std::string vhost);
+    /**
+     * get the storage of hls, disk, ram or both.
+     */
+    virtual std::string         get_hls_storage(std::string vhost);
+    /**
+     * get the max memory in MB of hls in ram for vhost.
+     */
+    virtual int                 get_hls_ram_budget(std::string vhost);
     /**
      * get the size of bytes to read from cdn network, for the on_hls_notify callback,
      * that is, to read max bytes of the bytes from the callback, or timeout or error.
@@ -1125,6 +1244,110 @@ public:
     * @return the disk device name to stat. NULL if not configed.
     */
     virtual SrsConfDirective*   get_stats_disk_device();
+// workers section
+private:
+    /**
+    * get the workers directive.
+    */
+    virtual SrsConfDirective*   get_workers();
+public:
+    /**
+    * whether the master/worker multiple processes mode enabled.
+    */
+    virtual bool                get_workers_enabled();
+    /**
+    * get the number of worker processes to fork.
+    */
+    virtual int                 get_workers_count();
+    /**
+    * get the base port of the worker local rtmp listeners,
+    * the worker i listen at 127.0.0.1:(port+i) for other workers to pull from.
+    */
+    virtual int                 get_workers_port();
+// async io section
+private:
+    /**
+    * get the async_io directive.
+    */
+    virtual SrsConfDirective*   get_async_io();
+public:
+    /**
+    * whether write file in the native threads of async io pool.
+    */
+    virtual bool                get_async_io_enabled();
+    /**
+    * get the number of native threads of async io pool.
+    */
+    virtual int                 get_async_io_threads();
+    /**
+    * get the max pending KB of each file, the write wait when exceed.
+    */
+    virtual int                 get_async_io_max_pending();
+    /**
+    * whether the dvr, hls and log use the async io.
+    * @remark false when async io disabled.
+    */
+    virtual bool                get_async_io_dvr();
+    virtual bool                get_async_io_hls();
+    virtual bool                get_async_io_log();
+    /**
+    * whether readahead the static files and vod streams of http server
+    * in async io, before sendfile them to players.
+    */
+    virtual bool                get_async_io_vod();
+// hooks pool section
+private:
+    /**
+    * get the hooks_pool directive.
+    */
+    virtual SrsConfDirective*   get_hooks_pool();
+public:
+    /**
+    * get the max keep-alive connections to each callback server.
+    */
+    virtual int                 get_hooks_pool_max_connections();
+    /**
+    * whether send the notify only hooks in background.
+    */
+    virtual bool                get_hooks_pool_async_notify();
+// dns resolver section
+private:
+    /**
+    * get the dns_resolver directive.
+    */
+    virtual SrsConfDirective*   get_dns_resolver();
+public:
+    /**
+    * whether resolve the domain over udp in st, use the system resolver when disabled.
+    */
+    virtual bool                get_dns_resolver_enabled();
+    /**
+    * get the timeout in ms for each nameserver to answer.
+    */
+    virtual int                 get_dns_resolver_timeout();
+    /**
+    * get the max seconds to cache the resolved ip.
+    */
+    virtual int                 get_dns_resolver_max_ttl();
+    /**
+    * get the seconds to cache the failed lookup.
+    */
+    virtual int                 get_dns_resolver_negative_ttl();
+// handshake section
+private:
+    /**
+    * get the handshake directive.
+    */
+    virtual SrsConfDirective*   get_handshake();
+public:
+    /**
+    * get the max pre-generated DH keys for complex handshake, 0 to disable.
+    */
+    virtual int                 get_handshake_dh_pool();
+    /**
+    * whether use simple handshake when the DH keys pool is used up.
+    */
+    virtual bool                get_handshake_overload();
 };
 
 namespace _srs_internal
@@ -1171,6 +1394,8 @@ extern bool srs_directive_equals(SrsConfDirective* a, SrsConfDirective* b);
  */
 extern bool srs_config_hls_is_on_error_ignore(std::string strategy);
 extern bool srs_config_hls_is_on_error_continue(std::string strategy);
+extern bool srs_config_hls_is_storage_disk(std::string storage);
+extern bool srs_config_hls_is_storage_ram(std::string storage);
 extern bool srs_config_ingest_is_file(std::string type);
 extern bool srs_config_ingest_is_stream(std::string type);
 extern bool srs_config_dvr_is_plan_segment(std::string plan);
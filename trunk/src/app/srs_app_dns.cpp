@@ -0,0 +1,584 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <srs_app_dns.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sstream>
+using namespace std;
+
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_stream.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_app_config.hpp>
+
+// the udp port of nameserver.
+#define SRS_DNS_PORT 53
+// the max size of udp dns message.
+#define SRS_DNS_UDP_SIZE 512
+// the A record and IN class.
+#define SRS_DNS_TYPE_A 1
+#define SRS_DNS_CLASS_IN 1
+// the rcode of answer when domain not exists.
+#define SRS_DNS_RCODE_NXDOMAIN 3
+// sweep the expired entries when cache exceed it.
+#define SRS_DNS_CACHE_MAX 1024
+
+SrsDnsPacket::SrsDnsPacket()
+{
+    id = 0;
+    rcode = 0;
+    ttl = 0;
+}
+
+SrsDnsPacket::~SrsDnsPacket()
+{
+}
+
+int SrsDnsPacket::encode(SrsStream* stream)
+{
+    int ret = ERROR_SUCCESS;
+
+    // header(12B) + name(host+2B) + qtype(2B) + qclass(2B)
+    if (!stream->require(12 + (int)host.length() + 2 + 4)) {
+        ret = ERROR_SYSTEM_DNS_RESOLVE;
+        srs_error("dns: encode query of %s requires more bytes. ret=%d", host.c_str(), ret);
+        return ret;
+    }
+
+    stream->write_2bytes(id);
+    // flags, the RD(recursion desired).
+    stream->write_2bytes(0x0100);
+    // qdcount, ancount, nscount, arcount
+    stream->write_2bytes(1);
+    stream->write_2bytes(0);
+    stream->write_2bytes(0);
+    stream->write_2bytes(0);
+
+    // the name in labels, for example, 3www6ossrs3net0
+    std::string name = srs_string_trim_end(host, ".");
+    while (!name.empty()) {
+        size_t pos = name.find(".");
+        std::string label = name.substr(0, pos);
+        name = (pos == std::string::npos)? "" : name.substr(pos + 1);
+
+        if (label.empty() || label.length() > 63) {
+            ret = ERROR_SYSTEM_DNS_RESOLVE;
+            srs_error("dns: invalid host %s. ret=%d", host.c_str(), ret);
+            return ret;
+        }
+
+        stream->write_1bytes((int8_t)label.length());
+        stream->write_string(label);
+    }
+    stream->write_1bytes(0);
+
+    stream->write_2bytes(SRS_DNS_TYPE_A);
+    stream->write_2bytes(SRS_DNS_CLASS_IN);
+
+    return ret;
+}
+
+int SrsDnsPacket::decode(SrsStream* stream)
+{
+    int ret = ERROR_SUCCESS;
+
+    if (!stream->require(12)) {
+        ret = ERROR_SYSTEM_DNS_RESOLVE;
+        srs_error("dns: decode header requires 12 bytes. ret=%d", ret);
+        return ret;
+    }
+
+    id = (uint16_t)stream->read_2bytes();
+    uint16_t flags = (uint16_t)stream->read_2bytes();
+    int qdcount = (uint16_t)stream->read_2bytes();
+    int ancount = (uint16_t)stream->read_2bytes();
+    stream->skip(4);
+
+    // must be the answer.
+    if ((flags & 0x8000) == 0) {
+        ret = ERROR_SYSTEM_DNS_RESOLVE;
+        srs_error("dns: decode message is not answer, flags=%#x. ret=%d", flags, ret);
+        return ret;
+    }
+    rcode = flags & 0x0f;
+
+    for (int i = 0; i < qdcount; i++) {
+        if ((ret = skip_name(stream)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        if (!stream->require(4)) {
+            ret = ERROR_SYSTEM_DNS_RESOLVE;
+            srs_error("dns: decode question requires 4 bytes. ret=%d", ret);
+            return ret;
+        }
+        stream->skip(4);
+    }
+
+    for (int i = 0; i < ancount; i++) {
+        if ((ret = skip_name(stream)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        // type(2B) + class(2B) + ttl(4B) + rdlength(2B)
+        if (!stream->require(10)) {
+            ret = ERROR_SYSTEM_DNS_RESOLVE;
+            srs_error("dns: decode record requires 10 bytes. ret=%d", ret);
+            return ret;
+        }
+        int type = (uint16_t)stream->read_2bytes();
+        int klass = (uint16_t)stream->read_2bytes();
+        int record_ttl = stream->read_4bytes();
+        int rdlength = (uint16_t)stream->read_2bytes();
+
+        if (!stream->require(rdlength)) {
+            ret = ERROR_SYSTEM_DNS_RESOLVE;
+            srs_error("dns: decode record requires %d bytes. ret=%d", rdlength, ret);
+            return ret;
+        }
+
+        // ignore the CNAME, its A records follow it.
+        if (type != SRS_DNS_TYPE_A || klass != SRS_DNS_CLASS_IN || rdlength != 4) {
+            stream->skip(rdlength);
+            continue;
+        }
+
+        char ipv4[16];
+        in_addr addr;
+        memcpy(&addr, stream->data() + stream->pos(), 4);
+        stream->skip(4);
+
+        if (!inet_ntop(AF_INET, &addr, ipv4, sizeof(ipv4))) {
+            continue;
+        }
+        ips.push_back(ipv4);
+
+        record_ttl = srs_max(0, record_ttl);
+        ttl = (ips.size() == 1)? record_ttl : srs_min(ttl, record_ttl);
+    }
+
+    return ret;
+}
+
+int SrsDnsPacket::skip_name(SrsStream* stream)
+{
+    int ret = ERROR_SUCCESS;
+
+    while (true) {
+        if (!stream->require(1)) {
+            ret = ERROR_SYSTEM_DNS_RESOLVE;
+            srs_error("dns: decode name requires 1 byte. ret=%d", ret);
+            return ret;
+        }
+
+        uint8_t len = (uint8_t)stream->read_1bytes();
+        if (len == 0) {
+            break;
+        }
+
+        // the compressed name, 2B pointer ends the name.
+        if ((len & 0xc0) == 0xc0) {
+            if (!stream->require(1)) {
+                ret = ERROR_SYSTEM_DNS_RESOLVE;
+                srs_error("dns: decode name pointer requires 1 byte. ret=%d", ret);
+                return ret;
+            }
+            stream->skip(1);
+            break;
+        }
+
+        if (!stream->require(len)) {
+            ret = ERROR_SYSTEM_DNS_RESOLVE;
+            srs_error("dns: decode label requires %d bytes. ret=%d", len, ret);
+            return ret;
+        }
+        stream->skip(len);
+    }
+
+    return ret;
+}
+
+SrsDnsResolver::SrsDnsEntry::SrsDnsEntry()
+{
+    expired = 0;
+}
+
+SrsDnsResolver* SrsDnsResolver::_instance = new SrsDnsResolver();
+
+SrsDnsResolver::SrsDnsResolver()
+{
+    loaded = false;
+    cond = NULL;
+
+    nb_lookups = 0;
+    nb_hits = 0;
+    nb_queries = 0;
+    nb_failures = 0;
+    total_latency = 0;
+    max_latency = 0;
+}
+
+SrsDnsResolver::~SrsDnsResolver()
+{
+    // the resolver is never destroyed, for the thread maybe waiting.
+}
+
+SrsDnsResolver* SrsDnsResolver::instance()
+{
+    return _instance;
+}
+
+int SrsDnsResolver::resolve(string host, string* pip)
+{
+    int ret = ERROR_SUCCESS;
+
+    if (inet_addr(host.c_str()) != INADDR_NONE) {
+        *pip = host;
+        return ret;
+    }
+
+    // use the blocking resolver of system when disabled.
+    if (!_srs_config->get_dns_resolver_enabled()) {
+        if ((*pip = srs_dns_resolve(host)).empty()) {
+            ret = ERROR_SYSTEM_DNS_RESOLVE;
+            srs_error("dns: resolve %s by system failed. ret=%d", host.c_str(), ret);
+        }
+        return ret;
+    }
+
+    // the cond is created when st initialized.
+    if (!loaded) {
+        load();
+    }
+
+    nb_lookups++;
+
+    // the static hosts never expired.
+    std::map<std::string, std::string>::iterator hit = hosts.find(host);
+    if (hit != hosts.end()) {
+        nb_hits++;
+        *pip = hit->second;
+        return ret;
+    }
+
+    while (true) {
+        std::map<std::string, SrsDnsEntry>::iterator it = entries.find(host);
+        if (it != entries.end() && it->second.expired > srs_get_system_time_ms()) {
+            nb_hits++;
+
+            SrsDnsEntry& entry = it->second;
+            if (entry.ip.empty()) {
+                ret = ERROR_SYSTEM_DNS_RESOLVE;
+                srs_warn("dns: resolve %s failed in cache. ret=%d", host.c_str(), ret);
+                return ret;
+            }
+
+            *pip = entry.ip;
+            return ret;
+        }
+
+        // query it when no one is querying.
+        if (querying.find(host) == querying.end()) {
+            break;
+        }
+
+        // wait for the query in flight, which always signal when done.
+        if (st_cond_wait(cond) != 0) {
+            ret = ERROR_SYSTEM_DNS_RESOLVE;
+            srs_warn("dns: wait for %s interrupted. ret=%d", host.c_str(), ret);
+            return ret;
+        }
+    }
+
+    // sweep the expired entries.
+    if (entries.size() >= SRS_DNS_CACHE_MAX) {
+        int64_t now = srs_get_system_time_ms();
+        std::map<std::string, SrsDnsEntry>::iterator it;
+        for (it = entries.begin(); it != entries.end();) {
+            if (it->second.expired <= now) {
+                entries.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    querying.insert(host);
+
+    std::string ip;
+    int ttl = 0;
+    int64_t starttime = srs_update_system_time_ms();
+    ret = query(host, &ip, &ttl);
+    int64_t latency = srs_update_system_time_ms() - starttime;
+
+    nb_queries++;
+    total_latency += latency;
+    max_latency = srs_max(max_latency, latency);
+
+    // cache the answer by ttl of record, or the failure by negative ttl.
+    SrsDnsEntry& entry = entries[host];
+    entry.ip = ip;
+    if (ret == ERROR_SUCCESS) {
+        ttl = srs_max(1, srs_min(ttl, _srs_config->get_dns_resolver_max_ttl()));
+        srs_trace("dns: resolve %s to %s, ttl=%ds, latency=%dms", host.c_str(), ip.c_str(), ttl, (int)latency);
+    } else {
+        nb_failures++;
+        ttl = _srs_config->get_dns_resolver_negative_ttl();
+        srs_error("dns: resolve %s failed, negative ttl=%ds, latency=%dms. ret=%d", host.c_str(), ttl, (int)latency, ret);
+    }
+    entry.expired = srs_get_system_time_ms() + ttl * 1000;
+
+    querying.erase(host);
+    st_cond_broadcast(cond);
+
+    if (ret == ERROR_SUCCESS) {
+        *pip = ip;
+    }
+
+    return ret;
+}
+
+int64_t SrsDnsResolver::lookups()
+{
+    return nb_lookups;
+}
+
+int64_t SrsDnsResolver::hits()
+{
+    return nb_hits;
+}
+
+int64_t SrsDnsResolver::queries()
+{
+    return nb_queries;
+}
+
+int64_t SrsDnsResolver::failures()
+{
+    return nb_failures;
+}
+
+int64_t SrsDnsResolver::avg_latency()
+{
+    if (nb_queries <= 0) {
+        return 0;
+    }
+    return total_latency / nb_queries;
+}
+
+int64_t SrsDnsResolver::peak_latency()
+{
+    return max_latency;
+}
+
+void SrsDnsResolver::load()
+{
+    loaded = true;
+    cond = st_cond_new();
+
+    char buf[1024];
+
+    // nameserver 8.8.8.8
+    // search ossrs.net
+    FILE* f = fopen("/etc/resolv.conf", "r");
+    while (f && fgets(buf, sizeof(buf), f)) {
+        std::stringstream ss(buf);
+        std::string key, value;
+        if (!(ss >> key) || key.at(0) == '#' || key.at(0) == ';') {
+            continue;
+        }
+
+        if (key == "nameserver" && (ss >> value) && inet_addr(value.c_str()) != INADDR_NONE) {
+            nameservers.push_back(value);
+        } else if (key == "search" || key == "domain") {
+            domains.clear();
+            while (ss >> value) {
+                domains.push_back(srs_string_trim_end(value, "."));
+            }
+        }
+    }
+    if (f) {
+        fclose(f);
+    }
+
+    // the default nameserver of resolv.conf
+    if (nameservers.empty()) {
+        nameservers.push_back("127.0.0.1");
+    }
+
+    // 127.0.0.1 localhost localhost.localdomain
+    f = fopen("/etc/hosts", "r");
+    while (f && fgets(buf, sizeof(buf), f)) {
+        std::string line = buf;
+        line = line.substr(0, line.find("#"));
+
+        std::stringstream ss(line);
+        std::string ip, name;
+        if (!(ss >> ip) || inet_addr(ip.c_str()) == INADDR_NONE) {
+            continue;
+        }
+
+        // the first ip of host is used.
+        while (ss >> name) {
+            if (hosts.find(name) == hosts.end()) {
+                hosts[name] = ip;
+            }
+        }
+    }
+    if (f) {
+        fclose(f);
+    }
+
+    srs_trace("dns: resolver nameservers=%d, first=%s, domains=%d, hosts=%d",
+        (int)nameservers.size(), nameservers.at(0).c_str(), (int)domains.size(), (int)hosts.size());
+}
+
+int SrsDnsResolver::query(string host, string* pip, int* pttl)
+{
+    int ret = ERROR_SUCCESS;
+
+    // the host without dot is tried with the search domains first.
+    std::vector<std::string> names;
+    if (host.find(".") == std::string::npos) {
+        for (int i = 0; i < (int)domains.size(); i++) {
+            names.push_back(host + "." + domains.at(i));
+        }
+    }
+    names.push_back(host);
+
+    int64_t timeout_us = (int64_t)_srs_config->get_dns_resolver_timeout() * 1000;
+
+    for (int i = 0; i < (int)names.size(); i++) {
+        std::string name = names.at(i);
+
+        // try the next nameserver when error or timeout,
+        // and the next name when domain not exists.
+        for (int j = 0; j < (int)nameservers.size(); j++) {
+            std::string server = nameservers.at(j);
+
+            int rcode = 0;
+            if ((ret = query_server(server, name, timeout_us, pip, pttl, &rcode)) == ERROR_SUCCESS) {
+                return ret;
+            }
+
+            if (rcode == SRS_DNS_RCODE_NXDOMAIN) {
+                break;
+            }
+        }
+    }
+
+    return ret;
+}
+
+int SrsDnsResolver::query_server(string server, string name, int64_t timeout_us, string* pip, int* pttl, int* prcode)
+{
+    int ret = ERROR_SUCCESS;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock == -1) {
+        ret = ERROR_SOCKET_CREATE;
+        srs_error("dns: create udp socket error. ret=%d", ret);
+        return ret;
+    }
+
+    st_netfd_t stfd = st_netfd_open_socket(sock);
+    if (stfd == NULL) {
+        ret = ERROR_ST_OPEN_SOCKET;
+        srs_error("dns: st open udp socket failed. ret=%d", ret);
+        ::close(sock);
+        return ret;
+    }
+
+    char buf[SRS_DNS_UDP_SIZE];
+    SrsStream stream;
+
+    SrsDnsPacket question;
+    question.id = (uint16_t)::random();
+    question.host = name;
+
+    sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SRS_DNS_PORT);
+    addr.sin_addr.s_addr = inet_addr(server.c_str());
+
+    int64_t deadline = srs_update_system_time_ms() + timeout_us / 1000;
+
+    if ((ret = stream.initialize(buf, sizeof(buf))) != ERROR_SUCCESS) {
+        goto failed;
+    }
+    if ((ret = question.encode(&stream)) != ERROR_SUCCESS) {
+        goto failed;
+    }
+
+    if (st_sendto(stfd, buf, stream.pos(), (sockaddr*)&addr, sizeof(sockaddr_in), timeout_us) <= 0) {
+        ret = ERROR_SYSTEM_DNS_RESOLVE;
+        srs_error("dns: send query of %s to %s failed. ret=%d", name.c_str(), server.c_str(), ret);
+        goto failed;
+    }
+
+    // drop the unexpected packets until the answer of query.
+    while (true) {
+        int64_t left = deadline - srs_update_system_time_ms();
+
+        sockaddr_in from;
+        int nb_from = sizeof(sockaddr_in);
+        int nread = 0;
+        if (left <= 0 || (nread = st_recvfrom(stfd, buf, sizeof(buf), (sockaddr*)&from, &nb_from, left * 1000)) <= 0) {
+            ret = ERROR_SYSTEM_DNS_RESOLVE;
+            srs_warn("dns: query %s on %s timeout, timeout=%dms. ret=%d", name.c_str(), server.c_str(), (int)(timeout_us / 1000), ret);
+            goto failed;
+        }
+
+        if (from.sin_addr.s_addr != addr.sin_addr.s_addr || from.sin_port != addr.sin_port) {
+            continue;
+        }
+
+        SrsDnsPacket answer;
+        if ((ret = stream.initialize(buf, nread)) != ERROR_SUCCESS) {
+            goto failed;
+        }
+        if (answer.decode(&stream) != ERROR_SUCCESS || answer.id != question.id) {
+            continue;
+        }
+
+        *prcode = answer.rcode;
+        if (answer.ips.empty()) {
+            ret = ERROR_SYSTEM_DNS_RESOLVE;
+            srs_info("dns: no A record of %s on %s, rcode=%d. ret=%d", name.c_str(), server.c_str(), answer.rcode, ret);
+            goto failed;
+        }
+
+        *pip = answer.ips.at(0);
+        *pttl = answer.ttl;
+        break;
+    }
+
+failed:
+    srs_close_stfd(stfd);
+    return ret;
+}
@@ -0,0 +1,160 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SRS_APP_DNS_HPP
+#define SRS_APP_DNS_HPP
+
+/*
+#include <srs_app_dns.hpp>
+*/
+#include <srs_core.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <srs_app_st.hpp>
+
+class SrsStream;
+
+/**
+ * the dns packet of A record, encode the query and decode the answer.
+ * @see https://tools.ietf.org/html/rfc1035#section-4
+ */
+class SrsDnsPacket
+{
+public:
+    // the id to match the answer to query.
+    uint16_t id;
+    // the domain to query.
+    std::string host;
+public:
+    // the rcode of answer, 0 is no error, 3 is NXDOMAIN.
+    int rcode;
+    // the ipv4 of A records in answer.
+    std::vector<std::string> ips;
+    // the min ttl in seconds of the A records.
+    int ttl;
+public:
+    SrsDnsPacket();
+    virtual ~SrsDnsPacket();
+public:
+    /**
+     * encode the query of A record for host.
+     */
+    virtual int encode(SrsStream* stream);
+    /**
+     * decode the answer, ignore the records except A.
+     */
+    virtual int decode(SrsStream* stream);
+private:
+    virtual int skip_name(SrsStream* stream);
+};
+
+/**
+ * the resolver which sends the dns query over udp in st,
+ * so a slow nameserver only blocks the thread who connects,
+ * never the whole server like gethostbyname.
+ * the answer is cached for the ttl of record, and the failed
+ * lookup is cached for the negative ttl, the concurrent lookups
+ * of the same host wait for the one in flight.
+ * @remark the /etc/hosts and /etc/resolv.conf are loaded once.
+ */
+class SrsDnsResolver
+{
+private:
+    static SrsDnsResolver* _instance;
+private:
+    class SrsDnsEntry
+    {
+    public:
+        // the resolved ip, empty for the negative entry.
+        std::string ip;
+        // the time in ms when entry expired.
+        int64_t expired;
+    public:
+        SrsDnsEntry();
+    };
+private:
+    bool loaded;
+    // the nameservers, the ipv4 only.
+    std::vector<std::string> nameservers;
+    // the search domains for the host without dot.
+    std::vector<std::string> domains;
+    // the static hosts, key is the host.
+    std::map<std::string, std::string> hosts;
+    // the cache, key is the host.
+    std::map<std::string, SrsDnsEntry> entries;
+    // the hosts in querying, others wait on the cond.
+    std::set<std::string> querying;
+    st_cond_t cond;
+private:
+    // the number of lookups, and the lookups answered by cache.
+    int64_t nb_lookups;
+    int64_t nb_hits;
+    // the number of queries to nameservers, and the failed ones.
+    int64_t nb_queries;
+    int64_t nb_failures;
+    // the latency in ms of queries.
+    int64_t total_latency;
+    int64_t max_latency;
+private:
+    SrsDnsResolver();
+public:
+    virtual ~SrsDnsResolver();
+public:
+    static SrsDnsResolver* instance();
+public:
+    /**
+     * resolve the host to ipv4, return directly when host is ip.
+     * @param pip output the ip.
+     * @return ERROR_SYSTEM_DNS_RESOLVE when no A record or timeout.
+     */
+    virtual int resolve(std::string host, std::string* pip);
+public:
+    virtual int64_t lookups();
+    virtual int64_t hits();
+    virtual int64_t queries();
+    virtual int64_t failures();
+    /**
+     * the average and max latency in ms of queries to nameservers.
+     */
+    virtual int64_t avg_latency();
+    virtual int64_t peak_latency();
+private:
+    /**
+     * load the nameservers, search domains and static hosts.
+     */
+    virtual void load();
+    /**
+     * query the host with the search domains.
+     */
+    virtual int query(std::string host, std::string* pip, int* pttl);
+    /**
+     * query the name on the nameserver, the rcode is 3 for NXDOMAIN.
+     */
+    virtual int query_server(std::string server, std::string name, int64_t timeout_us, std::string* pip, int* pttl, int* prcode);
+};
+
+#endif
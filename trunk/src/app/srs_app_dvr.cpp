@@ -42,6 +42,7 @@ using namespace std;
 #include <srs_kernel_stream.hpp>
 #include <srs_protocol_json.hpp>
 #include <srs_app_utility.hpp>
+#include <srs_app_async_io.hpp>
 
 // update the flv duration and filesize every this interval in ms.
 #define SRS_DVR_UPDATE_DURATION_INTERVAL 60000
@@ -52,7 +53,11 @@ SrsFlvSegment::SrsFlvSegment(SrsDvrPlan* p)
     jitter = NULL;
     plan = p;
 
-    fs = new SrsFileWriter();
+    if (_srs_config->get_async_io_dvr()) {
+        fs = new SrsAsyncFileWriter();
+    } else {
+        fs = new SrsFileWriter();
+    }
     enc = new SrsFlvEncoder();
     jitter_algorithm = SrsRtmpJitterAlgorithmOFF;
 
@@ -317,7 +322,7 @@ int SrsFlvSegment::write_video(SrsSharedPtrMessage* shared_video)
     // accept the sequence header here.
     // when got no keyframe, ignore when should wait keyframe.
     if (!has_keyframe && !is_sequence_header) {
-        bool wait_keyframe = _srs_config->get_dvr_wait_keyframe(req->vhost);
+        bool wait_keyframe = plan->settings->dvr_wait_keyframe;
         if (wait_keyframe) {
             srs_info("dvr: ignore when wait keyframe.");
             return ret;
@@ -555,6 +560,7 @@ string SrsDvrAsyncCallOnDvr::to_string()
 SrsDvrPlan::SrsDvrPlan()
 {
     req = NULL;
+    settings = NULL;
 
     dvr_enabled = false;
     segment = new SrsFlvSegment(this);
@@ -572,6 +578,7 @@ int SrsDvrPlan::initialize(SrsRequest* r)
     int ret = ERROR_SUCCESS;
     
     req = r;
+    settings = _srs_config->get_vhost_settings(req->vhost);
 
     if ((ret = segment->initialize(r)) != ERROR_SUCCESS) {
         return ret;
@@ -929,7 +936,7 @@ int SrsDvrSegmentPlan::update_duration(SrsSharedPtrMessage* msg)
     
     // when wait keyframe, ignore if no frame arrived.
     // @see https://github.com/ossrs/srs/issues/177
-    if (_srs_config->get_dvr_wait_keyframe(req->vhost)) {
+    if (settings->dvr_wait_keyframe) {
         if (!msg->is_video()) {
             return ret;
         }
@@ -46,6 +46,7 @@ class SrsDvrPlan;
 class SrsJsonAny;
 class SrsJsonObject;
 class SrsThread;
+class SrsVhostSettings;
 
 #include <srs_app_source.hpp>
 #include <srs_app_reload.hpp>
@@ -205,6 +206,8 @@ public:
     friend class SrsFlvSegment;
 public:
     SrsRequest* req;
+    // the compiled vhost settings, never free it.
+    SrsVhostSettings* settings;
 protected:
     SrsFlvSegment* segment;
     SrsAsyncCallWorker* async;
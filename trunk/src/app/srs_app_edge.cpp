@@ -44,6 +44,8 @@ using namespace std;
 #include <srs_app_utility.hpp>
 #include <srs_rtmp_amf0.hpp>
 #include <srs_kernel_utility.hpp>
+#include <srs_app_worker.hpp>
+#include <srs_protocol_json.hpp>
 
 // when error, edge ingester sleep for a while and retry.
 #define SRS_EDGE_INGESTER_SLEEP_US (int64_t)(1*1000*1000LL)
@@ -60,6 +62,302 @@ using namespace std;
 // when edge error, wait for quit
 #define SRS_EDGE_FORWARDER_ERROR_US (int64_t)(50*1000LL)
 
+// the continuous failures to open the circuit of origin.
+#define SRS_EDGE_ORIGIN_BREAK_FAILURES 3
+// the time in ms the circuit is open, doubled for each failure after open.
+#define SRS_EDGE_ORIGIN_BREAK_MS 5000
+#define SRS_EDGE_ORIGIN_BREAK_MAX_MS 60000
+// the time in ms for the trial of half-open circuit, the origin is not
+// selected by others util the trial connected, failed or timeout.
+#define SRS_EDGE_ORIGIN_TRIAL_MS 3000
+// the interval in ms to sample the kbps of origin.
+#define SRS_EDGE_ORIGIN_SAMPLE_MS 10000
+
+SrsEdgeOrigin::SrsEdgeOrigin(string ep)
+{
+    endpoint = ep;
+    srtt = 0;
+    nb_streak = 0;
+    nb_failures = 0;
+    nb_connects = 0;
+    open_until = 0;
+    nb_active = 0;
+    nb_bytes = 0;
+    sample_bytes = 0;
+    sample_time = 0;
+    kbps = 0;
+}
+
+SrsEdgeOrigin::~SrsEdgeOrigin()
+{
+}
+
+bool SrsEdgeOrigin::available(int64_t now)
+{
+    return open_until <= now;
+}
+
+bool SrsEdgeOrigin::half_open(int64_t now)
+{
+    return nb_streak >= SRS_EDGE_ORIGIN_BREAK_FAILURES && open_until <= now;
+}
+
+int64_t SrsEdgeOrigin::cost()
+{
+    // the never connected origin is 0, to probe it.
+    return (int64_t)srtt * (nb_active + 1);
+}
+
+void SrsEdgeOrigin::sample(int64_t now)
+{
+    if (sample_time <= 0) {
+        sample_time = now;
+        sample_bytes = nb_bytes;
+        return;
+    }
+    
+    int64_t elapsed = now - sample_time;
+    if (elapsed < SRS_EDGE_ORIGIN_SAMPLE_MS) {
+        return;
+    }
+    
+    kbps = (int)((nb_bytes - sample_bytes) * 8 / elapsed);
+    sample_time = now;
+    sample_bytes = nb_bytes;
+}
+
+int SrsEdgeOrigin::dumps(stringstream& ss, int64_t now)
+{
+    int ret = ERROR_SUCCESS;
+    
+    sample(now);
+    
+    ss << SRS_JOBJECT_START
+            << SRS_JFIELD_STR("endpoint", endpoint) << SRS_JFIELD_CONT
+            << SRS_JFIELD_STR("circuit", (half_open(now)? "half-open" : (available(now)? "closed":"open"))) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("open_ms", srs_max(0, open_until - now)) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("srtt", srtt) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("streak", nb_streak) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("failures", nb_failures) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("connects", nb_connects) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("active", nb_active) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("kbps", kbps)
+        << SRS_JOBJECT_END;
+    
+    return ret;
+}
+
+SrsEdgeOriginPool* SrsEdgeOriginPool::_instance = new SrsEdgeOriginPool();
+
+SrsEdgeOriginPool::SrsEdgeOriginPool()
+{
+}
+
+SrsEdgeOriginPool::~SrsEdgeOriginPool()
+{
+    std::map<std::string, SrsEdgeOrigin*>::iterator it;
+    for (it = origins.begin(); it != origins.end(); ++it) {
+        SrsEdgeOrigin* o = it->second;
+        srs_freep(o);
+    }
+    origins.clear();
+}
+
+SrsEdgeOriginPool* SrsEdgeOriginPool::instance()
+{
+    return _instance;
+}
+
+string SrsEdgeOriginPool::select(string vhost, SrsConfDirective* conf, string url, int* pindex)
+{
+    return select(vhost, conf, url, pindex, srs_get_system_time_ms());
+}
+
+string SrsEdgeOriginPool::select(string vhost, SrsConfDirective* conf, string url, int* pindex, int64_t now)
+{
+    int nb_origins = (int)conf->args.size();
+    std::string strategy = _srs_config->get_vhost_edge_origin_select(vhost);
+    
+    // select the next origin.
+    if (strategy == "round_robin" || nb_origins == 1) {
+        std::string ep = conf->args.at(*pindex % nb_origins);
+        *pindex = (*pindex + 1) % nb_origins;
+        return ep;
+    }
+    
+    // stick to the origin by hash of url, util its circuit opens,
+    // and stick again when the trial of half-open circuit connected.
+    if (strategy == "hash") {
+        u_int32_t hash = srs_crc32(url.data(), (int)url.length());
+        SrsEdgeOrigin* o = fetch(conf->args.at(hash % (u_int32_t)nb_origins));
+        if (o->available(now)) {
+            return on_selected(o, now);
+        }
+    }
+    
+    // try the half-open origin first, or it's never selected again
+    // when other origins are ok.
+    for (int i = 0; i < nb_origins; i++) {
+        int index = (*pindex + i) % nb_origins;
+        SrsEdgeOrigin* o = fetch(conf->args.at(index));
+        if (o->half_open(now)) {
+            *pindex = (index + 1) % nb_origins;
+            return on_selected(o, now);
+        }
+    }
+    
+    // the closed origin with least cost, the failures under the threshold
+    // never change the order, start from the index to probe the never
+    // connected origins in turn.
+    SrsEdgeOrigin* best = NULL;
+    int best_index = 0;
+    // when all circuits open, use the one closes soonest.
+    SrsEdgeOrigin* soonest = NULL;
+    int soonest_index = 0;
+    
+    for (int i = 0; i < nb_origins; i++) {
+        int index = (*pindex + i) % nb_origins;
+        SrsEdgeOrigin* o = fetch(conf->args.at(index));
+        
+        if (!soonest || o->open_until < soonest->open_until) {
+            soonest = o;
+            soonest_index = index;
+        }
+        
+        if (!o->available(now)) {
+            continue;
+        }
+        
+        if (!best || o->cost() < best->cost()) {
+            best = o;
+            best_index = index;
+        }
+    }
+    
+    if (!best) {
+        best = soonest;
+        best_index = soonest_index;
+        srs_warn("edge: all origins of vhost %s are open, try %s", vhost.c_str(), best->endpoint.c_str());
+    }
+    
+    *pindex = (best_index + 1) % nb_origins;
+    return on_selected(best, now);
+}
+
+void SrsEdgeOriginPool::on_connected(string ep, int rtt)
+{
+    if (ep.empty()) {
+        return;
+    }
+    
+    SrsEdgeOrigin* o = fetch(ep);
+    
+    rtt = srs_max(1, rtt);
+    o->srtt = (o->srtt <= 0)? rtt : (o->srtt * 7 + rtt) / 8;
+    o->nb_streak = 0;
+    o->open_until = 0;
+    o->nb_connects++;
+    o->nb_active++;
+    
+    srs_info("edge: origin %s connected, rtt=%d, srtt=%d, active=%d", ep.c_str(), rtt, o->srtt, o->nb_active);
+}
+
+void SrsEdgeOriginPool::on_failure(string ep)
+{
+    if (ep.empty()) {
+        return;
+    }
+    
+    SrsEdgeOrigin* o = fetch(ep);
+    
+    o->nb_streak++;
+    o->nb_failures++;
+    
+    if (o->nb_streak < SRS_EDGE_ORIGIN_BREAK_FAILURES) {
+        return;
+    }
+    
+    // open the circuit, longer for more failures.
+    int shift = srs_min(o->nb_streak - SRS_EDGE_ORIGIN_BREAK_FAILURES, 4);
+    int64_t duration = srs_min(SRS_EDGE_ORIGIN_BREAK_MAX_MS, SRS_EDGE_ORIGIN_BREAK_MS << shift);
+    o->open_until = srs_get_system_time_ms() + duration;
+    
+    srs_warn("edge: origin %s circuit open for %dms, streak=%d, failures=%"PRId64,
+        ep.c_str(), (int)duration, o->nb_streak, o->nb_failures);
+}
+
+void SrsEdgeOriginPool::on_close(string ep, int64_t bytes)
+{
+    if (ep.empty()) {
+        return;
+    }
+    
+    SrsEdgeOrigin* o = fetch(ep);
+    
+    o->nb_active--;
+    o->nb_bytes += bytes;
+    o->sample(srs_get_system_time_ms());
+}
+
+void SrsEdgeOriginPool::on_bytes(string ep, int64_t bytes)
+{
+    if (ep.empty()) {
+        return;
+    }
+    
+    SrsEdgeOrigin* o = fetch(ep);
+    
+    o->nb_bytes += bytes;
+    o->sample(srs_get_system_time_ms());
+}
+
+int SrsEdgeOriginPool::dumps(stringstream& ss)
+{
+    int ret = ERROR_SUCCESS;
+    
+    int64_t now = srs_get_system_time_ms();
+    
+    ss << SRS_JARRAY_START;
+    std::map<std::string, SrsEdgeOrigin*>::iterator it;
+    for (it = origins.begin(); it != origins.end(); ++it) {
+        SrsEdgeOrigin* o = it->second;
+        
+        if (it != origins.begin()) {
+            ss << SRS_JFIELD_CONT;
+        }
+        
+        if ((ret = o->dumps(ss, now)) != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    ss << SRS_JARRAY_END;
+    
+    return ret;
+}
+
+string SrsEdgeOriginPool::on_selected(SrsEdgeOrigin* o, int64_t now)
+{
+    // the trial of half-open circuit, open it util the trial done.
+    if (o->half_open(now)) {
+        o->open_until = now + SRS_EDGE_ORIGIN_TRIAL_MS;
+        srs_trace("edge: origin %s circuit half-open, try it, streak=%d", o->endpoint.c_str(), o->nb_streak);
+    }
+    
+    return o->endpoint;
+}
+
+SrsEdgeOrigin* SrsEdgeOriginPool::fetch(string ep)
+{
+    std::map<std::string, SrsEdgeOrigin*>::iterator it = origins.find(ep);
+    if (it != origins.end()) {
+        return it->second;
+    }
+    
+    SrsEdgeOrigin* o = new SrsEdgeOrigin(ep);
+    origins[ep] = o;
+    return o;
+}
+
 SrsEdgeIngester::SrsEdgeIngester()
 {
     io = NULL;
@@ -123,13 +421,44 @@ int SrsEdgeIngester::cycle()
     int ret = ERROR_SUCCESS;
 
     _source->on_source_id_changed(_srs_context->get_id());
+    
+    SrsEdgeOriginPool* pool = SrsEdgeOriginPool::instance();
+    int64_t starttime = srs_update_system_time_ms();
         
     std::string ep_server, ep_port;
     if ((ret = connect_server(ep_server, ep_port)) != ERROR_SUCCESS) {
+        pool->on_failure(origin);
+        origin = "";
         return ret;
     }
     srs_assert(client);
+    
+    if ((ret = connect_stream(ep_server, ep_port)) != ERROR_SUCCESS) {
+        pool->on_failure(origin);
+        origin = "";
+        return ret;
+    }
+    pool->on_connected(origin, (int)(srs_update_system_time_ms() - starttime));
+    
+    if ((ret = _edge->on_ingest_play()) != ERROR_SUCCESS) {
+        report_origin(true);
+        return ret;
+    }
+    
+    ret = ingest();
+    report_origin(true);
+    if (srs_is_client_gracefully_close(ret)) {
+        srs_warn("origin disconnected, retry. ret=%d", ret);
+        ret = ERROR_SUCCESS;
+    }
+    
+    return ret;
+}
 
+int SrsEdgeIngester::connect_stream(string ep_server, string ep_port)
+{
+    int ret = ERROR_SUCCESS;
+    
     client->set_recv_timeout(SRS_CONSTS_RTMP_RECV_TIMEOUT_US);
     client->set_send_timeout(SRS_CONSTS_RTMP_SEND_TIMEOUT_US);
 
@@ -153,16 +482,6 @@ int SrsEdgeIngester::cycle()
         return ret;
     }
     
-    if ((ret = _edge->on_ingest_play()) != ERROR_SUCCESS) {
-        return ret;
-    }
-    
-    ret = ingest();
-    if (srs_is_client_gracefully_close(ret)) {
-        srs_warn("origin disconnected, retry. ret=%d", ret);
-        ret = ERROR_SUCCESS;
-    }
-    
     return ret;
 }
 
@@ -172,6 +491,11 @@ int SrsEdgeIngester::ingest()
     
     client->set_recv_timeout(SRS_EDGE_INGESTER_TIMEOUT_US);
     
+#ifdef SRS_PERF_RECV_SLAB
+    // receive the payload from origin in slab, like the publisher.
+    client->set_recv_slab(true);
+#endif
+    
     SrsPithyPrint* pprint = SrsPithyPrint::create_edge();
     SrsAutoFree(SrsPithyPrint, pprint);
 
@@ -186,6 +510,7 @@ int SrsEdgeIngester::ingest()
                 pprint->age(),
                 kbps->get_send_kbps(), kbps->get_send_kbps_30s(), kbps->get_send_kbps_5m(),
                 kbps->get_recv_kbps(), kbps->get_recv_kbps_30s(), kbps->get_recv_kbps_5m());
+            report_origin(false);
         }
 
         // read from client.
@@ -333,6 +658,25 @@ void SrsEdgeIngester::close_underlayer_socket()
     srs_close_stfd(stfd);
 }
 
+void SrsEdgeIngester::report_origin(bool closed)
+{
+    if (origin.empty()) {
+        return;
+    }
+    
+    kbps->resample();
+    int64_t bytes = kbps->get_recv_bytes_delta() + kbps->get_send_bytes_delta();
+    kbps->cleanup();
+    
+    if (!closed) {
+        SrsEdgeOriginPool::instance()->on_bytes(origin, bytes);
+        return;
+    }
+    
+    SrsEdgeOriginPool::instance()->on_close(origin, bytes);
+    origin = "";
+}
+
 int SrsEdgeIngester::connect_server(string& ep_server, string& ep_port)
 {
     int ret = ERROR_SUCCESS;
@@ -340,21 +684,29 @@ int SrsEdgeIngester::connect_server(string& ep_server, string& ep_port)
     // reopen
     close_underlayer_socket();
     
-    SrsConfDirective* conf = _srs_config->get_vhost_edge_origin(_req->vhost);
-    
-    // @see https://github.com/ossrs/srs/issues/79
-    // when origin is error, for instance, server is shutdown,
-    // then user remove the vhost then reload, the conf is empty.
-    if (!conf) {
-        ret = ERROR_EDGE_VHOST_REMOVED;
-        srs_warn("vhost %s removed. ret=%d", _req->vhost.c_str(), ret);
-        return ret;
+    origin = "";
+    std::string server;
+    if (srs_worker_is_proxy(_req)) {
+        // the worker proxy pull from the local port of owner worker.
+        int owner = srs_worker_owner(_req->get_stream_url());
+        server = srs_worker_local_endpoint(owner);
+    } else {
+        SrsConfDirective* conf = _srs_config->get_vhost_edge_origin(_req->vhost);
+        
+        // @see https://github.com/ossrs/srs/issues/79
+        // when origin is error, for instance, server is shutdown,
+        // then user remove the vhost then reload, the conf is empty.
+        if (!conf) {
+            ret = ERROR_EDGE_VHOST_REMOVED;
+            srs_warn("vhost %s removed. ret=%d", _req->vhost.c_str(), ret);
+            return ret;
+        }
+        
+        // select the origin.
+        server = SrsEdgeOriginPool::instance()->select(_req->vhost, conf, _req->get_stream_url(), &origin_index);
+        origin = server;
     }
     
-    // select the origin.
-    std::string server = conf->args.at(origin_index % conf->args.size());
-    origin_index = (origin_index + 1) % conf->args.size();
-    
     std::string s_port = SRS_CONSTS_RTMP_DEFAULT_PORT;
     int port = ::atoi(SRS_CONSTS_RTMP_DEFAULT_PORT);
     size_t pos = server.find(":");
@@ -438,12 +790,31 @@ int SrsEdgeForwarder::start()
     
     send_error_code = ERROR_SUCCESS;
     
+    SrsEdgeOriginPool* pool = SrsEdgeOriginPool::instance();
+    int64_t starttime = srs_update_system_time_ms();
+    
     std::string ep_server, ep_port;
     if ((ret = connect_server(ep_server, ep_port)) != ERROR_SUCCESS) {
+        pool->on_failure(origin);
+        origin = "";
         return ret;
     }
     srs_assert(client);
+    
+    if ((ret = connect_stream(ep_server, ep_port)) != ERROR_SUCCESS) {
+        pool->on_failure(origin);
+        origin = "";
+        return ret;
+    }
+    pool->on_connected(origin, (int)(srs_update_system_time_ms() - starttime));
+    
+    return pthread->start();
+}
 
+int SrsEdgeForwarder::connect_stream(string ep_server, string ep_port)
+{
+    int ret = ERROR_SUCCESS;
+    
     client->set_recv_timeout(SRS_CONSTS_RTMP_RECV_TIMEOUT_US);
     client->set_send_timeout(SRS_CONSTS_RTMP_SEND_TIMEOUT_US);
 
@@ -477,7 +848,7 @@ int SrsEdgeForwarder::start()
     }
     srs_trace("publish stream %s", stream.c_str());
     
-    return pthread->start();
+    return ret;
 }
 
 void SrsEdgeForwarder::stop()
@@ -488,6 +859,7 @@ void SrsEdgeForwarder::stop()
     
     queue->clear();
     
+    report_origin(true);
     kbps->set_io(NULL, NULL);
     srs_freep(client);
     srs_freep(io);
@@ -544,6 +916,7 @@ int SrsEdgeForwarder::cycle()
                 pprint->age(), count,
                 kbps->get_send_kbps(), kbps->get_send_kbps_30s(), kbps->get_send_kbps_5m(),
                 kbps->get_recv_kbps(), kbps->get_recv_kbps_30s(), kbps->get_recv_kbps_5m());
+            report_origin(false);
         }
         
         // ignore when no messages.
@@ -601,6 +974,25 @@ void SrsEdgeForwarder::close_underlayer_socket()
     srs_close_stfd(stfd);
 }
 
+void SrsEdgeForwarder::report_origin(bool closed)
+{
+    if (origin.empty()) {
+        return;
+    }
+    
+    kbps->resample();
+    int64_t bytes = kbps->get_recv_bytes_delta() + kbps->get_send_bytes_delta();
+    kbps->cleanup();
+    
+    if (!closed) {
+        SrsEdgeOriginPool::instance()->on_bytes(origin, bytes);
+        return;
+    }
+    
+    SrsEdgeOriginPool::instance()->on_close(origin, bytes);
+    origin = "";
+}
+
 int SrsEdgeForwarder::connect_server(string& ep_server, string& ep_port)
 {
     int ret = ERROR_SUCCESS;
@@ -608,12 +1000,20 @@ int SrsEdgeForwarder::connect_server(string& ep_server, string& ep_port)
     // reopen
     close_underlayer_socket();
     
-    SrsConfDirective* conf = _srs_config->get_vhost_edge_origin(_req->vhost);
-    srs_assert(conf);
-    
-    // select the origin.
-    std::string server = conf->args.at(origin_index % conf->args.size());
-    origin_index = (origin_index + 1) % conf->args.size();
+    origin = "";
+    std::string server;
+    if (srs_worker_is_proxy(_req)) {
+        // the worker proxy push to the local port of owner worker.
+        int owner = srs_worker_owner(_req->get_stream_url());
+        server = srs_worker_local_endpoint(owner);
+    } else {
+        SrsConfDirective* conf = _srs_config->get_vhost_edge_origin(_req->vhost);
+        srs_assert(conf);
+        
+        // select the origin.
+        server = SrsEdgeOriginPool::instance()->select(_req->vhost, conf, _req->get_stream_url(), &origin_index);
+        origin = server;
+    }
     
     std::string s_port = SRS_CONSTS_RTMP_DEFAULT_PORT;
     int port = ::atoi(SRS_CONSTS_RTMP_DEFAULT_PORT);
@@ -33,7 +33,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_app_st.hpp>
 #include <srs_app_thread.hpp>
 
+#include <map>
 #include <string>
+#include <sstream>
 
 class SrsStSocket;
 class SrsRtmpServer;
@@ -46,6 +48,7 @@ class SrsCommonMessage;
 class SrsMessageQueue;
 class ISrsProtocolReaderWriter;
 class SrsKbps;
+class SrsConfDirective;
 
 /**
 * the state of edge, auto machine
@@ -72,6 +75,111 @@ enum SrsEdgeUserState
     SrsEdgeUserStateReloading = 100,
 };
 
+/**
+* the health of origin, shared by all edge streams connect to it.
+*/
+class SrsEdgeOrigin
+{
+public:
+    // the origin, <server>[:port] as configed.
+    std::string endpoint;
+    // the smoothed rtt in ms to connect and play/publish, 0 when never connected.
+    int srtt;
+    // the consecutive failures to connect.
+    int nb_streak;
+    int64_t nb_failures;
+    int64_t nb_connects;
+    // the time in ms when the circuit is half-open, that is, the origin is
+    // not selected before it, unless all origins are open.
+    int64_t open_until;
+    // the edge streams on origin.
+    int nb_active;
+    // the bytes received from or sent to origin, sampled to kbps.
+    int64_t nb_bytes;
+    int64_t sample_bytes;
+    int64_t sample_time;
+    int kbps;
+public:
+    SrsEdgeOrigin(std::string ep);
+    virtual ~SrsEdgeOrigin();
+public:
+    /**
+    * whether the circuit is closed or half-open, the origin can be selected.
+    */
+    virtual bool available(int64_t now);
+    /**
+    * whether the circuit is half-open, that is, it's opened by failures
+    * and expired, the origin should be tried to close the circuit.
+    */
+    virtual bool half_open(int64_t now);
+    /**
+    * the cost to select, the less is better.
+    */
+    virtual int64_t cost();
+    virtual void sample(int64_t now);
+    virtual int dumps(std::stringstream& ss, int64_t now);
+};
+
+/**
+* the origins of edge, select the origin for edge stream by the
+* connect rtt and active streams of origin, skip the origin which
+* fails continuously for a while, that is, circuit breaker, then
+* try it once when the circuit is half-open, closed when connected.
+*/
+class SrsEdgeOriginPool
+{
+private:
+    static SrsEdgeOriginPool* _instance;
+private:
+    // key: the origin endpoint.
+    std::map<std::string, SrsEdgeOrigin*> origins;
+private:
+    SrsEdgeOriginPool();
+public:
+    virtual ~SrsEdgeOriginPool();
+public:
+    static SrsEdgeOriginPool* instance();
+public:
+    /**
+    * select the origin from the configed origins of vhost.
+    * @param url the stream url, hashed to stick to a origin.
+    * @param pindex the index for round robin, updated when selected.
+    */
+    virtual std::string select(std::string vhost, SrsConfDirective* conf, std::string url, int* pindex);
+    /**
+    * select the origin at the time.
+    * @param now the time in ms, to check the circuit of origins.
+    */
+    virtual std::string select(std::string vhost, SrsConfDirective* conf, std::string url, int* pindex, int64_t now);
+    /**
+    * when connected to origin, the rtt in ms to connect and play/publish.
+    */
+    virtual void on_connected(std::string ep, int rtt);
+    /**
+    * when failed to connect to origin.
+    */
+    virtual void on_failure(std::string ep);
+    /**
+    * when the stream of origin closed.
+    * @param bytes the bytes not reported by on_bytes.
+    */
+    virtual void on_close(std::string ep, int64_t bytes);
+    /**
+    * when the stream transfered bytes with origin.
+    */
+    virtual void on_bytes(std::string ep, int64_t bytes);
+    /**
+    * dumps the origins to json array.
+    */
+    virtual int dumps(std::stringstream& ss);
+private:
+    virtual SrsEdgeOrigin* fetch(std::string ep);
+    /**
+    * when the origin is selected, start the trial of the half-open circuit.
+    */
+    virtual std::string on_selected(SrsEdgeOrigin* o, int64_t now);
+};
+
 /**
 * edge used to ingest stream from origin.
 */
@@ -89,6 +197,8 @@ private:
     SrsKbps* kbps;
     SrsRtmpClient* client;
     int origin_index;
+    // the connected origin endpoint, empty for the local owner worker.
+    std::string origin;
 public:
     SrsEdgeIngester();
     virtual ~SrsEdgeIngester();
@@ -103,8 +213,14 @@ private:
     virtual int ingest();
     virtual void close_underlayer_socket();
     virtual int connect_server(std::string& ep_server, std::string& ep_port);
+    virtual int connect_stream(std::string ep_server, std::string ep_port);
     virtual int connect_app(std::string ep_server, std::string ep_port);
     virtual int process_publish_message(SrsCommonMessage* msg);
+    /**
+    * report the bytes of origin to pool.
+    * @param closed whether the stream of origin is closed.
+    */
+    virtual void report_origin(bool closed);
 };
 
 /**
@@ -124,6 +240,8 @@ private:
     SrsKbps* kbps;
     SrsRtmpClient* client;
     int origin_index;
+    // the connected origin endpoint, empty for the local owner worker.
+    std::string origin;
     /**
     * we must ensure one thread one fd principle,
     * that is, a fd must be write/read by the one thread.
@@ -152,7 +270,13 @@ public:
 private:
     virtual void close_underlayer_socket();
     virtual int connect_server(std::string& ep_server, std::string& ep_port);
+    virtual int connect_stream(std::string ep_server, std::string ep_port);
     virtual int connect_app(std::string ep_server, std::string ep_port);
+    /**
+    * report the bytes of origin to pool.
+    * @param closed whether the stream of origin is closed.
+    */
+    virtual void report_origin(bool closed);
 };
 
 /**
@@ -50,6 +50,8 @@ using namespace std;
 #include <srs_kernel_ts.hpp>
 #include <srs_app_utility.hpp>
 #include <srs_app_http_hooks.hpp>
+#include <srs_app_async_io.hpp>
+#include <srs_app_hls_store.hpp>
 
 // drop the segment when duration of ts too small.
 #define SRS_AUTO_HLS_SEGMENT_MIN_DURATION_MS 100
@@ -70,19 +72,32 @@ SrsHlsCacheWriter::SrsHlsCacheWriter(bool write_cache, bool write_file)
 {
     should_write_cache = write_cache;
     should_write_file = write_file;
+    data = NULL;
+    
+    if (_srs_config->get_async_io_hls()) {
+        impl = new SrsAsyncFileWriter();
+    } else {
+        impl = new SrsFileWriter();
+    }
 }
 
 SrsHlsCacheWriter::~SrsHlsCacheWriter()
 {
+    srs_freep(impl);
+    srs_freep(data);
 }
 
 int SrsHlsCacheWriter::open(string file)
 {
+    if (should_write_cache) {
+        srs_freep(data);
+    }
+    
     if (!should_write_file) {
         return ERROR_SUCCESS;
     }
 
-    return impl.open(file);
+    return impl->open(file);
 }
 
 void SrsHlsCacheWriter::close()
@@ -91,7 +106,7 @@ void SrsHlsCacheWriter::close()
         return;
     }
 
-    impl.close();
+    impl->close();
 }
 
 bool SrsHlsCacheWriter::is_open()
@@ -100,7 +115,7 @@ bool SrsHlsCacheWriter::is_open()
         return true;
     }
 
-    return impl.is_open();
+    return impl->is_open();
 }
 
 int64_t SrsHlsCacheWriter::tellg()
@@ -109,27 +124,32 @@ int64_t SrsHlsCacheWriter::tellg()
         return 0;
     }
 
-    return impl.tellg();
+    return impl->tellg();
 }
 
 int SrsHlsCacheWriter::write(void* buf, size_t count, ssize_t* pnwrite)
 {
     if (should_write_cache) {
+        if (!data) {
+            data = new SrsHlsRamBuffer();
+        }
         if (count > 0) {
-            data.append((char*)buf, count);
+            data->append((char*)buf, (int)count);
         }
     }
 
     if (should_write_file) {
-        return impl.write(buf, count, pnwrite);
+        return impl->write(buf, count, pnwrite);
     }
 
     return ERROR_SUCCESS;
 }
 
-string SrsHlsCacheWriter::cache()
+SrsHlsRamBuffer* SrsHlsCacheWriter::cache()
 {
-    return data;
+    SrsHlsRamBuffer* buffer = data;
+    data = NULL;
+    return buffer;
 }
 
 SrsHlsSegment::SrsHlsSegment(SrsTsContext* c, bool write_cache, bool write_file, SrsCodecAudio ac, SrsCodecVideo vc)
@@ -321,31 +341,33 @@ SrsHlsMuxer::~SrsHlsMuxer()
 
 void SrsHlsMuxer::dispose()
 {
-    if (should_write_file) {
-        std::vector<SrsHlsSegment*>::iterator it;
-        for (it = segments.begin(); it != segments.end(); ++it) {
-            SrsHlsSegment* segment = *it;
-            if (unlink(segment->full_path.c_str()) < 0) {
-                srs_warn("dispose unlink path failed, file=%s.", segment->full_path.c_str());
-            }
-            srs_freep(segment);
+    std::vector<SrsHlsSegment*>::iterator it;
+    for (it = segments.begin(); it != segments.end(); ++it) {
+        SrsHlsSegment* segment = *it;
+        if (should_write_file && unlink(segment->full_path.c_str()) < 0) {
+            srs_warn("dispose unlink path failed, file=%s.", segment->full_path.c_str());
         }
-        segments.clear();
-        
-        if (current) {
-            std::string path = current->full_path + ".tmp";
-            if (unlink(path.c_str()) < 0) {
-                srs_warn("dispose unlink path failed, file=%s", path.c_str());
-            }
-            srs_freep(current);
+        if (should_write_cache) {
+            SrsHlsRamStore::instance()->remove(req->vhost, ram_url(segment->full_path));
         }
-        
-        if (unlink(m3u8.c_str()) < 0) {
-            srs_warn("dispose unlink path failed. file=%s", m3u8.c_str());
+        srs_freep(segment);
+    }
+    segments.clear();
+    
+    if (current) {
+        std::string path = current->full_path + ".tmp";
+        if (should_write_file && unlink(path.c_str()) < 0) {
+            srs_warn("dispose unlink path failed, file=%s", path.c_str());
         }
+        srs_freep(current);
     }
     
-    // TODO: FIXME: support hls dispose in HTTP cache.
+    if (should_write_file && unlink(m3u8.c_str()) < 0) {
+        srs_warn("dispose unlink path failed. file=%s", m3u8.c_str());
+    }
+    if (should_write_cache) {
+        SrsHlsRamStore::instance()->remove(req->vhost, ram_url(m3u8));
+    }
     
     srs_trace("gracefully dispose hls %s", req? req->get_stream_url().c_str() : "");
 }
@@ -415,9 +437,10 @@ int SrsHlsMuxer::update_config(SrsRequest* r, string entry_prefix,
     // when update config, reset the history target duration.
     max_td = (int)(fragment * _srs_config->get_hls_td_ratio(r->vhost));
     
-    // TODO: FIXME: refine better for SRS2 only support disk.
-    should_write_cache = false;
-    should_write_file = true;
+    // the hls in disk, ram or both.
+    std::string storage = _srs_config->get_hls_storage(r->vhost);
+    should_write_cache = srs_config_hls_is_storage_ram(storage);
+    should_write_file = srs_config_hls_is_storage_disk(storage);
     
     // create m3u8 dir once.
     m3u8_dir = srs_path_dirname(m3u8);
@@ -739,6 +762,14 @@ int SrsHlsMuxer::segment_close(string log_desc)
         // close the muxer of finished segment.
         srs_freep(current->muxer);
         std::string full_path = current->full_path;
+        
+        // the ts in ram is owned by store, served to http players.
+        if (should_write_cache) {
+            SrsHlsRamBuffer* buffer = current->writer->cache();
+            if (buffer) {
+                SrsHlsRamStore::instance()->update(req->vhost, ram_url(full_path), buffer);
+            }
+        }
         current = NULL;
         
         // rename from tmp to real path
@@ -801,6 +832,9 @@ int SrsHlsMuxer::segment_close(string log_desc)
                 srs_warn("cleanup unlink path failed, file=%s.", segment->full_path.c_str());
             }
         }
+        if (hls_cleanup && should_write_cache) {
+            SrsHlsRamStore::instance()->remove(req->vhost, ram_url(segment->full_path));
+        }
         
         srs_freep(segment);
     }
@@ -924,9 +958,32 @@ int SrsHlsMuxer::_refresh_m3u8(string m3u8_file)
     }
     srs_info("write m3u8 %s success.", m3u8_file.c_str());
     
+    // the m3u8 in ram is owned by store, served to http players.
+    if (should_write_cache) {
+        SrsHlsRamBuffer* buffer = writer.cache();
+        if (buffer) {
+            SrsHlsRamStore::instance()->update(req->vhost, ram_url(this->m3u8), buffer);
+        }
+    }
+    
     return ret;
 }
 
+string SrsHlsMuxer::ram_url(string full_path)
+{
+    // the path relative to hls_path, the same url as disk.
+    std::string url = full_path;
+    if (srs_string_starts_with(url, hls_path)) {
+        url = url.substr(hls_path.length());
+    }
+    
+    if (!srs_string_starts_with(url, "/")) {
+        url = "/" + url;
+    }
+    
+    return url;
+}
+
 SrsHlsCache::SrsHlsCache()
 {
     cache = new SrsTsCache();
@@ -1125,6 +1182,7 @@ int SrsHlsCache::reap_segment(string log_desc, SrsHlsMuxer* muxer, int64_t segme
 SrsHls::SrsHls()
 {
     _req = NULL;
+    settings = NULL;
     source = NULL;
     
     hls_enabled = false;
@@ -1163,7 +1221,7 @@ void SrsHls::dispose()
     
     // Ignore when hls_dispose disabled.
     // @see https://github.com/ossrs/srs/issues/865
-    int hls_dispose = _srs_config->get_hls_dispose(_req->vhost);
+    int hls_dispose = settings->hls_dispose;
     if (!hls_dispose) {
         return;
     }
@@ -1185,7 +1243,7 @@ int SrsHls::cycle()
         return ret;
     }
     
-    int hls_dispose = _srs_config->get_hls_dispose(_req->vhost) * 1000;
+    int hls_dispose = settings->hls_dispose * 1000;
     if (hls_dispose <= 0) {
         return ret;
     }
@@ -1211,6 +1269,7 @@ int SrsHls::initialize(SrsSource* s, SrsRequest* r)
 
     srs_assert(!_req);
     _req = r->copy();
+    settings = _srs_config->get_vhost_settings(_req->vhost);
 
     source = s;
 
@@ -1310,8 +1369,19 @@ int SrsHls::on_audio(SrsSharedPtrMessage* shared_audio)
     SrsSharedPtrMessage* audio = shared_audio->copy();
     SrsAutoFree(SrsSharedPtrMessage, audio);
     
+    // use the frame demuxed by source, or demux it when not demuxed.
+    SrsAvcAacCodec* c = codec;
+    SrsCodecFrame* frame = audio->frame();
+    
     sample->clear();
-    if ((ret = codec->audio_aac_demux(audio->payload, audio->size, sample)) != ERROR_SUCCESS) {
+    if (frame) {
+        if ((ret = frame->error) != ERROR_SUCCESS) {
+            srs_error("hls demux audio failed. ret=%d", ret);
+            return ret;
+        }
+        frame->to_sample(sample);
+        c = frame->codec->codec;
+    } else if ((ret = codec->audio_aac_demux(audio->payload, audio->size, sample)) != ERROR_SUCCESS) {
         if (ret != ERROR_HLS_TRY_MP3) {
             srs_error("hls aac demux audio failed. ret=%d", ret);
             return ret;
@@ -1322,8 +1392,8 @@ int SrsHls::on_audio(SrsSharedPtrMessage* shared_audio)
         }
     }
     srs_info("audio decoded, type=%d, codec=%d, cts=%d, size=%d, time=%"PRId64, 
-        sample->frame_type, codec->audio_codec_id, sample->cts, audio->size, audio->timestamp);
-    SrsCodecAudio acodec = (SrsCodecAudio)codec->audio_codec_id;
+        sample->frame_type, c->audio_codec_id, sample->cts, audio->size, audio->timestamp);
+    SrsCodecAudio acodec = (SrsCodecAudio)c->audio_codec_id;
     
     // ts support audio codec: aac/mp3
     if (acodec != SrsCodecAudioAAC && acodec != SrsCodecAudioMP3) {
@@ -1353,7 +1423,7 @@ int SrsHls::on_audio(SrsSharedPtrMessage* shared_audio)
     // for pure audio, we need to update the stream dts also.
     stream_dts = dts;
     
-    if ((ret = hls_cache->write_audio(codec, muxer, dts, sample)) != ERROR_SUCCESS) {
+    if ((ret = hls_cache->write_audio(c, muxer, dts, sample)) != ERROR_SUCCESS) {
         srs_error("hls cache write audio failed. ret=%d", ret);
         return ret;
     }
@@ -1375,19 +1445,30 @@ int SrsHls::on_video(SrsSharedPtrMessage* shared_video, bool is_sps_pps)
     SrsSharedPtrMessage* video = shared_video->copy();
     SrsAutoFree(SrsSharedPtrMessage, video);
     
+    // use the frame demuxed by source, or demux it when not demuxed.
+    SrsAvcAacCodec* c = codec;
+    SrsCodecFrame* frame = video->frame();
+    
     // user can disable the sps parse to workaround when parse sps failed.
     // @see https://github.com/ossrs/srs/issues/474
     if (is_sps_pps) {
-        codec->avc_parse_sps = _srs_config->get_parse_sps(_req->vhost);
+        codec->avc_parse_sps = settings->parse_sps;
     }
     
     sample->clear();
-    if ((ret = codec->video_avc_demux(video->payload, video->size, sample)) != ERROR_SUCCESS) {
+    if (frame) {
+        if ((ret = frame->error) != ERROR_SUCCESS) {
+            srs_error("hls demux video failed. ret=%d", ret);
+            return ret;
+        }
+        frame->to_sample(sample);
+        c = frame->codec->codec;
+    } else if ((ret = codec->video_avc_demux(video->payload, video->size, sample)) != ERROR_SUCCESS) {
         srs_error("hls codec demux video failed. ret=%d", ret);
         return ret;
     }
     srs_info("video decoded, type=%d, codec=%d, avc=%d, cts=%d, size=%d, time=%"PRId64, 
-        sample->frame_type, codec->video_codec_id, sample->avc_packet_type, sample->cts, video->size, video->timestamp);
+        sample->frame_type, c->video_codec_id, sample->avc_packet_type, sample->cts, video->size, video->timestamp);
     
     // ignore info frame,
     // @see https://github.com/ossrs/srs/issues/288#issuecomment-69863909
@@ -1395,7 +1476,7 @@ int SrsHls::on_video(SrsSharedPtrMessage* shared_video, bool is_sps_pps)
         return ret;
     }
     
-    if (codec->video_codec_id != SrsCodecVideoAVC) {
+    if (c->video_codec_id != SrsCodecVideoAVC) {
         return ret;
     }
     
@@ -1413,7 +1494,7 @@ int SrsHls::on_video(SrsSharedPtrMessage* shared_video, bool is_sps_pps)
     
     int64_t dts = video->timestamp * 90;
     stream_dts = dts;
-    if ((ret = hls_cache->write_video(codec, muxer, dts, sample)) != ERROR_SUCCESS) {
+    if ((ret = hls_cache->write_video(c, muxer, dts, sample)) != ERROR_SUCCESS) {
         srs_error("hls cache write video failed. ret=%d", ret);
         return ret;
     }
@@ -52,6 +52,8 @@ class SrsTsCache;
 class SrsHlsSegment;
 class SrsTsCache;
 class SrsTsContext;
+class SrsVhostSettings;
+class SrsHlsRamBuffer;
 
 /**
  * * the HLS section, only available when HLS enabled.
@@ -64,8 +66,8 @@ class SrsTsContext;
 class SrsHlsCacheWriter : public SrsFileWriter
 {
 private:
-    SrsFileWriter impl;
-    std::string data;
+    SrsFileWriter* impl;
+    SrsHlsRamBuffer* data;
     bool should_write_cache;
     bool should_write_file;
 public:
@@ -88,9 +90,10 @@ public:
     virtual int write(void* buf, size_t count, ssize_t* pnwrite);
 public:
     /**
-    * get the string cache.
+    * detach the bytes written in ram.
+    * @return the buffer which user must free, NULL when nothing written.
     */
-    virtual std::string cache();
+    virtual SrsHlsRamBuffer* cache();
 };
 
 /**
@@ -289,6 +292,10 @@ public:
 private:
     virtual int refresh_m3u8();
     virtual int _refresh_m3u8(std::string m3u8_file);
+    /**
+    * the url of file in ram, for example, /live/livestream.m3u8
+    */
+    virtual std::string ram_url(std::string full_path);
 };
 
 /**
@@ -358,6 +365,8 @@ private:
     SrsHlsCache* hls_cache;
 private:
     SrsRequest* _req;
+    // the compiled vhost settings, never free it.
+    SrsVhostSettings* settings;
     bool hls_enabled;
     bool hls_can_dispose;
     int64_t last_update_time;
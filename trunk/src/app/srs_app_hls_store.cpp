@@ -0,0 +1,265 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <srs_app_hls_store.hpp>
+
+#include <string.h>
+using namespace std;
+
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_app_config.hpp>
+#include <srs_core_performance.hpp>
+
+#ifdef SRS_AUTO_HLS
+
+SrsHlsRamBuffer::SrsHlsRamPayload::SrsHlsRamPayload()
+{
+    size = 0;
+    shared_count = 0;
+}
+
+SrsHlsRamBuffer::SrsHlsRamPayload::~SrsHlsRamPayload()
+{
+    std::vector<char*>::iterator it;
+    for (it = chunks.begin(); it != chunks.end(); ++it) {
+        char* chunk = *it;
+        SrsHlsRamStore::instance()->free_chunk(chunk);
+    }
+    chunks.clear();
+}
+
+SrsHlsRamBuffer::SrsHlsRamBuffer()
+{
+    ptr = new SrsHlsRamPayload();
+}
+
+SrsHlsRamBuffer::SrsHlsRamBuffer(SrsHlsRamPayload* p)
+{
+    ptr = p;
+    ptr->shared_count++;
+}
+
+SrsHlsRamBuffer::~SrsHlsRamBuffer()
+{
+    if (ptr->shared_count == 0) {
+        srs_freep(ptr);
+    } else {
+        ptr->shared_count--;
+    }
+}
+
+void SrsHlsRamBuffer::append(const char* bytes, int size)
+{
+    // the shared buffer is immutable, for it maybe in sending.
+    srs_assert(ptr->shared_count == 0);
+    
+    while (size > 0) {
+        // the last chunk is full, alloc a new one.
+        if (ptr->size == capacity()) {
+            ptr->chunks.push_back(SrsHlsRamStore::instance()->alloc_chunk());
+        }
+        
+        int pos = ptr->size % SRS_PERF_HLS_RAM_CHUNK_SIZE;
+    
+        int nb_copy = srs_min(size, SRS_PERF_HLS_RAM_CHUNK_SIZE - pos);
+        memcpy(ptr->chunks.back() + pos, bytes, nb_copy);
+    
+        bytes += nb_copy;
+        size -= nb_copy;
+        ptr->size += nb_copy;
+    }
+}
+
+int SrsHlsRamBuffer::length()
+{
+    return ptr->size;
+}
+
+int SrsHlsRamBuffer::capacity()
+{
+    return (int)ptr->chunks.size() * SRS_PERF_HLS_RAM_CHUNK_SIZE;
+}
+
+int SrsHlsRamBuffer::nb_chunks()
+{
+    return (int)ptr->chunks.size();
+}
+
+int SrsHlsRamBuffer::to_iovs(iovec* iovs)
+{
+    int left = ptr->size;
+    int nb_iovs = (int)ptr->chunks.size();
+    
+    for (int i = 0; i < nb_iovs; i++) {
+        iovs[i].iov_base = ptr->chunks[i];
+        iovs[i].iov_len = srs_min(left, SRS_PERF_HLS_RAM_CHUNK_SIZE);
+        left -= (int)iovs[i].iov_len;
+    }
+    
+    return nb_iovs;
+}
+
+SrsHlsRamBuffer* SrsHlsRamBuffer::copy()
+{
+    return new SrsHlsRamBuffer(ptr);
+}
+
+SrsHlsRamStore::SrsHlsRamEntry::SrsHlsRamEntry()
+{
+    buffer = NULL;
+}
+
+SrsHlsRamStore::SrsHlsRamEntry::~SrsHlsRamEntry()
+{
+    srs_freep(buffer);
+}
+
+SrsHlsRamStore::SrsHlsRamVhost::SrsHlsRamVhost()
+{
+    bytes = 0;
+}
+
+SrsHlsRamStore* SrsHlsRamStore::_instance = new SrsHlsRamStore();
+
+SrsHlsRamStore::SrsHlsRamStore()
+{
+}
+
+SrsHlsRamStore::~SrsHlsRamStore()
+{
+    // the store is never destroyed, for the buffers maybe in sending.
+}
+
+SrsHlsRamStore* SrsHlsRamStore::instance()
+{
+    return _instance;
+}
+
+void SrsHlsRamStore::update(string vhost, string url, SrsHlsRamBuffer* buffer)
+{
+    // remove the previous one, for instance, the m3u8.
+    remove(vhost, url);
+    
+    SrsHlsRamVhost* v = NULL;
+    if (vhosts.find(vhost) == vhosts.end()) {
+        v = vhosts[vhost] = new SrsHlsRamVhost();
+    } else {
+        v = vhosts[vhost];
+    }
+    
+    SrsHlsRamEntry* entry = new SrsHlsRamEntry();
+    entry->vhost = vhost;
+    entry->buffer = buffer;
+    entry->pos = v->urls.insert(v->urls.end(), url);
+    entries[key_of(vhost, url)] = entry;
+    v->bytes += buffer->capacity();
+    
+    // evict the oldest updated entries, but never the updating one.
+    int64_t budget = (int64_t)_srs_config->get_hls_ram_budget(vhost) * 1024 * 1024;
+    while (v->bytes > budget && v->urls.size() > 1) {
+        std::string oldest = v->urls.front();
+        srs_warn("hls: evict %s for vhost %s exceed ram budget, bytes=%"PRId64", budget=%"PRId64,
+            oldest.c_str(), vhost.c_str(), v->bytes, budget);
+        remove(vhost, oldest);
+    }
+    
+    srs_info("hls: update %s in ram, size=%d, vhost=%s, bytes=%"PRId64,
+        url.c_str(), buffer->length(), vhost.c_str(), v->bytes);
+}
+
+void SrsHlsRamStore::remove(string vhost, string url)
+{
+    std::map<std::string, SrsHlsRamEntry*>::iterator it = entries.find(key_of(vhost, url));
+    if (it == entries.end()) {
+        return;
+    }
+    
+    erase(it);
+}
+
+SrsHlsRamBuffer* SrsHlsRamStore::fetch(string vhost, string url)
+{
+    std::map<std::string, SrsHlsRamEntry*>::iterator it = entries.find(key_of(vhost, url));
+    if (it == entries.end()) {
+        return NULL;
+    }
+    
+    SrsHlsRamEntry* entry = it->second;
+    return entry->buffer->copy();
+}
+
+int64_t SrsHlsRamStore::bytes(string vhost)
+{
+    std::map<std::string, SrsHlsRamVhost*>::iterator it = vhosts.find(vhost);
+    if (it == vhosts.end()) {
+        return 0;
+    }
+    
+    SrsHlsRamVhost* v = it->second;
+    return v->bytes;
+}
+
+char* SrsHlsRamStore::alloc_chunk()
+{
+    if (pool.empty()) {
+        return new char[SRS_PERF_HLS_RAM_CHUNK_SIZE];
+    }
+    
+    char* chunk = pool.back();
+    pool.pop_back();
+    
+    return chunk;
+}
+
+void SrsHlsRamStore::free_chunk(char* chunk)
+{
+    if ((int)pool.size() >= SRS_PERF_HLS_RAM_POOL_CHUNKS) {
+        srs_freepa(chunk);
+        return;
+    }
+    
+    pool.push_back(chunk);
+}
+
+string SrsHlsRamStore::key_of(string vhost, string url)
+{
+    // the url always starts with /, which never in vhost.
+    return vhost + url;
+}
+
+void SrsHlsRamStore::erase(std::map<std::string, SrsHlsRamEntry*>::iterator it)
+{
+    SrsHlsRamEntry* entry = it->second;
+    entries.erase(it);
+    
+    SrsHlsRamVhost* v = vhosts[entry->vhost];
+    v->urls.erase(entry->pos);
+    v->bytes -= entry->buffer->capacity();
+    
+    // the buffer is freed when all players sendout it.
+    srs_freep(entry);
+}
+
+#endif
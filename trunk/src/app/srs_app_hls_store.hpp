@@ -0,0 +1,183 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SRS_APP_HLS_STORE_HPP
+#define SRS_APP_HLS_STORE_HPP
+
+/*
+#include <srs_app_hls_store.hpp>
+*/
+#include <srs_core.hpp>
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <srs_kernel_file.hpp>
+
+#ifdef SRS_AUTO_HLS
+
+/**
+ * the buffer of hls segment or m3u8 in ram, a list of fixed size chunks,
+ * shared by the hls muxer and all http players by reference count.
+ *
+ * create first object by constructor and append the bytes,
+ * use copy to share it, which is immutable once copied.
+ */
+class SrsHlsRamBuffer
+{
+private:
+    class SrsHlsRamPayload
+    {
+    public:
+        // the chunks, each is SRS_PERF_HLS_RAM_CHUNK_SIZE bytes.
+        std::vector<char*> chunks;
+        // the bytes in chunks.
+        int size;
+        // the reference count.
+        int shared_count;
+    public:
+        SrsHlsRamPayload();
+        virtual ~SrsHlsRamPayload();
+    };
+    SrsHlsRamPayload* ptr;
+private:
+    SrsHlsRamBuffer(SrsHlsRamPayload* p);
+public:
+    SrsHlsRamBuffer();
+    virtual ~SrsHlsRamBuffer();
+public:
+    /**
+     * append bytes to the last chunk, alloc new chunk when it's full.
+     * @remark assert the buffer is not shared.
+     */
+    virtual void append(const char* bytes, int size);
+    /**
+     * the bytes of buffer.
+     */
+    virtual int length();
+    /**
+     * the memory of chunks, used to account the budget.
+     */
+    virtual int capacity();
+    /**
+     * the number of chunks, that is the iovs to sendout.
+     */
+    virtual int nb_chunks();
+    /**
+     * build the iovs of chunks to sendout.
+     * @param iovs the iovs to fill, which must hold nb_chunks() iovs.
+     * @return the number of iovs filled.
+     */
+    virtual int to_iovs(iovec* iovs);
+    /**
+     * copy the buffer, use ref-count.
+     */
+    virtual SrsHlsRamBuffer* copy();
+};
+
+/**
+ * the hls segments and m3u8 in ram, served by the http server,
+ * where the key is the vhost and url path, for example, /live/livestream-0.ts,
+ * that is the path relative to hls_path, served the same as disk, and
+ * the vhosts which publish the same stream never share the url.
+ * @remark the bytes of each vhost is limited by hls_ram_budget,
+ *       the oldest updated entry of vhost is evicted when exceed it.
+ */
+class SrsHlsRamStore
+{
+private:
+    static SrsHlsRamStore* _instance;
+private:
+    class SrsHlsRamEntry
+    {
+    public:
+        std::string vhost;
+        SrsHlsRamBuffer* buffer;
+        // the position in the updated order of vhost.
+        std::list<std::string>::iterator pos;
+    public:
+        SrsHlsRamEntry();
+        virtual ~SrsHlsRamEntry();
+    };
+    class SrsHlsRamVhost
+    {
+    public:
+        // the capacity of all buffers of vhost.
+        int64_t bytes;
+        // the url of entries, the oldest updated first.
+        std::list<std::string> urls;
+    public:
+        SrsHlsRamVhost();
+    };
+private:
+    // key: the vhost and url path, @see key_of().
+    std::map<std::string, SrsHlsRamEntry*> entries;
+    // key: the vhost.
+    std::map<std::string, SrsHlsRamVhost*> vhosts;
+    // the free chunks to reuse.
+    std::vector<char*> pool;
+private:
+    SrsHlsRamStore();
+public:
+    virtual ~SrsHlsRamStore();
+public:
+    static SrsHlsRamStore* instance();
+public:
+    /**
+     * update the buffer of url, evict the oldest entries of vhost when exceed the budget.
+     * @param vhost the vhost of stream, the arg0 of vhost directive.
+     * @param buffer the buffer to store, which is freed by store.
+     */
+    virtual void update(std::string vhost, std::string url, SrsHlsRamBuffer* buffer);
+    /**
+     * remove the buffer of url in vhost, ignore when not found.
+     */
+    virtual void remove(std::string vhost, std::string url);
+    /**
+     * fetch the buffer of url in vhost.
+     * @return a copy of buffer which user must free, NULL when not found.
+     */
+    virtual SrsHlsRamBuffer* fetch(std::string vhost, std::string url);
+    /**
+     * the bytes of vhost, 0 when not found.
+     */
+    virtual int64_t bytes(std::string vhost);
+public:
+    /**
+     * alloc a chunk from pool, or new one when pool is empty.
+     */
+    virtual char* alloc_chunk();
+    /**
+     * free the chunk to pool, or delete it when pool is full.
+     */
+    virtual void free_chunk(char* chunk);
+private:
+    virtual std::string key_of(std::string vhost, std::string url);
+    virtual void erase(std::map<std::string, SrsHlsRamEntry*>::iterator it);
+};
+
+#endif
+
+#endif
@@ -42,6 +42,8 @@ using namespace std;
 #include <srs_app_config.hpp>
 #include <srs_app_source.hpp>
 #include <srs_app_http_conn.hpp>
+#include <srs_app_edge.hpp>
+#include <srs_app_rtmp_conn.hpp>
 
 int srs_api_response_jsonp(ISrsHttpResponseWriter* w, string callback, string data)
 {
@@ -194,7 +196,7 @@ int SrsGoApiV1::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
         << SRS_JFIELD_ORG("server", stat->server_id()) << SRS_JFIELD_CONT
         << SRS_JFIELD_ORG("urls", SRS_JOBJECT_START)
             << SRS_JFIELD_STR("versions", "the version of SRS") << SRS_JFIELD_CONT
-            << SRS_JFIELD_STR("summaries", "the summary(pid, argv, pwd, cpu, mem) of SRS") << SRS_JFIELD_CONT
+            << SRS_JFIELD_STR("summaries", "the summary(pid, argv, pwd, cpu, mem, pool) of SRS") << SRS_JFIELD_CONT
             << SRS_JFIELD_STR("rusages", "the rusage of SRS") << SRS_JFIELD_CONT
             << SRS_JFIELD_STR("self_proc_stats", "the self process stats") << SRS_JFIELD_CONT
             << SRS_JFIELD_STR("system_proc_stats", "the system process stats") << SRS_JFIELD_CONT
@@ -202,6 +204,8 @@ int SrsGoApiV1::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
             << SRS_JFIELD_STR("authors", "the license, copyright, authors and contributors") << SRS_JFIELD_CONT
             << SRS_JFIELD_STR("features", "the supported features of SRS") << SRS_JFIELD_CONT
             << SRS_JFIELD_STR("requests", "the request itself, for http debug") << SRS_JFIELD_CONT
+            << SRS_JFIELD_STR("origins", "the health of origins for edge") << SRS_JFIELD_CONT
+            << SRS_JFIELD_STR("handshakes", "the rate and latency of rtmp handshakes") << SRS_JFIELD_CONT
             << SRS_JFIELD_STR("vhosts", "manage all vhosts or specified vhost") << SRS_JFIELD_CONT
             << SRS_JFIELD_STR("streams", "manage all streams or specified stream") << SRS_JFIELD_CONT
             << SRS_JFIELD_STR("clients", "manage all clients or specified client, default query top 10 clients") << SRS_JFIELD_CONT
@@ -670,6 +674,60 @@ int SrsGoApiRequests::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
     return srs_api_response(w, r, ss.str());
 }
 
+SrsGoApiOrigins::SrsGoApiOrigins()
+{
+}
+
+SrsGoApiOrigins::~SrsGoApiOrigins()
+{
+}
+
+int SrsGoApiOrigins::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+{
+    int ret = ERROR_SUCCESS;
+    
+    SrsStatistic* stat = SrsStatistic::instance();
+    std::stringstream ss;
+    
+    std::stringstream data;
+    ret = SrsEdgeOriginPool::instance()->dumps(data);
+    
+    ss << SRS_JOBJECT_START
+            << SRS_JFIELD_ERROR(ret) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("server", stat->server_id()) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("origins", data.str())
+        << SRS_JOBJECT_END;
+    
+    return srs_api_response(w, r, ss.str());
+}
+
+SrsGoApiHandshakes::SrsGoApiHandshakes()
+{
+}
+
+SrsGoApiHandshakes::~SrsGoApiHandshakes()
+{
+}
+
+int SrsGoApiHandshakes::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+{
+    int ret = ERROR_SUCCESS;
+    
+    SrsStatistic* stat = SrsStatistic::instance();
+    std::stringstream ss;
+    
+    std::stringstream data;
+    ret = SrsRtmpHandshakes::instance()->dumps(data);
+    
+    ss << SRS_JOBJECT_START
+            << SRS_JFIELD_ERROR(ret) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("server", stat->server_id()) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("handshakes", data.str())
+        << SRS_JOBJECT_END;
+    
+    return srs_api_response(w, r, ss.str());
+}
+
 SrsGoApiVhosts::SrsGoApiVhosts()
 {
 }
@@ -150,6 +150,24 @@ public:
     virtual int serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
 };
 
+class SrsGoApiOrigins : public ISrsHttpHandler
+{
+public:
+    SrsGoApiOrigins();
+    virtual ~SrsGoApiOrigins();
+public:
+    virtual int serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
+};
+
+class SrsGoApiHandshakes : public ISrsHttpHandler
+{
+public:
+    SrsGoApiHandshakes();
+    virtual ~SrsGoApiHandshakes();
+public:
+    virtual int serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
+};
+
 class SrsGoApiVhosts : public ISrsHttpHandler
 {
 public:
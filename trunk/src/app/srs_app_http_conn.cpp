@@ -162,21 +162,14 @@ int SrsHttpResponseWriter::writev(iovec* iov, int iovcnt, ssize_t* pnwrite)
 {
     int ret = ERROR_SUCCESS;
     
-    // when header not ready, or not chunked, send one by one.
-    if (!header_wrote || content_length != -1) {
-        ssize_t nwrite = 0;
-        for (int i = 0; i < iovcnt; i++) {
-            iovec* piovc = iov + i;
-            nwrite += piovc->iov_len;
-            if ((ret = write((char*)piovc->iov_base, (int)piovc->iov_len)) != ERROR_SUCCESS) {
-                return ret;
-            }
-        }
-        
-        if (pnwrite) {
-            *pnwrite = nwrite;
-        }
-        
+    // write the header data in memory.
+    if (!header_wrote) {
+        write_header(SRS_CONSTS_HTTP_OK);
+    }
+    
+    // whatever header is wrote, we should try to send header.
+    if ((ret = send_header(iovcnt > 0? (char*)iov[0].iov_base : NULL, iovcnt > 0? (int)iov[0].iov_len : 0)) != ERROR_SUCCESS) {
+        srs_error("http: send header failed. ret=%d", ret);
         return ret;
     }
     
@@ -185,6 +178,23 @@ int SrsHttpResponseWriter::writev(iovec* iov, int iovcnt, ssize_t* pnwrite)
         return ret;
     }
     
+    // directly send with content length, in a writev.
+    if (content_length != -1) {
+        int size = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            size += (int)iov[i].iov_len;
+        }
+        
+        written += size;
+        if (written > content_length) {
+            ret = ERROR_HTTP_CONTENT_LENGTH;
+            srs_error("http: exceed content length. ret=%d", ret);
+            return ret;
+        }
+        
+        return srs_write_large_iovs(skt, iov, iovcnt, pnwrite);
+    }
+    
     // send in chunked encoding.
     int nb_iovss = 3 + iovcnt;
     iovec* iovss = iovss_cache;
@@ -242,6 +252,47 @@ int SrsHttpResponseWriter::writev(iovec* iov, int iovcnt, ssize_t* pnwrite)
     return ret;
 }
 
+int SrsHttpResponseWriter::sendfile(int fd, int64_t offset, int size)
+{
+    int ret = ERROR_SUCCESS;
+    
+    // write the header data in memory.
+    if (!header_wrote) {
+        write_header(SRS_CONSTS_HTTP_OK);
+    }
+    
+    // whatever header is wrote, we should try to send header.
+    if ((ret = send_header(NULL, 0)) != ERROR_SUCCESS) {
+        srs_error("http: send header failed. ret=%d", ret);
+        return ret;
+    }
+    
+    // check the bytes send and content length.
+    written += size;
+    if (content_length != -1 && written > content_length) {
+        ret = ERROR_HTTP_CONTENT_LENGTH;
+        srs_error("http: exceed content length. ret=%d", ret);
+        return ret;
+    }
+    
+    // directly send with content length
+    if (content_length != -1) {
+        return skt->sendfile(fd, offset, size, NULL);
+    }
+    
+    // send in chunked encoding, the file is the chunk body.
+    int nb_size = snprintf(header_cache, SRS_HTTP_HEADER_CACHE_SIZE, "%x" SRS_HTTP_CRLF, size);
+    if ((ret = skt->write(header_cache, nb_size, NULL)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    if ((ret = skt->sendfile(fd, offset, size, NULL)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    return skt->write((void*)SRS_HTTP_CRLF, 2, NULL);
+}
+
 void SrsHttpResponseWriter::write_header(int code)
 {
     if (header_wrote) {
@@ -902,6 +953,7 @@ int SrsHttpParser::initialize(enum http_parser_type type)
     settings.on_body = on_body;
     settings.on_message_complete = on_message_complete;
     
+    this->type = type;
     http_parser_init(&parser, type);
     // callback object ptr.
     parser.data = (void*)this;
@@ -915,6 +967,12 @@ int SrsHttpParser::parse_message(SrsStSocket* skt, SrsConnection* conn, ISrsHttp
     
     int ret = ERROR_SUCCESS;
     
+    // reset the parser for each message of keep-alive connection,
+    // for the body is read by body reader, the parser maybe wait for the body
+    // of last message, for example, the response of http hooks.
+    http_parser_init(&parser, type);
+    parser.data = (void*)this;
+    
     // reset request data.
     field_name = "";
     field_value = "";
@@ -110,6 +110,7 @@ public:
     virtual SrsHttpHeader* header();
     virtual int write(char* data, int size);
     virtual int writev(iovec* iov, int iovcnt, ssize_t* pnwrite);
+    virtual int sendfile(int fd, int64_t offset, int size);
     virtual void write_header(int code);
     virtual int send_header(char* data, int size);
 };
@@ -310,6 +311,8 @@ class SrsHttpParser
 private:
     http_parser_settings settings;
     http_parser parser;
+    // the type of parser, to reset the parser for each message.
+    enum http_parser_type type;
     // the global parse buffer.
     SrsFastBuffer* buffer;
 private:
@@ -49,6 +49,232 @@ using namespace std;
 // the timeout for hls notify, in us.
 #define SRS_HLS_NOTIFY_TIMEOUT_US (int64_t)(10*1000*1000LL)
 
+// the interval to remove the expired answers of on_play, in ms.
+#define SRS_HTTP_HOOKS_SWEEP_INTERVAL_MS 10000
+
+SrsHttpHooksPool::SrsHttpHooksPool(string h, int p, int max)
+{
+    host = h;
+    port = p;
+    max_connections = max;
+    nb_busy = 0;
+    cond = st_cond_new();
+}
+
+SrsHttpHooksPool::~SrsHttpHooksPool()
+{
+    std::vector<SrsHttpClient*>::iterator it;
+    for (it = idles.begin(); it != idles.end(); ++it) {
+        SrsHttpClient* client = *it;
+        srs_freep(client);
+    }
+    idles.clear();
+    
+    st_cond_destroy(cond);
+}
+
+int SrsHttpHooksPool::acquire(SrsHttpClient** pclient, bool* preused)
+{
+    int ret = ERROR_SUCCESS;
+    
+    // wait for the busy connections to release.
+    while (idles.empty() && max_connections > 0 && nb_busy >= max_connections) {
+        if (st_cond_timedwait(cond, SRS_HTTP_CLIENT_TIMEOUT_US) != 0) {
+            ret = ERROR_HTTP_HOOKS_BUSY;
+            srs_error("http: hooks server %s:%d busy, connections=%d, ret=%d", host.c_str(), port, nb_busy, ret);
+            return ret;
+        }
+    }
+    
+    // reuse the last released one, which is most possible alive.
+    if (!idles.empty()) {
+        *pclient = idles.back();
+        *preused = true;
+        idles.pop_back();
+        nb_busy++;
+        return ret;
+    }
+    
+    SrsHttpClient* client = new SrsHttpClient();
+    if ((ret = client->initialize(host, port)) != ERROR_SUCCESS) {
+        srs_freep(client);
+        return ret;
+    }
+    
+    *pclient = client;
+    *preused = false;
+    nb_busy++;
+    
+    return ret;
+}
+
+void SrsHttpHooksPool::release(SrsHttpClient* client, bool keep_alive)
+{
+    nb_busy--;
+    
+    if (keep_alive) {
+        idles.push_back(client);
+    } else {
+        srs_freep(client);
+    }
+    
+    st_cond_signal(cond);
+}
+
+SrsHttpHooksNotifyTask::SrsHttpHooksNotifyTask(string a, int c, string u, string d)
+{
+    action = a;
+    client_id = c;
+    url = u;
+    data = d;
+}
+
+SrsHttpHooksNotifyTask::~SrsHttpHooksNotifyTask()
+{
+}
+
+int SrsHttpHooksNotifyTask::call()
+{
+    int ret = ERROR_SUCCESS;
+    
+    std::string res;
+    int status_code = 0;
+    if ((ret = SrsHttpHooks::do_post(url, data, status_code, res)) != ERROR_SUCCESS) {
+        srs_warn("http post %s uri failed, ignored. "
+            "client_id=%d, url=%s, request=%s, response=%s, code=%d, ret=%d",
+            action.c_str(), client_id, url.c_str(), data.c_str(), res.c_str(), status_code, ret);
+        return ret;
+    }
+    
+    srs_trace("http hook %s success. "
+        "client_id=%d, url=%s, request=%s, response=%s, ret=%d",
+        action.c_str(), client_id, url.c_str(), data.c_str(), res.c_str(), ret);
+    
+    return ret;
+}
+
+string SrsHttpHooksNotifyTask::to_string()
+{
+    std::stringstream ss;
+    ss << "action=" << action << ", client_id=" << client_id << ", url=" << url;
+    return ss.str();
+}
+
+SrsHttpHooksDispatcher* SrsHttpHooksDispatcher::_instance = new SrsHttpHooksDispatcher();
+
+SrsHttpHooksDispatcher::SrsHttpHooksDispatcher()
+{
+    max_connections = 0;
+    worker = NULL;
+    last_sweep_ms = 0;
+}
+
+SrsHttpHooksDispatcher::~SrsHttpHooksDispatcher()
+{
+    if (worker) {
+        worker->stop();
+    }
+    srs_freep(worker);
+    
+    std::map<std::string, SrsHttpHooksPool*>::iterator it;
+    for (it = pools.begin(); it != pools.end(); ++it) {
+        SrsHttpHooksPool* pool = it->second;
+        srs_freep(pool);
+    }
+    pools.clear();
+}
+
+SrsHttpHooksDispatcher* SrsHttpHooksDispatcher::instance()
+{
+    return _instance;
+}
+
+int SrsHttpHooksDispatcher::initialize(int max, bool async_notify)
+{
+    int ret = ERROR_SUCCESS;
+    
+    max_connections = max;
+    
+    if (async_notify && !worker) {
+        worker = new SrsAsyncCallWorker();
+        if ((ret = worker->start()) != ERROR_SUCCESS) {
+            srs_error("http: start hooks notify worker failed. ret=%d", ret);
+            return ret;
+        }
+    }
+    
+    srs_trace("http: hooks pool max_connections=%d, async_notify=%d", max_connections, async_notify);
+    
+    return ret;
+}
+
+SrsHttpHooksPool* SrsHttpHooksDispatcher::fetch_pool(string host, int port)
+{
+    std::stringstream ss;
+    ss << host << ":" << port;
+    std::string key = ss.str();
+    
+    std::map<std::string, SrsHttpHooksPool*>::iterator it = pools.find(key);
+    if (it != pools.end()) {
+        return it->second;
+    }
+    
+    SrsHttpHooksPool* pool = new SrsHttpHooksPool(host, port, max_connections);
+    pools[key] = pool;
+    
+    return pool;
+}
+
+void SrsHttpHooksDispatcher::notify(SrsHttpHooksNotifyTask* task)
+{
+    if (worker) {
+        worker->execute(task);
+        return;
+    }
+    
+    SrsAutoFree(SrsHttpHooksNotifyTask, task);
+    task->call();
+}
+
+bool SrsHttpHooksDispatcher::fetch_answer(string key, int* pret)
+{
+    std::map<std::string, SrsHttpHooksAnswer>::iterator it = answers.find(key);
+    if (it == answers.end()) {
+        return false;
+    }
+    
+    SrsHttpHooksAnswer& answer = it->second;
+    if (answer.expired_ms < srs_get_system_time_ms()) {
+        answers.erase(it);
+        return false;
+    }
+    
+    *pret = answer.ret;
+    return true;
+}
+
+void SrsHttpHooksDispatcher::cache_answer(string key, int ret, int ttl_ms)
+{
+    int64_t now = srs_get_system_time_ms();
+    
+    // remove the expired answers, which never fetch again.
+    if (now - last_sweep_ms > SRS_HTTP_HOOKS_SWEEP_INTERVAL_MS) {
+        std::map<std::string, SrsHttpHooksAnswer>::iterator it;
+        for (it = answers.begin(); it != answers.end();) {
+            if (it->second.expired_ms < now) {
+                answers.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+        last_sweep_ms = now;
+    }
+    
+    SrsHttpHooksAnswer& answer = answers[key];
+    answer.ret = ret;
+    answer.expired_ms = now + ttl_ms;
+}
+
 SrsHttpHooks::SrsHttpHooks()
 {
 }
@@ -93,8 +319,6 @@ int SrsHttpHooks::on_connect(string url, SrsRequest* req)
 
 void SrsHttpHooks::on_close(string url, SrsRequest* req, int64_t send_bytes, int64_t recv_bytes)
 {
-    int ret = ERROR_SUCCESS;
-    
     int client_id = _srs_context->get_id();
     
     std::stringstream ss;
@@ -109,20 +333,7 @@ void SrsHttpHooks::on_close(string url, SrsRequest* req, int64_t send_bytes, int
         << SRS_JOBJECT_END;
         
     std::string data = ss.str();
-    std::string res;
-    int status_code;
-    if ((ret = do_post(url, data, status_code, res)) != ERROR_SUCCESS) {
-        srs_warn("http post on_close uri failed, ignored. "
-            "client_id=%d, url=%s, request=%s, response=%s, code=%d, ret=%d",
-            client_id, url.c_str(), data.c_str(), res.c_str(), status_code, ret);
-        return;
-    }
-    
-    srs_trace("http hook on_close success. "
-        "client_id=%d, url=%s, request=%s, response=%s, ret=%d",
-        client_id, url.c_str(), data.c_str(), res.c_str(), ret);
-    
-    return;
+    SrsHttpHooksDispatcher::instance()->notify(new SrsHttpHooksNotifyTask("on_close", client_id, url, data));
 }
 
 int SrsHttpHooks::on_publish(string url, SrsRequest* req)
@@ -162,8 +373,6 @@ int SrsHttpHooks::on_publish(string url, SrsRequest* req)
 
 void SrsHttpHooks::on_unpublish(string url, SrsRequest* req)
 {
-    int ret = ERROR_SUCCESS;
-    
     int client_id = _srs_context->get_id();
     
     std::stringstream ss;
@@ -178,20 +387,7 @@ void SrsHttpHooks::on_unpublish(string url, SrsRequest* req)
         << SRS_JOBJECT_END;
         
     std::string data = ss.str();
-    std::string res;
-    int status_code;
-    if ((ret = do_post(url, data, status_code, res)) != ERROR_SUCCESS) {
-        srs_warn("http post on_unpublish uri failed, ignored. "
-            "client_id=%d, url=%s, request=%s, response=%s, code=%d, ret=%d",
-            client_id, url.c_str(), data.c_str(), res.c_str(), status_code, ret);
-        return;
-    }
-    
-    srs_trace("http hook on_unpublish success. "
-        "client_id=%d, url=%s, request=%s, response=%s, ret=%d",
-        client_id, url.c_str(), data.c_str(), res.c_str(), ret);
-    
-    return;
+    SrsHttpHooksDispatcher::instance()->notify(new SrsHttpHooksNotifyTask("on_unpublish", client_id, url, data));
 }
 
 int SrsHttpHooks::on_play(string url, SrsRequest* req)
@@ -211,11 +407,27 @@ int SrsHttpHooks::on_play(string url, SrsRequest* req)
         << SRS_JFIELD_STR("param", req->param) << SRS_JFIELD_CONT
         << SRS_JFIELD_STR("pageUrl", req->pageUrl)
         << SRS_JOBJECT_END;
+    
+    // the answer is same for the client with same ip, page and stream.
+    int ttl = _srs_config->get_vhost_on_play_cache_ttl(req->vhost);
+    std::string key = url + " " + req->ip + " " + req->pageUrl + " " + req->get_stream_url() + req->param;
+    if (ttl > 0 && SrsHttpHooksDispatcher::instance()->fetch_answer(key, &ret)) {
+        srs_trace("http hook on_play cached. client_id=%d, url=%s, ret=%d", client_id, url.c_str(), ret);
+        return ret;
+    }
         
     std::string data = ss.str();
     std::string res;
-    int status_code;
-    if ((ret = do_post(url, data, status_code, res)) != ERROR_SUCCESS) {
+    int status_code = 0;
+    ret = do_post(url, data, status_code, res);
+    
+    // cache the answer of server, but never cache the transport or server error,
+    // for example, the server is restarting.
+    if (ttl > 0 && (ret == ERROR_SUCCESS || ret == ERROR_RESPONSE_CODE || ret == ERROR_HTTP_DATA_INVALID)) {
+        SrsHttpHooksDispatcher::instance()->cache_answer(key, ret, ttl * 1000);
+    }
+    
+    if (ret != ERROR_SUCCESS) {
         srs_error("http post on_play uri failed. "
             "client_id=%d, url=%s, request=%s, response=%s, code=%d, ret=%d",
             client_id, url.c_str(), data.c_str(), res.c_str(), status_code, ret);
@@ -231,8 +443,6 @@ int SrsHttpHooks::on_play(string url, SrsRequest* req)
 
 void SrsHttpHooks::on_stop(string url, SrsRequest* req)
 {
-    int ret = ERROR_SUCCESS;
-    
     int client_id = _srs_context->get_id();
     
     std::stringstream ss;
@@ -247,20 +457,7 @@ void SrsHttpHooks::on_stop(string url, SrsRequest* req)
         << SRS_JOBJECT_END;
         
     std::string data = ss.str();
-    std::string res;
-    int status_code;
-    if ((ret = do_post(url, data, status_code, res)) != ERROR_SUCCESS) {
-        srs_warn("http post on_stop uri failed, ignored. "
-            "client_id=%d, url=%s, request=%s, response=%s, code=%d, ret=%d",
-            client_id, url.c_str(), data.c_str(), res.c_str(), status_code, ret);
-        return;
-    }
-    
-    srs_trace("http hook on_stop success. "
-        "client_id=%d, url=%s, request=%s, response=%s, ret=%d",
-        client_id, url.c_str(), data.c_str(), res.c_str(), ret);
-    
-    return;
+    SrsHttpHooksDispatcher::instance()->notify(new SrsHttpHooksNotifyTask("on_stop", client_id, url, data));
 }
 
 int SrsHttpHooks::on_dvr(int cid, string url, SrsRequest* req, string file)
@@ -427,21 +624,35 @@ int SrsHttpHooks::do_post(std::string url, std::string req, int& code, string& r
         return ret;
     }
     
-    SrsHttpClient http;
-    if ((ret = http.initialize(uri.get_host(), uri.get_port())) != ERROR_SUCCESS) {
-        return ret;
-    }
+    SrsHttpHooksPool* pool = SrsHttpHooksDispatcher::instance()->fetch_pool(uri.get_host(), uri.get_port());
     
+    SrsHttpClient* http = NULL;
     ISrsHttpMessage* msg = NULL;
-    if ((ret = http.post(uri.get_path(), req, &msg)) != ERROR_SUCCESS) {
-        return ret;
+    for (int i = 0;; i++) {
+        bool reused = false;
+        if ((ret = pool->acquire(&http, &reused)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        
+        if ((ret = http->post(uri.get_path(), req, &msg)) == ERROR_SUCCESS) {
+            break;
+        }
+        pool->release(http, false);
+        
+        // retry once when the reused connection is closed by server.
+        if (!reused || i > 0) {
+            return ret;
+        }
+        srs_info("http: retry for the keep-alive connection closed. url=%s, ret=%d", url.c_str(), ret);
     }
     SrsAutoFree(ISrsHttpMessage, msg);
     
     code = msg->status_code();
     if ((ret = msg->body_read_all(res)) != ERROR_SUCCESS) {
+        pool->release(http, false);
         return ret;
     }
+    pool->release(http, msg->is_keep_alive());
     
     // ensure the http status is ok.
     // https://github.com/ossrs/srs/issues/158
@@ -30,16 +30,132 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_core.hpp>
 
 #include <string>
+#include <map>
+#include <vector>
 
 #ifdef SRS_AUTO_HTTP_CALLBACK
 
 #include <http_parser.h>
 
+#include <srs_app_st.hpp>
+#include <srs_app_async_call.hpp>
+
 class SrsHttpUri;
 class SrsStSocket;
 class SrsRequest;
 class SrsHttpParser;
 class SrsFlvSegment;
+class SrsHttpClient;
+
+/**
+ * the keep-alive connections to a callback server, for example, 127.0.0.1:8085,
+ * the hook acquire a connection to post, and release it when got the response,
+ * the hook waits when all connections are busy.
+ */
+class SrsHttpHooksPool
+{
+private:
+    std::string host;
+    int port;
+    // the max connections, 0 to no limit.
+    int max_connections;
+    // the connections not in use, the last released first.
+    std::vector<SrsHttpClient*> idles;
+    // the number of connections in use.
+    int nb_busy;
+    // signal when a connection is released.
+    st_cond_t cond;
+public:
+    SrsHttpHooksPool(std::string h, int p, int max);
+    virtual ~SrsHttpHooksPool();
+public:
+    /**
+     * acquire a connection, wait when all connections are busy.
+     * @param preused output whether the connection is reused,
+     *       which maybe already closed by server for keep-alive timeout.
+     */
+    virtual int acquire(SrsHttpClient** pclient, bool* preused);
+    /**
+     * release the connection, which is freed when not keep-alive.
+     */
+    virtual void release(SrsHttpClient* client, bool keep_alive);
+};
+
+/**
+ * the notify only hook, for example, on_close, the server never deny it,
+ * so the client never need to wait for it.
+ */
+class SrsHttpHooksNotifyTask : public ISrsAsyncCallTask
+{
+private:
+    std::string action;
+    int client_id;
+    std::string url;
+    std::string data;
+public:
+    SrsHttpHooksNotifyTask(std::string a, int c, std::string u, std::string d);
+    virtual ~SrsHttpHooksNotifyTask();
+public:
+    virtual int call();
+    virtual std::string to_string();
+};
+
+/**
+ * the dispatcher of http hooks, which reuse the connections to each callback server,
+ * send the notify only hooks in background in batch, and cache the answer of on_play.
+ */
+class SrsHttpHooksDispatcher
+{
+private:
+    static SrsHttpHooksDispatcher* _instance;
+private:
+    class SrsHttpHooksAnswer
+    {
+    public:
+        int ret;
+        int64_t expired_ms;
+    };
+private:
+    int max_connections;
+    // key: the host:port of callback server.
+    std::map<std::string, SrsHttpHooksPool*> pools;
+    // the worker to send the notify only hooks,
+    // NULL to send in the client thread.
+    SrsAsyncCallWorker* worker;
+    // key: the callback url and client.
+    std::map<std::string, SrsHttpHooksAnswer> answers;
+    int64_t last_sweep_ms;
+private:
+    SrsHttpHooksDispatcher();
+public:
+    virtual ~SrsHttpHooksDispatcher();
+public:
+    static SrsHttpHooksDispatcher* instance();
+public:
+    /**
+     * initialize the dispatcher, start the notify worker when async_notify.
+     * @param max the max connections to each callback server.
+     */
+    virtual int initialize(int max, bool async_notify);
+    /**
+     * fetch the connection pool of callback server, create when not exists.
+     */
+    virtual SrsHttpHooksPool* fetch_pool(std::string host, int port);
+    /**
+     * send the notify only hook in background, or send it directly
+     * when async notify disabled.
+     */
+    virtual void notify(SrsHttpHooksNotifyTask* task);
+    /**
+     * fetch the cached answer, which is removed when expired.
+     * @return true when got the answer in pret.
+     */
+    virtual bool fetch_answer(std::string key, int* pret);
+    /**
+     * cache the answer of callback server in ttl_ms.
+     */
+    virtual void cache_answer(std::string key, int ret, int ttl_ms);
+};
 
 /**
 * the http hooks, http callback api,
@@ -48,6 +164,7 @@ class SrsFlvSegment;
 */
 class SrsHttpHooks
 {
+    friend class SrsHttpHooksNotifyTask;
 private:
     SrsHttpHooks();
 public:
@@ -63,6 +180,7 @@ public:
     * on_close hook, when client disconnect to srs, where client is valid by on_connect.
     * @param url the api server url, to process the event. 
     *         ignore if empty.
+    * @remark send in background, @see SrsHttpHooksDispatcher.notify
     */
     static void on_close(std::string url, SrsRequest* req, int64_t send_bytes, int64_t recv_bytes);
     /**
@@ -75,18 +193,21 @@ public:
     * on_unpublish hook, when client(encoder) stop publish stream.
     * @param url the api server url, to process the event. 
     *         ignore if empty.
+    * @remark send in background, @see SrsHttpHooksDispatcher.notify
     */
     static void on_unpublish(std::string url, SrsRequest* req);
     /**
     * on_play hook, when client start to play stream.
     * @param url the api server url, to valid the client. 
     *         ignore if empty.
+    * @remark use the cached answer when on_play_cache_ttl is configed.
     */
     static int on_play(std::string url, SrsRequest* req);
     /**
     * on_stop hook, when client stop to play the stream.
     * @param url the api server url, to process the event. 
     *         ignore if empty.
+    * @remark send in background, @see SrsHttpHooksDispatcher.notify
     */
     static void on_stop(std::string url, SrsRequest* req);
     /**
@@ -120,6 +241,9 @@ public:
      */
     static int on_hls_notify(int cid, std::string url, SrsRequest* req, std::string ts_url, int nb_notify);
 private:
+    /**
+     * post the req to url, over the keep-alive connection of pool.
+     */
     static int do_post(std::string url, std::string req, int& code, std::string& res);
 };
 
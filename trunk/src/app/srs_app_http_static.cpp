@@ -52,6 +52,8 @@ using namespace std;
 #include <srs_app_pithy_print.hpp>
 #include <srs_app_source.hpp>
 #include <srs_app_server.hpp>
+#include <srs_app_async_io.hpp>
+#include <srs_core_performance.hpp>
 
 #endif
 
@@ -164,12 +166,13 @@ int SrsVodStream::serve_mp4_stream(ISrsHttpResponseWriter* w, ISrsHttpMessage* r
         return ret;
     }
 
-    // parse -1 to whole file.
-    if (end == -1) {
-        end = (int)fs.filesize();
+    // parse -1 to whole file, the end is the last byte of range,
+    // which is clamped to the last byte of file, @see RFC 7233.
+    if (end == -1 || end >= fs.filesize()) {
+        end = (int)fs.filesize() - 1;
     }
     
-    if (end > fs.filesize() || start > end) {
+    if (start > end) {
         ret = ERROR_HTTP_REMUX_OFFSET_OVERFLOW;
         srs_warn("http mp4 streaming %s overflow. size=%"PRId64", offset=%d, ret=%d", 
             fullpath.c_str(), fs.filesize(), start, ret);
@@ -203,6 +206,54 @@ int SrsVodStream::serve_mp4_stream(ISrsHttpResponseWriter* w, ISrsHttpMessage* r
     return ret;
 }
 
+#ifdef SRS_PERF_HTTP_SENDFILE
+int SrsVodStream::copy(ISrsHttpResponseWriter* w, SrsFileReader* fs, ISrsHttpMessage* r, int size)
+{
+    int ret = ERROR_SUCCESS;
+    
+    int fd = fs->get_fd();
+    int64_t offset = fs->tellg();
+    
+    // readahead in the native threads, so the sendfile never read disk in st.
+    SrsAsyncIoFile* afile = NULL;
+    if (_srs_config->get_async_io_vod() && SrsAsyncIo::instance()->enabled()) {
+        int afd = ::dup(fd);
+        if (afd >= 0) {
+            afile = SrsAsyncIo::instance()->open(afd);
+            SrsAsyncIo::instance()->readahead(afile, offset, srs_min(size, SRS_PERF_HTTP_SENDFILE_CHUNK));
+        }
+    }
+    
+    int left = size;
+    while (left > 0) {
+        int nb_chunk = srs_min(left, SRS_PERF_HTTP_SENDFILE_CHUNK);
+        int nb_next = srs_min(left - nb_chunk, SRS_PERF_HTTP_SENDFILE_CHUNK);
+        
+        // readahead the next chunk, and wait for current chunk in cache.
+        if (afile) {
+            if (nb_next > 0) {
+                SrsAsyncIo::instance()->readahead(afile, offset + nb_chunk, nb_next);
+            }
+            SrsAsyncIo::instance()->wait(afile, nb_next > 0? 1 : 0);
+        }
+        
+        if ((ret = w->sendfile(fd, offset, nb_chunk)) != ERROR_SUCCESS) {
+            break;
+        }
+        
+        offset += nb_chunk;
+        left -= nb_chunk;
+    }
+    
+    // the dup fd is closed by async io, never wait for it.
+    if (afile) {
+        SrsAsyncIo::instance()->close(afile, false);
+    }
+    
+    return ret;
+}
+#endif
+
 SrsHttpStaticServer::SrsHttpStaticServer(SrsServer* svr)
 {
     server = svr;
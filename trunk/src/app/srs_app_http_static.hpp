@@ -48,6 +48,14 @@ public:
 protected:
     virtual int serve_flv_stream(ISrsHttpResponseWriter* w, ISrsHttpMessage* r, std::string fullpath, int offset);
     virtual int serve_mp4_stream(ISrsHttpResponseWriter* w, ISrsHttpMessage* r, std::string fullpath, int start, int end);
+#ifdef SRS_PERF_HTTP_SENDFILE
+protected:
+    /**
+     * sendfile the fs from current position in size bytes,
+     * readahead the file in async io when enabled.
+     */
+    virtual int copy(ISrsHttpResponseWriter* w, SrsFileReader* fs, ISrsHttpMessage* r, int size);
+#endif
 };
 
 /**
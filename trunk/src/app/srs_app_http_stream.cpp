@@ -36,6 +36,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 using namespace std;
 
 #include <srs_protocol_buffer.hpp>
+#include <srs_kernel_buffer.hpp>
 #include <srs_rtmp_utility.hpp>
 #include <srs_kernel_log.hpp>
 #include <srs_kernel_error.hpp>
@@ -51,11 +52,13 @@ using namespace std;
 #include <srs_kernel_aac.hpp>
 #include <srs_kernel_mp3.hpp>
 #include <srs_kernel_ts.hpp>
+#include <srs_kernel_codec.hpp>
 #include <srs_app_pithy_print.hpp>
 #include <srs_app_source.hpp>
 #include <srs_app_server.hpp>
 #include <srs_app_recv_thread.hpp>
 #include <srs_app_http_hooks.hpp>
+#include <srs_app_hls_store.hpp>
 
 #endif
 
@@ -63,10 +66,11 @@ using namespace std;
 
 #ifdef SRS_AUTO_HTTP_SERVER
 
-SrsStreamCache::SrsStreamCache(SrsSource* s, SrsRequest* r)
+SrsStreamCache::SrsStreamCache(SrsSource* s, SrsRequest* r, ISrsSourceHandler* h)
 {
     req = r->copy()->as_http();
     source = s;
+    handler = h;
     queue = new SrsMessageQueue(true);
     pthread = new SrsEndlessThread("http-stream", this);
     
@@ -128,10 +132,35 @@ int SrsStreamCache::cycle()
         return ret;
     }
     
+    SrsSource* s = source;
+#ifdef __INGEST_DYNAMIC__
+    // hold the source when consume it, like the player, for the publisher
+    // releases the source when unpublish, then the source of mount is freed.
+    // @remark the cache holds the source util the mount is freed, so the
+    //      players of mount always fetch the source which cache consumes.
+    if ((ret = SrsSource::fetch_or_create(req, handler, &s)) != ERROR_SUCCESS) {
+        srs_error("http: hold source for cache failed. ret=%d", ret);
+        return ret;
+    }
+#endif
+    
+    ret = do_cycle(s);
+    
+#ifdef __INGEST_DYNAMIC__
+    SrsSource::unfetch_or_remove(s);
+#endif
+    
+    return ret;
+}
+
+int SrsStreamCache::do_cycle(SrsSource* s)
+{
+    int ret = ERROR_SUCCESS;
+    
     // the stream cache will create consumer to cache stream,
     // which will trigger to fetch stream from origin for edge.
     SrsConsumer* consumer = NULL;
-    if ((ret = source->create_consumer(NULL, consumer, false, false, true)) != ERROR_SUCCESS) {
+    if ((ret = s->create_consumer(NULL, consumer, false, false, true)) != ERROR_SUCCESS) {
         srs_error("http: create consumer failed. ret=%d", ret);
         return ret;
     }
@@ -189,6 +218,29 @@ ISrsStreamEncoder::~ISrsStreamEncoder()
 {
 }
 
+int ISrsStreamEncoder::write_tags(SrsSharedPtrMessage** msgs, int count)
+{
+    int ret = ERROR_SUCCESS;
+    
+    for (int i = 0; i < count; i++) {
+        SrsSharedPtrMessage* msg = msgs[i];
+        
+        if (msg->is_audio()) {
+            ret = write_audio(msg->timestamp, msg->payload, msg->size);
+        } else if (msg->is_video()) {
+            ret = write_video(msg->timestamp, msg->payload, msg->size);
+        } else {
+            ret = write_metadata(msg->timestamp, msg->payload, msg->size);
+        }
+        
+        if (ret != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    
+    return ret;
+}
+
 SrsTsStreamEncoder::SrsTsStreamEncoder()
 {
     enc = new SrsTsEncoder();
@@ -225,6 +277,36 @@ int SrsTsStreamEncoder::write_metadata(int64_t /*timestamp*/, char* /*data*/, in
     return ERROR_SUCCESS;
 }
 
+int SrsTsStreamEncoder::write_tags(SrsSharedPtrMessage** msgs, int count)
+{
+    int ret = ERROR_SUCCESS;
+    
+    for (int i = 0; i < count; i++) {
+        SrsSharedPtrMessage* msg = msgs[i];
+        SrsCodecFrame* frame = msg->frame();
+        
+        if (msg->is_audio()) {
+            if (frame) {
+                ret = enc->write_audio_frame(msg->timestamp, frame);
+            } else {
+                ret = enc->write_audio(msg->timestamp, msg->payload, msg->size);
+            }
+        } else if (msg->is_video()) {
+            if (frame) {
+                ret = enc->write_video_frame(msg->timestamp, frame);
+            } else {
+                ret = enc->write_video(msg->timestamp, msg->payload, msg->size);
+            }
+        }
+        
+        if (ret != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    
+    return ret;
+}
+
 bool SrsTsStreamEncoder::has_cache()
 {
     // for ts stream, use gop cache of SrsSource is ok.
@@ -416,10 +498,15 @@ int SrsMp3StreamEncoder::dump_cache(SrsConsumer* consumer, SrsRtmpJitterAlgorith
 SrsStreamWriter::SrsStreamWriter(ISrsHttpResponseWriter* w)
 {
     writer = w;
+    batch = new SrsSimpleBuffer();
+    nb_iovss_cache = 0;
+    iovss_cache = NULL;
 }
 
 SrsStreamWriter::~SrsStreamWriter()
 {
+    srs_freep(batch);
+    srs_freepa(iovss_cache);
 }
 
 int SrsStreamWriter::open(std::string /*file*/)
@@ -446,18 +533,68 @@ int SrsStreamWriter::write(void* buf, size_t count, ssize_t* pnwrite)
     if (pnwrite) {
         *pnwrite = count;
     }
-    return writer->write((char*)buf, (int)count);
+    
+    // batch it, sendout when flush.
+    if (count > 0) {
+        batch->append((const char*)buf, (int)count);
+    }
+    
+    return ERROR_SUCCESS;
 }
 
 int SrsStreamWriter::writev(iovec* iov, int iovcnt, ssize_t* pnwrite)
 {
-    return writer->writev(iov, iovcnt, pnwrite);
+    int ret = ERROR_SUCCESS;
+    
+    if (batch->length() <= 0) {
+        return writer->writev(iov, iovcnt, pnwrite);
+    }
+    
+    // sendout the batched bytes with the iovs in a chunk.
+    int nb_iovss = 1 + iovcnt;
+    iovec* iovss = iovss_cache;
+    if (nb_iovss_cache < nb_iovss) {
+        srs_freepa(iovss_cache);
+        
+        nb_iovss_cache = nb_iovss;
+        iovss = iovss_cache = new iovec[nb_iovss];
+    }
+    
+    iovss[0].iov_base = batch->bytes();
+    iovss[0].iov_len = batch->length();
+    for (int i = 0; i < iovcnt; i++) {
+        iovss[i + 1] = iov[i];
+    }
+    
+    if ((ret = writer->writev(iovss, nb_iovss, pnwrite)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    batch->erase(batch->length());
+    
+    return ret;
+}
+
+int SrsStreamWriter::flush()
+{
+    int ret = ERROR_SUCCESS;
+    
+    if (batch->length() <= 0) {
+        return ret;
+    }
+    
+    if ((ret = writer->write(batch->bytes(), batch->length())) != ERROR_SUCCESS) {
+        return ret;
+    }
+    batch->erase(batch->length());
+    
+    return ret;
 }
 
-SrsLiveStream::SrsLiveStream(SrsSource* s, SrsRequest* r, SrsStreamCache* c)
+SrsLiveStream::SrsLiveStream(SrsSource* s, SrsRequest* r, SrsStreamCache* c, ISrsSourceHandler* h)
 {
     source = s;
     cache = c;
+    handler = h;
     req = r->copy()->as_http();
 }
 
@@ -481,19 +618,34 @@ int SrsLiveStream::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
 {
     int ret = ERROR_SUCCESS;
     
-    if ((ret = http_hooks_on_play(r)) != ERROR_SUCCESS) {
-        srs_error("http hook on_play failed. ret=%d", ret);
+    SrsSource* s = source;
+#ifdef __INGEST_DYNAMIC__
+    // hold the source like the rtmp player, for the publisher releases the
+    // source when unpublish, but the consumer of http player still use it.
+    // create the source when not exists, the player waits for the publisher.
+    // @remark the source of mount is shared by all players, which maybe freed,
+    //      so the player always use its own source.
+    if ((ret = SrsSource::fetch_or_create(req, handler, &s)) != ERROR_SUCCESS) {
+        srs_error("http: hold source failed. ret=%d", ret);
         return ret;
     }
+#endif
     
-    ret = do_serve_http(w, r);
+    if ((ret = http_hooks_on_play(r)) == ERROR_SUCCESS) {
+        ret = do_serve_http(s, w, r);
+        http_hooks_on_stop(r);
+    } else {
+        srs_error("http hook on_play failed. ret=%d", ret);
+    }
     
-    http_hooks_on_stop(r);
+#ifdef __INGEST_DYNAMIC__
+    SrsSource::unfetch_or_remove(s);
+#endif
     
     return ret;
 }
 
-int SrsLiveStream::do_serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+int SrsLiveStream::do_serve_http(SrsSource* s, ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
 {
     int ret = ERROR_SUCCESS;
     
@@ -530,7 +682,7 @@ int SrsLiveStream::do_serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
     
     // create consumer of souce, ignore gop cache, use the audio gop cache.
     SrsConsumer* consumer = NULL;
-    if ((ret = source->create_consumer(NULL, consumer, true, true, !enc->has_cache())) != ERROR_SUCCESS) {
+    if ((ret = s->create_consumer(NULL, consumer, true, true, !enc->has_cache())) != ERROR_SUCCESS) {
         srs_error("http: create consumer failed. ret=%d", ret);
         return ret;
     }
@@ -551,15 +703,19 @@ int SrsLiveStream::do_serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
     
     // if gop cache enabled for encoder, dump to consumer.
     if (enc->has_cache()) {
-        if ((ret = enc->dump_cache(consumer, source->jitter())) != ERROR_SUCCESS) {
+        if ((ret = enc->dump_cache(consumer, s->jitter())) != ERROR_SUCCESS) {
             srs_error("http: dump cache to consumer failed. ret=%d", ret);
             return ret;
         }
     }
     
-#ifdef SRS_PERF_FAST_FLV_ENCODER
-    SrsFastFlvStreamEncoder* ffe = dynamic_cast<SrsFastFlvStreamEncoder*>(enc);
-#endif
+    // sendout the header of stream, for instance, the flv header.
+    if ((ret = writer.flush()) != ERROR_SUCCESS) {
+        if (!srs_is_client_gracefully_close(ret)) {
+            srs_error("http: send stream header failed. ret=%d", ret);
+        }
+        return ret;
+    }
     
     // Use receive thread to accept the close event to avoid FD leak.
     // @see https://github.com/ossrs/srs/issues/636#issuecomment-298208427
@@ -607,16 +763,10 @@ int SrsLiveStream::do_serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
                 count, pprint->age(), SRS_PERF_MW_MIN_MSGS, mw_sleep);
         }
         
-        // sendout all messages.
-#ifdef SRS_PERF_FAST_FLV_ENCODER
-        if (ffe) {
-            ret = ffe->write_tags(msgs.msgs, count);
-        } else {
-            ret = streaming_send_messages(enc, msgs.msgs, count);
+        // sendout all messages, in a chunk for the batched encoders.
+        if ((ret = enc->write_tags(msgs.msgs, count)) == ERROR_SUCCESS) {
+            ret = writer.flush();
         }
-#else
-        ret = streaming_send_messages(enc, msgs.msgs, count);
-#endif
     
         // free the messages.
         for (int i = 0; i < count; i++) {
@@ -715,29 +865,6 @@ void SrsLiveStream::http_hooks_on_stop(ISrsHttpMessage* r)
     return;
 }
 
-int SrsLiveStream::streaming_send_messages(ISrsStreamEncoder* enc, SrsSharedPtrMessage** msgs, int nb_msgs)
-{
-    int ret = ERROR_SUCCESS;
-    
-    for (int i = 0; i < nb_msgs; i++) {
-        SrsSharedPtrMessage* msg = msgs[i];
-        
-        if (msg->is_audio()) {
-            ret = enc->write_audio(msg->timestamp, msg->payload, msg->size);
-        } else if (msg->is_video()) {
-            ret = enc->write_video(msg->timestamp, msg->payload, msg->size);
-        } else {
-            ret = enc->write_metadata(msg->timestamp, msg->payload, msg->size);
-        }
-        
-        if (ret != ERROR_SUCCESS) {
-            return ret;
-        }
-    }
-    
-    return ret;
-}
-
 SrsLiveEntry::SrsLiveEntry(std::string m, bool h)
 {
     mount = m;
@@ -785,78 +912,80 @@ bool SrsLiveEntry::is_mp3()
     return _is_mp3;
 }
 
-SrsHlsM3u8Stream::SrsHlsM3u8Stream()
+#ifdef SRS_AUTO_HLS
+SrsHlsRamStream::SrsHlsRamStream()
 {
 }
 
-SrsHlsM3u8Stream::~SrsHlsM3u8Stream()
+SrsHlsRamStream::~SrsHlsRamStream()
 {
 }
 
-void SrsHlsM3u8Stream::set_m3u8(std::string v)
+bool SrsHlsRamStream::can_serve(ISrsHttpMessage* r)
 {
-    m3u8 = v;
+    std::string ext = r->ext();
+    if (ext != ".m3u8" && ext != ".ts") {
+        return false;
+    }
+    
+    SrsHlsRamBuffer* buffer = fetch(r);
+    SrsAutoFree(SrsHlsRamBuffer, buffer);
+    
+    return buffer != NULL;
 }
 
-int SrsHlsM3u8Stream::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
+int SrsHlsRamStream::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
 {
     int ret = ERROR_SUCCESS;
     
-    std::string data = m3u8;
+    // the buffer is immutable and never freed util sendout,
+    // even the store evict or update it when writev blocked.
+    SrsHlsRamBuffer* buffer = fetch(r);
+    if (!buffer) {
+        return srs_go_http_error(w, SRS_CONSTS_HTTP_NotFound);
+    }
+    SrsAutoFree(SrsHlsRamBuffer, buffer);
     
-    w->header()->set_content_length((int)data.length());
-    w->header()->set_content_type("application/x-mpegURL;charset=utf-8");
-
-    if ((ret = w->write((char*)data.data(), (int)data.length())) != ERROR_SUCCESS) {
-        if (!srs_is_client_gracefully_close(ret)) {
-            srs_error("send m3u8 failed. ret=%d", ret);
-        }
-        return ret;
+    if (r->ext() == ".m3u8") {
+        w->header()->set_content_type("application/x-mpegURL;charset=utf-8");
+    } else {
+        w->header()->set_content_type("video/MP2T");
     }
-
-    return ret;
-}
-
-SrsHlsTsStream::SrsHlsTsStream()
-{
-}
-
-SrsHlsTsStream::~SrsHlsTsStream()
-{
-}
-
-void SrsHlsTsStream::set_ts(std::string v)
-{
-    ts = v;
-}
-
-int SrsHlsTsStream::serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r)
-{
-    int ret = ERROR_SUCCESS;
+    w->header()->set_content_length(buffer->length());
     
-    std::string data = ts;
+    int nb_iovs = buffer->nb_chunks();
+    iovec* iovs = new iovec[nb_iovs];
+    SrsAutoFreeA(iovec, iovs);
+    buffer->to_iovs(iovs);
     
-    w->header()->set_content_length((int)data.length());
-    w->header()->set_content_type("video/MP2T");
-
-    if ((ret = w->write((char*)data.data(), (int)data.length())) != ERROR_SUCCESS) {
+    if ((ret = w->writev(iovs, nb_iovs, NULL)) != ERROR_SUCCESS) {
         if (!srs_is_client_gracefully_close(ret)) {
-            srs_error("send ts failed. ret=%d", ret);
+            srs_error("send hls %s failed. ret=%d", r->path().c_str(), ret);
         }
         return ret;
     }
-
+    
     return ret;
 }
 
-SrsHlsEntry::SrsHlsEntry()
+SrsHlsRamBuffer* SrsHlsRamStream::fetch(ISrsHttpMessage* r)
 {
-    tmpl = NULL;
+    // find the actually request vhost, the same as hls muxer.
+    SrsConfDirective* vhost = _srs_config->get_vhost(r->host());
+    if (!vhost || !_srs_config->get_vhost_enabled(vhost)) {
+        return NULL;
+    }
+    
+    return SrsHlsRamStore::instance()->fetch(vhost->arg0(), r->path());
 }
+#endif
 
 SrsHttpStreamServer::SrsHttpStreamServer(SrsServer* svr)
 {
     server = svr;
+#ifdef SRS_AUTO_HLS
+    hls = new SrsHlsRamStream();
+#endif
     
     mux.hijack(this);
     _srs_config->subscribe(this);
@@ -884,6 +1013,10 @@ SrsHttpStreamServer::~SrsHttpStreamServer()
         }
         sflvs.clear();
     }
+    
+#ifdef SRS_AUTO_HLS
+    srs_freep(hls);
+#endif
 }
 
 int SrsHttpStreamServer::initialize()
@@ -928,8 +1061,8 @@ int SrsHttpStreamServer::http_mount(SrsSource* s, SrsRequest* r)
         
         entry = new SrsLiveEntry(mount, tmpl->hstrs);
     
-        entry->cache = new SrsStreamCache(s, r);
-        entry->stream = new SrsLiveStream(s, r, entry->cache);
+        entry->cache = new SrsStreamCache(s, r, server);
+        entry->stream = new SrsLiveStream(s, r, entry->cache, server);
 
         // TODO: FIXME: maybe refine the logic of http remux service.
         // if user push streams followed:
@@ -1070,6 +1203,14 @@ int SrsHttpStreamServer::hijack(ISrsHttpMessage* request, ISrsHttpHandler** ph)
         return ret;
     }
     
+#ifdef SRS_AUTO_HLS
+    // serve the hls m3u8 and ts in ram.
+    if (hls->can_serve(request)) {
+        *ph = hls;
+        return ret;
+    }
+#endif
+    
     // only hijack for http streaming, http-flv/ts/mp3/aac.
     std::string ext = request->ext();
     if (ext.empty()) {
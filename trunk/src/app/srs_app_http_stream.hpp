@@ -34,6 +34,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #ifdef SRS_AUTO_HTTP_SERVER
 
+class SrsSimpleBuffer;
+class ISrsSourceHandler;
+class SrsHlsRamBuffer;
+
 /**
 * for the srs http stream cache, 
 * for example, the audio stream cache to make android(weixin) happy.
@@ -47,9 +51,10 @@ private:
     SrsMessageQueue* queue;
     SrsSource* source;
     SrsRequest* req;
+    ISrsSourceHandler* handler;
     SrsEndlessThread* pthread;
 public:
-    SrsStreamCache(SrsSource* s, SrsRequest* r);
+    SrsStreamCache(SrsSource* s, SrsRequest* r, ISrsSourceHandler* h);
     virtual ~SrsStreamCache();
     virtual int update(SrsSource* s, SrsRequest* r);
 public:
@@ -58,6 +63,8 @@ public:
 // interface ISrsEndlessThreadHandler.
 public:
     virtual int cycle();
+private:
+    virtual int do_cycle(SrsSource* s);
 };
 
 /**
@@ -81,6 +88,12 @@ public:
     virtual int write_audio(int64_t timestamp, char* data, int size) = 0;
     virtual int write_video(int64_t timestamp, char* data, int size) = 0;
     virtual int write_metadata(int64_t timestamp, char* data, int size) = 0;
+    /**
+    * write the messages got in a consumer wakeup,
+    * default to write each message by write_audio/video/metadata.
+    * @remark the writer should flush the batch after write the tags.
+    */
+    virtual int write_tags(SrsSharedPtrMessage** msgs, int count);
 public:
     /**
     * for some stream, for example, mp3 and aac, the audio stream,
@@ -147,6 +160,10 @@ public:
     virtual int write_audio(int64_t timestamp, char* data, int size);
     virtual int write_video(int64_t timestamp, char* data, int size);
     virtual int write_metadata(int64_t timestamp, char* data, int size);
+    /**
+    * write the frames demuxed by source, demux the message without frame.
+    */
+    virtual int write_tags(SrsSharedPtrMessage** msgs, int count);
 public:
     virtual bool has_cache();
     virtual int dump_cache(SrsConsumer* consumer, SrsRtmpJitterAlgorithm jitter);
@@ -196,11 +213,19 @@ public:
 
 /**
 * write stream to http response direclty.
+* the small writes of encoder, for instance, the ts packets of a frame,
+* are batched in memory and sendout in a chunk when flush, while the
+* writev of flv tags is sendout directly with the batched bytes.
 */
 class SrsStreamWriter : public SrsFileWriter
 {
 private:
     ISrsHttpResponseWriter* writer;
+    // the batched bytes to send, reused for each flush.
+    SrsSimpleBuffer* batch;
+    // the cached iovs to send the batch with the writev.
+    int nb_iovss_cache;
+    iovec* iovss_cache;
 public:
     SrsStreamWriter(ISrsHttpResponseWriter* w);
     virtual ~SrsStreamWriter();
@@ -213,6 +238,11 @@ public:
 public:
     virtual int write(void* buf, size_t count, ssize_t* pnwrite);
     virtual int writev(iovec* iov, int iovcnt, ssize_t* pnwrite);
+public:
+    /**
+    * sendout the batched bytes in a chunk, ignore when empty.
+    */
+    virtual int flush();
 };
 
 /**
@@ -225,17 +255,17 @@ private:
     SrsRequest* req;
     SrsSource* source;
     SrsStreamCache* cache;
+    ISrsSourceHandler* handler;
 public:
-    SrsLiveStream(SrsSource* s, SrsRequest* r, SrsStreamCache* c);
+    SrsLiveStream(SrsSource* s, SrsRequest* r, SrsStreamCache* c, ISrsSourceHandler* h);
     virtual ~SrsLiveStream();
     virtual int update(SrsSource* s, SrsRequest* r);
 public:
     virtual int serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
 private:
-    virtual int do_serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
+    virtual int do_serve_http(SrsSource* s, ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
     virtual int http_hooks_on_play(ISrsHttpMessage* r);
     virtual void http_hooks_on_stop(ISrsHttpMessage* r);
-    virtual int streaming_send_messages(ISrsStreamEncoder* enc, SrsSharedPtrMessage** msgs, int nb_msgs);
 };
 
 /**
@@ -270,57 +300,32 @@ public:
     bool is_aac();
 };
 
+#ifdef SRS_AUTO_HLS
 /**
-* the m3u8 stream handler.
+* the hls m3u8 and ts handler, serve the hls in ram,
+* sendout the chunks of buffer in a writev without copy.
+* @see SrsHlsRamStore
 */
-class SrsHlsM3u8Stream : public ISrsHttpHandler
+class SrsHlsRamStream : public ISrsHttpHandler
 {
-private:
-    std::string m3u8;
 public:
-    SrsHlsM3u8Stream();
-    virtual ~SrsHlsM3u8Stream();
+    SrsHlsRamStream();
+    virtual ~SrsHlsRamStream();
 public:
-    virtual void set_m3u8(std::string v);
+    /**
+    * whether the request is the hls in ram.
+    */
+    virtual bool can_serve(ISrsHttpMessage* r);
 public:
     virtual int serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
-};
-
-/**
-* the ts stream handler.
-*/
-class SrsHlsTsStream : public ISrsHttpHandler
-{
 private:
-    std::string ts;
-public:
-    SrsHlsTsStream();
-    virtual ~SrsHlsTsStream();
-public:
-    virtual void set_ts(std::string v);
-public:
-    virtual int serve_http(ISrsHttpResponseWriter* w, ISrsHttpMessage* r);
-};
-
-/**
-* the srs hls entry.
-*/
-// TODO: FIXME: use hte hls template and entry.
-struct SrsHlsEntry
-{
-    // for template, the mount contains variables.
-    // for concrete stream, the mount is url to access.
-    std::string mount;
-    
-    // the template to create the entry
-    SrsHlsEntry* tmpl;
-
-    // key: the m3u8/ts file path.
-    // value: the http handler.
-    std::map<std::string, ISrsHttpHandler*> streams;
-    
-    SrsHlsEntry();
+    /**
+    * fetch the hls of request in the vhost of its host.
+    * @return NULL when not found.
+    */
+    virtual SrsHlsRamBuffer* fetch(ISrsHttpMessage* r);
 };
+#endif
 
 /**
 * the http stream server instance,
@@ -337,6 +342,10 @@ public:
     std::map<std::string, SrsLiveEntry*> tflvs;
     // the http live streaming streams, crote by template.
     std::map<std::string, SrsLiveEntry*> sflvs;
+#ifdef SRS_AUTO_HLS
+    // the hls in ram, hijack the request when found.
+    SrsHlsRamStream* hls;
+#endif
 public:
     SrsHttpStreamServer(SrsServer* svr);
     virtual ~SrsHttpStreamServer();
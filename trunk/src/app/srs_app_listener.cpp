@@ -26,6 +26,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
 #include <signal.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -34,8 +36,11 @@ using namespace std;
 
 #include <srs_kernel_log.hpp>
 #include <srs_kernel_error.hpp>
+#include <srs_kernel_utility.hpp>
 #include <srs_app_server.hpp>
 #include <srs_app_utility.hpp>
+#include <srs_app_worker.hpp>
+#include <srs_app_pithy_print.hpp>
 
 // set the max packet size.
 #define SRS_UDP_MAX_PACKET_SIZE 65535
@@ -59,6 +64,20 @@ int ISrsUdpHandler::on_stfd_change(st_netfd_t /*fd*/)
     return ERROR_SUCCESS;
 }
 
+int ISrsUdpHandler::on_udp_packets(SrsUdpPacket* packets, int nb_packets)
+{
+    int ret = ERROR_SUCCESS;
+    
+    for (int i = 0; i < nb_packets; i++) {
+        SrsUdpPacket* packet = &packets[i];
+        if ((ret = on_udp_packet(&packet->from, packet->bytes, packet->size)) != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    
+    return ret;
+}
+
 ISrsTcpHandler::ISrsTcpHandler()
 {
 }
@@ -76,25 +95,54 @@ SrsUdpListener::SrsUdpListener(ISrsUdpHandler* h, string i, int p)
     _fd = -1;
     _stfd = NULL;
 
+#ifdef SRS_PERF_UDP_RECV_BATCH
+    // the slots of buffer for each packet in batch.
+    nb_buf = SRS_PERF_UDP_RECV_BATCH * SRS_PERF_UDP_RECV_PACKET_SIZE;
+    buf = new char[nb_buf];
+    
+    mmsgs = new mmsghdr[SRS_PERF_UDP_RECV_BATCH];
+    iovs = new iovec[SRS_PERF_UDP_RECV_BATCH];
+    nb_control = CMSG_SPACE(sizeof(u_int32_t));
+    controls = new char[SRS_PERF_UDP_RECV_BATCH * nb_control];
+    packets = new SrsUdpPacket[SRS_PERF_UDP_RECV_BATCH];
+#else
     nb_buf = SRS_UDP_MAX_PACKET_SIZE;
     buf = new char[nb_buf];
+    packets = new SrsUdpPacket[1];
+#endif
+    
+    nb_batches = 0;
+    nb_packets = 0;
+    max_batch = 0;
+    nb_drops = 0;
+    nb_truncated = 0;
+    nb_truncated_shown = 0;
+    pprint = SrsPithyPrint::create_udp_listener();
 
     pthread = new SrsReusableThread("udp", this);
 }
 
 SrsUdpListener::~SrsUdpListener()
 {
-    // close the stfd to trigger thread to interrupted.
-    srs_close_stfd(_stfd);
-
+    // interrupt the thread which waits on stfd, then close it,
+    // for st never close the fd which is waiting.
     pthread->stop();
     srs_freep(pthread);
     
+    srs_close_stfd(_stfd);
+    
     // st does not close it sometimes, 
     // close it manually.
     close(_fd);
 
     srs_freepa(buf);
+#ifdef SRS_PERF_UDP_RECV_BATCH
+    srs_freepa(mmsgs);
+    srs_freepa(iovs);
+    srs_freepa(controls);
+#endif
+    srs_freepa(packets);
+    srs_freep(pprint);
 }
 
 int SrsUdpListener::fd()
@@ -137,6 +185,14 @@ int SrsUdpListener::listen()
     }
     srs_verbose("bind socket success. ep=%s:%d, fd=%d", ip.c_str(), port, _fd);
     
+#if defined(SRS_PERF_UDP_RECV_BATCH) && defined(SO_RXQ_OVFL)
+    // get the packets dropped by kernel in the control message.
+    int rxq_ovfl = 1;
+    if (setsockopt(_fd, SOL_SOCKET, SO_RXQ_OVFL, &rxq_ovfl, sizeof(int)) == -1) {
+        srs_warn("ignore setsockopt rxq-ovfl failed. ep=%s:%d", ip.c_str(), port);
+    }
+#endif
+    
     if ((_stfd = st_netfd_open_socket(_fd)) == NULL){
         ret = ERROR_ST_OPEN_SOCKET;
         srs_error("st_netfd_open_socket open socket failed. ep=%s:%d, ret=%d", ip.c_str(), port, ret);
@@ -153,21 +209,52 @@ int SrsUdpListener::listen()
     return ret;
 }
 
-int SrsUdpListener::cycle()
+int64_t SrsUdpListener::get_batches()
 {
-    int ret = ERROR_SUCCESS;
+    return nb_batches;
+}
 
-    // TODO: FIXME: support ipv6, @see man 7 ipv6
-    sockaddr_in from;
-    int nb_from = sizeof(sockaddr_in);
-    int nread = 0;
+int64_t SrsUdpListener::get_packets()
+{
+    return nb_packets;
+}
 
-    if ((nread = st_recvfrom(_stfd, buf, nb_buf, (sockaddr*)&from, &nb_from, ST_UTIME_NO_TIMEOUT)) <= 0) {
-        srs_warn("ignore recv udp packet failed, nread=%d", nread);
+int SrsUdpListener::get_max_batch()
+{
+    return max_batch;
+}
+
+int64_t SrsUdpListener::get_drops()
+{
+    return nb_drops;
+}
+
+int64_t SrsUdpListener::get_truncated()
+{
+    return nb_truncated;
+}
+
+int SrsUdpListener::cycle()
+{
+    int ret = ERROR_SUCCESS;
+    
+    SrsUdpPacket* pkts = NULL;
+    int nb_pkts = 0;
+    if ((ret = recv_packets(&pkts, &nb_pkts)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    pprint->elapse();
+    if (pprint->can_print()) {
+        show_stat();
+    }
+    
+    // ignore when all packets dropped.
+    if (nb_pkts <= 0) {
         return ret;
     }
     
-    if ((ret = handler->on_udp_packet(&from, buf, nread)) != ERROR_SUCCESS) {
+    if ((ret = handler->on_udp_packets(pkts, nb_pkts)) != ERROR_SUCCESS) {
         srs_warn("handle udp packet failed. ret=%d", ret);
         return ret;
     }
@@ -179,6 +266,120 @@ int SrsUdpListener::cycle()
     return ret;
 }
 
+#ifdef SRS_PERF_UDP_RECV_BATCH
+int SrsUdpListener::recv_packets(SrsUdpPacket** ppackets, int* pnb_packets)
+{
+    int ret = ERROR_SUCCESS;
+    
+    *ppackets = packets;
+    *pnb_packets = 0;
+    
+    // wait for the socket readable, then read all packets in a batch.
+    if (st_netfd_poll(_stfd, POLLIN, ST_UTIME_NO_TIMEOUT) != 0) {
+        srs_warn("ignore poll udp packet failed.");
+        return ret;
+    }
+    
+    for (int i = 0; i < SRS_PERF_UDP_RECV_BATCH; i++) {
+        iovec* iov = &iovs[i];
+        iov->iov_base = buf + i * SRS_PERF_UDP_RECV_PACKET_SIZE;
+        iov->iov_len = SRS_PERF_UDP_RECV_PACKET_SIZE;
+        
+        msghdr* mh = &mmsgs[i].msg_hdr;
+        mh->msg_name = &packets[i].from;
+        mh->msg_namelen = sizeof(sockaddr_in);
+        mh->msg_iov = iov;
+        mh->msg_iovlen = 1;
+        mh->msg_control = controls + i * nb_control;
+        mh->msg_controllen = nb_control;
+        mh->msg_flags = 0;
+        mmsgs[i].msg_len = 0;
+    }
+    
+    int nb_msgs = recvmmsg(_fd, mmsgs, SRS_PERF_UDP_RECV_BATCH, MSG_DONTWAIT, NULL);
+    if (nb_msgs <= 0) {
+        if (errno != EAGAIN && errno != EINTR) {
+            srs_warn("ignore recv udp packets failed, nb_msgs=%d", nb_msgs);
+        }
+        return ret;
+    }
+    
+    nb_batches++;
+    nb_packets += nb_msgs;
+    max_batch = srs_max(max_batch, nb_msgs);
+    
+    // compact the packets, drop the truncated.
+    int nb_pkts = 0;
+    for (int i = 0; i < nb_msgs; i++) {
+        msghdr* mh = &mmsgs[i].msg_hdr;
+        
+#ifdef SO_RXQ_OVFL
+        // the total packets dropped by kernel.
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(mh); cmsg; cmsg = CMSG_NXTHDR(mh, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                nb_drops = *(u_int32_t*)CMSG_DATA(cmsg);
+            }
+        }
+#endif
+        
+        // warn the first truncated packet util the stat shown,
+        // the others are counted, to not flood the log.
+        if ((mh->msg_flags & MSG_TRUNC) != 0) {
+            if (nb_truncated++ == nb_truncated_shown) {
+                srs_warn("drop udp packet larger than %dB, truncated=%"PRId64, SRS_PERF_UDP_RECV_PACKET_SIZE, nb_truncated);
+            }
+            continue;
+        }
+        
+        SrsUdpPacket* pkt = &packets[nb_pkts++];
+        if (pkt != &packets[i]) {
+            pkt->from = packets[i].from;
+        }
+        pkt->bytes = (char*)mh->msg_iov->iov_base;
+        pkt->size = (int)mmsgs[i].msg_len;
+    }
+    
+    *pnb_packets = nb_pkts;
+    
+    return ret;
+}
+#else
+int SrsUdpListener::recv_packets(SrsUdpPacket** ppackets, int* pnb_packets)
+{
+    int ret = ERROR_SUCCESS;
+    
+    *ppackets = packets;
+    *pnb_packets = 0;
+
+    SrsUdpPacket* pkt = &packets[0];
+    int nb_from = sizeof(sockaddr_in);
+    int nread = 0;
+
+    if ((nread = st_recvfrom(_stfd, buf, nb_buf, (sockaddr*)&pkt->from, &nb_from, ST_UTIME_NO_TIMEOUT)) <= 0) {
+        srs_warn("ignore recv udp packet failed, nread=%d", nread);
+        return ret;
+    }
+    
+    pkt->bytes = buf;
+    pkt->size = nread;
+    
+    nb_batches++;
+    nb_packets++;
+    max_batch = 1;
+    *pnb_packets = 1;
+    
+    return ret;
+}
+#endif
+
+void SrsUdpListener::show_stat()
+{
+    srs_trace("udp: listen %s:%d, batches=%"PRId64", packets=%"PRId64", avg_batch=%.2f, max_batch=%d, drops=%"PRId64", truncated=%"PRId64,
+        ip.c_str(), port, nb_batches, nb_packets, nb_batches > 0? nb_packets / (double)nb_batches : 0,
+        max_batch, nb_drops, nb_truncated);
+    nb_truncated_shown = nb_truncated;
+}
+
 SrsTcpListener::SrsTcpListener(ISrsTcpHandler* h, string i, int p)
 {
     handler = h;
@@ -223,6 +424,18 @@ int SrsTcpListener::listen()
     }
     srs_verbose("setsockopt reuse-addr success. port=%d, fd=%d", port, _fd);
     
+    // all workers listen at the same port, the kernel balances the connections.
+#ifdef SO_REUSEPORT
+    if (srs_worker_index() >= 0) {
+        if (setsockopt(_fd, SOL_SOCKET, SO_REUSEPORT, &reuse_socket, sizeof(int)) == -1) {
+            ret = ERROR_SOCKET_SETREUSE;
+            srs_error("setsockopt reuse-port error. port=%d, ret=%d", port, ret);
+            return ret;
+        }
+        srs_verbose("setsockopt reuse-port success. port=%d, fd=%d", port, _fd);
+    }
+#endif
+    
     // Detect alive for TCP connection.
     // @see https://github.com/ossrs/srs/issues/1044
 #ifdef SO_KEEPALIVE
@@ -35,7 +35,24 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_app_st.hpp>
 #include <srs_app_thread.hpp>
 
-struct sockaddr_in;
+#include <netinet/in.h>
+
+class SrsPithyPrint;
+struct mmsghdr;
+struct iovec;
+
+/**
+* the udp packet got by listener.
+*/
+struct SrsUdpPacket
+{
+    // the address of peer.
+    // TODO: FIXME: support ipv6, @see man 7 ipv6
+    sockaddr_in from;
+    // the bytes of packet, point to the buffer of listener.
+    char* bytes;
+    int size;
+};
 
 /**
 * the udp packet handler.
@@ -62,6 +79,14 @@ public:
     * @remark user should never use the buf, for it's a shared memory bytes.
     */
     virtual int on_udp_packet(sockaddr_in* from, char* buf, int nb_buf) = 0;
+    /**
+    * when udp listener got a batch of udp packets, which maybe from
+    * different peers, the default implementation handle each packet.
+    * @param packets, the udp packets, the bytes point to shared memory.
+    * @param nb_packets, the number of packets, atleast 1.
+    * @see SRS_PERF_UDP_RECV_BATCH
+    */
+    virtual int on_udp_packets(SrsUdpPacket* packets, int nb_packets);
 };
 
 /**
@@ -91,6 +116,30 @@ private:
 private:
     char* buf;
     int nb_buf;
+#ifdef SRS_PERF_UDP_RECV_BATCH
+private:
+    // the headers for recvmmsg, each point to a slot of buf.
+    mmsghdr* mmsgs;
+    iovec* iovs;
+    // the control buffer for each packet, to get the drops of socket.
+    char* controls;
+    int nb_control;
+#endif
+    // the packets got by recv, point to buf.
+    SrsUdpPacket* packets;
+private:
+    // the number of batches and the packets received.
+    int64_t nb_batches;
+    int64_t nb_packets;
+    // the max packets in a batch.
+    int max_batch;
+    // the packets dropped by kernel when socket buffer is full,
+    // and the packets dropped for larger than the slot.
+    int64_t nb_drops;
+    int64_t nb_truncated;
+    // the truncated packets when stat shown, to warn once util next stat.
+    int64_t nb_truncated_shown;
+    SrsPithyPrint* pprint;
 private:
     ISrsUdpHandler* handler;
     std::string ip;
@@ -103,9 +152,28 @@ public:
     virtual st_netfd_t stfd();
 public:
     virtual int listen();
+public:
+    /**
+    * the stat of listener, the batches and packets received,
+    * the packets dropped by kernel and truncated.
+    */
+    virtual int64_t get_batches();
+    virtual int64_t get_packets();
+    virtual int get_max_batch();
+    virtual int64_t get_drops();
+    virtual int64_t get_truncated();
 // interface ISrsReusableThreadHandler.
 public:
     virtual int cycle();
+private:
+    /**
+    * receive a batch of packets by recvmmsg, or a packet by recvfrom.
+    */
+    virtual int recv_packets(SrsUdpPacket** ppackets, int* pnb_packets);
+    /**
+    * print the batch and drop counters of listener.
+    */
+    virtual void show_stat();
 };
 
 /**
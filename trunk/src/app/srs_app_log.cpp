@@ -24,7 +24,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_app_log.hpp>
 
 #include <stdarg.h>
+#include <stdlib.h>
+#include <signal.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -34,6 +37,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_kernel_error.hpp>
 #include <srs_app_utility.hpp>
 #include <srs_kernel_utility.hpp>
+#include <srs_app_async_io.hpp>
+#include <srs_kernel_stream.hpp>
 
 SrsThreadContext::SrsThreadContext()
 {
@@ -88,24 +93,564 @@ void SrsThreadContext::clear_cid()
 // reserved for the end of log data, it must be strlen(LOG_TAIL)
 #define LOG_TAIL_SIZE 1
 
+// the magic of chunk in binary log file, SRSB.
+#define SRS_BINARY_LOG_MAGIC 0x53525342
+// the chunk header, magic(4B), pid(4B) and size(4B).
+#define SRS_BINARY_LOG_CHUNK_HEADER 12
+// the log record header, size(2B), type(1B), level(1B), time(8B),
+// fmt id(4B), tag id(4B), context id(4B) and errno(4B).
+#define SRS_BINARY_LOG_RECORD_HEADER 28
+// the interval in ms for the native thread to flush the ring.
+#define SRS_BINARY_LOG_FLUSH_INTERVAL_MS 100
+// the fmt for the log not supported, which is formatted in st.
+static const char* SRS_BINARY_LOG_TEXT_FMT = "%s";
+
+bool srs_binary_log_parse(const char* fmt, std::string& types)
+{
+    types = "";
+    
+    for (const char* p = fmt; *p; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        
+        p++;
+        if (*p == '%') {
+            continue;
+        }
+        
+        // flags.
+        while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' || *p == '\'') {
+            p++;
+        }
+        
+        // width.
+        if (*p == '*') {
+            types += "i";
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            p++;
+        }
+        
+        // precision.
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                types += "i";
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') {
+                p++;
+            }
+        }
+        
+        // length, the long is int64 for 64bits only.
+        int nb_long = 0;
+        bool is_int64 = false;
+        while (*p == 'h' || *p == 'l' || *p == 'j' || *p == 'z' || *p == 't' || *p == 'q' || *p == 'L') {
+            if (*p == 'L') {
+                return false;
+            }
+            if (*p == 'l') {
+                nb_long++;
+            }
+            if (*p == 'j' || *p == 'q' || *p == 'z' || *p == 't') {
+                is_int64 = sizeof(size_t) == 8 || *p == 'j' || *p == 'q';
+            }
+            p++;
+        }
+        if (nb_long > 1 || (nb_long == 1 && sizeof(long) == 8)) {
+            is_int64 = true;
+        }
+        
+        // conversion.
+        switch (*p) {
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+                types += is_int64? "I" : "i";
+                break;
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                types += "d";
+                break;
+            case 's':
+                if (nb_long) {
+                    return false;
+                }
+                types += "s";
+                break;
+            case 'p':
+                types += "p";
+                break;
+            default:
+                return false;
+        }
+    }
+    
+    return true;
+}
+
+SrsBinaryLog* SrsBinaryLog::_instance = new SrsBinaryLog();
+
+SrsBinaryLog::SrsBinaryLog()
+{
+    next_id = 1;
+    pending_drops = 0;
+    nb_drops = 0;
+    record = new char[LOG_MAX_SIZE];
+    text = new char[LOG_MAX_SIZE];
+    
+    started = false;
+    pthread_mutex_init(&io_lock, NULL);
+    fd = -1;
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+    ring = NULL;
+    nb_ring = 0;
+    head = tail = 0;
+}
+
+SrsBinaryLog::~SrsBinaryLog()
+{
+    // the log is never freed, for the native thread never quit.
+}
+
+SrsBinaryLog* SrsBinaryLog::instance()
+{
+    return _instance;
+}
+
+void SrsBinaryLog::set_ring_size(int size)
+{
+    if (!ring) {
+        nb_ring = size;
+    }
+}
+
+void SrsBinaryLog::write(const char* tag, int context_id, int level, int err, const char* fmt, va_list ap)
+{
+    if (!ring) {
+        nb_ring = srs_max(nb_ring, LOG_MAX_SIZE * 2);
+        ring = new char[nb_ring];
+    }
+    
+    if (!started) {
+        start();
+    }
+    
+    timeval tv;
+    if (gettimeofday(&tv, NULL) == -1) {
+        return;
+    }
+    int64_t now = tv.tv_sec * 1000000LL + tv.tv_usec;
+    
+    // write the dropped logs before the log, the record is size(2B),
+    // type(1B), 0(1B), time(8B) and count(4B).
+    if (pending_drops > 0) {
+        SrsStream stream;
+        if (stream.initialize(record, 16) == ERROR_SUCCESS) {
+            stream.write_2bytes(16);
+            stream.write_1bytes(SrsBinaryLogRecordDropped);
+            stream.write_1bytes(0);
+            stream.write_8bytes(now);
+            stream.write_4bytes((int32_t)pending_drops);
+            if (append(record, 16)) {
+                pending_drops = 0;
+            }
+        }
+    }
+    
+    // define the tag and fmt when first used.
+    uint32_t tag_id = 0;
+    if (tag && (tag_id = define(tag, NULL)) == 0) {
+        pending_drops++;
+        nb_drops++;
+        return;
+    }
+    
+    SrsBinaryLogString* str = NULL;
+    uint32_t fmt_id = define(fmt, &str);
+    if (fmt_id == 0) {
+        pending_drops++;
+        nb_drops++;
+        return;
+    }
+    
+    // the fmt not supported, format it to text in st.
+    int size = 0;
+    if (str->supported) {
+        size = encode_log(record, LOG_MAX_SIZE, str->types, now, fmt_id, tag_id, context_id, level, err, ap);
+    } else {
+        vsnprintf(text, LOG_MAX_SIZE, fmt, ap);
+        
+        SrsBinaryLogString* text_str = NULL;
+        if ((fmt_id = define(SRS_BINARY_LOG_TEXT_FMT, &text_str)) == 0) {
+            pending_drops++;
+            nb_drops++;
+            return;
+        }
+        size = encode_logf(record, LOG_MAX_SIZE, text_str->types, now, fmt_id, tag_id, context_id, level, err, text);
+    }
+    
+    if (size <= 0 || !append(record, size)) {
+        pending_drops++;
+        nb_drops++;
+    }
+}
+
+void SrsBinaryLog::reopen(std::string file)
+{
+    pthread_mutex_lock(&io_lock);
+    
+    flush_ring();
+    
+    if (fd > 0) {
+        ::close(fd);
+    }
+    fd = -1;
+    filename = file;
+    
+    pthread_mutex_unlock(&io_lock);
+    
+    // the new file requires the strings defined again.
+    clear_strings();
+}
+
+void SrsBinaryLog::flush()
+{
+    pthread_mutex_lock(&io_lock);
+    flush_ring();
+    pthread_mutex_unlock(&io_lock);
+}
+
+int64_t SrsBinaryLog::drops()
+{
+    return nb_drops;
+}
+
+int SrsBinaryLog::encode_log(char* buf, int size, std::string& types, int64_t time, uint32_t fmt_id, uint32_t tag_id, int context_id, int level, int err, va_list ap)
+{
+    SrsStream stream;
+    if (stream.initialize(buf, srs_min(size, 0xffff)) != ERROR_SUCCESS) {
+        return 0;
+    }
+    
+    if (!stream.require(SRS_BINARY_LOG_RECORD_HEADER)) {
+        return 0;
+    }
+    // the size is written when all args encoded.
+    stream.skip(2);
+    stream.write_1bytes(SrsBinaryLogRecordLog);
+    stream.write_1bytes(level);
+    stream.write_8bytes(time);
+    stream.write_4bytes(fmt_id);
+    stream.write_4bytes(tag_id);
+    stream.write_4bytes(context_id);
+    stream.write_4bytes(err);
+    
+    for (int i = 0; i < (int)types.length(); i++) {
+        char type = types.at(i);
+        
+        if (type == 'i') {
+            if (!stream.require(4)) {
+                return 0;
+            }
+            stream.write_4bytes(va_arg(ap, int));
+        } else if (type == 'I') {
+            if (!stream.require(8)) {
+                return 0;
+            }
+            stream.write_8bytes(va_arg(ap, int64_t));
+        } else if (type == 'd') {
+            if (!stream.require(8)) {
+                return 0;
+            }
+            double v = va_arg(ap, double);
+            int64_t bits = 0;
+            memcpy(&bits, &v, 8);
+            stream.write_8bytes(bits);
+        } else if (type == 'p') {
+            if (!stream.require(8)) {
+                return 0;
+            }
+            stream.write_8bytes((int64_t)(intptr_t)va_arg(ap, void*));
+        } else if (type == 's') {
+            if (!stream.require(2)) {
+                return 0;
+            }
+            // truncate the string when exceed the record.
+            const char* s = va_arg(ap, const char*);
+            if (!s) {
+                s = "(null)";
+            }
+            int len = srs_min((int)strlen(s), stream.size() - stream.pos() - 2);
+            stream.write_2bytes(len);
+            stream.write_bytes((char*)s, len);
+        }
+    }
+    
+    int nb_record = stream.pos();
+    
+    SrsStream size_stream;
+    size_stream.initialize(buf, 2);
+    size_stream.write_2bytes(nb_record);
+    
+    return nb_record;
+}
+
+int SrsBinaryLog::encode_logf(char* buf, int size, std::string& types, int64_t time, uint32_t fmt_id, uint32_t tag_id, int context_id, int level, int err, ...)
+{
+    va_list ap;
+    va_start(ap, err);
+    int nb_record = encode_log(buf, size, types, time, fmt_id, tag_id, context_id, level, err, ap);
+    va_end(ap);
+    
+    return nb_record;
+}
+
+uint32_t SrsBinaryLog::define(const char* str, SrsBinaryLogString** pstr)
+{
+    std::map<const char*, SrsBinaryLogString*>::iterator it = strings.find(str);
+    if (it != strings.end()) {
+        if (pstr) {
+            *pstr = it->second;
+        }
+        return it->second->id;
+    }
+    
+    SrsBinaryLogString* s = new SrsBinaryLogString();
+    s->id = next_id++;
+    s->supported = srs_binary_log_parse(str, s->types);
+    
+    // the string record, size(2B), type(1B), 0(1B), id(4B) and string.
+    int len = srs_min((int)strlen(str), LOG_MAX_SIZE - 8);
+    
+    SrsStream stream;
+    if (stream.initialize(record, 8 + len) != ERROR_SUCCESS) {
+        srs_freep(s);
+        return 0;
+    }
+    stream.write_2bytes(8 + len);
+    stream.write_1bytes(SrsBinaryLogRecordString);
+    stream.write_1bytes(0);
+    stream.write_4bytes(s->id);
+    stream.write_bytes((char*)str, len);
+    
+    // define it again when ring full.
+    if (!append(record, 8 + len)) {
+        srs_freep(s);
+        return 0;
+    }
+    
+    strings[str] = s;
+    if (pstr) {
+        *pstr = s;
+    }
+    
+    return s->id;
+}
+
+void SrsBinaryLog::clear_strings()
+{
+    std::map<const char*, SrsBinaryLogString*>::iterator it;
+    for (it = strings.begin(); it != strings.end(); ++it) {
+        SrsBinaryLogString* str = it->second;
+        srs_freep(str);
+    }
+    strings.clear();
+}
+
+bool SrsBinaryLog::append(char* data, int size)
+{
+    pthread_mutex_lock(&lock);
+    
+    if (head - tail + size > (uint64_t)nb_ring) {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+    
+    // copy to ring, maybe wrap to the start.
+    int pos = (int)(head % nb_ring);
+    int nb_copy = srs_min(size, nb_ring - pos);
+    memcpy(ring + pos, data, nb_copy);
+    if (nb_copy < size) {
+        memcpy(ring, data + nb_copy, size - nb_copy);
+    }
+    head += size;
+    
+    // wakeup the native thread when half full.
+    if (head - tail >= (uint64_t)nb_ring / 2) {
+        pthread_cond_signal(&cond);
+    }
+    
+    pthread_mutex_unlock(&lock);
+    
+    // write in st when no native thread.
+    if (!started) {
+        flush();
+    }
+    
+    return true;
+}
+
+int SrsBinaryLog::start()
+{
+    int ret = ERROR_SUCCESS;
+    
+    // only register the handlers once, for the child restart the thread.
+    static bool registered = false;
+    if (!registered) {
+        pthread_atfork(on_fork_prepare, on_fork_parent, on_fork_child);
+        atexit(on_exit);
+        registered = true;
+    }
+    
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    
+    int r0 = pthread_create(&tid, &attr, flush_thread, this);
+    pthread_attr_destroy(&attr);
+    
+    // never log here, write the log in st when thread failed.
+    if (r0 != 0) {
+        ret = ERROR_SYSTEM_LOG_THREAD;
+        return ret;
+    }
+    
+    started = true;
+    
+    return ret;
+}
+
+void SrsBinaryLog::flush_ring()
+{
+    pthread_mutex_lock(&lock);
+    uint64_t h = head;
+    uint64_t t = tail;
+    pthread_mutex_unlock(&lock);
+    
+    if (h == t) {
+        return;
+    }
+    
+    if (fd < 0 && !filename.empty()) {
+        fd = ::open(filename.c_str(), O_RDWR | O_APPEND | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    }
+    
+    // the region [t, h) is never changed by st, write it without lock.
+    if (fd > 0) {
+        int size = (int)(h - t);
+        int pos = (int)(t % nb_ring);
+        
+        char header[SRS_BINARY_LOG_CHUNK_HEADER];
+        SrsStream stream;
+        stream.initialize(header, SRS_BINARY_LOG_CHUNK_HEADER);
+        stream.write_4bytes(SRS_BINARY_LOG_MAGIC);
+        stream.write_4bytes(getpid());
+        stream.write_4bytes(size);
+        
+        iovec iovs[3];
+        iovs[0].iov_base = header;
+        iovs[0].iov_len = SRS_BINARY_LOG_CHUNK_HEADER;
+        iovs[1].iov_base = ring + pos;
+        iovs[1].iov_len = srs_min(size, nb_ring - pos);
+        iovs[2].iov_base = ring;
+        iovs[2].iov_len = size - iovs[1].iov_len;
+        
+        // ignore the error, the logs are dropped when disk full.
+        ::writev(fd, iovs, iovs[2].iov_len > 0? 3 : 2);
+    }
+    
+    pthread_mutex_lock(&lock);
+    tail = h;
+    pthread_mutex_unlock(&lock);
+}
+
+void* SrsBinaryLog::flush_thread(void* arg)
+{
+    // the signals are always handled by st.
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    
+    SrsBinaryLog* log = (SrsBinaryLog*)arg;
+    log->cycle();
+    
+    return NULL;
+}
+
+void SrsBinaryLog::cycle()
+{
+    for (;;) {
+        timeval tv;
+        gettimeofday(&tv, NULL);
+        
+        int64_t us = tv.tv_usec + SRS_BINARY_LOG_FLUSH_INTERVAL_MS * 1000;
+        timespec ts;
+        ts.tv_sec = tv.tv_sec + us / 1000000;
+        ts.tv_nsec = (us % 1000000) * 1000;
+        
+        pthread_mutex_lock(&lock);
+        pthread_cond_timedwait(&cond, &lock, &ts);
+        pthread_mutex_unlock(&lock);
+        
+        flush();
+    }
+}
+
+void SrsBinaryLog::on_fork_prepare()
+{
+    // flush the logs of parent, and hold the locks during fork,
+    // so the child never got a lock held by the native thread.
+    pthread_mutex_lock(&_instance->io_lock);
+    _instance->flush_ring();
+    pthread_mutex_lock(&_instance->lock);
+}
+
+void SrsBinaryLog::on_fork_parent()
+{
+    pthread_mutex_unlock(&_instance->lock);
+    pthread_mutex_unlock(&_instance->io_lock);
+}
+
+void SrsBinaryLog::on_fork_child()
+{
+    pthread_mutex_unlock(&_instance->lock);
+    pthread_mutex_unlock(&_instance->io_lock);
+    
+    // the native thread never exists in child, which is started
+    // again when child write log, and the ring is already flushed.
+    _instance->started = false;
+    _instance->head = _instance->tail = 0;
+    
+    // the logs of child is a new stream of pid, define strings again.
+    _instance->clear_strings();
+}
+
+void SrsBinaryLog::on_exit()
+{
+    _instance->flush();
+}
+
 SrsFastLog::SrsFastLog()
 {
     _level = SrsLogLevel::Trace;
     log_data = new char[LOG_MAX_SIZE];
 
     fd = -1;
+    async = false;
+    afile = NULL;
+    nb_reported = 0;
     log_to_file_tank = false;
     utc = false;
+    binary = false;
 }
 
 SrsFastLog::~SrsFastLog()
 {
     srs_freepa(log_data);
 
-    if (fd > 0) {
-        ::close(fd);
-        fd = -1;
-    }
+    close_log_file();
 
     if (_srs_config) {
         _srs_config->unsubscribe(this);
@@ -122,6 +667,14 @@ int SrsFastLog::initialize()
         log_to_file_tank = _srs_config->get_log_tank_file();
         _level = srs_get_log_level(_srs_config->get_log_level());
         utc = _srs_config->get_utc_time();
+        async = _srs_config->get_async_io_log();
+        binary = _srs_config->get_log_binary();
+    }
+    
+    // the binary log write the file in native thread.
+    if (binary) {
+        SrsBinaryLog::instance()->set_ring_size(_srs_config->get_log_ring_size());
+        SrsBinaryLog::instance()->reopen(_srs_config->get_log_file());
     }
     
     return ret;
@@ -133,6 +686,14 @@ void SrsFastLog::verbose(const char* tag, int context_id, const char* fmt, ...)
         return;
     }
     
+    if (binary && log_to_file_tank) {
+        va_list ap;
+        va_start(ap, fmt);
+        SrsBinaryLog::instance()->write(tag, context_id, SrsLogLevel::Verbose, errno, fmt, ap);
+        va_end(ap);
+        return;
+    }
+    
     int size = 0;
     if (!generate_header(false, tag, context_id, "verb", &size)) {
         return;
@@ -153,6 +714,14 @@ void SrsFastLog::info(const char* tag, int context_id, const char* fmt, ...)
         return;
     }
     
+    if (binary && log_to_file_tank) {
+        va_list ap;
+        va_start(ap, fmt);
+        SrsBinaryLog::instance()->write(tag, context_id, SrsLogLevel::Info, errno, fmt, ap);
+        va_end(ap);
+        return;
+    }
+    
     int size = 0;
     if (!generate_header(false, tag, context_id, "debug", &size)) {
         return;
@@ -173,6 +742,14 @@ void SrsFastLog::trace(const char* tag, int context_id, const char* fmt, ...)
         return;
     }
     
+    if (binary && log_to_file_tank) {
+        va_list ap;
+        va_start(ap, fmt);
+        SrsBinaryLog::instance()->write(tag, context_id, SrsLogLevel::Trace, errno, fmt, ap);
+        va_end(ap);
+        return;
+    }
+    
     int size = 0;
     if (!generate_header(false, tag, context_id, "trace", &size)) {
         return;
@@ -193,6 +770,14 @@ void SrsFastLog::warn(const char* tag, int context_id, const char* fmt, ...)
         return;
     }
     
+    if (binary && log_to_file_tank) {
+        va_list ap;
+        va_start(ap, fmt);
+        SrsBinaryLog::instance()->write(tag, context_id, SrsLogLevel::Warn, errno, fmt, ap);
+        va_end(ap);
+        return;
+    }
+    
     int size = 0;
     if (!generate_header(true, tag, context_id, "warn", &size)) {
         return;
@@ -213,6 +798,14 @@ void SrsFastLog::error(const char* tag, int context_id, const char* fmt, ...)
         return;
     }
     
+    if (binary && log_to_file_tank) {
+        va_list ap;
+        va_start(ap, fmt);
+        SrsBinaryLog::instance()->write(tag, context_id, SrsLogLevel::Error, errno, fmt, ap);
+        va_end(ap);
+        return;
+    }
+    
     int size = 0;
     if (!generate_header(true, tag, context_id, "error", &size)) {
         return;
@@ -257,10 +850,13 @@ int SrsFastLog::on_reload_log_tank()
     if (!log_to_file_tank) {
         return ret;
     }
-
-    if (fd > 0) {
-        ::close(fd);
+    
+    if (binary) {
+        SrsBinaryLog::instance()->reopen(_srs_config->get_log_file());
+        return ret;
     }
+
+    close_log_file();
     open_log_file();
     
     return ret;
@@ -290,10 +886,13 @@ int SrsFastLog::on_reload_log_file()
     if (!log_to_file_tank) {
         return ret;
     }
-
-    if (fd > 0) {
-        ::close(fd);
+    
+    if (binary) {
+        SrsBinaryLog::instance()->reopen(_srs_config->get_log_file());
+        return ret;
     }
+
+    close_log_file();
     open_log_file();
     
     return ret;
@@ -392,6 +991,32 @@ void SrsFastLog::write_log(int& fd, char *str_log, int size, int level)
         open_log_file();
     }
     
+    // attach the log file to async io pool, when pool started.
+    if (fd > 0 && async && !afile && SrsAsyncIo::instance()->enabled()) {
+        afile = SrsAsyncIo::instance()->open(fd);
+        nb_reported = 0;
+    }
+    
+    // write log to file in async io, never wait for the disk,
+    // drop the log when the pool is full.
+    if (afile && SrsAsyncIo::instance()->enabled()) {
+        iovec iov;
+        iov.iov_base = str_log;
+        iov.iov_len = size;
+        if (SrsAsyncIo::instance()->writev(afile, &iov, 1, false) != ERROR_SUCCESS) {
+            return;
+        }
+        
+        // report the dropped logs once the pool is writable,
+        // it's ok to reuse the log data, which is copied by writev.
+        if (afile->nb_dropped > nb_reported) {
+            int64_t nb_dropped = afile->nb_dropped - nb_reported;
+            nb_reported = afile->nb_dropped;
+            srs_warn("async log dropped %"PRId64" lines for pool full, total %"PRId64"", nb_dropped, nb_reported);
+        }
+        return;
+    }
+    
     // write log to file.
     if (fd > 0) {
         ::write(fd, str_log, size);
@@ -420,3 +1045,22 @@ void SrsFastLog::open_log_file()
     }
 }
 
+void SrsFastLog::close_log_file()
+{
+    // the async io close the fd after the pending logs written,
+    // never wait for it, for the log never yield.
+    if (afile && SrsAsyncIo::instance()->enabled()) {
+        SrsAsyncIo::instance()->close(afile, false);
+        afile = NULL;
+        fd = -1;
+        return;
+    }
+    // the fd is still owned by log, when pool not enabled.
+    srs_freep(afile);
+    
+    if (fd > 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
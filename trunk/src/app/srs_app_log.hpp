@@ -35,10 +35,14 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_app_reload.hpp>
 
 #include <string.h>
+#include <stdarg.h>
+#include <pthread.h>
 
 #include <string>
 #include <map>
 
+class SrsAsyncIoFile;
+
 /**
 * st thread context, get_id will get the st-thread id, 
 * which identify the client.
@@ -58,6 +62,145 @@ public:
     virtual void clear_cid();
 };
 
+/**
+ * the type of record in binary log.
+ */
+enum SrsBinaryLogRecordType
+{
+    // the log, the id of fmt and tag, and the args.
+    SrsBinaryLogRecordLog = 0,
+    // define the id of a fmt or tag string.
+    SrsBinaryLogRecordString,
+    // the number of logs dropped for the ring is full.
+    SrsBinaryLogRecordDropped,
+};
+
+/**
+ * parse the printf fmt to the types of args, each char is a arg:
+ *      i, the int32, for %d %u %x %c and the * of width or precision.
+ *      I, the int64, for %ld %lld %zu and PRId64 etc.
+ *      d, the double, for %f %g %e etc.
+ *      s, the string, for %s.
+ *      p, the pointer, for %p.
+ * @return false if fmt not supported, for example, %Lf or %n.
+ */
+extern bool srs_binary_log_parse(const char* fmt, std::string& types);
+
+/**
+ * the binary log, to write log without format in st.
+ * the log is encoded in a compact record, which only contains the
+ * time, context id, the id of fmt and the args, then copied to a ring,
+ * a native thread flush the ring to the log file, which is decoded to
+ * text by the offline tool research/log/srs_log_decoder.
+ * the fmt and tag is defined in a string record when first used,
+ * so the decoder knows the string of id.
+ * each write to file is a chunk with the pid, for the log file is
+ * shared by the master and the worker processes.
+ * @remark the fmt and tag must be literal string, which never change.
+ * @remark the log is dropped and counted when ring is full, never wait.
+ * @remark all record is in big-endian, encoded by SrsStream.
+ */
+class SrsBinaryLog
+{
+private:
+    static SrsBinaryLog* _instance;
+private:
+    class SrsBinaryLogString
+    {
+    public:
+        uint32_t id;
+        // the types of args, see srs_binary_log_parse.
+        std::string types;
+        // whether the fmt is parsed and supported.
+        bool supported;
+    };
+private:
+    // the strings of fmt and tag, only accessed in st.
+    std::map<const char*, SrsBinaryLogString*> strings;
+    uint32_t next_id;
+    // the logs dropped but not written in the dropped record.
+    int64_t pending_drops;
+    int64_t nb_drops;
+    // the buffer to encode record.
+    char* record;
+    // the formatted log for the fmt not supported.
+    char* text;
+private:
+    // whether the native thread is started.
+    bool started;
+    pthread_t tid;
+    // lock the file, always locked before the ring.
+    pthread_mutex_t io_lock;
+    int fd;
+    std::string filename;
+    // lock the ring, the head and tail are the total bytes of
+    // ring written and flushed, so the size of ring is head - tail.
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    char* ring;
+    int nb_ring;
+    uint64_t head;
+    uint64_t tail;
+private:
+    SrsBinaryLog();
+public:
+    virtual ~SrsBinaryLog();
+public:
+    static SrsBinaryLog* instance();
+public:
+    /**
+     * set the size of ring in bytes, only effect before the first log.
+     */
+    virtual void set_ring_size(int size);
+    /**
+     * write the log to ring, start the native thread when first log.
+     * @param err the errno, for warn and error log.
+     */
+    virtual void write(const char* tag, int context_id, int level, int err, const char* fmt, va_list ap);
+    /**
+     * open the log file, the pending logs are flushed to the old file.
+     */
+    virtual void reopen(std::string file);
+    /**
+     * flush the ring to file in current thread.
+     */
+    virtual void flush();
+    /**
+     * the total number of dropped logs.
+     */
+    virtual int64_t drops();
+public:
+    /**
+     * encode the log record to buf.
+     * @return the size of record, 0 if the record is too large.
+     */
+    static int encode_log(char* buf, int size, std::string& types, int64_t time, uint32_t fmt_id, uint32_t tag_id, int context_id, int level, int err, va_list ap);
+    static int encode_logf(char* buf, int size, std::string& types, int64_t time, uint32_t fmt_id, uint32_t tag_id, int context_id, int level, int err, ...);
+private:
+    /**
+     * get the id of string, write the string record when first used.
+     * @return the id, 0 if ring is full.
+     */
+    virtual uint32_t define(const char* str, SrsBinaryLogString** pstr);
+    virtual void clear_strings();
+    /**
+     * append the record to ring.
+     * @return false if ring is full.
+     */
+    virtual bool append(char* data, int size);
+    virtual int start();
+    /**
+     * flush the ring to file, the io_lock must be held.
+     */
+    virtual void flush_ring();
+    static void* flush_thread(void* arg);
+    virtual void cycle();
+    static void on_fork_prepare();
+    static void on_fork_parent();
+    static void on_fork_child();
+    static void on_exit();
+};
+
 /**
 * we use memory/disk cache and donot flush when write log.
 * it's ok to use it without config, which will log to console, and default trace level.
@@ -73,10 +216,18 @@ private:
     char* log_data;
     // log to file if specified srs_log_file
     int fd;
+    // whether write log file in the async io pool.
+    bool async;
+    // the async io file of fd, NULL when write in sync.
+    SrsAsyncIoFile* afile;
+    // the dropped logs of afile which already reported.
+    int64_t nb_reported;
     // whether log to file tank
     bool log_to_file_tank;
     // whether use utc time.
     bool utc;
+    // whether write the binary log, for file tank only.
+    bool binary;
 public:
     SrsFastLog();
     virtual ~SrsFastLog();
@@ -97,6 +248,7 @@ private:
     virtual bool generate_header(bool error, const char* tag, int context_id, const char* level_name, int* header_size);
     virtual void write_log(int& fd, char* str_log, int size, int level);
     virtual void open_log_file();
+    virtual void close_log_file();
 };
 
 #endif
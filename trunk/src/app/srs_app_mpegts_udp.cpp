@@ -173,6 +173,26 @@ int SrsMpegtsOverUdp::on_udp_packet(sockaddr_in* from, char* buf, int nb_buf)
     return on_udp_bytes(peer_ip, peer_port, buf, nb_buf);
 }
 
+int SrsMpegtsOverUdp::on_udp_packets(SrsUdpPacket* packets, int nb_packets)
+{
+    // append all packets of batch, then parse the ts packets in a time.
+    int nb_bytes = 0;
+    for (int i = 0; i < nb_packets; i++) {
+        SrsUdpPacket* packet = &packets[i];
+        buffer->append(packet->bytes, packet->size);
+        nb_bytes += packet->size;
+    }
+    
+    SrsUdpPacket* last = &packets[nb_packets - 1];
+    std::string peer_ip = inet_ntoa(last->from.sin_addr);
+    int peer_port = ntohs(last->from.sin_port);
+    
+    srs_info("udp: got %s:%d %d packets %d/%d bytes",
+        peer_ip.c_str(), peer_port, nb_packets, nb_bytes, buffer->length());
+    
+    return on_udp_bytes(peer_ip, peer_port, last->bytes, nb_bytes);
+}
+
 int SrsMpegtsOverUdp::on_udp_bytes(string host, int port, char* buf, int nb_buf)
 {
     int ret = ERROR_SUCCESS;
@@ -109,6 +109,7 @@ public:
 // interface ISrsUdpHandler
 public:
     virtual int on_udp_packet(sockaddr_in* from, char* buf, int nb_buf);
+    virtual int on_udp_packets(SrsUdpPacket* packets, int nb_packets);
 private:
     virtual int on_udp_bytes(std::string host, int port, char* buf, int nb_buf);
 // interface ISrsTsHandler
@@ -108,6 +108,8 @@ SrsPithyPrint::SrsPithyPrint(int _stage_id)
 #define SRS_CONSTS_STAGE_HTTP_STREAM 9
 // the pithy stage for all http stream cache.
 #define SRS_CONSTS_STAGE_HTTP_STREAM_CACHE 10
+// the pithy stage for all udp listeners.
+#define SRS_CONSTS_STAGE_UDP_LISTENER 11
 
 SrsPithyPrint* SrsPithyPrint::create_rtmp_play()
 {
@@ -159,6 +161,11 @@ SrsPithyPrint* SrsPithyPrint::create_http_stream_cache()
     return new SrsPithyPrint(SRS_CONSTS_STAGE_HTTP_STREAM_CACHE);
 }
 
+SrsPithyPrint* SrsPithyPrint::create_udp_listener()
+{
+    return new SrsPithyPrint(SRS_CONSTS_STAGE_UDP_LISTENER);
+}
+
 SrsPithyPrint::~SrsPithyPrint()
 {
     leave_stage();
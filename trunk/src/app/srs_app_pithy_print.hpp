@@ -95,6 +95,7 @@ public:
     static SrsPithyPrint* create_caster();
     static SrsPithyPrint* create_http_stream();
     static SrsPithyPrint* create_http_stream_cache();
+    static SrsPithyPrint* create_udp_listener();
     virtual ~SrsPithyPrint();
 private:
     /**
@@ -337,6 +337,11 @@ void SrsPublishRecvThread::on_thread_start()
 {
     // we donot set the auto response to false,
     // for the main thread never send message.
+    
+#ifdef SRS_PERF_RECV_SLAB
+    // receive the payload of publisher in slab, without copy when possible.
+    rtmp->set_recv_slab(true);
+#endif
 
 #ifdef SRS_PERF_MERGED_READ
     if (mr) {
@@ -358,6 +363,10 @@ void SrsPublishRecvThread::on_thread_stop()
     // when thread stop, signal the conn thread which wait.
     // @see https://github.com/ossrs/srs/issues/244
     st_cond_signal(error);
+    
+#ifdef SRS_PERF_RECV_SLAB
+    rtmp->set_recv_slab(false);
+#endif
 
 #ifdef SRS_PERF_MERGED_READ
     if (mr) {
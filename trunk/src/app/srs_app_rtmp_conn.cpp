@@ -24,6 +24,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_app_rtmp_conn.hpp>
 
 #include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
@@ -54,6 +56,11 @@ using namespace std;
 #include <srs_app_security.hpp>
 #include <srs_app_statistic.hpp>
 #include <srs_rtmp_utility.hpp>
+#include <srs_app_worker.hpp>
+#include <srs_protocol_json.hpp>
+#ifdef SRS_AUTO_SSL
+#include <srs_rtmp_handshake.hpp>
+#endif
 
 // when stream is busy, for example, streaming is already
 // publishing, when a new client to request to publish,
@@ -75,6 +82,324 @@ using namespace std;
 // when edge timeout, retry next.
 #define SRS_EDGE_TOKEN_TRAVERSE_TIMEOUT_US (int64_t)(3*1000*1000LL)
 
+// the interval to check the DH keys pool when it's full, and the max keys
+// to generate before check again, about 1ms to generate a key.
+#define SRS_RTMP_HANDSHAKE_REFILL_US (int64_t)(10*1000LL)
+#define SRS_RTMP_HANDSHAKE_REFILL_KEYS 4
+
+// the upper bound in ms of the latency buckets, except the overflow one.
+static int64_t srs_handshake_buckets[SRS_RTMP_HANDSHAKE_BUCKETS - 1] = {1, 5, 10, 50, 100, 500, 1000};
+
+SrsRtmpHandshakes* SrsRtmpHandshakes::_instance = new SrsRtmpHandshakes();
+
+SrsRtmpHandshakes::SrsRtmpHandshakes()
+{
+    started = false;
+    refill_ret = ERROR_SUCCESS;
+    refill_ret_shown = false;
+    nb_complex = nb_simple = nb_failed = 0;
+    for (int i = 0; i < SRS_RTMP_HANDSHAKE_BUCKETS; i++) {
+        complex_latency[i] = simple_latency[i] = 0;
+    }
+    sample_time = 0;
+    sample_handshakes = 0;
+    rate = peak_rate = 0;
+}
+
+SrsRtmpHandshakes::~SrsRtmpHandshakes()
+{
+    // the refiller is never stopped, for the native thread never quit.
+}
+
+SrsRtmpHandshakes* SrsRtmpHandshakes::instance()
+{
+    return _instance;
+}
+
+int SrsRtmpHandshakes::initialize(int dh_pool, bool overload)
+{
+    int ret = ERROR_SUCCESS;
+    
+    sample_time = srs_get_system_time_ms();
+    
+#ifdef SRS_AUTO_SSL
+    if ((ret = _srs_internal::SrsHandshakeKeys::instance()->initialize(dh_pool, overload)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    if (dh_pool > 0 && !started) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        
+        int r0 = pthread_create(&tid, &attr, refill_thread, this);
+        pthread_attr_destroy(&attr);
+        
+        if (r0 != 0) {
+            ret = ERROR_SYSTEM_HANDSHAKE_THREAD;
+            srs_error("handshake: start dh keys refiller failed, r0=%d. ret=%d", r0, ret);
+            return ret;
+        }
+        started = true;
+    }
+#else
+    srs_trace("handshake: ignore dh_pool=%d, overload=%d for ssl disabled", dh_pool, overload);
+#endif
+    
+    return ret;
+}
+
+void SrsRtmpHandshakes::on_handshake(bool complex, int64_t elapsed, int ret)
+{
+    if (ret != ERROR_SUCCESS) {
+        nb_failed++;
+        return;
+    }
+    
+    int64_t* latency = simple_latency;
+    if (complex) {
+        nb_complex++;
+        latency = complex_latency;
+    } else {
+        nb_simple++;
+    }
+    
+    int i = 0;
+    while (i < SRS_RTMP_HANDSHAKE_BUCKETS - 1 && elapsed >= srs_handshake_buckets[i]) {
+        i++;
+    }
+    latency[i]++;
+    
+    sample();
+}
+
+int SrsRtmpHandshakes::dumps(std::stringstream& ss)
+{
+    int ret = ERROR_SUCCESS;
+    
+    sample();
+    
+    int dh_pool = 0;
+    int64_t dh_misses = 0;
+    int64_t overloads = 0;
+#ifdef SRS_AUTO_SSL
+    _srs_internal::SrsHandshakeKeys* keys = _srs_internal::SrsHandshakeKeys::instance();
+    dh_pool = keys->size();
+    dh_misses = keys->misses();
+    overloads = keys->overloads();
+#endif
+    
+    ss << SRS_JOBJECT_START
+            << SRS_JFIELD_ORG("complex", nb_complex) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("simple", nb_simple) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("failed", nb_failed) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("rate", rate) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("peak_rate", peak_rate) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("dh_pool", dh_pool) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("dh_misses", dh_misses) << SRS_JFIELD_CONT
+            << SRS_JFIELD_ORG("overloads", overloads) << SRS_JFIELD_CONT
+            << SRS_JFIELD_NAME("buckets_ms") << SRS_JARRAY_START;
+    for (int i = 0; i < SRS_RTMP_HANDSHAKE_BUCKETS - 1; i++) {
+        ss << (i > 0? SRS_JFIELD_CONT : "") << srs_handshake_buckets[i];
+    }
+    ss << SRS_JARRAY_END << SRS_JFIELD_CONT
+            << SRS_JFIELD_NAME("complex_latency") << SRS_JARRAY_START;
+    for (int i = 0; i < SRS_RTMP_HANDSHAKE_BUCKETS; i++) {
+        ss << (i > 0? SRS_JFIELD_CONT : "") << complex_latency[i];
+    }
+    ss << SRS_JARRAY_END << SRS_JFIELD_CONT
+            << SRS_JFIELD_NAME("simple_latency") << SRS_JARRAY_START;
+    for (int i = 0; i < SRS_RTMP_HANDSHAKE_BUCKETS; i++) {
+        ss << (i > 0? SRS_JFIELD_CONT : "") << simple_latency[i];
+    }
+    ss << SRS_JARRAY_END
+        << SRS_JOBJECT_END;
+    
+    return ret;
+}
+
+void SrsRtmpHandshakes::sample()
+{
+    // the native thread never log, show its error in st.
+    if (refill_ret != ERROR_SUCCESS && !refill_ret_shown) {
+        srs_error("handshake: refill dh keys failed, stop refill. ret=%d", refill_ret);
+        refill_ret_shown = true;
+    }
+    
+    int64_t now = srs_get_system_time_ms();
+    if (now - sample_time < 10 * 1000) {
+        return;
+    }
+    
+    int64_t nb_handshakes = nb_complex + nb_simple;
+    rate = (nb_handshakes - sample_handshakes) * 1000.0 / (now - sample_time);
+    peak_rate = srs_max(peak_rate, rate);
+    
+    sample_time = now;
+    sample_handshakes = nb_handshakes;
+}
+
+void* SrsRtmpHandshakes::refill_thread(void* arg)
+{
+    // the signals are always handled by st.
+    sigset_t mask;
+    sigfillset(&mask);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    
+    SrsRtmpHandshakes* hs = (SrsRtmpHandshakes*)arg;
+    hs->refill_ret = hs->cycle();
+    
+    return NULL;
+}
+
+int SrsRtmpHandshakes::cycle()
+{
+    int ret = ERROR_SUCCESS;
+    
+#ifdef SRS_AUTO_SSL
+    _srs_internal::SrsHandshakeKeys* keys = _srs_internal::SrsHandshakeKeys::instance();
+    
+    for (;;) {
+        // refill until full, never block st for it's another thread.
+        while (!keys->full()) {
+            if ((ret = keys->refill(SRS_RTMP_HANDSHAKE_REFILL_KEYS)) != ERROR_SUCCESS) {
+                return ret;
+            }
+        }
+        
+        // never use st_usleep, it's a native thread.
+        ::usleep(SRS_RTMP_HANDSHAKE_REFILL_US);
+    }
+#endif
+    
+    return ret;
+}
+
+// the weight of new sample for the estimation of mw.
+#define SRS_MW_EWMA_ALPHA 0.2
+// ignore the sample when timestamp jump over this in ms, for republish.
+#define SRS_MW_MAX_SAMPLE_MS 10000
+
+// the exponentially weighted moving average, use the sample when not initialized.
+static void srs_mw_ewma(double& value, double sample)
+{
+    if (value <= 0) {
+        value = sample;
+    } else {
+        value = value * (1 - SRS_MW_EWMA_ALPHA) + sample * SRS_MW_EWMA_ALPHA;
+    }
+}
+
+SrsMwController::SrsMwController()
+{
+    target = SRS_PERF_MW_SLEEP;
+    realtime = SRS_PERF_MIN_LATENCY_ENABLED;
+    bytes_rate = msgs_rate = 0;
+    last_timestamp = -1;
+    queued = 0;
+    batch_msgs = batch_bytes = 0;
+    send_us = 0;
+
+    pick();
+}
+
+SrsMwController::~SrsMwController()
+{
+}
+
+void SrsMwController::initialize(int target_ms, bool rt)
+{
+    target = target_ms;
+    realtime = rt;
+
+    pick();
+}
+
+void SrsMwController::on_send(int count, int bytes, int64_t timestamp, int64_t elapsed, int outq)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    // the msgs of batch are in (last_timestamp, timestamp].
+    int64_t duration = timestamp - last_timestamp;
+    if (last_timestamp >= 0 && duration > 0 && duration < SRS_MW_MAX_SAMPLE_MS) {
+        srs_mw_ewma(bytes_rate, bytes / (double)duration);
+        srs_mw_ewma(msgs_rate, count / (double)duration);
+    }
+    last_timestamp = timestamp;
+
+    srs_mw_ewma(batch_msgs, count);
+    srs_mw_ewma(batch_bytes, bytes);
+    srs_mw_ewma(send_us, (double)srs_max(1, elapsed));
+    queued = outq;
+
+    pick();
+}
+
+int SrsMwController::wait()
+{
+    return wait_ms;
+}
+
+int SrsMwController::msgs()
+{
+    return min_msgs;
+}
+
+int SrsMwController::batch()
+{
+    return (int)(batch_msgs + 0.5);
+}
+
+int SrsMwController::batch_size()
+{
+    return (int)batch_bytes;
+}
+
+int SrsMwController::send_latency()
+{
+    return (int)send_us;
+}
+
+int SrsMwController::kbps()
+{
+    return (int)(bytes_rate * 8);
+}
+
+void SrsMwController::pick()
+{
+    // use the target and default msgs util the stream is measured.
+    if (bytes_rate <= 0 || msgs_rate <= 0) {
+        wait_ms = target;
+        min_msgs = realtime? 0 : SRS_PERF_MW_MIN_MSGS;
+        return;
+    }
+
+    // the latency left for merged-write, when the bytes in socket
+    // send buffer and the send of batch already consumed some.
+    double budget = target - queued / bytes_rate - send_us / 1000.0;
+
+    // when backlogged, write at least some bytes, the syscall is
+    // useless for tiny bytes because peer is slow.
+    if (queued > 0) {
+        budget = srs_max(budget, srs_min((double)target, SRS_PERF_MW_MIN_BYTES / bytes_rate));
+    }
+
+    // never merge more msgs than a write can send.
+    budget = srs_min(budget, SRS_PERF_MW_MSGS / msgs_rate);
+
+    wait_ms = (int)srs_max((double)srs_min(SRS_PERF_MW_MIN_SLEEP, target), srs_min(budget, (double)target));
+
+    // for realtime, send when got one+ msgs; otherwise, wait for half the msgs
+    // in the wait time, so the audio only stream never waits too long for msgs.
+    if (realtime) {
+        min_msgs = 0;
+    } else {
+        min_msgs = srs_max(1, srs_min(SRS_PERF_MW_MIN_MSGS, (int)(msgs_rate * wait_ms / 2)));
+    }
+}
+
 SrsRtmpConn::SrsRtmpConn(SrsServer* svr, st_netfd_t c)
     : SrsConnection(svr, c)
 {
@@ -93,10 +418,12 @@ SrsRtmpConn::SrsRtmpConn(SrsServer* svr, st_netfd_t c)
     
     mw_sleep = SRS_PERF_MW_SLEEP;
     mw_enabled = false;
+    mw = NULL;
     realtime = SRS_PERF_MIN_LATENCY_ENABLED;
     send_min_interval = 0;
     tcp_nodelay = true;
     client_type = SrsRtmpConnUnknown;
+    relay = false;
     
     _srs_config->subscribe(this);
 }
@@ -113,6 +440,7 @@ SrsRtmpConn::~SrsRtmpConn()
     srs_freep(bandwidth);
     srs_freep(security);
     srs_freep(kbps);
+    srs_freep(mw);
 }
 
 void SrsRtmpConn::dispose()
@@ -125,6 +453,11 @@ void SrsRtmpConn::dispose()
     }
 }
 
+void SrsRtmpConn::set_relay()
+{
+    relay = true;
+}
+
 // TODO: return detail message when error for client.
 int SrsRtmpConn::do_cycle()
 {
@@ -135,7 +468,13 @@ int SrsRtmpConn::do_cycle()
     rtmp->set_recv_timeout(SRS_CONSTS_RTMP_RECV_TIMEOUT_US);
     rtmp->set_send_timeout(SRS_CONSTS_RTMP_SEND_TIMEOUT_US);
     
-    if ((ret = rtmp->handshake()) != ERROR_SUCCESS) {
+    int64_t starttime = srs_update_system_time_ms();
+    ret = rtmp->handshake();
+    
+    int64_t elapsed = srs_update_system_time_ms() - starttime;
+    SrsRtmpHandshakes::instance()->on_handshake(rtmp->is_complex_handshake(), elapsed, ret);
+    
+    if (ret != ERROR_SUCCESS) {
         srs_error("rtmp handshake failed. ret=%d", ret);
         return ret;
     }
@@ -224,6 +563,9 @@ int SrsRtmpConn::on_reload_vhost_mw(string vhost)
     
     // when mw_sleep changed, resize the socket send buffer.
     change_mw_sleep(sleep_ms);
+    change_mw_adaptive(_srs_config->get_mw_adaptive(req->vhost));
+    
+    rtmp->set_send_aggregate(_srs_config->get_mw_aggregate(req->vhost));
 
     return ret;
 }
@@ -270,6 +612,7 @@ int SrsRtmpConn::on_reload_vhost_realtime(string vhost)
     if (realtime_enabled != realtime) {
         srs_trace("realtime changed %d=>%d", realtime, realtime_enabled);
         realtime = realtime_enabled;
+        change_mw_adaptive(_srs_config->get_mw_adaptive(req->vhost));
     }
 
     return ret;
@@ -486,8 +829,8 @@ int SrsRtmpConn::stream_service_cycle()
         }
     }
     
-    // security check
-    if ((ret = security->check(type, ip, req)) != ERROR_SUCCESS) {
+    // security check, the relay of workers is checked by the proxy worker.
+    if (!relay && (ret = security->check(type, ip, req)) != ERROR_SUCCESS) {
         srs_error("security check failed. ret=%d", ret);
         return ret;
     }
@@ -512,14 +855,15 @@ int SrsRtmpConn::stream_service_cycle()
     }
     srs_assert(source != NULL);
     
-    // update the statistic when source disconveried.
+    // update the statistic when source disconveried,
+    // the relay of workers is counted by the proxy worker.
     SrsStatistic* stat = SrsStatistic::instance();
-    if ((ret = stat->on_client(_srs_context->get_id(), req, this, type)) != ERROR_SUCCESS) {
+    if (!relay && (ret = stat->on_client(_srs_context->get_id(), req, this, type)) != ERROR_SUCCESS) {
         srs_error("stat client failed. ret=%d", ret);
         return ret;
     }
 
-    bool vhost_is_edge = _srs_config->get_vhost_is_edge(req->vhost);
+    bool vhost_is_edge = _srs_config->get_vhost_is_edge(req->vhost) || srs_worker_is_proxy(req);
     bool enabled_cache = _srs_config->get_gop_cache(req->vhost);
     srs_trace("source url=%s, ip=%s, cache=%d, is_edge=%d, source_id=%d[%d]",
         req->get_stream_url().c_str(), ip.c_str(), enabled_cache, vhost_is_edge, 
@@ -712,14 +1056,19 @@ int SrsRtmpConn::do_playing(SrsSource* source, SrsConsumer* consumer, SrsQueueRe
     // when mw_sleep changed, resize the socket send buffer.
     mw_enabled = true;
     change_mw_sleep(_srs_config->get_mw_sleep_ms(req->vhost));
+    // the adaptive mw use the mw_sleep as latency target.
+    change_mw_adaptive(_srs_config->get_mw_adaptive(req->vhost));
+    // send the messages of mw in aggregate messages.
+    bool mw_aggregate = _srs_config->get_mw_aggregate(req->vhost);
+    rtmp->set_send_aggregate(mw_aggregate);
     // initialize the send_min_interval
     send_min_interval = _srs_config->get_send_min_interval(req->vhost);
     
     // set the sock options.
     set_sock_options();
     
-    srs_trace("start play smi=%.2f, mw_sleep=%d, mw_enabled=%d, realtime=%d, tcp_nodelay=%d",
-        send_min_interval, mw_sleep, mw_enabled, realtime, tcp_nodelay);
+    srs_trace("start play smi=%.2f, mw_sleep=%d, mw_enabled=%d, mw_aggregate=%d, mw_adaptive=%d, realtime=%d, tcp_nodelay=%d",
+        send_min_interval, mw_sleep, mw_enabled, mw_aggregate, (mw != NULL), realtime, tcp_nodelay);
     
     while (!disposed) {
         // collect elapse for pithy print.
@@ -762,7 +1111,10 @@ int SrsRtmpConn::do_playing(SrsSource* source, SrsConsumer* consumer, SrsQueueRe
         // wait for message to incoming.
         // @see https://github.com/ossrs/srs/issues/251
         // @see https://github.com/ossrs/srs/issues/257
-        if (realtime) {
+        if (mw) {
+            // for adaptive, the controller picks the msgs and wait time.
+            consumer->wait(mw->msgs(), mw->wait());
+        } else if (realtime) {
             // for realtime, min required msgs is 0, send when got one+ msgs.
             consumer->wait(0, mw_sleep);
         } else {
@@ -791,8 +1143,16 @@ int SrsRtmpConn::do_playing(SrsSource* source, SrsConsumer* consumer, SrsQueueRe
                 pprint->age(), count,
                 kbps->get_send_kbps(), kbps->get_send_kbps_30s(), kbps->get_send_kbps_5m(),
                 kbps->get_recv_kbps(), kbps->get_recv_kbps_30s(), kbps->get_recv_kbps_5m(),
-                mw_sleep
+                (mw? mw->wait() : mw_sleep)
             );
+            
+            // report the effective batch and send latency of adaptive mw.
+            if (mw) {
+                srs_trace("-> "SRS_CONSTS_LOG_PLAY" mw wait=%dms, msgs=%d, batch=%d, bytes=%d, send=%dus, kbps=%d",
+                    mw->wait(), mw->msgs(), mw->batch(), mw->batch_size(), mw->send_latency(), mw->kbps());
+                SrsStatistic::instance()->on_client_mw(_srs_context->get_id(),
+                    mw->wait(), mw->batch(), mw->batch_size(), mw->send_latency());
+            }
         }
         
         // we use wait timeout to get messages,
@@ -809,7 +1169,7 @@ int SrsRtmpConn::do_playing(SrsSource* source, SrsConsumer* consumer, SrsQueueRe
         if (count <= 0) {
 #ifndef SRS_PERF_QUEUE_COND_WAIT
             srs_info("mw sleep %dms for no msg", mw_sleep);
-            st_usleep(mw_sleep * 1000);
+            st_usleep((mw? mw->wait() : mw_sleep) * 1000);
 #else
             srs_verbose("mw wait %dms and got nothing.", mw_sleep);
 #endif
@@ -834,6 +1194,18 @@ int SrsRtmpConn::do_playing(SrsSource* source, SrsConsumer* consumer, SrsQueueRe
             }
         }
         
+        // for adaptive mw, measure the batch before sent, for msgs will be freed.
+        int nb_bytes = 0;
+        int64_t timestamp = 0;
+        int64_t send_start = 0;
+        if (mw) {
+            for (int i = 0; i < count; i++) {
+                nb_bytes += msgs.msgs[i]->size;
+            }
+            timestamp = msgs.msgs[count - 1]->timestamp;
+            send_start = st_utime();
+        }
+        
         // sendout messages, all messages are freed by send_and_free_messages().
         // no need to assert msg, for the rtmp will assert it.
         if (count > 0 && (ret = rtmp->send_and_free_messages(msgs.msgs, count, res->stream_id)) != ERROR_SUCCESS) {
@@ -843,6 +1215,10 @@ int SrsRtmpConn::do_playing(SrsSource* source, SrsConsumer* consumer, SrsQueueRe
             return ret;
         }
         
+        if (mw) {
+            mw->on_send(count, nb_bytes, timestamp, st_utime() - send_start, srs_get_sock_outq(st_netfd_fileno(stfd)));
+        }
+        
         // if duration specified, and exceed it, stop play live.
         // @see: https://github.com/ossrs/srs/issues/45
         if (user_specified_duration_to_stop) {
@@ -877,7 +1253,8 @@ int SrsRtmpConn::publishing(SrsSource* source)
         return ret;
     }
 
-    bool vhost_is_edge = _srs_config->get_vhost_is_edge(req->vhost);
+    // the worker proxy publish to the owner worker, like edge.
+    bool vhost_is_edge = _srs_config->get_vhost_is_edge(req->vhost) || srs_worker_is_proxy(req);
     if ((ret = acquire_publish(source, vhost_is_edge)) == ERROR_SUCCESS) {
         // use isolate thread to recv,
         // @see: https://github.com/ossrs/srs/issues/237
@@ -1275,6 +1652,28 @@ void SrsRtmpConn::change_mw_sleep(int sleep_ms)
     mw_sleep = sleep_ms;
 }
 
+void SrsRtmpConn::change_mw_adaptive(bool adaptive)
+{
+    if (!mw_enabled) {
+        return;
+    }
+    
+    if (!adaptive) {
+        if (mw) {
+            srs_trace("mw adaptive disabled, sleep=%d", mw_sleep);
+        }
+        srs_freep(mw);
+        return;
+    }
+    
+    if (!mw) {
+        mw = new SrsMwController();
+    }
+    mw->initialize(mw_sleep, realtime);
+    
+    srs_trace("mw adaptive target=%dms, realtime=%d, wait=%dms, msgs=%d", mw_sleep, realtime, mw->wait(), mw->msgs());
+}
+
 void SrsRtmpConn::set_sock_options()
 {
     bool nvalue = _srs_config->get_tcp_nodelay(req->vhost);
@@ -1397,7 +1796,8 @@ int SrsRtmpConn::http_hooks_on_connect()
     int ret = ERROR_SUCCESS;
     
 #ifdef SRS_AUTO_HTTP_CALLBACK
-    if (!_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
+    // the relay of workers never callback, the proxy worker already did.
+    if (relay || !_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
         return ret;
     }
     
@@ -1432,7 +1832,8 @@ int SrsRtmpConn::http_hooks_on_connect()
 void SrsRtmpConn::http_hooks_on_close()
 {
 #ifdef SRS_AUTO_HTTP_CALLBACK
-    if (!_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
+    // the relay of workers never callback, the proxy worker already did.
+    if (relay || !_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
         return;
     }
     
@@ -1464,7 +1865,8 @@ int SrsRtmpConn::http_hooks_on_publish()
     int ret = ERROR_SUCCESS;
     
 #ifdef SRS_AUTO_HTTP_CALLBACK
-    if (!_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
+    // the relay of workers never callback, the proxy worker already did.
+    if (relay || !_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
         return ret;
     }
     
@@ -1499,7 +1901,8 @@ int SrsRtmpConn::http_hooks_on_publish()
 void SrsRtmpConn::http_hooks_on_unpublish()
 {
 #ifdef SRS_AUTO_HTTP_CALLBACK
-    if (!_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
+    // the relay of workers never callback, the proxy worker already did.
+    if (relay || !_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
         return;
     }
     
@@ -1531,7 +1934,8 @@ int SrsRtmpConn::http_hooks_on_play()
     int ret = ERROR_SUCCESS;
     
 #ifdef SRS_AUTO_HTTP_CALLBACK
-    if (!_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
+    // the relay of workers never callback, the proxy worker already did.
+    if (relay || !_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
         return ret;
     }
     
@@ -1566,7 +1970,8 @@ int SrsRtmpConn::http_hooks_on_play()
 void SrsRtmpConn::http_hooks_on_stop()
 {
 #ifdef SRS_AUTO_HTTP_CALLBACK
-    if (!_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
+    // the relay of workers never callback, the proxy worker already did.
+    if (relay || !_srs_config->get_vhost_http_hooks_enabled(req->vhost)) {
         return;
     }
     
@@ -33,8 +33,12 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_app_st.hpp>
 #include <srs_app_conn.hpp>
 #include <srs_app_reload.hpp>
+#include <srs_app_thread.hpp>
 #include <srs_rtmp_stack.hpp>
 
+#include <sstream>
+#include <pthread.h>
+
 class SrsServer;
 class SrsRtmpServer;
 class SrsRequest;
@@ -56,6 +60,135 @@ class SrsPublishRecvThread;
 class SrsSecurity;
 class ISrsWakable;
 
+// the buckets of handshake latency histogram, the last one is the overflow.
+#define SRS_RTMP_HANDSHAKE_BUCKETS 8
+
+/**
+* the handshakes of rtmp clients, which refills the DH keys pool of complex
+* handshake in a native thread, and stats the rate and latency of handshakes,
+* for the storm of handshakes when lots of clients reconnect.
+* @remark the DH key generation is CPU bound and never yields, so the refiller
+*       is a native thread rather than st, which never block the st scheduler
+*       and use another core in the storm.
+*/
+class SrsRtmpHandshakes
+{
+private:
+    static SrsRtmpHandshakes* _instance;
+private:
+    // the native thread to refill DH keys, started when pool enabled.
+    bool started;
+    pthread_t tid;
+    // the error of refiller, set by native thread and logged by st.
+    volatile int refill_ret;
+    bool refill_ret_shown;
+    // the number of handshakes.
+    int64_t nb_complex;
+    int64_t nb_simple;
+    int64_t nb_failed;
+    // the latency histogram of complex and simple handshakes.
+    int64_t complex_latency[SRS_RTMP_HANDSHAKE_BUCKETS];
+    int64_t simple_latency[SRS_RTMP_HANDSHAKE_BUCKETS];
+    // the handshakes per second, sampled at least every 10s.
+    int64_t sample_time;
+    int64_t sample_handshakes;
+    double rate;
+    double peak_rate;
+private:
+    SrsRtmpHandshakes();
+public:
+    virtual ~SrsRtmpHandshakes();
+public:
+    static SrsRtmpHandshakes* instance();
+public:
+    /**
+    * initialize the keys of complex handshake, start to refill when pool enabled.
+    * @param dh_pool the max DH keys in pool, 0 to disable.
+    * @param overload whether use simple handshake when pool is used up.
+    */
+    virtual int initialize(int dh_pool, bool overload);
+    /**
+    * when handshake with client done.
+    * @param complex whether the handshake is complex.
+    * @param elapsed the elapsed time in ms of handshake.
+    * @param ret the error code of handshake.
+    */
+    virtual void on_handshake(bool complex, int64_t elapsed, int ret);
+    /**
+    * dumps the handshakes to sstream in json.
+    */
+    virtual int dumps(std::stringstream& ss);
+private:
+    virtual void sample();
+    static void* refill_thread(void* arg);
+    virtual int cycle();
+};
+
+/**
+* the adaptive MW(merged-write) controller of player, which picks the wait
+* time and min msgs of each write from the measured bitrate and msgs rate of
+* stream, and the bytes queued in socket send buffer(SIOCOUTQ), to deliver
+* the stream in the latency target, that is the mw_latency of vhost.
+* for instance, the audio only stream never waits for SRS_PERF_MW_MIN_MSGS,
+* and the backlogged player of high bitrate stream never writes tiny bytes.
+*/
+class SrsMwController
+{
+private:
+    // the latency target in ms.
+    int target;
+    // for realtime, send when got one+ msgs.
+    bool realtime;
+    // the estimated bitrate in bytes per ms, and msgs per ms of stream.
+    double bytes_rate;
+    double msgs_rate;
+    // the timestamp of last msg sent, -1 for none.
+    int64_t last_timestamp;
+    // the bytes queued in socket send buffer, which not acked by peer.
+    int queued;
+    // the picked wait time in ms, and min msgs to wait.
+    int wait_ms;
+    int min_msgs;
+    // the effective batch, the average msgs and bytes of each write.
+    double batch_msgs;
+    double batch_bytes;
+    // the average time in us to send a batch.
+    double send_us;
+public:
+    SrsMwController();
+    virtual ~SrsMwController();
+public:
+    /**
+    * set the latency target, the estimation of stream is kept for reload.
+    * @param target_ms the latency target in ms, the mw_latency of vhost.
+    * @param rt whether realtime, the min_latency of vhost.
+    */
+    virtual void initialize(int target_ms, bool rt);
+    /**
+    * when sent a batch of msgs, update the estimation and pick the next wait.
+    * @param count the msgs sent.
+    * @param bytes the payload bytes of msgs.
+    * @param timestamp the timestamp of last msg.
+    * @param elapsed the time in us to send the batch.
+    * @param outq the bytes queued in socket send buffer after sent.
+    */
+    virtual void on_send(int count, int bytes, int64_t timestamp, int64_t elapsed, int outq);
+    /**
+    * the wait time in ms and min msgs for consumer.
+    */
+    virtual int wait();
+    virtual int msgs();
+    /**
+    * the effective batch and send latency, for report.
+    */
+    virtual int batch();
+    virtual int batch_size();
+    virtual int send_latency();
+    virtual int kbps();
+private:
+    virtual void pick();
+};
+
 /**
 * the client provides the main logic control for RTMP clients.
 */
@@ -83,6 +216,8 @@ private:
     int mw_sleep;
     // the MR(merged-write) only enabled for play.
     int mw_enabled;
+    // the adaptive MR(merged-write) for player, NULL when disabled.
+    SrsMwController* mw;
     // for realtime
     // @see https://github.com/ossrs/srs/issues/257
     bool realtime;
@@ -96,11 +231,19 @@ private:
     bool tcp_nodelay;
     // The type of client, play or publish.
     SrsRtmpConnType client_type;
+    // whether the relay of workers, which other worker proxies the client to,
+    // the hooks, security and stat are done by the proxy worker for the client.
+    bool relay;
 public:
     SrsRtmpConn(SrsServer* svr, st_netfd_t c);
     virtual ~SrsRtmpConn();
 public:
     virtual void dispose();
+    /**
+    * mark the connection as the relay of workers,
+    * accepted by the local listener of worker.
+    */
+    virtual void set_relay();
 protected:
     virtual int do_cycle();
 // interface ISrsReloadHandler
@@ -134,6 +277,7 @@ private:
     virtual int process_publish_message(SrsSource* source, SrsCommonMessage* msg, bool vhost_is_edge);
     virtual int process_play_control_msg(SrsConsumer* consumer, SrsCommonMessage* msg);
     virtual void change_mw_sleep(int sleep_ms);
+    virtual void change_mw_adaptive(bool adaptive);
     virtual void set_sock_options();
 private:
     virtual int check_edge_token_traverse_auth();
@@ -48,6 +48,10 @@ using namespace std;
 #include <srs_app_statistic.hpp>
 #include <srs_app_caster_flv.hpp>
 #include <srs_core_mem_watch.hpp>
+#include <srs_kernel_slab.hpp>
+#include <srs_app_worker.hpp>
+#include <srs_app_async_io.hpp>
+#include <srs_app_http_hooks.hpp>
 
 // signal defines.
 #define SIGNAL_RELOAD SIGHUP
@@ -109,6 +113,8 @@ std::string srs_listener_type2string(SrsListenerType type)
         return "RTSP";
     case SrsListenerFlv:
         return "HTTP-FLV";
+    case SrsListenerRtmpWorker:
+        return "RTMP-Worker";
     default:
         return "UNKONWN";
     }
@@ -548,6 +554,7 @@ void SrsServer::dispose()
     
     // prevent fresh clients.
     close_listeners(SrsListenerRtmpStream);
+    close_listeners(SrsListenerRtmpWorker);
     close_listeners(SrsListenerHttpApi);
     close_listeners(SrsListenerHttpStream);
     close_listeners(SrsListenerMpegTsOverUdp);
@@ -563,6 +570,7 @@ void SrsServer::dispose()
 
 #ifdef SRS_AUTO_MEM_WATCH
     srs_memory_report();
+    SrsObjectPool::report();
 #endif
 }
 
@@ -611,6 +619,11 @@ int SrsServer::initialize(ISrsServerCycle* cycle_handler)
     // ensure the time is ok.
     srs_update_system_time_ms();
     
+#ifdef SRS_PERF_MSG_POOL
+    // the server only use st threads, alloc the messages from pools.
+    SrsObjectPool::enable();
+#endif
+    
     // for the main objects(server, config, log, context),
     // never subscribe handler in constructor,
     // instead, subscribe handler in initialize method.
@@ -675,6 +688,11 @@ int SrsServer::initialize_st()
     // set current log id.
     _srs_context->generate_id();
     
+    // the worker quit when master quit, the parent is the master.
+    if (srs_worker_index() >= 0) {
+        ppid = ::getppid();
+    }
+    
     // check asprocess.
     bool asprocess = _srs_config->get_asprocess();
     if (asprocess && ppid == 1) {
@@ -682,8 +700,36 @@ int SrsServer::initialize_st()
         srs_error("for asprocess, ppid should never be init(1), ret=%d", ret);
         return ret;
     }
-    srs_trace("server main cid=%d, pid=%d, ppid=%d, asprocess=%d",
-        _srs_context->get_id(), ::getpid(), ppid, asprocess);
+    srs_trace("server main cid=%d, pid=%d, ppid=%d, asprocess=%d, worker=%d",
+        _srs_context->get_id(), ::getpid(), ppid, asprocess, srs_worker_index());
+    
+    // start the async io pool, after the workers forked.
+    if (_srs_config->get_async_io_enabled()) {
+        int threads = _srs_config->get_async_io_threads();
+        int max_pending = _srs_config->get_async_io_max_pending() * 1024;
+        if ((ret = SrsAsyncIo::instance()->initialize(threads, max_pending)) != ERROR_SUCCESS) {
+            srs_error("initialize async io failed. ret=%d", ret);
+            return ret;
+        }
+    }
+    
+#ifdef SRS_AUTO_HTTP_CALLBACK
+    // start the http hooks pool, after the workers forked.
+    int max_connections = _srs_config->get_hooks_pool_max_connections();
+    bool async_notify = _srs_config->get_hooks_pool_async_notify();
+    if ((ret = SrsHttpHooksDispatcher::instance()->initialize(max_connections, async_notify)) != ERROR_SUCCESS) {
+        srs_error("initialize http hooks pool failed. ret=%d", ret);
+        return ret;
+    }
+#endif
+    
+    // start the refiller of handshake keys, after the workers forked.
+    int dh_pool = _srs_config->get_handshake_dh_pool();
+    bool overload = _srs_config->get_handshake_overload();
+    if ((ret = SrsRtmpHandshakes::instance()->initialize(dh_pool, overload)) != ERROR_SUCCESS) {
+        srs_error("initialize rtmp handshakes failed. ret=%d", ret);
+        return ret;
+    }
     
     return ret;
 }
@@ -843,6 +889,12 @@ int SrsServer::http_handle()
     if ((ret = http_api_mux->handle("/api/v1/features", new SrsGoApiFeatures())) != ERROR_SUCCESS) {
         return ret;
     }
+    if ((ret = http_api_mux->handle("/api/v1/origins", new SrsGoApiOrigins())) != ERROR_SUCCESS) {
+        return ret;
+    }
+    if ((ret = http_api_mux->handle("/api/v1/handshakes", new SrsGoApiHandshakes())) != ERROR_SUCCESS) {
+        return ret;
+    }
     if ((ret = http_api_mux->handle("/api/v1/vhosts/", new SrsGoApiVhosts())) != ERROR_SUCCESS) {
         return ret;
     }
@@ -892,6 +944,11 @@ int SrsServer::ingest()
 {
     int ret = ERROR_SUCCESS;
     
+    // only the first worker ingest streams, which publish to any worker.
+    if (srs_worker_index() > 0) {
+        return ret;
+    }
+    
 #ifdef SRS_AUTO_INGEST
     if ((ret = ingester->start()) != ERROR_SUCCESS) {
         srs_error("start ingest streams failed. ret=%d", ret);
@@ -921,6 +978,12 @@ int SrsServer::cycle()
     dispose();
     srs_trace("srs terminated");
     
+    // wait for the logs and files pending in async io pool.
+    int left = SrsAsyncIo::instance()->drain(SRS_ASYNC_IO_DRAIN_TIMEOUT_MS);
+    if (left > 0) {
+        srs_warn("async io drain timeout, %d tasks lost", left);
+    }
+    
     // for valgrind to detect.
     srs_freep(_srs_config);
     srs_freep(_srs_log);
@@ -969,6 +1032,7 @@ void SrsServer::on_signal(int signo)
         srs_trace("user terminate program");
 #ifdef SRS_AUTO_MEM_WATCH
         srs_memory_report();
+        SrsObjectPool::report();
 #endif
         exit(0);
 #endif
@@ -999,8 +1063,8 @@ int SrsServer::do_cycle()
     max = srs_max(max, SRS_SYS_NETWORK_RTMP_SERVER_RESOLUTION_TIMES);
 #endif
     
-    // for asprocess.
-    bool asprocess = _srs_config->get_asprocess();
+    // for asprocess, or worker which quit when master quit.
+    bool asprocess = _srs_config->get_asprocess() || srs_worker_index() >= 0;
     
     // the deamon thread, update the time cache
     while (true) {
@@ -1096,7 +1160,7 @@ int SrsServer::do_cycle()
                 resample_kbps();
             }
     #ifdef SRS_AUTO_HTTP_CORE
-            if (_srs_config->get_heartbeat_enabled()) {
+            if (_srs_config->get_heartbeat_enabled() && srs_worker_index() <= 0) {
                 if ((i % heartbeat_max_resolution) == 0) {
                     srs_info("do http heartbeat, for internal server to report.");
                     http_heartbeat->heartbeat();
@@ -1136,6 +1200,20 @@ int SrsServer::listen_rtmp()
         }
     }
     
+    // the local listener of worker, for other workers to play from or publish to
+    // the streams owned by this worker.
+    close_listeners(SrsListenerRtmpWorker);
+    if (srs_worker_index() >= 0) {
+        SrsListener* listener = new SrsStreamListener(this, SrsListenerRtmpWorker);
+        listeners.push_back(listener);
+        
+        int port = srs_worker_local_port(srs_worker_index());
+        if ((ret = listener->listen(SRS_CONSTS_LOCALHOST, port)) != ERROR_SUCCESS) {
+            srs_error("RTMP worker listen at %s:%d failed. ret=%d", SRS_CONSTS_LOCALHOST, port, ret);
+            return ret;
+        }
+    }
+    
     return ret;
 }
 
@@ -1145,7 +1223,8 @@ int SrsServer::listen_http_api()
     
 #ifdef SRS_AUTO_HTTP_API
     close_listeners(SrsListenerHttpApi);
-    if (_srs_config->get_http_api_enabled()) {
+    // only the first worker serve the http api.
+    if (_srs_config->get_http_api_enabled() && srs_worker_index() <= 0) {
         SrsListener* listener = new SrsStreamListener(this, SrsListenerHttpApi);
         listeners.push_back(listener);
         
@@ -1210,6 +1289,12 @@ int SrsServer::listen_stream_caster()
         SrsListener* listener = NULL;
 
         std::string caster = _srs_config->get_stream_caster_engine(stream_caster);
+        
+        // the udp and rtsp(with rtp udp ports) casters only run in the first worker,
+        // the flv caster is a tcp listener which all workers share.
+        if (srs_worker_index() > 0 && !srs_stream_caster_is_flv(caster)) {
+            continue;
+        }
         if (srs_stream_caster_is_udp(caster)) {
             listener = new SrsUdpCasterListener(this, SrsListenerMpegTsOverUdp, stream_caster);
         } else if (srs_stream_caster_is_rtsp(caster)) {
@@ -1318,6 +1403,10 @@ int SrsServer::accept_client(SrsListenerType type, st_netfd_t client_stfd)
     SrsConnection* conn = NULL;
     if (type == SrsListenerRtmpStream) {
         conn = new SrsRtmpConn(this, client_stfd);
+    } else if (type == SrsListenerRtmpWorker) {
+        SrsRtmpConn* rtmp = new SrsRtmpConn(this, client_stfd);
+        rtmp->set_relay();
+        conn = rtmp;
     } else if (type == SrsListenerHttpApi) {
 #ifdef SRS_AUTO_HTTP_API
         conn = new SrsHttpApi(this, client_stfd, http_api_mux);
@@ -1362,6 +1451,11 @@ int SrsServer::on_reload_listen()
 
 int SrsServer::on_reload_pid()
 {
+    // the pid file is held by master for workers.
+    if (srs_worker_index() >= 0) {
+        return ERROR_SUCCESS;
+    }
+    
     if (pid_fd > 0) {
         ::close(pid_fd);
         pid_fd = -1;
@@ -72,6 +72,9 @@ enum SrsListenerType
     SrsListenerRtsp             = 4,
     // TCP stream, FLV stream over HTTP.
     SrsListenerFlv              = 5,
+    // RTMP relay of workers, the local listener of worker which
+    // other workers play from or publish to.
+    SrsListenerRtmpWorker       = 6,
 };
 
 /**
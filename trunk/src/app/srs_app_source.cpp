@@ -46,6 +46,7 @@ using namespace std;
 #include <srs_app_statistic.hpp>
 #include <srs_core_autofree.hpp>
 #include <srs_rtmp_utility.hpp>
+#include <srs_app_worker.hpp>
 
 #ifdef __INGEST_DYNAMIC__
 #include <srs_app_conn.hpp>
@@ -66,6 +67,10 @@ using namespace std;
 // the time to cleanup source in ms.
 #define SRS_SOURCE_CLEANUP 30000
 
+// when timestamp jump over this, for example, republish,
+// the time of message ring continue from the last time.
+#define SRS_RING_MAX_JUMP_MS 3000
+
 int _srs_time_jitter_string2int(std::string time_jitter)
 {
     if (time_jitter == "full") {
@@ -246,11 +251,112 @@ void SrsFastVector::free()
 }
 #endif
 
+SrsShrinkPolicy::SrsShrinkPolicy()
+{
+    queue_size_ms = 0;
+    smart_shrink = false;
+    wait_keyframe = false;
+    req = NULL;
+}
+
+SrsShrinkPolicy::~SrsShrinkPolicy()
+{
+}
+
+void SrsShrinkPolicy::set_queue_size(double queue_size)
+{
+    queue_size_ms = (int)(queue_size * 1000);
+}
+
+void SrsShrinkPolicy::set_smart_shrink(bool v, SrsRequest* r)
+{
+    smart_shrink = v;
+    req = r;
+    
+    if (!smart_shrink) {
+        wait_keyframe = false;
+    }
+}
+
+int SrsShrinkPolicy::queue_size()
+{
+    return queue_size_ms;
+}
+
+bool SrsShrinkPolicy::smart()
+{
+    return smart_shrink;
+}
+
+bool SrsShrinkPolicy::waiting_keyframe()
+{
+    return wait_keyframe;
+}
+
+bool SrsShrinkPolicy::drop_video(bool sequence_header, bool keyframe, bool disposable, int duration, int* reasons)
+{
+    if (!smart_shrink || sequence_header) {
+        return false;
+    }
+    
+    if (keyframe) {
+        wait_keyframe = false;
+        return false;
+    }
+    
+    SrsStatisticDropReason reason;
+    if (wait_keyframe) {
+        reason = SrsStatisticDropReasonWaitKeyframe;
+    } else if (disposable && duration > queue_size_ms / 2) {
+        // the queue is congested, drop the frame which no frame refer to.
+        reason = SrsStatisticDropReasonDisposable;
+    } else {
+        return false;
+    }
+    
+    if (reasons) {
+        reasons[reason]++;
+    } else if (req) {
+        SrsStatistic* stat = SrsStatistic::instance();
+        stat->on_queue_drop(req, reason, 1);
+    }
+    
+    return true;
+}
+
+void SrsShrinkPolicy::on_shrink(bool keyframe, bool video_dropped, int nb_dropped)
+{
+    // the video must resume at keyframe.
+    if (smart_shrink && !keyframe && video_dropped) {
+        wait_keyframe = true;
+    }
+    
+    if (req && nb_dropped > 0) {
+        SrsStatistic* stat = SrsStatistic::instance();
+        SrsStatisticDropReason reason = smart_shrink? SrsStatisticDropReasonGop : SrsStatisticDropReasonAll;
+        stat->on_queue_drop(req, reason, nb_dropped);
+    }
+}
+
+void SrsShrinkPolicy::on_dropped(int* reasons)
+{
+    if (!req) {
+        return;
+    }
+    
+    SrsStatistic* stat = SrsStatistic::instance();
+    for (int i = 0; i < SrsStatisticDropReasonMax; i++) {
+        if (reasons[i] > 0) {
+            stat->on_queue_drop(req, (SrsStatisticDropReason)i, reasons[i]);
+        }
+    }
+}
+
 SrsMessageQueue::SrsMessageQueue(bool ignore_shrink)
 {
     _ignore_shrink = ignore_shrink;
-    queue_size_ms = 0;
     av_start_time = av_end_time = -1;
+    nal_length_size = 0;
 }
 
 SrsMessageQueue::~SrsMessageQueue()
@@ -270,13 +376,35 @@ int SrsMessageQueue::duration()
 
 void SrsMessageQueue::set_queue_size(double queue_size)
 {
-    queue_size_ms = (int)(queue_size * 1000);
+    policy.set_queue_size(queue_size);
+}
+
+void SrsMessageQueue::set_smart_shrink(bool v, SrsRequest* r)
+{
+    policy.set_smart_shrink(v, r);
 }
 
 int SrsMessageQueue::enqueue(SrsSharedPtrMessage* msg, bool* is_overflow)
 {
     int ret = ERROR_SUCCESS;
     
+    if (policy.smart() && msg->is_video()) {
+        char* payload = msg->payload;
+        int size = msg->size;
+        
+        bool sh = SrsFlvCodec::video_is_sequence_header(payload, size);
+        if (sh) {
+            nal_length_size = SrsFlvCodec::video_nal_length_size(payload, size);
+        }
+        bool keyframe = !sh && SrsFlvCodec::video_is_keyframe(payload, size);
+        bool disposable = !sh && !keyframe && SrsFlvCodec::video_is_disposable(payload, size, nal_length_size);
+        
+        if (policy.drop_video(sh, keyframe, disposable, (int)(av_end_time - av_start_time), NULL)) {
+            srs_freep(msg);
+            return ret;
+        }
+    }
+    
     if (msg->is_av()) {
         if (av_start_time == -1) {
             av_start_time = msg->timestamp;
@@ -287,13 +415,17 @@ int SrsMessageQueue::enqueue(SrsSharedPtrMessage* msg, bool* is_overflow)
     
     msgs.push_back(msg);
 
-    while (av_end_time - av_start_time > queue_size_ms) {
+    while (av_end_time - av_start_time > policy.queue_size()) {
         // notice the caller queue already overflow and shrinked.
         if (is_overflow) {
             *is_overflow = true;
         }
         
-        shrink();
+        if (policy.smart()) {
+            shrink_smart();
+        } else {
+            shrink();
+        }
     }
     
     return ret;
@@ -393,10 +525,116 @@ void SrsMessageQueue::shrink()
     
     if (_ignore_shrink) {
         srs_info("shrink the cache queue, size=%d, removed=%d, max=%.2f", 
-            (int)msgs.size(), msgs_size - (int)msgs.size(), queue_size_ms / 1000.0);
+            (int)msgs.size(), msgs_size - (int)msgs.size(), policy.queue_size() / 1000.0);
     } else {
         srs_trace("shrink the cache queue, size=%d, removed=%d, max=%.2f", 
-            (int)msgs.size(), msgs_size - (int)msgs.size(), queue_size_ms / 1000.0);
+            (int)msgs.size(), msgs_size - (int)msgs.size(), policy.queue_size() / 1000.0);
+    }
+    
+    policy.on_shrink(false, true, msgs_size - (int)msgs.size());
+}
+
+void SrsMessageQueue::shrink_smart()
+{
+    int nb_msgs = (int)msgs.size();
+    SrsSharedPtrMessage** omsgs = msgs.data();
+    
+    // find the keyframe to resume, which must after the first frame,
+    // so each shrink drops at least the first gop.
+    int start = 0;
+    while (start < nb_msgs) {
+        SrsSharedPtrMessage* msg = omsgs[start];
+        if (!(msg->is_video() && SrsFlvCodec::video_is_sequence_header(msg->payload, msg->size))
+            && !(msg->is_audio() && SrsFlvCodec::audio_is_sequence_header(msg->payload, msg->size))
+        ) {
+            break;
+        }
+        start++;
+    }
+    
+    int keyframe = -1;
+    for (int i = start + 1; i < nb_msgs; i++) {
+        SrsSharedPtrMessage* msg = omsgs[i];
+        if (msg->is_video() && SrsFlvCodec::video_is_keyframe(msg->payload, msg->size)
+            && !SrsFlvCodec::video_is_sequence_header(msg->payload, msg->size)
+        ) {
+            keyframe = i;
+            break;
+        }
+    }
+    
+    // keep the audio in the queue size, for the audio is continuous
+    // whatever the gop is dropped or not.
+    int64_t deadline = av_end_time - policy.queue_size();
+    
+    SrsSharedPtrMessage* video_sh = NULL;
+    SrsSharedPtrMessage* audio_sh = NULL;
+    std::vector<SrsSharedPtrMessage*> left;
+    int nb_dropped = 0;
+    bool video_dropped = false;
+    
+    for (int i = 0; i < nb_msgs; i++) {
+        SrsSharedPtrMessage* msg = omsgs[i];
+        
+        if (keyframe >= 0 && i >= keyframe) {
+            left.push_back(msg);
+            continue;
+        }
+        
+        // always keep the last sequence header.
+        if (msg->is_video() && SrsFlvCodec::video_is_sequence_header(msg->payload, msg->size)) {
+            srs_freep(video_sh);
+            video_sh = msg;
+            continue;
+        }
+        if (msg->is_audio() && SrsFlvCodec::audio_is_sequence_header(msg->payload, msg->size)) {
+            srs_freep(audio_sh);
+            audio_sh = msg;
+            continue;
+        }
+        
+        if (!msg->is_video() && msg->timestamp >= deadline) {
+            left.push_back(msg);
+            continue;
+        }
+        
+        video_dropped = video_dropped || msg->is_video();
+        nb_dropped++;
+        srs_freep(msg);
+    }
+    msgs.clear();
+    
+    // the video must resume at keyframe.
+    policy.on_shrink(keyframe >= 0, video_dropped, nb_dropped);
+    
+    // update av_start_time to the first left av.
+    av_start_time = av_end_time;
+    for (int i = 0; i < (int)left.size(); i++) {
+        if (left.at(i)->is_av()) {
+            av_start_time = left.at(i)->timestamp;
+            break;
+        }
+    }
+    
+    // push_back sequence header and update timestamp
+    if (video_sh) {
+        video_sh->timestamp = av_start_time;
+        msgs.push_back(video_sh);
+    }
+    if (audio_sh) {
+        audio_sh->timestamp = av_start_time;
+        msgs.push_back(audio_sh);
+    }
+    for (int i = 0; i < (int)left.size(); i++) {
+        msgs.push_back(left.at(i));
+    }
+    
+    if (_ignore_shrink) {
+        srs_info("smart shrink the cache queue, size=%d, removed=%d, max=%.2f, wait_keyframe=%d",
+            (int)msgs.size(), nb_dropped, policy.queue_size() / 1000.0, policy.waiting_keyframe());
+    } else {
+        srs_trace("smart shrink the cache queue, size=%d, removed=%d, max=%.2f, wait_keyframe=%d",
+            (int)msgs.size(), nb_dropped, policy.queue_size() / 1000.0, policy.waiting_keyframe());
     }
 }
 
@@ -426,9 +664,290 @@ ISrsWakable::~ISrsWakable()
 {
 }
 
-SrsConsumer::SrsConsumer(SrsSource* s, SrsConnection* c)
+SrsMessageRing::SrsMessageRing()
+{
+    capacity = SRS_PERF_QUEUE_RING_MSGS;
+    slots = new SrsRingSlot[capacity];
+    head = tail = 0;
+    queue_size_ms = 0;
+    
+    last_timestamp = -1;
+    time_base = 0;
+    last_time = 0;
+    
+    sh_video = sh_audio = NULL;
+    sh_video_seq = sh_audio_seq = -1;
+    nal_length_size = 0;
+    
+#ifdef SRS_PERF_QUEUE_COND_WAIT
+    wake_seq = wake_time = 0;
+#endif
+}
+
+SrsMessageRing::~SrsMessageRing()
+{
+    clear();
+    srs_freepa(slots);
+}
+
+void SrsMessageRing::set_queue_size(double queue_size)
+{
+    queue_size_ms = (int)(queue_size * 1000);
+}
+
+int64_t SrsMessageRing::begin()
+{
+    return head;
+}
+
+int64_t SrsMessageRing::end()
+{
+    return tail;
+}
+
+bool SrsMessageRing::full()
+{
+    return tail - head >= capacity;
+}
+
+SrsRingSlot* SrsMessageRing::at(int64_t seq)
+{
+    srs_assert(seq >= head && seq < tail);
+    return &slots[seq & (capacity - 1)];
+}
+
+int SrsMessageRing::duration(int64_t cursor)
+{
+    if (cursor >= tail) {
+        return 0;
+    }
+    
+    // from the last message the consumer read.
+    int64_t from = srs_max(cursor - 1, head);
+    return (int)(last_time - at(from)->time);
+}
+
+int SrsMessageRing::enqueue(SrsSharedPtrMessage* msg, bool atc, SrsRtmpJitterAlgorithm ag)
+{
+    int ret = ERROR_SUCCESS;
+    
+    // drop the messages out of queue size,
+    // the consumer lagging will jump over them.
+    if (full()) {
+        while (head < tail && last_time - at(head)->time > queue_size_ms) {
+            srs_freep(at(head)->msg);
+            head++;
+        }
+    }
+    
+    // some consumer lagging in queue size, grow it.
+    if (full()) {
+        if (capacity < SRS_PERF_QUEUE_RING_MAX_MSGS) {
+            grow();
+        } else {
+            srs_freep(at(head)->msg);
+            head++;
+        }
+    }
+    
+    // the monotonically time, continue when timestamp jump.
+    if (msg->is_av()) {
+        int64_t delta = msg->timestamp - last_timestamp;
+        if (last_timestamp == -1 || delta > SRS_RING_MAX_JUMP_MS || delta < -SRS_RING_MAX_JUMP_MS) {
+            time_base = last_time - msg->timestamp;
+        }
+        last_timestamp = msg->timestamp;
+        last_time = srs_max(last_time, time_base + msg->timestamp);
+    }
+    
+    SrsRingSlot* slot = &slots[tail & (capacity - 1)];
+    slot->msg = msg->copy();
+    slot->time = last_time;
+    slot->atc = atc;
+    slot->ag = ag;
+    slot->sequence_header = false;
+    slot->keyframe = false;
+    slot->disposable = false;
+    
+    char* payload = msg->payload;
+    int size = msg->size;
+    if (msg->is_video()) {
+        slot->sequence_header = SrsFlvCodec::video_is_sequence_header(payload, size);
+        if (slot->sequence_header) {
+            srs_freep(sh_video);
+            sh_video = msg->copy();
+            sh_video_seq = tail;
+            nal_length_size = SrsFlvCodec::video_nal_length_size(payload, size);
+        } else if (SrsFlvCodec::video_is_keyframe(payload, size)) {
+            slot->keyframe = true;
+        } else {
+            slot->disposable = SrsFlvCodec::video_is_disposable(payload, size, nal_length_size);
+        }
+    } else if (msg->is_audio()) {
+        slot->sequence_header = SrsFlvCodec::audio_is_sequence_header(payload, size);
+        if (slot->sequence_header) {
+            srs_freep(sh_audio);
+            sh_audio = msg->copy();
+            sh_audio_seq = tail;
+        }
+    }
+    
+    tail++;
+    
+#ifdef SRS_PERF_QUEUE_COND_WAIT
+    // only check the waiters when the earliest one is ok,
+    // and wakeup the consumers whose own seq and time ok,
+    // the others keep waiting for a full batch.
+    if (!waiters.empty() && tail > wake_seq && last_time > wake_time) {
+        std::vector<SrsRingWaiter> consumers;
+        consumers.swap(waiters);
+        
+        std::vector<SrsRingWaiter>::iterator it;
+        for (it = consumers.begin(); it != consumers.end(); ++it) {
+            SrsRingWaiter& waiter = *it;
+            if (tail > waiter.seq && last_time > waiter.time) {
+                waiter.consumer->wakeup();
+            } else {
+                add_waiter(waiter);
+            }
+        }
+    }
+#endif
+    
+    return ret;
+}
+
+void SrsMessageRing::reclaim(int64_t cursor)
+{
+    cursor = srs_min(cursor, tail);
+    
+    while (head < cursor) {
+        srs_freep(at(head)->msg);
+        head++;
+    }
+}
+
+void SrsMessageRing::clear()
+{
+    reclaim(tail);
+    
+    srs_freep(sh_video);
+    srs_freep(sh_audio);
+    sh_video_seq = sh_audio_seq = -1;
+    nal_length_size = 0;
+    
+#ifdef SRS_PERF_QUEUE_COND_WAIT
+    waiters.clear();
+#endif
+}
+
+int64_t SrsMessageRing::find_keyframe(int64_t cursor)
+{
+    for (int64_t seq = srs_max(cursor, head); seq < tail; seq++) {
+        SrsRingSlot* slot = at(seq);
+        if (slot->keyframe && last_time - slot->time <= queue_size_ms) {
+            return seq;
+        }
+    }
+    
+    return -1;
+}
+
+int64_t SrsMessageRing::find_in_queue(int64_t cursor)
+{
+    int64_t seq = srs_max(cursor, head);
+    for (; seq < tail; seq++) {
+        if (last_time - at(seq)->time <= queue_size_ms) {
+            break;
+        }
+    }
+    
+    return seq;
+}
+
+SrsSharedPtrMessage* SrsMessageRing::video_sh_in(int64_t from, int64_t to)
+{
+    if (sh_video && sh_video_seq >= from && sh_video_seq < to) {
+        return sh_video;
+    }
+    return NULL;
+}
+
+SrsSharedPtrMessage* SrsMessageRing::audio_sh_in(int64_t from, int64_t to)
+{
+    if (sh_audio && sh_audio_seq >= from && sh_audio_seq < to) {
+        return sh_audio;
+    }
+    return NULL;
+}
+
+#ifdef SRS_PERF_QUEUE_COND_WAIT
+void SrsMessageRing::wait(ISrsWakable* consumer, int64_t cursor, int nb_msgs, int duration)
+{
+    // the time of last message the consumer read.
+    int64_t time = last_time;
+    int64_t from = srs_max(cursor - 1, head);
+    if (from < tail) {
+        time = at(from)->time;
+    }
+    
+    SrsRingWaiter waiter;
+    waiter.consumer = consumer;
+    waiter.seq = cursor + nb_msgs;
+    waiter.time = time + duration;
+    add_waiter(waiter);
+}
+
+void SrsMessageRing::unwait(ISrsWakable* consumer)
+{
+    std::vector<SrsRingWaiter>::iterator it;
+    for (it = waiters.begin(); it != waiters.end(); ++it) {
+        if (it->consumer == consumer) {
+            waiters.erase(it);
+            break;
+        }
+    }
+}
+
+int SrsMessageRing::nb_waiters()
+{
+    return (int)waiters.size();
+}
+
+void SrsMessageRing::add_waiter(SrsRingWaiter& waiter)
+{
+    if (waiters.empty()) {
+        wake_seq = waiter.seq;
+        wake_time = waiter.time;
+    } else {
+        wake_seq = srs_min(wake_seq, waiter.seq);
+        wake_time = srs_min(wake_time, waiter.time);
+    }
+    
+    waiters.push_back(waiter);
+}
+#endif
+
+void SrsMessageRing::grow()
+{
+    int size = capacity * 2;
+    SrsRingSlot* buf = new SrsRingSlot[size];
+    for (int64_t seq = head; seq < tail; seq++) {
+        buf[seq & (size - 1)] = slots[seq & (capacity - 1)];
+    }
+    srs_trace("message ring increase %d=>%d", capacity, size);
+    
+    // use new array.
+    srs_freepa(slots);
+    slots = buf;
+    capacity = size;
+}
+
+SrsConsumer::SrsConsumer(SrsSource* s, SrsMessageRing* r, SrsConnection* c)
 {
     source = s;
+    ring = r;
+    cursor = ring->end();
     conn = c;
     paused = false;
     jitter = new SrsRtmpJitter();
@@ -467,6 +986,13 @@ void SrsConsumer::close_connection()
 void SrsConsumer::set_queue_size(double queue_size)
 {
     queue->set_queue_size(queue_size);
+    policy.set_queue_size(queue_size);
+}
+
+void SrsConsumer::set_smart_shrink(bool v, SrsRequest* r)
+{
+    queue->set_smart_shrink(v, r);
+    policy.set_smart_shrink(v, r);
 }
 
 void SrsConsumer::update_source_id()
@@ -474,6 +1000,11 @@ void SrsConsumer::update_source_id()
     should_update_source_id = true;
 }
 
+int64_t SrsConsumer::get_cursor()
+{
+    return cursor;
+}
+
 int SrsConsumer::get_time()
 {
     return jitter->get_time();
@@ -549,12 +1080,28 @@ int SrsConsumer::dump_packets(SrsMessageArray* msgs, int& count)
     if (paused) {
         return ret;
     }
+    
+    // lagging behind the ring, jump over the messages out of queue size.
+    if (cursor < ring->begin() || ring->duration(cursor) > policy.queue_size()) {
+        if ((ret = jump()) != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
 
     // pump msgs from queue.
     if ((ret = queue->dump_packets(max, msgs->msgs, count)) != ERROR_SUCCESS) {
         return ret;
     }
     
+    // pump msgs from ring.
+    if (count < max) {
+        int nb_msgs = 0;
+        if ((ret = dump_ring(max - count, msgs->msgs + count, nb_msgs)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        count += nb_msgs;
+    }
+    
     return ret;
 }
 
@@ -569,19 +1116,23 @@ void SrsConsumer::wait(int nb_msgs, int duration)
     mw_min_msgs = nb_msgs;
     mw_duration = duration;
 
-    int duration_ms = queue->duration();
-    bool match_min_msgs = queue->size() > mw_min_msgs;
+    int duration_ms = srs_max(queue->duration(), ring->duration(cursor));
+    bool match_min_msgs = queue->size() + (int)(ring->end() - cursor) > mw_min_msgs;
     
     // when duration ok, signal to flush.
     if (match_min_msgs && duration_ms > mw_duration) {
         return;
     }
     
-    // the enqueue will notify this cond.
+    // the enqueue of ring will notify this cond.
     mw_waiting = true;
+    ring->wait(this, cursor, nb_msgs, duration);
     
     // use cond block wait for high performance mode.
     st_cond_wait(mw_wait);
+    
+    // maybe wakeup by others, never notify by ring.
+    ring->unwait(this);
 }
 #endif
 
@@ -595,6 +1146,96 @@ int SrsConsumer::on_play_client_pause(bool is_pause)
     return ret;
 }
 
+int SrsConsumer::dump_ring(int max_count, SrsSharedPtrMessage** pmsgs, int& count)
+{
+    int ret = ERROR_SUCCESS;
+    
+    int reasons[SrsStatisticDropReasonMax];
+    memset(reasons, 0, sizeof(reasons));
+    
+    int64_t end = ring->end();
+    for (; cursor < end && count < max_count; cursor++) {
+        SrsRingSlot* slot = ring->at(cursor);
+        
+        if (slot->msg->is_video() && policy.drop_video(slot->sequence_header,
+            slot->keyframe, slot->disposable, ring->duration(cursor), reasons)
+        ) {
+            continue;
+        }
+        
+        // copy the message, for the timestamp of each consumer is different.
+        SrsSharedPtrMessage* msg = slot->msg->copy();
+        if (!slot->atc) {
+            if ((ret = jitter->correct(msg, slot->ag)) != ERROR_SUCCESS) {
+                srs_freep(msg);
+                break;
+            }
+        }
+        
+        pmsgs[count++] = msg;
+    }
+    
+    policy.on_dropped(reasons);
+    
+    return ret;
+}
+
+int SrsConsumer::jump()
+{
+    int ret = ERROR_SUCCESS;
+    
+    int64_t from = cursor;
+    int64_t to = ring->end();
+    
+    // all messages dropped, resume at the end.
+    if (ring->begin() >= to) {
+        cursor = to;
+        return ret;
+    }
+    
+    // the last message to jump, for the atc and jitter of sequence headers.
+    SrsRingSlot* last = ring->at(to - 1);
+    
+    // the smart shrink resume at the keyframe in queue size,
+    // when no keyframe, keep the audio in queue size and wait for keyframe.
+    bool keyframe = false;
+    if (policy.smart()) {
+        int64_t start = srs_max(cursor, ring->begin());
+        to = ring->find_keyframe(start);
+        keyframe = (to >= 0);
+        if (!keyframe) {
+            to = ring->find_in_queue(start);
+        }
+    }
+    
+    // the messages before begin are dropped by ring, maybe video.
+    bool video_dropped = (from < ring->begin());
+    for (int64_t seq = srs_max(from, ring->begin()); seq < to && !video_dropped; seq++) {
+        SrsRingSlot* slot = ring->at(seq);
+        video_dropped = slot->msg->is_video() && !slot->sequence_header;
+    }
+    
+    // resend the sequence headers jumped over.
+    SrsSharedPtrMessage* video_sh = ring->video_sh_in(from, to);
+    if (video_sh && (ret = enqueue(video_sh, last->atc, last->ag)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    SrsSharedPtrMessage* audio_sh = ring->audio_sh_in(from, to);
+    if (audio_sh && (ret = enqueue(audio_sh, last->atc, last->ag)) != ERROR_SUCCESS) {
+        return ret;
+    }
+    
+    cursor = to;
+    
+    int nb_dropped = (int)(to - from);
+    policy.on_shrink(keyframe, video_dropped, nb_dropped);
+    
+    srs_trace("consumer jump over the ring, removed=%d, max=%.2f, smart=%d, wait_keyframe=%d",
+        nb_dropped, policy.queue_size() / 1000.0, policy.smart(), policy.waiting_keyframe());
+    
+    return ret;
+}
+
 void SrsConsumer::wakeup()
 {
 #ifdef SRS_PERF_QUEUE_COND_WAIT
@@ -997,6 +1638,7 @@ SrsSource::SrsSource()
     jitter_algorithm = SrsRtmpJitterAlgorithmOFF;
     mix_correct = false;
     mix_queue = new SrsMixQueue();
+    demuxer = NULL;
     
 #ifdef SRS_AUTO_HLS
     hls = new SrsHls();
@@ -1027,12 +1669,14 @@ SrsSource::SrsSource()
     publish_edge = new SrsPublishEdge();
     gop_cache = new SrsGopCache();
     aggregate_stream = new SrsStream();
+    ring = new SrsMessageRing();
     
     is_monotonically_increase = false;
     last_packet_time = 0;
     
     _srs_config->subscribe(this);
     atc = false;
+    settings = NULL;
 }
 
 SrsSource::~SrsSource()
@@ -1053,6 +1697,7 @@ SrsSource::~SrsSource()
     }
     
     srs_freep(mix_queue);
+    srs_freep(demuxer);
     srs_freep(cache_metadata);
     srs_freep(cache_sh_video);
     srs_freep(cache_sh_audio);
@@ -1061,6 +1706,7 @@ SrsSource::~SrsSource()
     srs_freep(publish_edge);
     srs_freep(gop_cache);
     srs_freep(aggregate_stream);
+    srs_freep(ring);
     
 #ifdef SRS_AUTO_HLS
     srs_freep(hls);
@@ -1140,7 +1786,8 @@ int SrsSource::initialize(SrsRequest* r, ISrsSourceHandler* h)
 
     handler = h;
     _req = r->copy();
-    atc = _srs_config->get_atc(_req->vhost);
+    settings = _srs_config->get_vhost_settings(_req->vhost);
+    atc = settings->atc;
 
 #ifdef SRS_AUTO_HLS
     if ((ret = hls->initialize(this, _req)) != ERROR_SUCCESS) {
@@ -1163,6 +1810,7 @@ int SrsSource::initialize(SrsRequest* r, ISrsSourceHandler* h)
     
     double queue_size = _srs_config->get_queue_length(_req->vhost);
     publish_edge->set_queue_size(queue_size);
+    ring->set_queue_size(queue_size);
     
     jitter_algorithm = (SrsRtmpJitterAlgorithm)_srs_config->get_time_jitter(_req->vhost);
     mix_correct = _srs_config->get_mix_correct(_req->vhost);
@@ -1224,7 +1872,9 @@ int SrsSource::on_reload_vhost_queue_length(string vhost)
         for (it = consumers.begin(); it != consumers.end(); ++it) {
             SrsConsumer* consumer = *it;
             consumer->set_queue_size(queue_size);
+            consumer->set_smart_shrink(settings->queue_smart_shrink, _req);
         }
+        ring->set_queue_size(queue_size);
 
         srs_trace("consumers reload queue size success.");
     }
@@ -1292,7 +1942,7 @@ int SrsSource::on_reload_vhost_forward(string vhost)
     destroy_forwarders();
     
     // Don't start forwarders when source is not active.
-    if (_can_publish) {
+    if (_can_publish || srs_worker_is_proxy(_req)) {
         return ret;
     }
     
@@ -1318,7 +1968,7 @@ int SrsSource::on_reload_vhost_hls(string vhost)
     hls->on_unpublish();
     
     // Don't start forwarders when source is not active.
-    if (_can_publish) {
+    if (_can_publish || srs_worker_is_proxy(_req)) {
         return ret;
     }
     
@@ -1344,7 +1994,7 @@ int SrsSource::on_reload_vhost_hds(string vhost)
     hds->on_unpublish();
     
     // Don't start forwarders when source is not active.
-    if (_can_publish) {
+    if (_can_publish || srs_worker_is_proxy(_req)) {
         return ret;
     }
     
@@ -1371,7 +2021,7 @@ int SrsSource::on_reload_vhost_dvr(string vhost)
     dvr->on_unpublish();
     
     // Don't start forwarders when source is not active.
-    if (_can_publish) {
+    if (_can_publish || srs_worker_is_proxy(_req)) {
         return ret;
     }
     
@@ -1404,7 +2054,7 @@ int SrsSource::on_reload_vhost_transcode(string vhost)
     encoder->on_unpublish();
     
     // Don't start forwarders when source is not active.
-    if (_can_publish) {
+    if (_can_publish || srs_worker_is_proxy(_req)) {
         return ret;
     }
     
@@ -1607,8 +2257,8 @@ int SrsSource::on_meta_data(SrsCommonMessage* msg, SrsOnMetaDataPacket* metadata
     metadata->metadata->set("server_version", SrsAmf0Any::str(RTMP_SIG_SRS_VERSION));
     
     // if allow atc_auto and bravo-atc detected, open atc for vhost.
-    atc = _srs_config->get_atc(_req->vhost);
-    if (_srs_config->get_atc_auto(_req->vhost)) {
+    atc = settings->atc;
+    if (settings->atc_auto) {
         if ((prop = metadata->metadata->get_property("bravo_atc")) != NULL) {
             if (prop->is_string() && prop->to_str() == "true") {
                 atc = true;
@@ -1633,7 +2283,7 @@ int SrsSource::on_meta_data(SrsCommonMessage* msg, SrsOnMetaDataPacket* metadata
     
     // when already got metadata, drop when reduce sequence header.
     bool drop_for_reduce = false;
-    if (cache_metadata && _srs_config->get_reduce_sequence_header(_req->vhost)) {
+    if (cache_metadata && settings->reduce_sequence_header) {
         drop_for_reduce = true;
         srs_warn("drop for reduce sh metadata, size=%d", msg->size);
     }
@@ -1652,13 +2302,9 @@ int SrsSource::on_meta_data(SrsCommonMessage* msg, SrsOnMetaDataPacket* metadata
     
     // copy to all consumer
     if (!drop_for_reduce) {
-        std::vector<SrsConsumer*>::iterator it;
-        for (it = consumers.begin(); it != consumers.end(); ++it) {
-            SrsConsumer* consumer = *it;
-            if ((ret = consumer->enqueue(cache_metadata, atc, jitter_algorithm)) != ERROR_SUCCESS) {
-                srs_error("dispatch the metadata failed. ret=%d", ret);
-                return ret;
-            }
+        if ((ret = copy_to_consumers(cache_metadata)) != ERROR_SUCCESS) {
+            srs_error("dispatch the metadata failed. ret=%d", ret);
+            return ret;
         }
     }
     
@@ -1747,12 +2393,18 @@ int SrsSource::on_audio_imp(SrsSharedPtrMessage* msg)
     int ret = ERROR_SUCCESS;
     
     srs_info("Audio dts=%"PRId64", size=%d", msg->timestamp, msg->size);
+    
+    // demux once for all muxers, before copy the msg to them.
+    if (demuxer && !msg->frame()) {
+        msg->set_frame(demuxer->demux_audio(msg->payload, msg->size));
+    }
+    
     bool is_aac_sequence_header = SrsFlvCodec::audio_is_sequence_header(msg->payload, msg->size);
     bool is_sequence_header = is_aac_sequence_header;
     
     // whether consumer should drop for the duplicated sequence header.
     bool drop_for_reduce = false;
-    if (is_sequence_header && cache_sh_audio && _srs_config->get_reduce_sequence_header(_req->vhost)) {
+    if (is_sequence_header && cache_sh_audio && settings->reduce_sequence_header) {
         if (cache_sh_audio->size == msg->size) {
             drop_for_reduce = srs_bytes_equals(cache_sh_audio->payload, msg->payload, msg->size);
             srs_warn("drop for reduce sh audio, size=%d", msg->size);
@@ -1792,7 +2444,7 @@ int SrsSource::on_audio_imp(SrsSharedPtrMessage* msg)
     if ((ret = hls->on_audio(msg)) != ERROR_SUCCESS) {
         // apply the error strategy for hls.
         // @see https://github.com/ossrs/srs/issues/264
-        std::string hls_error_strategy = _srs_config->get_hls_on_error(_req->vhost);
+        std::string hls_error_strategy = settings->hls_on_error;
         if (srs_config_hls_is_on_error_ignore(hls_error_strategy)) {
             srs_warn("hls process audio message failed, ignore and disable hls. ret=%d", ret);
             
@@ -1840,13 +2492,9 @@ int SrsSource::on_audio_imp(SrsSharedPtrMessage* msg)
     
     // copy to all consumer
     if (!drop_for_reduce) {
-
-        for (int i = 0; i < (int)consumers.size(); i++) {
-            SrsConsumer* consumer = consumers.at(i);
-            if ((ret = consumer->enqueue(msg, atc, jitter_algorithm)) != ERROR_SUCCESS) {
-                srs_error("dispatch the audio failed. ret=%d", ret);
-                return ret;
-            }
+        if ((ret = copy_to_consumers(msg)) != ERROR_SUCCESS) {
+            srs_error("dispatch the audio failed. ret=%d", ret);
+            return ret;
         }
         srs_info("dispatch audio success.");
     }
@@ -1961,11 +2609,16 @@ int SrsSource::on_video_imp(SrsSharedPtrMessage* msg)
     
     srs_info("Video dts=%"PRId64", size=%d", msg->timestamp, msg->size);
     
+    // demux once for all muxers, before copy the msg to them.
+    if (demuxer && !msg->frame()) {
+        msg->set_frame(demuxer->demux_video(msg->payload, msg->size, settings->parse_sps));
+    }
+    
     bool is_sequence_header = SrsFlvCodec::video_is_sequence_header(msg->payload, msg->size);
     
     // whether consumer should drop for the duplicated sequence header.
     bool drop_for_reduce = false;
-    if (is_sequence_header && cache_sh_video && _srs_config->get_reduce_sequence_header(_req->vhost)) {
+    if (is_sequence_header && cache_sh_video && settings->reduce_sequence_header) {
         if (cache_sh_video->size == msg->size) {
             drop_for_reduce = srs_bytes_equals(cache_sh_video->payload, msg->payload, msg->size);
             srs_warn("drop for reduce sh video, size=%d", msg->size);
@@ -1983,7 +2636,7 @@ int SrsSource::on_video_imp(SrsSharedPtrMessage* msg)
         
         // user can disable the sps parse to workaround when parse sps failed.
         // @see https://github.com/ossrs/srs/issues/474
-        codec.avc_parse_sps = _srs_config->get_parse_sps(_req->vhost);
+        codec.avc_parse_sps = settings->parse_sps;
         
         SrsCodecSample sample;
         if ((ret = codec.video_avc_demux(msg->payload, msg->size, &sample)) != ERROR_SUCCESS) {
@@ -2014,7 +2667,7 @@ int SrsSource::on_video_imp(SrsSharedPtrMessage* msg)
     if ((ret = hls->on_video(msg, is_sequence_header)) != ERROR_SUCCESS) {
         // apply the error strategy for hls.
         // @see https://github.com/ossrs/srs/issues/264
-        std::string hls_error_strategy = _srs_config->get_hls_on_error(_req->vhost);
+        std::string hls_error_strategy = settings->hls_on_error;
         if (srs_config_hls_is_on_error_ignore(hls_error_strategy)) {
             srs_warn("hls process video message failed, ignore and disable hls. ret=%d", ret);
             
@@ -2062,13 +2715,9 @@ int SrsSource::on_video_imp(SrsSharedPtrMessage* msg)
     
     // copy to all consumer
     if (!drop_for_reduce) {
-        
-        for (int i = 0; i < (int)consumers.size(); i++) {
-            SrsConsumer* consumer = consumers.at(i);
-            if ((ret = consumer->enqueue(msg, atc, jitter_algorithm)) != ERROR_SUCCESS) {
-                srs_error("dispatch the video failed. ret=%d", ret);
-                return ret;
-            }
+        if ((ret = copy_to_consumers(msg)) != ERROR_SUCCESS) {
+            srs_error("dispatch the video failed. ret=%d", ret);
+            return ret;
         }
         srs_info("dispatch video success.");
     }
@@ -2110,6 +2759,28 @@ int SrsSource::on_video_imp(SrsSharedPtrMessage* msg)
     return ret;
 }
 
+int SrsSource::copy_to_consumers(SrsSharedPtrMessage* msg)
+{
+    int ret = ERROR_SUCCESS;
+    
+    // no consumer to read the ring.
+    if (consumers.empty()) {
+        return ret;
+    }
+    
+    // reclaim the messages read by all consumers.
+    if (ring->full()) {
+        int64_t cursor = ring->end();
+        for (int i = 0; i < (int)consumers.size(); i++) {
+            SrsConsumer* consumer = consumers.at(i);
+            cursor = srs_min(cursor, consumer->get_cursor());
+        }
+        ring->reclaim(cursor);
+    }
+    
+    return ring->enqueue(msg, atc, jitter_algorithm);
+}
+
 int SrsSource::on_aggregate(SrsCommonMessage* msg)
 {
     int ret = ERROR_SUCCESS;
@@ -2234,26 +2905,37 @@ int SrsSource::on_publish()
     // reset the mix queue.
     mix_queue->clear();
     
+    // demux the frames once when hls or http-ts enabled,
+    // reset it for the codec of stream maybe changed.
+    srs_freep(demuxer);
+    if (settings->hls_enabled || settings->http_ts_enabled) {
+        demuxer = new SrsCodecDemuxer();
+    }
+    
     // detect the monotonically again.
     is_monotonically_increase = true;
     last_packet_time = 0;
     
+    // the worker proxy only relay the stream from the owner worker,
+    // which delivers to the forwarders, transcoders, hls, dvr and hds.
+    bool proxy = srs_worker_is_proxy(_req);
+    
     // create forwarders
-    if ((ret = create_forwarders()) != ERROR_SUCCESS) {
+    if (!proxy && (ret = create_forwarders()) != ERROR_SUCCESS) {
         srs_error("create forwarders failed. ret=%d", ret);
         return ret;
     }
     
     // TODO: FIXME: use initialize to set req.
 #ifdef SRS_AUTO_TRANSCODE
-    if ((ret = encoder->on_publish(_req)) != ERROR_SUCCESS) {
+    if (!proxy && (ret = encoder->on_publish(_req)) != ERROR_SUCCESS) {
         srs_error("start encoder failed. ret=%d", ret);
         return ret;
     }
 #endif
     
 #ifdef SRS_AUTO_HLS
-    if ((ret = hls->on_publish(_req, false)) != ERROR_SUCCESS) {
+    if (!proxy && (ret = hls->on_publish(_req, false)) != ERROR_SUCCESS) {
         srs_error("start hls failed. ret=%d", ret);
         return ret;
     }
@@ -2261,14 +2943,14 @@ int SrsSource::on_publish()
     
     // TODO: FIXME: use initialize to set req.
 #ifdef SRS_AUTO_DVR
-    if ((ret = dvr->on_publish(_req)) != ERROR_SUCCESS) {
+    if (!proxy && (ret = dvr->on_publish(_req)) != ERROR_SUCCESS) {
         srs_error("start dvr failed. ret=%d", ret);
         return ret;
     }
 #endif
 
 #ifdef SRS_AUTO_HDS
-    if ((ret = hds->on_publish(_req)) != ERROR_SUCCESS) {
+    if (!proxy && (ret = hds->on_publish(_req)) != ERROR_SUCCESS) {
         srs_error("start hds failed. ret=%d", ret);
         return ret;
     }
@@ -2339,11 +3021,12 @@ int SrsSource::create_consumer(SrsConnection* conn, SrsConsumer*& consumer, bool
 {
     int ret = ERROR_SUCCESS;
     
-    consumer = new SrsConsumer(this, conn);
+    consumer = new SrsConsumer(this, ring, conn);
     consumers.push_back(consumer);
     
-    double queue_size = _srs_config->get_queue_length(_req->vhost);
+    double queue_size = settings->queue_length;
     consumer->set_queue_size(queue_size);
+    consumer->set_smart_shrink(settings->queue_smart_shrink, _req);
     
     // if atc, update the sequence header to gop cache time.
     if (atc && !gop_cache->empty()) {
@@ -2392,8 +3075,8 @@ int SrsSource::create_consumer(SrsConnection* conn, SrsConsumer*& consumer, bool
         srs_trace("create consumer, ignore gop cache, jitter=%d", jitter_algorithm);
     }
 
-    // for edge, when play edge stream, check the state
-    if (_srs_config->get_vhost_is_edge(_req->vhost)) {
+    // for edge or worker proxy, when play edge stream, check the state
+    if (settings->is_edge || srs_worker_is_proxy(_req)) {
         // notice edge to start for the first client.
         if ((ret = play_edge->on_client_play()) != ERROR_SUCCESS) {
             srs_error("notice edge start play stream failed. ret=%d", ret);
@@ -2436,6 +3119,9 @@ void SrsSource::on_consumer_destroy(SrsConsumer* consumer)
     if (consumers.empty()) {
         play_edge->on_all_client_stop();
         die_at = srs_get_system_time_ms();
+        
+        // no consumer to read the ring.
+        ring->clear();
     }
 }
 
@@ -52,6 +52,8 @@ class SrsRtmpServer;
 class SrsEdgeProxyContext;
 class SrsMessageArray;
 class SrsConnection;
+class SrsVhostSettings;
+class SrsCodecDemuxer;
 #ifdef SRS_AUTO_HLS
 class SrsHls;
 #endif
@@ -132,6 +134,60 @@ public:
 };
 #endif
 
+/**
+* the shrink policy of the message queue and the consumer of ring,
+* which decide the video to drop and when to resume at keyframe,
+* so the queue and the ring always drop the same messages.
+*/
+class SrsShrinkPolicy
+{
+private:
+    int queue_size_ms;
+    // whether use the smart shrink, drop the gops and resume at keyframe.
+    bool smart_shrink;
+    // whether drop the video util keyframe, when smart shrink dropped all video.
+    bool wait_keyframe;
+    // the request to stat the dropped messages, NULL to ignore.
+    SrsRequest* req;
+public:
+    SrsShrinkPolicy();
+    virtual ~SrsShrinkPolicy();
+public:
+    /**
+    * set the queue size
+    * @param queue_size the queue size in seconds.
+    */
+    virtual void set_queue_size(double queue_size);
+    /**
+    * set the shrink policy when queue overflow.
+    * @param v whether use the smart shrink.
+    * @param r the request to stat the dropped messages, NULL to ignore.
+    */
+    virtual void set_smart_shrink(bool v, SrsRequest* r);
+    virtual int queue_size();
+    virtual bool smart();
+    virtual bool waiting_keyframe();
+public:
+    /**
+    * for smart shrink, whether drop the video before send, that is,
+    * the disposable frame when the queue is congested, or the frame before keyframe.
+    * @param duration the duration of messages in queue.
+    * @param reasons the count of dropped reasons to stat later, NULL to stat now.
+    */
+    virtual bool drop_video(bool sequence_header, bool keyframe, bool disposable, int duration, int* reasons);
+    /**
+    * when the queue overflow and shrinked.
+    * @param keyframe whether resume at keyframe, the smart shrink wait for keyframe if not.
+    * @param video_dropped whether the video dropped by shrink.
+    * @param nb_dropped the number of dropped messages to stat.
+    */
+    virtual void on_shrink(bool keyframe, bool video_dropped, int nb_dropped);
+    /**
+    * stat the dropped messages of reasons, @see drop_video().
+    */
+    virtual void on_dropped(int* reasons);
+};
+
 /**
 * the message queue for the consumer(client), forwarder.
 * we limit the size in seconds, drop old messages(the whole gop) if full.
@@ -142,7 +198,10 @@ private:
     bool _ignore_shrink;
     int64_t av_start_time;
     int64_t av_end_time;
-    int queue_size_ms;
+    // the queue size and shrink policy, @see shrink_smart().
+    SrsShrinkPolicy policy;
+    // the size of NALU length from the video sequence header, 0 when unknown.
+    int nal_length_size;
 #ifdef SRS_PERF_QUEUE_FAST_VECTOR
     SrsFastVector msgs;
 #else
@@ -165,6 +224,12 @@ public:
     * @param queue_size the queue size in seconds.
     */
     virtual void set_queue_size(double queue_size);
+    /**
+    * set the shrink policy when queue overflow.
+    * @param v whether use the smart shrink, @see shrink_smart().
+    * @param r the request to stat the dropped messages, NULL to ignore.
+    */
+    virtual void set_smart_shrink(bool v, SrsRequest* r);
 public:
     /**
     * enqueue the message, the timestamp always monotonically.
@@ -190,6 +255,14 @@ private:
     * if no iframe found, clear it.
     */
     virtual void shrink();
+    /**
+    * the smart shrink, remove the first gop from the front and resume at the
+    * next keyframe, the enqueue shrinks again util the queue size ok. if no
+    * keyframe found, remove all video, then wait for the keyframe to resume.
+    * @remark only the audio out of the queue size is dropped, the audio before
+    *       the resume point is kept, and the audio after it is never dropped.
+    */
+    virtual void shrink_smart();
 public:
     /**
      * clear all messages in queue.
@@ -215,6 +288,152 @@ public:
     virtual void wakeup() = 0;
 };
 
+/**
+* the slot of message ring, the flags are parsed once when enqueue,
+* for all consumers to use.
+*/
+struct SrsRingSlot
+{
+    SrsSharedPtrMessage* msg;
+    // the monotonically time in ms, to calc the duration of ring.
+    int64_t time;
+    // the atc and jitter algorithm of source when enqueue.
+    bool atc;
+    SrsRtmpJitterAlgorithm ag;
+    // the flags of message.
+    bool sequence_header;
+    bool keyframe;
+    bool disposable;
+};
+
+#ifdef SRS_PERF_QUEUE_COND_WAIT
+/**
+* the consumer waiting on ring, wakeup when the ring
+* has message after seq, and the time after time.
+*/
+struct SrsRingWaiter
+{
+    ISrsWakable* consumer;
+    int64_t seq;
+    int64_t time;
+};
+#endif
+
+/**
+* the shared message ring of source, the source enqueue each message once,
+* and each consumer only hold a read cursor, which is the seq of message,
+* so the cost of publish is O(1) whatever the number of consumers.
+* the messages in [begin(), end()) are available, the consumer whose cursor
+* is before begin() or out of the queue size is lagging, it jump to the next gop.
+* @remark the ring reclaim the messages read by all consumers when full, drop
+*       the messages out of queue size, then grow when consumer lagging in it.
+*/
+class SrsMessageRing
+{
+private:
+    // the slots, the capacity is power of 2, the index of seq is seq&(capacity-1).
+    SrsRingSlot* slots;
+    int capacity;
+    // the seq of the first message, and the seq of next message.
+    int64_t head;
+    int64_t tail;
+    int queue_size_ms;
+    // to generate the monotonically time from timestamp.
+    int64_t last_timestamp;
+    int64_t time_base;
+    int64_t last_time;
+    // the last sequence headers and seq, for consumer to jump over it.
+    SrsSharedPtrMessage* sh_video;
+    int64_t sh_video_seq;
+    // the size of NALU length from the video sequence header, 0 when unknown.
+    int nal_length_size;
+    SrsSharedPtrMessage* sh_audio;
+    int64_t sh_audio_seq;
+#ifdef SRS_PERF_QUEUE_COND_WAIT
+    // the consumers waiting for messages, wakeup when its wanted seq and time ok.
+    std::vector<SrsRingWaiter> waiters;
+    // the earliest wanted seq and time of waiters, to check them only when ok.
+    int64_t wake_seq;
+    int64_t wake_time;
+#endif
+public:
+    SrsMessageRing();
+    virtual ~SrsMessageRing();
+public:
+    /**
+    * set the queue size, the messages out of it are dropped when full.
+    * @param queue_size the queue size in seconds.
+    */
+    virtual void set_queue_size(double queue_size);
+    /**
+    * the seq of first available message, and the seq of next message.
+    */
+    virtual int64_t begin();
+    virtual int64_t end();
+    /**
+    * whether ring is full, the source should reclaim it before enqueue.
+    */
+    virtual bool full();
+    /**
+    * get the slot of seq, which must in [begin(), end()).
+    */
+    virtual SrsRingSlot* at(int64_t seq);
+    /**
+    * get the duration in ms from the cursor to the last message,
+    * that is, the duration the consumer lag behind.
+    */
+    virtual int duration(int64_t cursor);
+public:
+    /**
+    * enqueue the message, the ring copy it, and wakeup the waiting consumers.
+    * @param atc whether atc, the consumer donot use jitter correct if true.
+    * @param ag the algorithm of time jitter.
+    */
+    virtual int enqueue(SrsSharedPtrMessage* msg, bool atc, SrsRtmpJitterAlgorithm ag);
+    /**
+    * free the messages before the cursor, which all consumers already read.
+    */
+    virtual void reclaim(int64_t cursor);
+    /**
+    * free all messages.
+    */
+    virtual void clear();
+public:
+    /**
+    * find the first keyframe from the cursor, which the duration in queue size.
+    * @return the seq of keyframe, -1 if not found.
+    */
+    virtual int64_t find_keyframe(int64_t cursor);
+    /**
+    * find the first message from the cursor, which the duration in queue size.
+    */
+    virtual int64_t find_in_queue(int64_t cursor);
+    /**
+    * get the last sequence headers in [from, to), NULL if not found.
+    */
+    virtual SrsSharedPtrMessage* video_sh_in(int64_t from, int64_t to);
+    virtual SrsSharedPtrMessage* audio_sh_in(int64_t from, int64_t to);
+#ifdef SRS_PERF_QUEUE_COND_WAIT
+public:
+    /**
+    * wait for messages, wakeup the consumer when atleast nb_msgs and in duration from cursor.
+    */
+    virtual void wait(ISrsWakable* consumer, int64_t cursor, int nb_msgs, int duration);
+    /**
+    * remove the consumer from waiters, when wakeup by others.
+    */
+    virtual void unwait(ISrsWakable* consumer);
+    /**
+    * get the number of consumers waiting.
+    */
+    virtual int nb_waiters();
+private:
+    virtual void add_waiter(SrsRingWaiter& waiter);
+#endif
+private:
+    virtual void grow();
+};
+
 /**
 * the consumer for SrsSource, that is a play client.
 */
@@ -223,6 +442,13 @@ class SrsConsumer : public ISrsWakable
 private:
     SrsRtmpJitter* jitter;
     SrsSource* source;
+    // the shared ring of source, the consumer read it from cursor.
+    SrsMessageRing* ring;
+    int64_t cursor;
+    // the queue size and shrink policy to jump over the lagging messages of ring.
+    SrsShrinkPolicy policy;
+    // the queue for messages to this consumer only, for example, the
+    // sequence headers and gop cache, which dumped before the ring.
     SrsMessageQueue* queue;
     // the owner connection for debug, maybe NULL.
     SrsConnection* conn;
@@ -238,7 +464,7 @@ private:
     int mw_duration;
 #endif
 public:
-    SrsConsumer(SrsSource* s, SrsConnection* c);
+    SrsConsumer(SrsSource* s, SrsMessageRing* r, SrsConnection* c);
     virtual ~SrsConsumer();
 public:
 #ifdef __INGEST_DYNAMIC__
@@ -250,9 +476,18 @@ public:
     */
     virtual void set_queue_size(double queue_size);
     /**
+    * set the shrink policy of queue.
+    * @see SrsMessageQueue::set_smart_shrink()
+    */
+    virtual void set_smart_shrink(bool v, SrsRequest* r);
+    /**
     * when source id changed, notice client to print.
     */
     virtual void update_source_id();
+    /**
+    * get the read cursor of ring.
+    */
+    virtual int64_t get_cursor();
 public:
     /**
     * get current client time, the last packet time.
@@ -284,6 +519,16 @@ public:
     * when client send the pause message.
     */
     virtual int on_play_client_pause(bool is_pause);
+private:
+    /**
+    * dump the messages of ring from cursor, correct the time jitter of copy.
+    */
+    virtual int dump_ring(int max_count, SrsSharedPtrMessage** pmsgs, int& count);
+    /**
+    * when lagging, jump the cursor over the messages out of queue size,
+    * @see SrsMessageQueue::shrink() and SrsMessageQueue::shrink_smart()
+    */
+    virtual int jump();
 // ISrsWakable
 public:
     /**
@@ -469,8 +714,12 @@ private:
     int _pre_source_id;
     // deep copy of client request.
     SrsRequest* _req;
+    // the compiled vhost settings for the hot path, never free it.
+    SrsVhostSettings* settings;
     // to delivery stream to clients.
     std::vector<SrsConsumer*> consumers;
+    // the shared messages for all consumers.
+    SrsMessageRing* ring;
     // the time jitter algorithm for vhost.
     SrsRtmpJitterAlgorithm jitter_algorithm;
     // whether use interlaced/mixed algorithm to correct timestamp.
@@ -479,6 +728,9 @@ private:
     // whether stream is monotonically increase.
     bool is_monotonically_increase;
     int64_t last_packet_time;
+    // demux the frames once for hls and http-ts,
+    // NULL when no muxer use the frames.
+    SrsCodecDemuxer* demuxer;
     // hls handler.
 #ifdef SRS_AUTO_HLS
     SrsHls* hls;
@@ -577,6 +829,10 @@ public:
     virtual int on_video(SrsCommonMessage* video);
 private:
     virtual int on_video_imp(SrsSharedPtrMessage* video);
+    /**
+    * copy the message to all consumers, by the shared ring.
+    */
+    virtual int copy_to_consumers(SrsSharedPtrMessage* msg);
 public:
     virtual int on_aggregate(SrsCommonMessage* msg);
     /**
@@ -23,8 +23,16 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <srs_app_st.hpp>
 
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#ifndef SRS_OSX
+#include <sys/sendfile.h>
+#endif
+
 #include <srs_kernel_error.hpp>
 #include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
 
 SrsStSocket::SrsStSocket(st_netfd_t client_stfd)
 {
@@ -182,6 +190,65 @@ int SrsStSocket::writev(const iovec *iov, int iov_size, ssize_t* nwrite)
     return ret;
 }
 
+int SrsStSocket::sendfile(int fd, int64_t offset, int size, ssize_t* nwrite)
+{
+    int ret = ERROR_SUCCESS;
+    
+    int osfd = st_netfd_fileno(stfd);
+    off_t pos = (off_t)offset;
+    int left = size;
+    
+    while (left > 0) {
+#ifndef SRS_OSX
+        ssize_t nb_write = ::sendfile(osfd, fd, &pos, left);
+#else
+        // the osx sendfile is different, read to buffer then write.
+        char buf[4096];
+        ssize_t nb_write = ::pread(fd, buf, srs_min(left, (int)sizeof(buf)), pos);
+        if (nb_write > 0) {
+            if ((nb_write = st_write(stfd, buf, nb_write, send_timeout)) <= 0) {
+                return (nb_write < 0 && errno == ETIME)? ERROR_SOCKET_TIMEOUT : ERROR_SOCKET_WRITE;
+            }
+            pos += nb_write;
+        }
+#endif
+        
+        if (nb_write > 0) {
+            left -= (int)nb_write;
+            send_bytes += nb_write;
+            continue;
+        }
+        
+        // the file is truncated.
+        if (nb_write == 0) {
+            ret = ERROR_SYSTEM_FILE_EOF;
+            break;
+        }
+        
+        if (errno == EINTR) {
+            continue;
+        }
+        
+        // wait in st when the send buffer is full.
+        if (errno == EAGAIN) {
+            if (st_netfd_poll(stfd, POLLOUT, send_timeout) != 0) {
+                ret = (errno == ETIME)? ERROR_SOCKET_TIMEOUT : ERROR_SOCKET_WRITE;
+                break;
+            }
+            continue;
+        }
+        
+        ret = ERROR_SOCKET_WRITE;
+        break;
+    }
+    
+    if (nwrite) {
+        *nwrite = size - left;
+    }
+    
+    return ret;
+}
+
 #ifdef __linux__
 #include <sys/epoll.h>
 
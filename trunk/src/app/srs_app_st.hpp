@@ -69,6 +69,12 @@ public:
      */
     virtual int write(void* buf, size_t size, ssize_t* nwrite);
     virtual int writev(const iovec *iov, int iov_size, ssize_t* nwrite);
+    /**
+     * send the size bytes of file from offset, without copy to user space.
+     * @remark the socket wait in st when send buffer full, but the file
+     *      is read in sendfile, user should readahead to never block on disk.
+     */
+    virtual int sendfile(int fd, int64_t offset, int size, ssize_t* nwrite);
 };
 
 // initialize st, requires epoll.
@@ -123,6 +123,10 @@ SrsStatisticStream::SrsStatisticStream()
     
     nb_clients = 0;
     nb_frames = 0;
+    
+    for (int i = 0; i < SrsStatisticDropReasonMax; i++) {
+        nb_dropped[i] = 0;
+    }
 }
 
 SrsStatisticStream::~SrsStatisticStream()
@@ -142,6 +146,12 @@ int SrsStatisticStream::dumps(stringstream& ss)
             << SRS_JFIELD_ORG("live_ms", srs_get_system_time_ms()) << SRS_JFIELD_CONT
             << SRS_JFIELD_ORG("clients", nb_clients) << SRS_JFIELD_CONT
             << SRS_JFIELD_ORG("frames", nb_frames) << SRS_JFIELD_CONT
+            << SRS_JFIELD_OBJ("dropped")
+                << SRS_JFIELD_ORG("disposable", nb_dropped[SrsStatisticDropReasonDisposable]) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("gop", nb_dropped[SrsStatisticDropReasonGop]) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("wait_keyframe", nb_dropped[SrsStatisticDropReasonWaitKeyframe]) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("all", nb_dropped[SrsStatisticDropReasonAll])
+            << SRS_JOBJECT_END << SRS_JFIELD_CONT
             << SRS_JFIELD_ORG("send_bytes", kbps->get_send_bytes()) << SRS_JFIELD_CONT
             << SRS_JFIELD_ORG("recv_bytes", kbps->get_recv_bytes()) << SRS_JFIELD_CONT
             << SRS_JFIELD_OBJ("kbps")
@@ -209,6 +219,7 @@ SrsStatisticClient::SrsStatisticClient()
     req = NULL;
     type = SrsRtmpConnUnknown;
     create = srs_get_system_time_ms();
+    mw_wait = mw_batch = mw_bytes = mw_send_us = 0;
 }
 
 SrsStatisticClient::~SrsStatisticClient()
@@ -229,8 +240,19 @@ int SrsStatisticClient::dumps(stringstream& ss)
             << SRS_JFIELD_STR("tcUrl", req->tcUrl) << SRS_JFIELD_CONT
             << SRS_JFIELD_STR("url", req->get_stream_url()) << SRS_JFIELD_CONT
             << SRS_JFIELD_STR("type", srs_client_type_string(type)) << SRS_JFIELD_CONT
-            << SRS_JFIELD_BOOL("publish", srs_client_type_is_publish(type)) << SRS_JFIELD_CONT
-            << SRS_JFIELD_ORG("alive", srs_get_system_time_ms() - create)
+            << SRS_JFIELD_BOOL("publish", srs_client_type_is_publish(type)) << SRS_JFIELD_CONT;
+    
+    // the adaptive mw of player.
+    if (mw_wait > 0) {
+        ss  << SRS_JFIELD_NAME("mw") << SRS_JOBJECT_START
+                << SRS_JFIELD_ORG("wait", mw_wait) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("batch", mw_batch) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("bytes", mw_bytes) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("send_us", mw_send_us)
+            << SRS_JOBJECT_END << SRS_JFIELD_CONT;
+    }
+    
+    ss      << SRS_JFIELD_ORG("alive", srs_get_system_time_ms() - create)
         << SRS_JOBJECT_END;
     
     return ret;
@@ -365,6 +387,20 @@ int SrsStatistic::on_video_frames(SrsRequest* req, int nb_frames)
     return ret;
 }
 
+int SrsStatistic::on_queue_drop(SrsRequest* req, SrsStatisticDropReason reason, int nb_msgs)
+{
+    int ret = ERROR_SUCCESS;
+    
+    srs_assert(reason >= SrsStatisticDropReasonDisposable && reason < SrsStatisticDropReasonMax);
+    
+    SrsStatisticVhost* vhost = create_vhost(req);
+    SrsStatisticStream* stream = create_stream(vhost, req);
+    
+    stream->nb_dropped[reason] += nb_msgs;
+    
+    return ret;
+}
+
 void SrsStatistic::on_stream_publish(SrsRequest* req, int cid)
 {
     SrsStatisticVhost* vhost = create_vhost(req);
@@ -425,6 +461,20 @@ int SrsStatistic::on_client(int id, SrsRequest* req, SrsConnection* conn, SrsRtm
     return ret;
 }
 
+void SrsStatistic::on_client_mw(int id, int wait, int batch, int bytes, int send_us)
+{
+    std::map<int, SrsStatisticClient*>::iterator it = clients.find(id);
+    if (it == clients.end()) {
+        return;
+    }
+    
+    SrsStatisticClient* client = it->second;
+    client->mw_wait = wait;
+    client->mw_batch = batch;
+    client->mw_bytes = bytes;
+    client->mw_send_us = send_us;
+}
+
 void SrsStatistic::on_disconnect(int id)
 {
     std::map<int, SrsStatisticClient*>::iterator it;
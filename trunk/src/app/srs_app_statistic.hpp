@@ -40,6 +40,24 @@ class SrsKbps;
 class SrsRequest;
 class SrsConnection;
 
+/**
+* the reason why the play queue drops messages.
+* @see SrsMessageQueue
+*/
+enum SrsStatisticDropReason
+{
+    // the disposable video frame, dropped when the queue is congested.
+    SrsStatisticDropReasonDisposable = 0,
+    // the gop from the head of queue, dropped when the queue is overflow.
+    SrsStatisticDropReasonGop,
+    // the video frame before keyframe, dropped to resume video at keyframe.
+    SrsStatisticDropReasonWaitKeyframe,
+    // all messages except the sequence header, dropped when the queue is overflow.
+    SrsStatisticDropReasonAll,
+    // the max reason, for array size.
+    SrsStatisticDropReasonMax
+};
+
 struct SrsStatisticVhost
 {
 public:
@@ -71,6 +89,8 @@ public:
     int connection_cid;
     int nb_clients;
     uint64_t nb_frames;
+    // the messages dropped by the play queues, index by SrsStatisticDropReason.
+    uint64_t nb_dropped[SrsStatisticDropReasonMax];
 #ifdef __INGEST_DYNAMIC__
     int width;
     int height;
@@ -124,6 +144,12 @@ public:
     SrsRtmpConnType type;
     int id;
     int64_t create;
+    // the adaptive mw of player, the wait time in ms, the average msgs
+    // and bytes of each write, and the time in us to send them.
+    int mw_wait;
+    int mw_batch;
+    int mw_bytes;
+    int mw_send_us;
 public:
     SrsStatisticClient();
     virtual ~SrsStatisticClient();
@@ -188,6 +214,12 @@ public:
      * We only stat the total number of video frames.
      */
     virtual int on_video_frames(SrsRequest* req, int nb_frames);
+    /**
+     * when the play queue dropped messages.
+     * @param reason the reason why drop the messages.
+     * @param nb_msgs the number of messages dropped.
+     */
+    virtual int on_queue_drop(SrsRequest* req, SrsStatisticDropReason reason, int nb_msgs);
     /**
      * when publish stream.
      * @param req the request object of publish connection.
@@ -215,6 +247,15 @@ public:
      */
     virtual void on_disconnect(int id);
     /**
+    * when the adaptive mw of player updated.
+    * @param id, the client srs id.
+    * @param wait, the wait time in ms of each write.
+    * @param batch, the average msgs of each write.
+    * @param bytes, the average bytes of each write.
+    * @param send_us, the average time in us to send a write.
+    */
+    virtual void on_client_mw(int id, int wait, int batch, int bytes, int send_us);
+    /**
     * sample the kbps, add delta bytes of conn.
     * use kbps_sample() to get all result of kbps stat.
     */
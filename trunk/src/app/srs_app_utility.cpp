@@ -34,6 +34,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifdef SRS_OSX
 #include <sys/sysctl.h>
 #endif
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
 #include <stdlib.h>
 #include <sys/time.h>
 #include <map>
@@ -47,6 +51,8 @@ using namespace std;
 #include <srs_protocol_json.hpp>
 #include <srs_kernel_stream.hpp>
 #include <srs_kernel_utility.hpp>
+#include <srs_kernel_slab.hpp>
+#include <srs_app_dns.hpp>
 
 // the longest time to wait for a process to quit.
 #define SRS_PROCESS_QUIT_TIMEOUT_MS 1000
@@ -75,11 +81,10 @@ int srs_socket_connect(string server, int port, int64_t timeout, st_netfd_t* pst
         return ret;
     }
     
-    // connect to server.
-    std::string ip = srs_dns_resolve(server);
-    if (ip.empty()) {
-        ret = ERROR_SYSTEM_IP_INVALID;
-        srs_error("dns resolve server error, ip empty. ret=%d", ret);
+    // connect to server, resolve in st without block the server.
+    std::string ip;
+    if ((ret = SrsDnsResolver::instance()->resolve(server, &ip)) != ERROR_SUCCESS) {
+        srs_error("dns resolve server %s error. ret=%d", server.c_str(), ret);
         goto failed;
     }
     
@@ -1413,6 +1418,19 @@ string srs_get_peer_ip(int fd)
     return ip;
 }
 
+int srs_get_sock_outq(int fd)
+{
+    int outq = 0;
+    
+#ifdef SIOCOUTQ
+    if (ioctl(fd, SIOCOUTQ, &outq) == -1) {
+        return 0;
+    }
+#endif
+    
+    return outq;
+}
+
 bool srs_string_is_http(string url)
 {
     return srs_string_starts_with(url, "http://", "https://");
@@ -1445,6 +1463,17 @@ void srs_api_dump_summaries(std::stringstream& ss)
     SrsNetworkDevices* n = srs_get_network_devices();
     SrsNetworkRtmpServer* nrs = srs_get_network_rtmp_server();
     SrsDiskStat* d = srs_get_disk_stat();
+    SrsSlabAllocator* sa = SrsSlabAllocator::instance();
+    SrsDnsResolver* dns = SrsDnsResolver::instance();
+    
+    // the objects of pools, the messages and payloads.
+    int pool_used_objects = 0;
+    int pool_cached_objects = 0;
+    std::vector<SrsObjectPool*>& pools = SrsObjectPool::pools();
+    for (int i = 0; i < (int)pools.size(); i++) {
+        pool_used_objects += pools[i]->used();
+        pool_cached_objects += pools[i]->cached();
+    }
     
     float self_mem_percent = 0;
     if (m->MemTotal > 0) {
@@ -1501,7 +1530,20 @@ void srs_api_dump_summaries(std::stringstream& ss)
                 << SRS_JFIELD_ORG("mem_kbyte", r->r.ru_maxrss) << SRS_JFIELD_CONT
                 << SRS_JFIELD_ORG("mem_percent", self_mem_percent) << SRS_JFIELD_CONT
                 << SRS_JFIELD_ORG("cpu_percent", u->percent) << SRS_JFIELD_CONT
-                << SRS_JFIELD_ORG("srs_uptime", srs_uptime)
+                << SRS_JFIELD_ORG("srs_uptime", srs_uptime) << SRS_JFIELD_CONT
+                // the slabs pool of receive buffers and payloads.
+                << SRS_JFIELD_ORG("pool_used_slabs", sa->used_slabs()) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("pool_used_kbyte", sa->used() / 1024) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("pool_cached_kbyte", sa->cached() / 1024) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("pool_used_objects", pool_used_objects) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("pool_cached_objects", pool_cached_objects) << SRS_JFIELD_CONT
+                // the dns resolver, the latency of queries to nameservers.
+                << SRS_JFIELD_ORG("dns_lookups", dns->lookups()) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("dns_hits", dns->hits()) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("dns_queries", dns->queries()) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("dns_failures", dns->failures()) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("dns_avg_ms", dns->avg_latency()) << SRS_JFIELD_CONT
+                << SRS_JFIELD_ORG("dns_max_ms", dns->peak_latency())
             << SRS_JOBJECT_END << SRS_JFIELD_CONT
             << SRS_JFIELD_ORG("system", SRS_JOBJECT_START)
                 << SRS_JFIELD_ORG("cpu_percent", s->percent) << SRS_JFIELD_CONT
@@ -670,6 +670,9 @@ extern std::string srs_get_local_ip(int fd);
 extern int srs_get_local_port(int fd);
 // where peer ip is the client public ip which connected to server.
 extern std::string srs_get_peer_ip(int fd);
+// get the bytes in socket send buffer, not sent or not acked by peer,
+// which is SIOCOUTQ for linux, 0 for other os.
+extern int srs_get_sock_outq(int fd);
 
 // whether the url is starts with http:// or https://
 extern bool srs_string_is_http(std::string url);
@@ -0,0 +1,291 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <srs_app_worker.hpp>
+
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sstream>
+using namespace std;
+
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_log.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_app_config.hpp>
+#include <srs_rtmp_stack.hpp>
+
+// the interval in ms for master to check the signals and workers.
+#define SRS_WORKER_CYCLE_INTERVAL_MS 100
+// when worker quit in this interval in ms, sleep before respawn it,
+// to avoid the master spin when worker always crash at startup.
+#define SRS_WORKER_RESPAWN_INTERVAL_MS 3000
+
+// the index of current worker, -1 for master or not in workers mode.
+static int _srs_worker_index = -1;
+// the workers count and local port when master started, which never
+// change by reload, for the owner of stream depends on it.
+static int _srs_worker_count = 0;
+static int _srs_worker_port = 0;
+
+// the signals received by master, set by signal handler.
+static volatile sig_atomic_t _srs_worker_signo = 0;
+
+static void srs_worker_sig_catcher(int signo)
+{
+    _srs_worker_signo = signo;
+}
+
+SrsWorkerMaster::SrsWorkerMaster()
+{
+}
+
+SrsWorkerMaster::~SrsWorkerMaster()
+{
+}
+
+int SrsWorkerMaster::cycle()
+{
+    int ret = ERROR_SUCCESS;
+    
+    int nb_workers = _srs_worker_count = _srs_config->get_workers_count();
+    _srs_worker_port = _srs_config->get_workers_port();
+    pids.resize(nb_workers, -1);
+    starttimes.resize(nb_workers, 0);
+    
+    // forward the reload, reopen and quit signals to workers.
+    struct sigaction sa;
+    sa.sa_handler = srs_worker_sig_catcher;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sigaction(SIGHUP, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGUSR2, &sa, NULL);
+    
+    srs_trace("master pid=%d start %d workers, local port=%d",
+        ::getpid(), nb_workers, _srs_worker_port);
+    
+    for (int i = 0; i < nb_workers; i++) {
+        if ((ret = spawn(i)) != ERROR_SUCCESS) {
+            notify(SIGTERM);
+            return ret;
+        }
+        
+        // in worker process, return to run the server.
+        if (_srs_worker_index >= 0) {
+            return ret;
+        }
+    }
+    
+    bool quit = false;
+    while (true) {
+        int signo = _srs_worker_signo;
+        if (signo) {
+            _srs_worker_signo = 0;
+            quit = quit || signo != SIGHUP;
+            if (signo == SIGHUP) {
+                reload();
+            }
+            notify(signo);
+        }
+        
+        int status = 0;
+        pid_t pid = ::waitpid(-1, &status, WNOHANG);
+        if (pid < 0 && errno == EINTR) {
+            continue;
+        }
+        if (pid < 0 && errno == ECHILD) {
+            srs_trace("master all workers quit");
+            return ret;
+        }
+        if (pid < 0) {
+            ret = ERROR_SYSTEM_WAITPID;
+            srs_error("master waitpid failed. ret=%d", ret);
+            return ret;
+        }
+        if (pid == 0) {
+            usleep(SRS_WORKER_CYCLE_INTERVAL_MS * 1000);
+            continue;
+        }
+        
+        int index = -1;
+        for (int i = 0; i < nb_workers; i++) {
+            if (pids[i] == pid) {
+                index = i;
+                break;
+            }
+        }
+        if (index < 0) {
+            continue;
+        }
+        pids[index] = -1;
+        
+        if (WIFEXITED(status)) {
+            srs_warn("worker %d pid=%d exited, code=%d", index, pid, WEXITSTATUS(status));
+        } else if (WIFSIGNALED(status)) {
+            srs_warn("worker %d pid=%d terminated, signal=%d", index, pid, WTERMSIG(status));
+        }
+        
+        if (quit) {
+            continue;
+        }
+        
+        // throttle the respawn of worker which crash at startup.
+        int64_t elapsed = srs_update_system_time_ms() - starttimes[index];
+        if (elapsed < SRS_WORKER_RESPAWN_INTERVAL_MS) {
+            srs_warn("worker %d quit in %"PRId64"ms, delay to respawn", index, elapsed);
+            usleep((SRS_WORKER_RESPAWN_INTERVAL_MS - elapsed) * 1000);
+        }
+        
+        if ((ret = spawn(index)) != ERROR_SUCCESS) {
+            notify(SIGTERM);
+            return ret;
+        }
+        
+        // in worker process, return to run the server.
+        if (_srs_worker_index >= 0) {
+            return ret;
+        }
+    }
+    
+    return ret;
+}
+
+int SrsWorkerMaster::spawn(int index)
+{
+    int ret = ERROR_SUCCESS;
+    
+    pid_t pid = fork();
+    if (pid < 0) {
+        ret = ERROR_SYSTEM_FORK;
+        srs_error("fork worker %d failed. ret=%d", index, ret);
+        return ret;
+    }
+    
+    // worker process, restore the signals for server to install.
+    if (pid == 0) {
+        signal(SIGHUP, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        signal(SIGUSR2, SIG_DFL);
+        
+        _srs_worker_index = index;
+        pids.clear();
+        starttimes.clear();
+        return ret;
+    }
+    
+    pids[index] = pid;
+    starttimes[index] = srs_update_system_time_ms();
+    srs_trace("master fork worker %d pid=%d", index, pid);
+    
+    return ret;
+}
+
+void SrsWorkerMaster::reload()
+{
+    int ret = ERROR_SUCCESS;
+    
+    // the workers reload the config themselves, master only checks the workers.
+    SrsConfig conf;
+    if ((ret = conf.parse_file(_srs_config->config().c_str())) != ERROR_SUCCESS
+        || (ret = conf.check_config()) != ERROR_SUCCESS
+    ) {
+        srs_warn("master ignore the invalid config to reload. ret=%d", ret);
+        return;
+    }
+    
+    // the owner of streams depends on the workers count,
+    // so it never changes until restart.
+    if (!srs_worker_config_equals(&conf)) {
+        srs_warn("master ignore the changed workers, enabled=%d, count=%d=>%d, port=%d=>%d, restart to apply",
+            conf.get_workers_enabled(), _srs_worker_count, conf.get_workers_count(),
+            _srs_worker_port, conf.get_workers_port());
+    }
+}
+
+void SrsWorkerMaster::notify(int signo)
+{
+    for (int i = 0; i < (int)pids.size(); i++) {
+        if (pids[i] > 0) {
+            ::kill(pids[i], signo);
+        }
+    }
+    srs_trace("master forward signal %d to workers", signo);
+}
+
+int srs_worker_index()
+{
+    return _srs_worker_index;
+}
+
+bool srs_worker_config_equals(SrsConfig* conf)
+{
+    return conf->get_workers_enabled()
+        && conf->get_workers_count() == _srs_worker_count
+        && conf->get_workers_port() == _srs_worker_port;
+}
+
+int srs_worker_owner(string url)
+{
+    return srs_worker_owner(url, _srs_worker_count);
+}
+
+int srs_worker_owner(string url, int nb_workers)
+{
+    if (nb_workers <= 1) {
+        return 0;
+    }
+    
+    u_int32_t hash = srs_crc32(url.data(), (int)url.length());
+    return (int)(hash % (u_int32_t)nb_workers);
+}
+
+bool srs_worker_is_proxy(SrsRequest* req)
+{
+    if (_srs_worker_index < 0) {
+        return false;
+    }
+    
+    // the edge vhost always pulls from or pushes to its configed origin.
+    if (_srs_config->get_vhost_is_edge(req->vhost)) {
+        return false;
+    }
+    
+    return srs_worker_owner(req->get_stream_url()) != _srs_worker_index;
+}
+
+int srs_worker_local_port(int index)
+{
+    return _srs_worker_port + index;
+}
+
+string srs_worker_local_endpoint(int index)
+{
+    std::stringstream ss;
+    ss << SRS_CONSTS_LOCALHOST << ":" << srs_worker_local_port(index);
+    return ss.str();
+}
+
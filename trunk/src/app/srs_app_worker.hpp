@@ -0,0 +1,114 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SRS_APP_WORKER_HPP
+#define SRS_APP_WORKER_HPP
+
+/*
+#include <srs_app_worker.hpp>
+*/
+#include <srs_core.hpp>
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+class SrsRequest;
+class SrsConfig;
+
+/**
+* the master of the master/worker multiple processes mode.
+* the master is forked before st initialized, it only forks the workers,
+* forwards the signals to them and respawns the dead worker,
+* each worker is a full SrsServer which listens with SO_REUSEPORT,
+* so the kernel balances the client connections over all workers.
+* @remark the master never uses st, it runs in the plain process.
+*/
+class SrsWorkerMaster
+{
+private:
+    // the pid of each worker, -1 when the worker is dead.
+    std::vector<pid_t> pids;
+    // the time in ms when the worker spawned.
+    std::vector<int64_t> starttimes;
+public:
+    SrsWorkerMaster();
+    virtual ~SrsWorkerMaster();
+public:
+    /**
+    * fork all workers and wait for them, respawn the dead worker.
+    * @return when the worker forked, returns in the worker process, where
+    *       the srs_worker_index() is the index of worker, the caller should run the server;
+    *       when all workers quit, returns in the master process, the caller should quit.
+    */
+    virtual int cycle();
+private:
+    virtual int spawn(int index);
+    /**
+    * when reload, check the workers of config, which never changes
+    * until restart, for the owner of stream depends on the workers count.
+    */
+    virtual void reload();
+    virtual void notify(int signo);
+};
+
+/**
+* get the index of current worker, in [0, count).
+* @return -1 when not in the workers mode, or in the master.
+*/
+extern int srs_worker_index();
+/**
+* get the index of the worker which owns the stream url,
+* the owner worker is the only one which accepts the publish of the stream
+* and delivers it to forwarders, transcoders, hls and dvr.
+* @param url the stream url, @see SrsRequest.get_stream_url().
+* @remark use the workers count when master started, never changed by reload.
+*/
+extern int srs_worker_owner(std::string url);
+/**
+* get the index of the worker which owns the stream url, in [0, nb_workers).
+* @param nb_workers the workers count, the owner is 0 when not more than 1.
+*/
+extern int srs_worker_owner(std::string url, int nb_workers);
+/**
+* whether the workers of config equals to the workers when master started.
+*/
+extern bool srs_worker_config_equals(SrsConfig* conf);
+/**
+* whether the stream of req should be proxied to its owner worker, that is,
+* current process is a worker but not the owner, and the vhost is not an edge.
+* a proxied stream works like the edge, play from or publish to the owner worker.
+*/
+extern bool srs_worker_is_proxy(SrsRequest* req);
+/**
+* get the local rtmp port of worker, which the other workers connect to.
+*/
+extern int srs_worker_local_port(int index);
+/**
+* get the local rtmp endpoint of worker, in the format of ip:port.
+*/
+extern std::string srs_worker_local_endpoint(int index);
+
+#endif
+
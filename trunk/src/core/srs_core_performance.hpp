@@ -126,6 +126,13 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 * @see https://github.com/ossrs/srs/issues/251
 */
 #define SRS_PERF_QUEUE_COND_WAIT
+/**
+* the initial messages of the shared ring of source, all consumers read from it,
+* the ring grows when consumer lagging in the queue length, but never exceed the max.
+* @remark must be power of 2.
+*/
+#define SRS_PERF_QUEUE_RING_MSGS 256
+#define SRS_PERF_QUEUE_RING_MAX_MSGS 65536
 #ifdef SRS_PERF_QUEUE_COND_WAIT
     #define SRS_PERF_MW_MIN_MSGS 8
 #endif
@@ -139,6 +146,19 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 #define SRS_PERF_MIN_LATENCY_ENABLED false
 
+/**
+* the adaptive MW(merged-write) for player, which picks the wait time and
+* min msgs of each write from the bitrate and msgs rate of stream, and the
+* bytes queued in socket send buffer, to meet the mw_latency of vhost.
+* @see SrsMwController
+*/
+#define SRS_PERF_MW_ADAPTIVE false
+// never wait less than this in ms, or write too often.
+#define SRS_PERF_MW_MIN_SLEEP 10
+// when the socket is backlogged, wait for at least these bytes to write,
+// to avoid the tiny writes, but never exceed the latency target.
+#define SRS_PERF_MW_MIN_BYTES 16384
+
 /**
 * how many chunk stream to cache, [0, N].
 * to imporove about 10% performance when chunk size small, and 5% for large chunk.
@@ -147,6 +167,112 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 #define SRS_PERF_CHUNK_STREAM_CACHE 16
 
+/**
+* how many chunk headers to cache for each shared ptr message, [0, N].
+* the players of a source which send the message with the same stream id
+* reuse the fmt3 headers rather than build for each chunk, and the fmt0
+* header when the timestamp is the same, for instance, the time jitter is off.
+* @remark the fmt3 header contains the timestamp only when extended, so
+*       the cache is keyed by stream id and the extended timestamp.
+* @remark 0 to disable the shared chunk headers.
+*/
+#define SRS_PERF_CHUNK_HEADER_CACHE 8
+/**
+* how many flv tag headers to cache for each shared ptr message, [0, N].
+* like the chunk headers, the http flv players of a source reuse the tag
+* header and previous tag size when send the message with the same timestamp.
+* @remark 0 to disable the shared flv tags.
+*/
+#define SRS_PERF_FLV_TAG_CACHE 8
+
+/**
+* the receive payloads in slab, for the publish connections of server,
+* the payload of message is allocated from the slabs in size classes,
+* and the message in one chunk point to the receive buffer without copy.
+* @remark the srs-librtmp never use it, for user detach and free the payload.
+* @see SrsProtocol::set_recv_slab()
+*/
+#define SRS_PERF_RECV_SLAB
+/**
+* the min in chunk size to point the message in one chunk to receive buffer,
+* for the receive buffer is kept until all the messages point to it freed,
+* which only worth when most messages in one chunk, that is, large chunk size.
+*/
+#define SRS_PERF_RECV_ZERO_COPY_CHUNK_SIZE 16384
+/**
+* the max bytes of free slabs to reuse, larger to avoid the malloc,
+* but use more memory.
+*/
+#define SRS_PERF_SLAB_MAX_CACHED 67108864
+/**
+* the receive buffer starts small, grows to the large one from the slabs
+* only when peer is streaming, for instance, the publisher, and shrinks
+* when idle, so the idle connections such as players never hold the large one.
+* @see SrsFastBuffer::grow()
+*/
+#define SRS_PERF_RECV_BUFFER_MIN 4096
+/**
+* the receive buffer is idle to shrink, when got less than
+* SRS_PERF_RECV_BUFFER_MIN bytes in this period, in ms.
+*/
+#define SRS_PERF_RECV_BUFFER_IDLE_MS 3000
+
+/**
+* the shared ptr messages and payloads from the object pools, for the copy()
+* new a message for each player of each frame, which is freed when sent.
+* @remark the srs-librtmp never use it, the pool is enabled by server.
+* @see SrsObjectPool
+*/
+#define SRS_PERF_MSG_POOL
+/**
+* the max free objects of each pool to reuse, larger to avoid the malloc
+* when players drain the queue, but use more memory.
+*/
+#define SRS_PERF_MSG_POOL_MAX_CACHED 65536
+
+/**
+* the chunk size of hls in ram, the ts is stored in chunks
+* and sendout to http players by writev, without copy.
+* @remark the m3u8 also use a chunk, so never set it too large.
+*/
+#define SRS_PERF_HLS_RAM_CHUNK_SIZE 16384
+/**
+* the max chunks of hls in ram to reuse, larger to avoid the malloc
+* for each ts segment, but use more memory.
+*/
+#define SRS_PERF_HLS_RAM_POOL_CHUNKS 1024
+
+/**
+* the static files and vod streams of http server are sent by sendfile,
+* without copy to user space, and when async io pool enabled, the native
+* threads readahead the file to page cache before sendfile, so the st is
+* never blocked by disk read.
+* @remark undef it to read the file to buffer then write to socket.
+* @see SrsVodStream::copy()
+*/
+#define SRS_PERF_HTTP_SENDFILE
+/**
+* the bytes of each sendfile, the next chunk is readahead in async io
+* when sending current one.
+*/
+#define SRS_PERF_HTTP_SENDFILE_CHUNK 262144
+
+/**
+* the max udp packets to receive in a batch by recvmmsg, for the stream
+* casters over udp, for instance, the MPEG-TS over UDP, and the handler
+* process the batch in a time, which reduce the syscalls.
+* @remark the recvmmsg is linux only, undef it to recvfrom each packet.
+* @see SrsUdpListener::cycle()
+*/
+#ifndef SRS_OSX
+    #define SRS_PERF_UDP_RECV_BATCH 16
+#endif
+/**
+* the max size of udp packet in batch, the larger packet is dropped,
+* the MPEG-TS over UDP is 1316 bytes, and RTP is less than MTU.
+*/
+#define SRS_PERF_UDP_RECV_PACKET_SIZE 9216
+
 /**
 * the gop cache and play cache queue.
 */
@@ -288,6 +288,89 @@ bool SrsFlvCodec::video_is_acceptable(char* data, int size)
     return true;
 }
 
+int SrsFlvCodec::video_nal_length_size(char* data, int size)
+{
+    if (!video_is_sequence_header(data, size)) {
+        return 0;
+    }
+    
+    // 5bytes avc header, and the configurationVersion, AVCProfileIndication,
+    // profile_compatibility, AVCLevelIndication, lengthSizeMinusOne.
+    if (size < 10) {
+        return 0;
+    }
+    
+    // 5.3.4.2.1 Syntax, H.264-AVC-ISO_IEC_14496-15.pdf, page 16
+    int8_t lengthSizeMinusOne = data[9] & 0x03;
+    
+    // 1, 2 or 4 bytes, 3 is invalid.
+    if (lengthSizeMinusOne == 2) {
+        return 0;
+    }
+    
+    return lengthSizeMinusOne + 1;
+}
+
+bool SrsFlvCodec::video_is_disposable(char* data, int size, int nal_length_size)
+{
+    // 1bytes required.
+    if (size < 1) {
+        return false;
+    }
+    
+    char frame_type = data[0];
+    frame_type = (frame_type >> 4) & 0x0F;
+    
+    if (frame_type == SrsCodecVideoAVCFrameDisposableInterFrame) {
+        return true;
+    }
+    if (frame_type != SrsCodecVideoAVCFrameInterFrame || !video_is_h264(data, size)) {
+        return false;
+    }
+    
+    // the NALU length must be parsed from sequence header.
+    if (nal_length_size != 1 && nal_length_size != 2 && nal_length_size != 4) {
+        return false;
+    }
+    
+    // 5bytes avc header required.
+    if (size < 5 || data[1] != SrsCodecVideoAVCTypeNALU) {
+        return false;
+    }
+    
+    // each NALU is the length in nal_length_size bytes and the payload,
+    // where the nal_ref_idc is the bit[5,6] of the first byte.
+    bool has_vcl = false;
+    u_int8_t* p = (u_int8_t*)data + 5;
+    u_int8_t* end = (u_int8_t*)data + size;
+    while (p < end) {
+        if (end - p < nal_length_size + 1) {
+            return false;
+        }
+        
+        u_int32_t nb_nalu = 0;
+        for (int i = 0; i < nal_length_size; i++) {
+            nb_nalu = (nb_nalu << 8) | p[i];
+        }
+        p += nal_length_size;
+        if (nb_nalu == 0 || nb_nalu > (u_int32_t)(end - p)) {
+            return false;
+        }
+        
+        SrsAvcNaluType nal_unit_type = (SrsAvcNaluType)(p[0] & 0x1f);
+        if (nal_unit_type >= SrsAvcNaluTypeNonIDR && nal_unit_type <= SrsAvcNaluTypeIDR) {
+            if ((p[0] & 0x60) != 0) {
+                return false;
+            }
+            has_vcl = true;
+        }
+        
+        p += nb_nalu;
+    }
+    
+    return has_vcl;
+}
+
 string srs_codec_avc_nalu2str(SrsAvcNaluType nalu_type)
 {
     switch (nalu_type) {
@@ -441,6 +524,52 @@ bool SrsAvcAacCodec::is_aac_codec_ok()
     return aac_extra_size > 0 && aac_extra_data;
 }
 
+SrsAvcAacCodec* SrsAvcAacCodec::copy()
+{
+    SrsAvcAacCodec* c = new SrsAvcAacCodec();
+    
+    c->duration = duration;
+    c->width = width;
+    c->height = height;
+    c->frame_rate = frame_rate;
+    c->video_codec_id = video_codec_id;
+    c->video_data_rate = video_data_rate;
+    c->audio_codec_id = audio_codec_id;
+    c->audio_data_rate = audio_data_rate;
+    
+    c->avc_profile = avc_profile;
+    c->avc_level = avc_level;
+    c->NAL_unit_length = NAL_unit_length;
+    c->payload_format = payload_format;
+    c->aac_object = aac_object;
+    c->aac_sample_rate = aac_sample_rate;
+    c->aac_channels = aac_channels;
+    c->avc_parse_sps = avc_parse_sps;
+    
+    if (sequenceParameterSetLength > 0) {
+        c->sequenceParameterSetLength = sequenceParameterSetLength;
+        c->sequenceParameterSetNALUnit = new char[sequenceParameterSetLength];
+        memcpy(c->sequenceParameterSetNALUnit, sequenceParameterSetNALUnit, sequenceParameterSetLength);
+    }
+    if (pictureParameterSetLength > 0) {
+        c->pictureParameterSetLength = pictureParameterSetLength;
+        c->pictureParameterSetNALUnit = new char[pictureParameterSetLength];
+        memcpy(c->pictureParameterSetNALUnit, pictureParameterSetNALUnit, pictureParameterSetLength);
+    }
+    if (avc_extra_size > 0) {
+        c->avc_extra_size = avc_extra_size;
+        c->avc_extra_data = new char[avc_extra_size];
+        memcpy(c->avc_extra_data, avc_extra_data, avc_extra_size);
+    }
+    if (aac_extra_size > 0) {
+        c->aac_extra_size = aac_extra_size;
+        c->aac_extra_data = new char[aac_extra_size];
+        memcpy(c->aac_extra_data, aac_extra_data, aac_extra_size);
+    }
+    
+    return c;
+}
+
 int SrsAvcAacCodec::audio_aac_demux(char* data, int size, SrsCodecSample* sample)
 {
     int ret = ERROR_SUCCESS;
@@ -1145,39 +1274,15 @@ int SrsAvcAacCodec::avc_demux_annexb_format(SrsStream* stream, SrsCodecSample* s
     // AnnexB
     // B.1.1 Byte stream NAL unit syntax,
     // H.264-AVC-ISO_IEC_14496-10.pdf, page 211.
-    while (!stream->empty()) {
-        // find start code
-        int nb_start_code = 0;
-        if (!srs_avc_startswith_annexb(stream, &nb_start_code)) {
-            return ret;
-        }
-
-        // skip the start code.
-        if (nb_start_code > 0) {
-            stream->skip(nb_start_code);
-        }
-        
-        // the NALU start bytes.
-        char* p = stream->data() + stream->pos();
-        
-        // get the last matched NALU
-        while (!stream->empty()) {
-            if (srs_avc_startswith_annexb(stream, NULL)) {
-                break;
-            }
-            
-            stream->skip(1);
-        }
-        
-        char* pp = stream->data() + stream->pos();
-        
-        // skip the empty.
-        if (pp - p <= 0) {
-            continue;
-        }
+    annexb_nalus.clear();
+    srs_avc_split_annexb(stream->data() + stream->pos(), stream->size() - stream->pos(), annexb_nalus);
+    stream->skip(stream->size() - stream->pos());
+    
+    for (int i = 0; i < (int)annexb_nalus.size(); i++) {
+        SrsAnnexbNalu& nalu = annexb_nalus[i];
         
         // got the NALU.
-        if ((ret = sample->add_sample_unit(p, pp - p)) != ERROR_SUCCESS) {
+        if ((ret = sample->add_sample_unit(nalu.bytes, nalu.size)) != ERROR_SUCCESS) {
             srs_error("annexb add video sample failed. ret=%d", ret);
             return ret;
         }
@@ -1243,5 +1348,160 @@ int SrsAvcAacCodec::avc_demux_ibmf_format(SrsStream* stream, SrsCodecSample* sam
     return ret;
 }
 
+SrsSharedCodec::SrsSharedCodec(SrsAvcAacCodec* c)
+{
+    ref_count = 1;
+    codec = c->copy();
+}
+
+SrsSharedCodec::~SrsSharedCodec()
+{
+    srs_freep(codec);
+}
+
+SrsSharedCodec* SrsSharedCodec::retain()
+{
+    ref_count++;
+    return this;
+}
+
+void SrsSharedCodec::release()
+{
+    srs_assert(ref_count > 0);
+    
+    if (--ref_count > 0) {
+        return;
+    }
+    
+    delete this;
+}
+
+SrsCodecFrame::SrsCodecFrame(SrsSharedCodec* c, SrsCodecSample* sample, int err)
+{
+    error = err;
+    codec = c->retain();
+    
+    is_video = sample->is_video;
+    cts = sample->cts;
+    frame_type = sample->frame_type;
+    avc_packet_type = sample->avc_packet_type;
+    has_idr = sample->has_idr;
+    has_aud = sample->has_aud;
+    has_sps_pps = sample->has_sps_pps;
+    first_nalu_type = sample->first_nalu_type;
+    acodec = sample->acodec;
+    sound_rate = sample->sound_rate;
+    sound_size = sample->sound_size;
+    sound_type = sample->sound_type;
+    aac_packet_type = sample->aac_packet_type;
+    
+    nb_units = sample->nb_sample_units;
+    units = NULL;
+    if (nb_units > 0) {
+        units = new SrsCodecSampleUnit[nb_units];
+    }
+    for (int i = 0; i < nb_units; i++) {
+        units[i].size = sample->sample_units[i].size;
+        units[i].bytes = sample->sample_units[i].bytes;
+    }
+}
+
+SrsCodecFrame::~SrsCodecFrame()
+{
+    codec->release();
+    srs_freepa(units);
+}
+
+void SrsCodecFrame::to_sample(SrsCodecSample* sample)
+{
+    sample->is_video = is_video;
+    sample->cts = cts;
+    sample->frame_type = frame_type;
+    sample->avc_packet_type = avc_packet_type;
+    sample->has_idr = has_idr;
+    sample->has_aud = has_aud;
+    sample->has_sps_pps = has_sps_pps;
+    sample->first_nalu_type = first_nalu_type;
+    sample->acodec = acodec;
+    sample->sound_rate = sound_rate;
+    sample->sound_size = sound_size;
+    sample->sound_type = sound_type;
+    sample->aac_packet_type = aac_packet_type;
+    
+    sample->nb_sample_units = nb_units;
+    for (int i = 0; i < nb_units; i++) {
+        sample->sample_units[i].size = units[i].size;
+        sample->sample_units[i].bytes = units[i].bytes;
+    }
+}
+
+SrsCodecDemuxer::SrsCodecDemuxer()
+{
+    codec = new SrsAvcAacCodec();
+    sample = new SrsCodecSample();
+    shared = NULL;
+}
+
+SrsCodecDemuxer::~SrsCodecDemuxer()
+{
+    srs_freep(codec);
+    srs_freep(sample);
+    
+    if (shared) {
+        shared->release();
+    }
+}
+
+SrsCodecFrame* SrsCodecDemuxer::demux_audio(char* data, int size)
+{
+    int ret = ERROR_SUCCESS;
+    
+    sample->clear();
+    if ((ret = codec->audio_aac_demux(data, size, sample)) == ERROR_HLS_TRY_MP3) {
+        ret = codec->audio_mp3_demux(data, size, sample);
+    }
+    
+    if (ret != ERROR_SUCCESS) {
+        srs_info("demux audio failed. ret=%d", ret);
+    }
+    
+    return create_frame(ret);
+}
+
+SrsCodecFrame* SrsCodecDemuxer::demux_video(char* data, int size, bool parse_sps)
+{
+    int ret = ERROR_SUCCESS;
+    
+    // user can disable the sps parse to workaround when parse sps failed.
+    // @see https://github.com/ossrs/srs/issues/474
+    codec->avc_parse_sps = parse_sps;
+    
+    sample->clear();
+    if ((ret = codec->video_avc_demux(data, size, sample)) != ERROR_SUCCESS) {
+        srs_info("demux video failed. ret=%d", ret);
+    }
+    
+    return create_frame(ret);
+}
+
+SrsCodecFrame* SrsCodecDemuxer::create_frame(int error)
+{
+    // copy the codec when changed, the previous frames use the previous one.
+    bool changed = !shared
+        || (sample->is_video && sample->avc_packet_type == SrsCodecVideoAVCTypeSequenceHeader)
+        || (!sample->is_video && sample->aac_packet_type == SrsCodecAudioTypeSequenceHeader)
+        || shared->codec->video_codec_id != codec->video_codec_id
+        || shared->codec->audio_codec_id != codec->audio_codec_id;
+    
+    if (changed) {
+        if (shared) {
+            shared->release();
+        }
+        shared = new SrsSharedCodec(codec);
+    }
+    
+    return new SrsCodecFrame(shared, sample, error);
+}
+
 #endif
 
@@ -31,6 +31,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_core.hpp>
 
 #include <string>
+#include <vector>
+
+#include <srs_kernel_utility.hpp>
 
 class SrsStream;
 
@@ -228,6 +231,21 @@ public:
      * @remark all type of audio is possible, no need to check audio.
      */
     static bool video_is_acceptable(char* data, int size);
+    /**
+     * get the size of NALU length from the h.264 sequence header,
+     * that is, the lengthSizeMinusOne+1 of AVCDecoderConfigurationRecord.
+     * @return 1, 2 or 4, 0 when not h.264 sequence header or invalid.
+     */
+    static int video_nal_length_size(char* data, int size);
+    /**
+     * check whether the video is a disposable frame, which no frame refer to,
+     * that is, the flv disposable inter frame, or the h.264 inter frame
+     * whose VCL NALUs are all with nal_ref_idc 0.
+     * @param nal_length_size the size of NALU length of h.264 stream,
+     *      @see video_nal_length_size(). 0 when unknown, that is, the
+     *      h.264 frame is never disposable without its sequence header.
+     */
+    static bool video_is_disposable(char* data, int size, int nal_length_size);
 };
 
 /**
@@ -544,6 +562,8 @@ class SrsAvcAacCodec
 {
 private:
     SrsStream* stream;
+    // the NALUs of annexb frame, reuse for each frame.
+    std::vector<SrsAnnexbNalu> annexb_nalus;
 public:
     /**
     * metadata specified
@@ -616,6 +636,10 @@ public:
     // whether avc or aac codec sequence header or extra data is decoded ok.
     virtual bool is_avc_codec_ok();
     virtual bool is_aac_codec_ok();
+    /**
+    * copy the codec, the sps, pps and extra data are copied.
+    */
+    virtual SrsAvcAacCodec* copy();
 // the following function used for hls to build the sample and codec.
 public:
     /**
@@ -665,6 +689,114 @@ private:
     virtual int avc_demux_ibmf_format(SrsStream* stream, SrsCodecSample* sample);
 };
 
+/**
+* the codec shared by the frames demuxed by it, which is a copy of
+* codec when it changed, for instance, got a sequence header.
+* @remark the codec is immutable, use retain and release to share it.
+*/
+class SrsSharedCodec
+{
+private:
+    // the count of references, free when 0.
+    int ref_count;
+public:
+    SrsAvcAacCodec* codec;
+public:
+    /**
+    * create the shared codec, copy the codec c, the reference is 1.
+    */
+    SrsSharedCodec(SrsAvcAacCodec* c);
+private:
+    virtual ~SrsSharedCodec();
+public:
+    /**
+    * add a reference.
+    * @return the shared codec itself.
+    */
+    virtual SrsSharedCodec* retain();
+    /**
+    * remove a reference, free when no reference.
+    */
+    virtual void release();
+};
+
+/**
+* the frame demuxed once by source, attached to the shared message,
+* then all muxers of source, such as hls and http-ts, use it without demux.
+* @remark the sample units point to the payload of message, immutable.
+*/
+class SrsCodecFrame
+{
+public:
+    // the error code of demux,
+    // the muxer should fail with it, as demux the frame itself.
+    int error;
+    // the codec when demux the frame.
+    SrsSharedCodec* codec;
+private:
+    // the fields of sample, never keep the sample for it's large.
+    bool is_video;
+    int32_t cts;
+    SrsCodecVideoAVCFrame frame_type;
+    SrsCodecVideoAVCType avc_packet_type;
+    bool has_idr;
+    bool has_aud;
+    bool has_sps_pps;
+    SrsAvcNaluType first_nalu_type;
+    SrsCodecAudio acodec;
+    SrsCodecAudioSampleRate sound_rate;
+    SrsCodecAudioSampleSize sound_size;
+    SrsCodecAudioSoundType sound_type;
+    SrsCodecAudioType aac_packet_type;
+    // the units of sample.
+    int nb_units;
+    SrsCodecSampleUnit* units;
+public:
+    /**
+    * create the frame by the demuxed sample, the units of sample are copied.
+    * @param c the codec when demux the frame, which is retained.
+    */
+    SrsCodecFrame(SrsSharedCodec* c, SrsCodecSample* sample, int err);
+    virtual ~SrsCodecFrame();
+public:
+    /**
+    * restore the demuxed sample, copy the units without demux.
+    */
+    virtual void to_sample(SrsCodecSample* sample);
+};
+
+/**
+* the demuxer of source, demux each audio and video frame once,
+* when codec changed, create a new shared codec for the frames.
+*/
+class SrsCodecDemuxer
+{
+private:
+    SrsAvcAacCodec* codec;
+    SrsCodecSample* sample;
+    // the shared copy of codec for frames.
+    SrsSharedCodec* shared;
+public:
+    SrsCodecDemuxer();
+    virtual ~SrsCodecDemuxer();
+public:
+    /**
+    * demux the aac or mp3 audio.
+    * @return the frame which user must free, never NULL.
+    * @remark the demux error is set in the frame.
+    */
+    virtual SrsCodecFrame* demux_audio(char* data, int size);
+    /**
+    * demux the h.264 video.
+    * @param parse_sps whether parse the sps when got sequence header.
+    * @return the frame which user must free, never NULL.
+    * @remark the demux error is set in the frame.
+    */
+    virtual SrsCodecFrame* demux_video(char* data, int size, bool parse_sps);
+private:
+    virtual SrsCodecFrame* create_frame(int error);
+};
+
 #endif
 
 #endif
@@ -133,6 +133,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 ///////////////////////////////////////////////////////////
 #define SRS_CONSTS_NULL_FILE "/dev/null"
 #define SRS_CONSTS_LOCALHOST "127.0.0.1"
+// the max worker processes for the master/worker mode.
+#define SRS_CONSTS_MAX_WORKERS 256
+// the max native threads of the async io pool.
+#define SRS_CONSTS_MAX_ASYNC_IO_THREADS 64
 
 ///////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////
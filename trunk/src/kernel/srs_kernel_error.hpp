@@ -99,6 +99,11 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define ERROR_SYSTEM_KILL                   1058
 #define ERROR_SYSTEM_DNS_RESOLVE            1059
 #define ERROR_SOCKET_SETKEEPALIVE           1060
+#define ERROR_SYSTEM_FORK                   1061
+#define ERROR_SYSTEM_ASYNC_IO_THREAD        1062
+#define ERROR_SYSTEM_ASYNC_IO_FULL          1063
+#define ERROR_SYSTEM_LOG_THREAD             1064
+#define ERROR_SYSTEM_HANDSHAKE_THREAD       1065
 
 ///////////////////////////////////////////////////////
 // RTMP protocol error.
@@ -267,6 +272,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define ERROR_AVC_NALU_UEV                  4027
 #define ERROR_AAC_BYTES_INVALID             4028
 #define ERROR_HTTP_REQUEST_EOF              4029
+#define ERROR_HTTP_HOOKS_BUSY               4030
 
 ///////////////////////////////////////////////////////
 // HTTP API error.
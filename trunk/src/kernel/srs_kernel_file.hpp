@@ -41,7 +41,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 class SrsFileWriter
 {
-private:
+protected:
     std::string path;
     int fd;
 public:
@@ -109,6 +109,10 @@ public:
     virtual void skip(int64_t size);
     virtual int64_t lseek(int64_t offset);
     virtual int64_t filesize();
+    /**
+     * get the fd of file, for example, to sendfile.
+     */
+    virtual int get_fd();
 public:
     /**
     * read from file. 
@@ -38,6 +38,7 @@ using namespace std;
 #include <srs_kernel_file.hpp>
 #include <srs_kernel_codec.hpp>
 #include <srs_kernel_utility.hpp>
+#include <srs_kernel_slab.hpp>
 #include <srs_core_mem_watch.hpp>
 
 SrsMessageHeader::SrsMessageHeader()
@@ -156,19 +157,17 @@ SrsCommonMessage::SrsCommonMessage()
 {
     payload = NULL;
     size = 0;
+    slab = NULL;
 }
 
 SrsCommonMessage::~SrsCommonMessage()
 {
-#ifdef SRS_AUTO_MEM_WATCH
-    srs_memory_unwatch(payload);
-#endif
-    srs_freepa(payload);
+    free_payload();
 }
 
 void SrsCommonMessage::create_payload(int size)
 {
-    srs_freepa(payload);
+    free_payload();
     
     payload = new char[size];
     srs_verbose("create payload for RTMP message. size=%d", size);
@@ -178,21 +177,94 @@ void SrsCommonMessage::create_payload(int size)
 #endif
 }
 
+void SrsCommonMessage::create_slab_payload(int size)
+{
+    free_payload();
+    
+    slab = SrsSlabAllocator::instance()->alloc(size);
+    payload = slab->data;
+    srs_verbose("create slab payload for RTMP message. size=%d, capacity=%d", size, slab->capacity);
+}
+
+void SrsCommonMessage::attach_slab_payload(SrsSlab* s, char* bytes, int nb_bytes)
+{
+    free_payload();
+    
+    slab = s->retain();
+    payload = bytes;
+    size = nb_bytes;
+}
+
+void SrsCommonMessage::free_payload()
+{
+    if (slab) {
+        slab->release();
+        slab = NULL;
+        payload = NULL;
+        return;
+    }
+    
+#ifdef SRS_AUTO_MEM_WATCH
+    srs_memory_unwatch(payload);
+#endif
+    srs_freepa(payload);
+}
+
+#ifdef SRS_PERF_MSG_POOL
+SrsObjectPool* SrsSharedPtrMessage::SrsSharedPtrPayload::pool = new SrsObjectPool(
+    "RTMP.msg.shared", sizeof(SrsSharedPtrMessage::SrsSharedPtrPayload), SRS_PERF_MSG_POOL_MAX_CACHED
+);
+#endif
+
 SrsSharedPtrMessage::SrsSharedPtrPayload::SrsSharedPtrPayload()
 {
     payload = NULL;
     size = 0;
+    slab = NULL;
     shared_count = 0;
+    chunk_headers = NULL;
+    nb_chunk_headers = 0;
+    flv_tags = NULL;
+    nb_flv_tags = 0;
+    frame = NULL;
 }
 
 SrsSharedPtrMessage::SrsSharedPtrPayload::~SrsSharedPtrPayload()
 {
+    if (slab) {
+        slab->release();
+        payload = NULL;
+    }
+    
 #ifdef SRS_AUTO_MEM_WATCH
     srs_memory_unwatch(payload);
 #endif
     srs_freepa(payload);
+    srs_freepa(chunk_headers);
+    srs_freepa(flv_tags);
+#if !defined(SRS_EXPORT_LIBRTMP)
+    srs_freep(frame);
+#endif
 }
 
+#ifdef SRS_PERF_MSG_POOL
+void* SrsSharedPtrMessage::SrsSharedPtrPayload::operator new(size_t size)
+{
+    return pool->alloc(size);
+}
+
+void SrsSharedPtrMessage::SrsSharedPtrPayload::operator delete(void* p, size_t size)
+{
+    pool->free(p, size);
+}
+#endif
+
+#ifdef SRS_PERF_MSG_POOL
+SrsObjectPool* SrsSharedPtrMessage::pool = new SrsObjectPool(
+    "RTMP.msg.wrapper", sizeof(SrsSharedPtrMessage), SRS_PERF_MSG_POOL_MAX_CACHED
+);
+#endif
+
 SrsSharedPtrMessage::SrsSharedPtrMessage()
 {
     ptr = NULL;
@@ -209,6 +281,18 @@ SrsSharedPtrMessage::~SrsSharedPtrMessage()
     }
 }
 
+#ifdef SRS_PERF_MSG_POOL
+void* SrsSharedPtrMessage::operator new(size_t size)
+{
+    return pool->alloc(size);
+}
+
+void SrsSharedPtrMessage::operator delete(void* p, size_t size)
+{
+    pool->free(p, size);
+}
+#endif
+
 int SrsSharedPtrMessage::create(SrsCommonMessage* msg)
 {
     int ret = ERROR_SUCCESS;
@@ -220,6 +304,8 @@ int SrsSharedPtrMessage::create(SrsCommonMessage* msg)
     // to prevent double free of payload:
     // initialize already attach the payload of msg,
     // detach the payload to transfer the owner to shared ptr.
+    ptr->slab = msg->slab;
+    msg->slab = NULL;
     msg->payload = NULL;
     msg->size = 0;
     
@@ -313,6 +399,141 @@ int SrsSharedPtrMessage::chunk_header(char* cache, int nb_cache, bool c0)
     }
 }
 
+SrsSharedChunkHeader* SrsSharedPtrMessage::shared_chunk_header()
+{
+#if SRS_PERF_CHUNK_HEADER_CACHE > 0
+    srs_assert(ptr);
+    
+    // the c3 only depends on the timestamp when extended,
+    // so the players of different timestamp share the c3.
+    bool extended = (u_int32_t)timestamp >= RTMP_EXTENDED_TIMESTAMP;
+    
+    for (int i = 0; i < ptr->nb_chunk_headers; i++) {
+        SrsSharedChunkHeader* h = &ptr->chunk_headers[i];
+        if (h->stream_id != stream_id || h->extended != extended) {
+            continue;
+        }
+        if (!extended || h->timestamp == timestamp) {
+            return h;
+        }
+    }
+    
+    // never overwrite the cached headers, for it maybe in sending,
+    // let the player build the header when cache is full.
+    if (ptr->nb_chunk_headers >= SRS_PERF_CHUNK_HEADER_CACHE) {
+        return NULL;
+    }
+    
+    if (!ptr->chunk_headers) {
+        ptr->chunk_headers = new SrsSharedChunkHeader[SRS_PERF_CHUNK_HEADER_CACHE];
+    }
+    
+    SrsSharedChunkHeader* h = &ptr->chunk_headers[ptr->nb_chunk_headers++];
+    h->stream_id = stream_id;
+    h->extended = extended;
+    h->timestamp = timestamp;
+    h->nb_c0 = chunk_header(h->c0, SRS_CONSTS_RTMP_MAX_FMT0_HEADER_SIZE, true);
+    h->nb_c3 = chunk_header(h->c3, SRS_CONSTS_RTMP_MAX_FMT3_HEADER_SIZE, false);
+    srs_assert(h->nb_c0 > 0 && h->nb_c3 > 0);
+    
+    return h;
+#else
+    return NULL;
+#endif
+}
+
+SrsSharedFlvTag* SrsSharedPtrMessage::shared_flv_tag()
+{
+#if SRS_PERF_FLV_TAG_CACHE > 0
+    srs_assert(ptr);
+    
+    // the metadata always use timestamp 0, see SrsFlvEncoder::write_metadata_to_cache
+    int64_t key = is_av()? (timestamp & 0x7fffffff) : 0;
+    
+    for (int i = 0; i < ptr->nb_flv_tags; i++) {
+        SrsSharedFlvTag* tag = &ptr->flv_tags[i];
+        if (tag->timestamp == key) {
+            return tag;
+        }
+    }
+    
+    // never overwrite the cached tags, for it maybe in sending.
+    if (ptr->nb_flv_tags >= SRS_PERF_FLV_TAG_CACHE) {
+        return NULL;
+    }
+    
+    if (!ptr->flv_tags) {
+        ptr->flv_tags = new SrsSharedFlvTag[SRS_PERF_FLV_TAG_CACHE];
+    }
+    
+    SrsSharedFlvTag* tag = &ptr->flv_tags[ptr->nb_flv_tags++];
+    tag->timestamp = key;
+    
+    char type = SrsCodecFlvTagScript;
+    if (is_audio()) {
+        type = SrsCodecFlvTagAudio;
+    } else if (is_video()) {
+        type = SrsCodecFlvTagVideo;
+    }
+    
+    // to directly set the field.
+    char* pp = NULL;
+    
+    // 11bytes tag header, @see SrsFlvEncoder::write_video_to_cache
+    char* p = tag->header;
+    *p++ = type;
+    
+    // DataSize UI24, big-endian
+    int32_t data_size = size;
+    pp = (char*)&data_size;
+    *p++ = pp[2];
+    *p++ = pp[1];
+    *p++ = pp[0];
+    
+    // Timestamp UI24 and TimestampExtended UI8
+    int32_t ts = (int32_t)key;
+    pp = (char*)&ts;
+    *p++ = pp[2];
+    *p++ = pp[1];
+    *p++ = pp[0];
+    *p++ = pp[3];
+    
+    // StreamID UI24 Always 0.
+    *p++ = 0x00;
+    *p++ = 0x00;
+    *p++ = 0x00;
+    
+    // PreviousTagSizeN UI32, big-endian
+    int32_t tag_size = SRS_FLV_TAG_HEADER_SIZE + size;
+    pp = (char*)&tag_size;
+    p = tag->pts;
+    *p++ = pp[3];
+    *p++ = pp[2];
+    *p++ = pp[1];
+    *p++ = pp[0];
+    
+    return tag;
+#else
+    return NULL;
+#endif
+}
+
+#if !defined(SRS_EXPORT_LIBRTMP)
+void SrsSharedPtrMessage::set_frame(SrsCodecFrame* f)
+{
+    srs_assert(ptr);
+    
+    srs_freep(ptr->frame);
+    ptr->frame = f;
+}
+
+SrsCodecFrame* SrsSharedPtrMessage::frame()
+{
+    srs_assert(ptr);
+    return ptr->frame;
+}
+#endif
+
 SrsSharedPtrMessage* SrsSharedPtrMessage::copy()
 {
     srs_assert(ptr);
@@ -518,6 +739,19 @@ int SrsFlvEncoder::write_tags(SrsSharedPtrMessage** msgs, int count)
     for (int i = 0; i < count; i++) {
         SrsSharedPtrMessage* msg = msgs[i];
         
+        // use the flv tag shared by all players when possible.
+        SrsSharedFlvTag* tag = msg->shared_flv_tag();
+        if (tag) {
+            iovs[0].iov_base = tag->header;
+            iovs[0].iov_len = SRS_FLV_TAG_HEADER_SIZE;
+            iovs[1].iov_base = msg->payload;
+            iovs[1].iov_len = msg->size;
+            iovs[2].iov_base = tag->pts;
+            iovs[2].iov_len = SRS_FLV_PREVIOUS_TAG_SIZE;
+            iovs += 3;
+            continue;
+        }
+        
         // cache all flv header.
         if (msg->is_audio()) {
             if ((ret = write_audio_to_cache(msg->timestamp, msg->payload, msg->size, cache)) != ERROR_SUCCESS) {
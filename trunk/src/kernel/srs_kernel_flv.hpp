@@ -31,6 +31,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <string>
 
+#include <srs_kernel_consts.hpp>
+
 // for srs-librtmp, @see https://github.com/ossrs/srs/issues/213
 #ifndef _WIN32
 #include <sys/uio.h>
@@ -39,6 +41,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 class SrsStream;
 class SrsFileWriter;
 class SrsFileReader;
+class SrsSlab;
+class SrsObjectPool;
+class SrsCodecFrame;
 
 #define SRS_FLV_TAG_HEADER_SIZE 11
 #define SRS_FLV_PREVIOUS_TAG_SIZE 4
@@ -281,6 +286,11 @@ public:
      *       video/audio packet use raw bytes, no video/audio packet.
      */
     char* payload;
+    /**
+     * the slab which the payload point to, NULL when payload alloc by new[].
+     * @remark user should never detach the payload in slab.
+     */
+    SrsSlab* slab;
 public:
     SrsCommonMessage();
     virtual ~SrsCommonMessage();
@@ -289,6 +299,19 @@ public:
      * alloc the payload to specified size of bytes.
      */
     virtual void create_payload(int size);
+    /**
+     * alloc the payload in slab, to specified size of bytes.
+     */
+    virtual void create_slab_payload(int size);
+    /**
+     * point the payload to the bytes in slab, without copy.
+     * @param s the slab of bytes, which is retained by message.
+     * @param bytes the bytes in slab.
+     * @param nb_bytes the size of bytes, that is, the size of message.
+     */
+    virtual void attach_slab_payload(SrsSlab* s, char* bytes, int nb_bytes);
+private:
+    virtual void free_payload();
 };
 
 /**
@@ -317,6 +340,49 @@ struct SrsSharedMessageHeader
     int perfer_cid;
 };
 
+/**
+ * the pre-serialized chunk headers of shared ptr message,
+ * the fmt0(c0) header for the first chunk and fmt3(c3) for others,
+ * which only depends on the timestamp and stream id, for the chunk size
+ * only decides how many c3 headers to send.
+ * the c3 header only contains the timestamp when it's extended, so it's
+ * keyed by stream id and the extended timestamp, shared by all players
+ * even the timestamp of player is corrected by jitter, while the c0 is
+ * shared only by the players of the same timestamp, others build the c0.
+ * @remark it's immutable once built, for the iovs of some player
+ *       maybe reference it when writev is blocked.
+ */
+struct SrsSharedChunkHeader
+{
+    // the key of the cached headers, the timestamp is the key
+    // only when extended, that is, not less than RTMP_EXTENDED_TIMESTAMP.
+    int32_t stream_id;
+    bool extended;
+    int64_t timestamp;
+    // the fmt0 header, of the timestamp.
+    int nb_c0;
+    char c0[SRS_CONSTS_RTMP_MAX_FMT0_HEADER_SIZE];
+    // the fmt3 header.
+    int nb_c3;
+    char c3[SRS_CONSTS_RTMP_MAX_FMT3_HEADER_SIZE];
+};
+
+/**
+ * the pre-serialized flv tag header and previous tag size of shared ptr message,
+ * which only depends on the timestamp, for the type and size is fixed,
+ * so all http flv players of a source reuse it rather than build for each tag.
+ * @remark it's immutable once built, like SrsSharedChunkHeader.
+ */
+struct SrsSharedFlvTag
+{
+    // the key of the cached tag.
+    int64_t timestamp;
+    // the 11bytes tag header.
+    char header[SRS_FLV_TAG_HEADER_SIZE];
+    // the 4bytes previous tag size.
+    char pts[SRS_FLV_PREVIOUS_TAG_SIZE];
+};
+
 /**
  * shared ptr message.
  * for audio/video/data message that need less memory copy.
@@ -372,16 +438,51 @@ private:
         char* payload;
         // size of payload.
         int size;
+        // the slab which payload point to, NULL when payload alloc by new[].
+        SrsSlab* slab;
         // the reference count
         int shared_count;
+        // the chunk headers shared by all players,
+        // lazy alloc when the message first sent over RTMP.
+        SrsSharedChunkHeader* chunk_headers;
+        int nb_chunk_headers;
+        // the flv tags shared by all players,
+        // lazy alloc when the message first sent over HTTP FLV.
+        SrsSharedFlvTag* flv_tags;
+        int nb_flv_tags;
+        // the frame demuxed by source, NULL when not demuxed.
+        SrsCodecFrame* frame;
+#ifdef SRS_PERF_MSG_POOL
+    private:
+        static SrsObjectPool* pool;
+#endif
     public:
         SrsSharedPtrPayload();
         virtual ~SrsSharedPtrPayload();
+#ifdef SRS_PERF_MSG_POOL
+    public:
+        static void* operator new(size_t size);
+        static void operator delete(void* p, size_t size);
+#endif
     };
     SrsSharedPtrPayload* ptr;
+#ifdef SRS_PERF_MSG_POOL
+private:
+    static SrsObjectPool* pool;
+#endif
 public:
     SrsSharedPtrMessage();
     virtual ~SrsSharedPtrMessage();
+#ifdef SRS_PERF_MSG_POOL
+public:
+    /**
+     * alloc the message from pool, for the copy() new one for each player,
+     * which is freed when sent.
+     * @see SRS_PERF_MSG_POOL
+     */
+    static void* operator new(size_t size);
+    static void operator delete(void* p, size_t size);
+#endif
 public:
     /**
      * create shared ptr message,
@@ -420,6 +521,37 @@ public:
      * @return the size of header.
      */
     virtual int chunk_header(char* cache, int nb_cache, bool c0);
+    /**
+     * get the chunk headers shared by all copies of this message,
+     * build it when no cached headers match the stream id and extended timestamp.
+     * @return the shared headers, NULL when cache is full or disabled,
+     *       user should use chunk_header() to build the header itself.
+     * @remark the c0 of headers is for the timestamp of headers, user
+     *       should build the c0 itself when its timestamp is not the same.
+     * @remark the headers are freed when the payload is freed.
+     */
+    virtual SrsSharedChunkHeader* shared_chunk_header();
+    /**
+     * get the flv tag header and previous tag size shared by all copies of this message,
+     * build it when no cached tag matches the timestamp.
+     * @return the shared tag, NULL when cache is full or disabled,
+     *       user should build the tag header itself.
+     * @remark the tags are freed when the payload is freed.
+     */
+    virtual SrsSharedFlvTag* shared_flv_tag();
+#if !defined(SRS_EXPORT_LIBRTMP)
+    /**
+     * attach the frame demuxed once by source, shared by all copies of this message.
+     * @param f the frame which is freed when the payload is freed.
+     * @remark only set once, before the message is copied to muxers.
+     */
+    virtual void set_frame(SrsCodecFrame* f);
+    /**
+     * get the frame demuxed by source.
+     * @return the frame, NULL when not demuxed, user should demux it itself.
+     */
+    virtual SrsCodecFrame* frame();
+#endif
 public:
     /**
      * copy current shared ptr message, use ref-count.
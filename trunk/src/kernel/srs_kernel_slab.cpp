@@ -0,0 +1,297 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#include <srs_kernel_slab.hpp>
+
+#include <stdio.h>
+#include <algorithm>
+using namespace std;
+
+#include <srs_core_performance.hpp>
+#include <srs_core_mem_watch.hpp>
+
+// the min and max size of classes, power of 2.
+#define SRS_SLAB_MIN_CLASS 256
+#define SRS_SLAB_MAX_CLASS 262144
+
+SrsSlab::SrsSlab(int size, int sc)
+{
+    data = new char[size];
+    capacity = size;
+    size_class = sc;
+    ref_count = 1;
+}
+
+SrsSlab::~SrsSlab()
+{
+    srs_freepa(data);
+}
+
+SrsSlab* SrsSlab::retain()
+{
+    ref_count++;
+    return this;
+}
+
+void SrsSlab::release()
+{
+    srs_assert(ref_count > 0);
+    
+    if (--ref_count > 0) {
+        return;
+    }
+    
+    SrsSlabAllocator::instance()->free(this);
+}
+
+bool SrsSlab::shared()
+{
+    return ref_count > 1;
+}
+
+SrsSlabAllocator* SrsSlabAllocator::_instance = new SrsSlabAllocator();
+
+SrsSlabAllocator::SrsSlabAllocator()
+{
+    cached_bytes = 0;
+    nb_used = 0;
+    used_bytes = 0;
+    
+    // for each power of 2, the size p, 1.25p, 1.5p and 1.75p.
+    for (int p = SRS_SLAB_MIN_CLASS; p < SRS_SLAB_MAX_CLASS; p *= 2) {
+        classes.push_back(p);
+        classes.push_back(p + p / 4);
+        classes.push_back(p + p / 2);
+        classes.push_back(p + p / 4 * 3);
+    }
+    classes.push_back(SRS_SLAB_MAX_CLASS);
+    
+    frees.resize(classes.size());
+}
+
+SrsSlabAllocator::~SrsSlabAllocator()
+{
+    for (int i = 0; i < (int)frees.size(); i++) {
+        std::vector<SrsSlab*>& slabs = frees[i];
+        
+        std::vector<SrsSlab*>::iterator it;
+        for (it = slabs.begin(); it != slabs.end(); ++it) {
+            SrsSlab* slab = *it;
+            srs_freep(slab);
+        }
+        slabs.clear();
+    }
+}
+
+SrsSlabAllocator* SrsSlabAllocator::instance()
+{
+    return _instance;
+}
+
+SrsSlab* SrsSlabAllocator::alloc(int size)
+{
+    srs_assert(size >= 0);
+    
+    SrsSlab* slab = NULL;
+    
+    if (size > SRS_SLAB_MAX_CLASS) {
+        // the huge slab, alloc directly.
+        slab = new SrsSlab(size, -1);
+    } else {
+        int sc = (int)(std::lower_bound(classes.begin(), classes.end(), size) - classes.begin());
+        std::vector<SrsSlab*>& slabs = frees[sc];
+        
+        if (slabs.empty()) {
+            slab = new SrsSlab(classes[sc], sc);
+        } else {
+            slab = slabs.back();
+            slabs.pop_back();
+            cached_bytes -= slab->capacity;
+            slab->ref_count = 1;
+        }
+    }
+    
+    nb_used++;
+    used_bytes += slab->capacity;
+    
+    return slab;
+}
+
+int64_t SrsSlabAllocator::cached()
+{
+    return cached_bytes;
+}
+
+int SrsSlabAllocator::used_slabs()
+{
+    return nb_used;
+}
+
+int64_t SrsSlabAllocator::used()
+{
+    return used_bytes;
+}
+
+void SrsSlabAllocator::free(SrsSlab* slab)
+{
+    nb_used--;
+    used_bytes -= slab->capacity;
+    
+    // free the huge slab, or when cache is full.
+    if (slab->size_class < 0 || cached_bytes + slab->capacity > SRS_PERF_SLAB_MAX_CACHED) {
+        srs_freep(slab);
+        return;
+    }
+    
+    frees[slab->size_class].push_back(slab);
+    cached_bytes += slab->capacity;
+}
+
+bool SrsObjectPool::enabled = false;
+
+SrsObjectPool::SrsObjectPool(string n, size_t s, int max)
+{
+    name = n;
+    size = s;
+    max_cached = max;
+    nb_used = 0;
+    nb_allocs = 0;
+    nb_hits = 0;
+    
+    pools().push_back(this);
+}
+
+SrsObjectPool::~SrsObjectPool()
+{
+    std::vector<void*>::iterator it;
+    for (it = frees.begin(); it != frees.end(); ++it) {
+        ::operator delete(*it);
+    }
+    frees.clear();
+    
+    std::vector<SrsObjectPool*>& v = pools();
+    std::vector<SrsObjectPool*>::iterator pit = std::find(v.begin(), v.end(), this);
+    if (pit != v.end()) {
+        v.erase(pit);
+    }
+}
+
+void SrsObjectPool::enable()
+{
+    enabled = true;
+}
+
+std::vector<SrsObjectPool*>& SrsObjectPool::pools()
+{
+    // the pools are created when static initialize,
+    // so use the local static which initialized when first use.
+    static std::vector<SrsObjectPool*> v;
+    return v;
+}
+
+void SrsObjectPool::report()
+{
+    printf("srs object pools report:\n");
+    
+    std::vector<SrsObjectPool*>& v = pools();
+    std::vector<SrsObjectPool*>::iterator it;
+    for (it = v.begin(); it != v.end(); ++it) {
+        SrsObjectPool* pool = *it;
+        printf("    %s: %dB, used %d, cached %d, allocs %"PRId64", hits %"PRId64"\n",
+            pool->name.c_str(), (int)pool->size, pool->nb_used, (int)pool->frees.size(),
+            pool->nb_allocs, pool->nb_hits);
+    }
+}
+
+void* SrsObjectPool::alloc(size_t s)
+{
+    if (!enabled || s != size) {
+        return ::operator new(s);
+    }
+    
+    void* p = NULL;
+    
+    if (frees.empty()) {
+        p = ::operator new(s);
+    } else {
+        p = frees.back();
+        frees.pop_back();
+        nb_hits++;
+    }
+    
+    nb_allocs++;
+    nb_used++;
+    
+#ifdef SRS_AUTO_MEM_WATCH
+    srs_memory_watch(p, name, (int)s);
+#endif
+    
+    return p;
+}
+
+void SrsObjectPool::free(void* p, size_t s)
+{
+    if (!p) {
+        return;
+    }
+    
+    if (!enabled || s != size) {
+        ::operator delete(p);
+        return;
+    }
+    
+#ifdef SRS_AUTO_MEM_WATCH
+    srs_memory_unwatch(p);
+#endif
+    
+    nb_used--;
+    
+    // free when cache is full.
+    if ((int)frees.size() >= max_cached) {
+        ::operator delete(p);
+        return;
+    }
+    
+    frees.push_back(p);
+}
+
+int SrsObjectPool::used()
+{
+    return nb_used;
+}
+
+int SrsObjectPool::cached()
+{
+    return (int)frees.size();
+}
+
+int64_t SrsObjectPool::allocs()
+{
+    return nb_allocs;
+}
+
+int64_t SrsObjectPool::hits()
+{
+    return nb_hits;
+}
@@ -0,0 +1,192 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+
+#ifndef SRS_KERNEL_SLAB_HPP
+#define SRS_KERNEL_SLAB_HPP
+
+/*
+#include <srs_kernel_slab.hpp>
+*/
+
+#include <srs_core.hpp>
+
+#include <string>
+#include <vector>
+
+/**
+* a block of memory from the slab allocator, shared by reference count,
+* for instance, the payload of message, or the receive buffer which the
+* payload of message in one chunk point to.
+* @remark the slab is not thread-safe, only use it in st threads.
+*/
+class SrsSlab
+{
+    friend class SrsSlabAllocator;
+public:
+    // the memory of slab, never changed.
+    char* data;
+    // the size of data, not less than the size to alloc.
+    int capacity;
+private:
+    // the index of size class, -1 for the huge slab never cached.
+    int size_class;
+    // the count of references, return to allocator when 0.
+    int ref_count;
+private:
+    SrsSlab(int size, int sc);
+    virtual ~SrsSlab();
+public:
+    /**
+    * add a reference of slab.
+    * @return the slab itself.
+    */
+    virtual SrsSlab* retain();
+    /**
+    * remove a reference of slab, return to allocator when no reference.
+    * @remark user should never use the slab after release.
+    */
+    virtual void release();
+    /**
+    * whether the slab is referenced by others.
+    */
+    virtual bool shared();
+};
+
+/**
+* the allocator of slabs in size classes, 4 classes for each power of 2
+* from 256B to 256KB, so the wasted memory is less than 25%.
+* the released slabs are cached to reuse, and the size larger than
+* the max class is allocated directly.
+*/
+class SrsSlabAllocator
+{
+    friend class SrsSlab;
+private:
+    static SrsSlabAllocator* _instance;
+private:
+    // the size of each class, ascending.
+    std::vector<int> classes;
+    // the free slabs of each class.
+    std::vector< std::vector<SrsSlab*> > frees;
+    // the total bytes of free slabs.
+    int64_t cached_bytes;
+    // the number and total bytes of slabs used by user.
+    int nb_used;
+    int64_t used_bytes;
+private:
+    SrsSlabAllocator();
+public:
+    virtual ~SrsSlabAllocator();
+public:
+    static SrsSlabAllocator* instance();
+public:
+    /**
+    * alloc a slab which capacity not less than size, the reference is 1.
+    * @remark user must release the slab.
+    */
+    virtual SrsSlab* alloc(int size);
+    /**
+    * the total bytes of cached free slabs.
+    */
+    virtual int64_t cached();
+    /**
+    * the number of slabs used by user, not released.
+    */
+    virtual int used_slabs();
+    /**
+    * the total bytes of slabs used by user, not released.
+    */
+    virtual int64_t used();
+private:
+    virtual void free(SrsSlab* slab);
+};
+
+/**
+* the pool of objects in the same size, for instance, the wrappers of shared
+* ptr message which are new for each player of each frame and freed when sent,
+* the freed memory is cached to reuse rather than return to system.
+* @remark the pool is disabled until the server enable it, for the srs-librtmp
+*       maybe used in multiple threads, while the pool is not thread-safe.
+*/
+class SrsObjectPool
+{
+private:
+    static bool enabled;
+private:
+    // the name of pool, the category for memory watch.
+    std::string name;
+    // the size of object in pool.
+    size_t size;
+    // the max number of free objects to cache.
+    int max_cached;
+    // the free objects to reuse.
+    std::vector<void*> frees;
+    // the number of objects used by user, not freed.
+    int nb_used;
+    // the number of allocs, and the allocs reuse the free objects.
+    int64_t nb_allocs;
+    int64_t nb_hits;
+public:
+    SrsObjectPool(std::string n, size_t s, int max);
+    virtual ~SrsObjectPool();
+public:
+    /**
+    * enable all pools of process, only for st threads.
+    */
+    static void enable();
+    /**
+    * all pools of process, for the stat and report.
+    */
+    static std::vector<SrsObjectPool*>& pools();
+    /**
+    * print the stat of all pools, for memory watch.
+    */
+    static void report();
+public:
+    /**
+    * alloc the memory of object, use system for the object larger than
+    * size of pool, for instance, the derived class.
+    */
+    virtual void* alloc(size_t s);
+    /**
+    * free the memory of object, which must alloc by this pool.
+    */
+    virtual void free(void* p, size_t s);
+public:
+    /**
+    * the number of objects used by user, not freed.
+    */
+    virtual int used();
+    /**
+    * the number of cached free objects.
+    */
+    virtual int cached();
+    /**
+    * the total number of allocs, and the allocs which reuse the cached.
+    */
+    virtual int64_t allocs();
+    virtual int64_t hits();
+};
+
+#endif
@@ -79,6 +79,7 @@ SrsTsChannel::SrsTsChannel()
     apply = SrsTsPidApplyReserved;
     stream = SrsTsStreamReserved;
     msg = NULL;
+    spare = NULL;
     continuity_counter = 0;
     context = NULL;
 }
@@ -86,6 +87,7 @@ SrsTsChannel::SrsTsChannel()
 SrsTsChannel::~SrsTsChannel()
 {
     srs_freep(msg);
+    srs_freep(spare);
 }
 
 SrsTsMessage::SrsTsMessage(SrsTsChannel* c, SrsTsPacket* p)
@@ -206,10 +208,16 @@ SrsTsContext::SrsTsContext()
     pure_audio = false;
     vcodec = SrsCodecVideoReserved;
     acodec = SrsCodecAudioReserved1;
+    pes_packets = NULL;
+    nb_pes_packets = 0;
+    packet = new SrsTsPacket(this);
 }
 
 SrsTsContext::~SrsTsContext()
 {
+    srs_freepa(pes_packets);
+    srs_freep(packet);
+    
     std::map<int, SrsTsChannel*>::iterator it;
     for (it = pids.begin(); it != pids.end(); ++it) {
         SrsTsChannel* channel = it->second;
@@ -275,8 +283,10 @@ int SrsTsContext::decode(SrsStream* stream, ISrsTsHandler* handler)
     // parse util EOF of stream.
     // for example, parse multiple times for the PES_packet_length(0) packet.
     while (!stream->empty()) {
-        SrsTsPacket* packet = new SrsTsPacket(this);
-        SrsAutoFree(SrsTsPacket, packet);
+        // most packets are the continuous PES, append in place.
+        if (decode_continuous(stream)) {
+            continue;
+        }
 
         SrsTsMessage* msg = NULL;
         if ((ret = packet->decode(stream, &msg)) != ERROR_SUCCESS) {
@@ -289,7 +299,17 @@ int SrsTsContext::decode(SrsStream* stream, ISrsTsHandler* handler)
         }
         SrsAutoFree(SrsTsMessage, msg);
 
-        if ((ret = handler->on_ts_message(msg)) != ERROR_SUCCESS) {
+        ret = handler->on_ts_message(msg);
+
+        // keep the payload for the next PES of pid, when not detached.
+        SrsTsChannel* channel = msg->channel;
+        if (msg->payload && channel && !channel->spare) {
+            msg->payload->erase(msg->payload->length());
+            channel->spare = msg->payload;
+            msg->payload = NULL;
+        }
+
+        if (ret != ERROR_SUCCESS) {
             srs_error("mpegts: handler ts message failed. ret=%d", ret);
             return ret;
         }
@@ -298,6 +318,70 @@ int SrsTsContext::decode(SrsStream* stream, ISrsTsHandler* handler)
     return ret;
 }
 
+bool SrsTsContext::decode_continuous(SrsStream* stream)
+{
+    if (!stream->require(SRS_TS_PACKET_SIZE)) {
+        return false;
+    }
+    u_int8_t* p = (u_int8_t*)stream->data() + stream->pos();
+
+    // the sync_byte, and payload_unit_start_indicator must be 0.
+    if (p[0] != 0x47 || (p[1] & 0x40) != 0) {
+        return false;
+    }
+
+    int pid = ((p[1] & 0x1f) << 8) | p[2];
+    std::map<int, SrsTsChannel*>::iterator it = pids.find(pid);
+    if (it == pids.end()) {
+        return false;
+    }
+
+    SrsTsChannel* channel = it->second;
+    if (channel->apply != SrsTsPidApplyVideo && channel->apply != SrsTsPidApplyAudio) {
+        return false;
+    }
+
+    // the PES must be started and not completed,
+    // the PES decoder reaps it or drops the packet.
+    SrsTsMessage* msg = channel->msg;
+    if (!msg || msg->fresh() || msg->completed(0)) {
+        return false;
+    }
+
+    // the duplicated or lost packet, by the PES decoder.
+    u_int8_t continuity_counter = p[3] & 0x0f;
+    if (((msg->continuity_counter + 1) & 0x0f) != continuity_counter) {
+        return false;
+    }
+
+    // skip the adaptation field, which is not used by decoder,
+    // the invalid one is checked by the af decoder.
+    int nb_header = 4;
+    SrsTsAdaptationFieldType adaption_field_control = (SrsTsAdaptationFieldType)((p[3] >> 4) & 0x03);
+    if (adaption_field_control == SrsTsAdaptationFieldTypeBoth) {
+        if (p[4] > 182) {
+            return false;
+        }
+        nb_header += 1 + p[4];
+    } else if (adaption_field_control != SrsTsAdaptationFieldTypePayloadOnly) {
+        return false;
+    }
+
+    msg->continuity_counter = continuity_counter;
+
+    // @see SrsTsMessage::dump
+    int nb_bytes = SRS_TS_PACKET_SIZE - nb_header;
+    if (msg->PES_packet_length > 0) {
+        nb_bytes = srs_min(nb_bytes, msg->PES_packet_length - msg->payload->length());
+    }
+    if (nb_bytes > 0) {
+        msg->payload->append((char*)p + nb_header, nb_bytes);
+    }
+    stream->skip(SRS_TS_PACKET_SIZE);
+
+    return true;
+}
+
 int SrsTsContext::encode(SrsFileWriter* writer, SrsTsMessage* msg, SrsCodecVideo vc, SrsCodecAudio ac)
 {
     int ret = ERROR_SUCCESS;
@@ -470,85 +554,185 @@ int SrsTsContext::encode_pes(SrsFileWriter* writer, SrsTsMessage* msg, int16_t p
     char* start = msg->payload->bytes();
     char* end = start + msg->payload->length();
     char* p = start;
-
+    
+    // write pcr according to message.
+    bool write_pcr = msg->write_pcr;
+    
+    // for pure audio, always write pcr.
+    // TODO: FIXME: maybe only need to write at begin and end of ts.
+    if (pure_audio && msg->is_audio()) {
+        write_pcr = true;
+    }
+    
+    // it's ok to set pcr equals to dts,
+    // @see https://github.com/ossrs/srs/issues/311
+    // Fig. 3.18. Program Clock Reference of Digital-Video-and-Audio-Broadcasting-Technology, page 65
+    // In MPEG-2, these are the "Program Clock Refer- ence" (PCR) values which are
+    // nothing else than an up-to-date copy of the STC counter fed into the transport
+    // stream at a certain time. The data stream thus carries an accurate internal
+    // "clock time". All coding and de- coding processes are controlled by this clock
+    // time. To do this, the receiver, i.e. the MPEG decoder, must read out the
+    // "clock time", namely the PCR values, and compare them with its own internal
+    // system clock, that is to say its own 42 bit counter.
+    int64_t pcr = write_pcr? msg->dts : -1;
+    
+    // the first packet carries at least the payload of a packet without
+    // the 8B adaptation field and 19B PES header, the others carry more,
+    // and one more packet for the 1B stuffing which requires 2B af.
+    int nb_max = (msg->payload->length() / (SRS_TS_PACKET_SIZE - 4 - 8 - 19) + 2) * SRS_TS_PACKET_SIZE;
+    if (nb_max > nb_pes_packets) {
+        srs_freepa(pes_packets);
+        pes_packets = new char[nb_max];
+        nb_pes_packets = nb_max;
+    }
+    
+    // packetize all ts packets of the PES to the buffer, write it at once.
+    char* buf = pes_packets;
     while (p < end) {
-        SrsTsPacket* pkt = NULL;
+        // the first packet write PES header, and the af when write pcr.
+        int nb_af = 0;
+        int nb_pes = 0;
         if (p == start) {
-            // write pcr according to message.
-            bool write_pcr = msg->write_pcr;
-            
-            // for pure audio, always write pcr.
-            // TODO: FIXME: maybe only need to write at begin and end of ts.
-            if (pure_audio && msg->is_audio()) {
-                write_pcr = true;
-            }
-
-            // it's ok to set pcr equals to dts,
-            // @see https://github.com/ossrs/srs/issues/311
-            // Fig. 3.18. Program Clock Reference of Digital-Video-and-Audio-Broadcasting-Technology, page 65
-            // In MPEG-2, these are the "Program Clock Refer- ence" (PCR) values which are
-            // nothing else than an up-to-date copy of the STC counter fed into the transport
-            // stream at a certain time. The data stream thus carries an accurate internal
-            // "clock time". All coding and de- coding processes are controlled by this clock
-            // time. To do this, the receiver, i.e. the MPEG decoder, must read out the
-            // "clock time", namely the PCR values, and compare them with its own internal
-            // system clock, that is to say its own 42 bit counter.
-            int64_t pcr = write_pcr? msg->dts : -1;
-            
-            // TODO: FIXME: finger it why use discontinuity of msg.
-            pkt = SrsTsPacket::create_pes_first(this, 
-                pid, msg->sid, channel->continuity_counter++, msg->is_discontinuity,
-                pcr, msg->dts, msg->pts, msg->payload->length()
-            );
-        } else {
-            pkt = SrsTsPacket::create_pes_continue(this, 
-                pid, msg->sid, channel->continuity_counter++
-            );
+            nb_af = (pcr >= 0)? 2 + 6 : 0;
+            nb_pes = 9 + ((msg->dts == msg->pts)? 5 : 10);
         }
-        SrsAutoFree(SrsTsPacket, pkt);
-
-        char* buf = new char[SRS_TS_PACKET_SIZE];
-        SrsAutoFreeA(char, buf);
-
-        // set the left bytes with 0xFF.
-        int nb_buf = pkt->size();
-        srs_assert(nb_buf < SRS_TS_PACKET_SIZE);
-
-        int left = (int)srs_min(end - p, SRS_TS_PACKET_SIZE - nb_buf);
-        int nb_stuffings = SRS_TS_PACKET_SIZE - nb_buf - left;
+        
+        int nb_header = 4 + nb_af + nb_pes;
+        int left = (int)srs_min(end - p, SRS_TS_PACKET_SIZE - nb_header);
+        int nb_stuffings = SRS_TS_PACKET_SIZE - nb_header - left;
         if (nb_stuffings > 0) {
-            // set all bytes to stuffings.
-            memset(buf, 0xFF, SRS_TS_PACKET_SIZE);
-
-            // padding with stuffings.
-            pkt->padding(nb_stuffings);
-
-            // size changed, recalc it.
-            nb_buf = pkt->size();
-            srs_assert(nb_buf < SRS_TS_PACKET_SIZE);
-
-            left = (int)srs_min(end - p, SRS_TS_PACKET_SIZE - nb_buf);
-            nb_stuffings = SRS_TS_PACKET_SIZE - nb_buf - left;
-            srs_assert(nb_stuffings == 0);
+            // the af without pcr consumes 2B of stuffings.
+            if (nb_af == 0) {
+                nb_af = 2;
+                nb_stuffings = srs_max(0, nb_stuffings - 2);
+            }
+            nb_af += nb_stuffings;
+            
+            nb_header = 4 + nb_af + nb_pes;
+            left = (int)srs_min(end - p, SRS_TS_PACKET_SIZE - nb_header);
         }
-        memcpy(buf + nb_buf, p, left);
+        srs_assert(nb_header + left == SRS_TS_PACKET_SIZE);
+        
+        encode_pes_header(buf, msg, pid, channel->continuity_counter++, p == start, pcr, nb_af);
+        memcpy(buf + nb_header, p, left);
+        
         p += left;
+        buf += SRS_TS_PACKET_SIZE;
+    }
+    
+    if ((ret = writer->write(pes_packets, buf - pes_packets, NULL)) != ERROR_SUCCESS) {
+        srs_error("ts write ts packets failed. ret=%d", ret);
+        return ret;
+    }
 
-        SrsStream stream;
-        if ((ret = stream.initialize(buf, nb_buf)) != ERROR_SUCCESS) {
-            return ret;
+    return ret;
+}
+
+void SrsTsContext::encode_pes_header(char* buf, SrsTsMessage* msg, int16_t pid, u_int8_t continuity_counter, bool first, int64_t pcr, int nb_af)
+{
+    char* p = buf;
+    
+    // 4B ts packet header, @see SrsTsPacket::encode
+    int16_t pidv = pid & 0x1FFF;
+    pidv |= first? 0x4000 : 0;
+    
+    SrsTsAdaptationFieldType afc = nb_af? SrsTsAdaptationFieldTypeBoth : SrsTsAdaptationFieldTypePayloadOnly;
+    int8_t ccv = continuity_counter & 0x0F;
+    ccv |= (afc << 4) & 0x30;
+    
+    *p++ = 0x47;
+    *p++ = (char)(pidv >> 8);
+    *p++ = (char)pidv;
+    *p++ = ccv;
+    
+    // optional: adaptation field, @see SrsTsAdaptationField::encode
+    if (nb_af) {
+        bool write_pcr = first && pcr >= 0;
+        
+        int8_t tmpv = 0;
+        if (write_pcr) {
+            tmpv |= (msg->is_discontinuity << 7) & 0x80;
+            tmpv |= 0x10;
         }
-        if ((ret = pkt->encode(&stream)) != ERROR_SUCCESS) {
-            srs_error("ts encode ts packet failed. ret=%d", ret);
-            return ret;
+        
+        *p++ = (char)(nb_af - 1);
+        *p++ = tmpv;
+        
+        if (write_pcr) {
+            // @remark, use pcr base and ignore the extension
+            // @see https://github.com/ossrs/srs/issues/250#issuecomment-71349370
+            int64_t pcrv = (0x3F << 9) & 0x7E00;
+            pcrv |= (pcr << 15) & 0xFFFFFFFF8000LL;
+            
+            *p++ = (char)(pcrv >> 40);
+            *p++ = (char)(pcrv >> 32);
+            *p++ = (char)(pcrv >> 24);
+            *p++ = (char)(pcrv >> 16);
+            *p++ = (char)(pcrv >> 8);
+            *p++ = (char)pcrv;
         }
-        if ((ret = writer->write(buf, SRS_TS_PACKET_SIZE, NULL)) != ERROR_SUCCESS) {
-            srs_error("ts write ts packet failed. ret=%d", ret);
-            return ret;
+        
+        // the stuffings.
+        int nb_stuffings = (int)(buf + 4 + nb_af - p);
+        memset(p, 0xFF, nb_stuffings);
+        p += nb_stuffings;
+    }
+    
+    if (!first) {
+        return;
+    }
+    
+    // PES header, @see SrsTsPayloadPES::encode
+    int8_t PTS_DTS_flags = (msg->dts == msg->pts)? 0x02 : 0x03;
+    int8_t PES_header_data_length = (PTS_DTS_flags == 0x02)? 5 : 10;
+    
+    int size = msg->payload->length();
+    int32_t pplv = 0;
+    if (size <= 0xFFFF) {
+        pplv = size + 3 + PES_header_data_length;
+        pplv = (pplv > 0xFFFF)? 0 : pplv;
+    }
+    
+    *p++ = 0x00;
+    *p++ = 0x00;
+    *p++ = 0x01;
+    *p++ = (char)msg->sid;
+    *p++ = (char)(pplv >> 8);
+    *p++ = (char)pplv;
+    // const2bits '10'.
+    *p++ = (char)0x80;
+    *p++ = (PTS_DTS_flags << 6) & 0xC0;
+    *p++ = PES_header_data_length;
+    
+    encode_33bits_dts_pts(p, PTS_DTS_flags, msg->pts);
+    p += 5;
+    
+    if (PTS_DTS_flags == 0x03) {
+        encode_33bits_dts_pts(p, 0x01, msg->dts);
+        p += 5;
+        
+        // check sync, the diff of dts and pts should never greater than 1s.
+        if (msg->dts - msg->pts > 90000 || msg->pts - msg->dts > 90000) {
+            srs_warn("ts: sync dts=%"PRId64", pts=%"PRId64, msg->dts, msg->pts);
         }
     }
+}
 
-    return ret;
+void SrsTsContext::encode_33bits_dts_pts(char* p, u_int8_t fb, int64_t v)
+{
+    // @see SrsTsPayloadPES::encode_33bits_dts_pts
+    int32_t val = 0;
+    
+    val = fb << 4 | (((v >> 30) & 0x07) << 1) | 1;
+    *p++ = val;
+    
+    val = (((v >> 15) & 0x7fff) << 1) | 1;
+    *p++ = (val >> 8);
+    *p++ = val;
+    
+    val = (((v) & 0x7fff) << 1) | 1;
+    *p++ = (val >> 8);
+    *p++ = val;
 }
 
 SrsTsPacket::SrsTsPacket(SrsTsContext* c)
@@ -579,6 +763,10 @@ int SrsTsPacket::decode(SrsStream* stream, SrsTsMessage** ppmsg)
 
     int pos = stream->pos();
 
+    // the packet is reused by context to decode.
+    srs_freep(adaptation_field);
+    srs_freep(payload);
+
     // 4B ts packet header.
     if (!stream->require(4)) {
         ret = ERROR_STREAM_CASTER_TS_HEADER;
@@ -1370,6 +1558,13 @@ int SrsTsPayloadPES::decode(SrsStream* stream, SrsTsMessage** ppmsg)
     if (!msg) {
         msg = new SrsTsMessage(channel, packet);
         channel->msg = msg;
+
+        // reuse the payload of previous PES of pid.
+        if (channel->spare) {
+            srs_freep(msg->payload);
+            msg->payload = channel->spare;
+            channel->spare = NULL;
+        }
     }
     
     // we must cache the fresh state of msg,
@@ -1409,10 +1604,12 @@ int SrsTsPayloadPES::decode(SrsStream* stream, SrsTsMessage** ppmsg)
     if (!is_fresh_msg) {
         // late-incoming or duplicated continuity, drop message.
         // @remark check overflow, the counter plus 1 should greater when invalid.
-        if (msg->continuity_counter >= packet->continuity_counter
-            && ((msg->continuity_counter + 1) & 0x0f) > packet->continuity_counter
+        // @remark the counter 0x0f plus 1 overflows to 0, so check the equal for duplicated.
+        if (msg->continuity_counter == packet->continuity_counter
+            || (msg->continuity_counter >= packet->continuity_counter
+                && ((msg->continuity_counter + 1) & 0x0f) > packet->continuity_counter)
         ) {
-            srs_warn("ts: drop PES %dB for duplicated cc=%#x", msg->continuity_counter);
+            srs_warn("ts: drop PES %dB for duplicated cc=%#x", stream->size() - stream->pos(), msg->continuity_counter);
             stream->skip(stream->size() - stream->pos());
             return ret;
         }
@@ -1437,6 +1634,7 @@ int SrsTsPayloadPES::decode(SrsStream* stream, SrsTsMessage** ppmsg)
         // reap previous PES packet.
         *ppmsg = msg;
         channel->msg = NULL;
+        msg->packet = packet;
 
         // reparse current msg.
         stream->skip(stream->pos() * -1);
@@ -3138,7 +3336,58 @@ int SrsTsEncoder::write_audio(int64_t timestamp, char* data, int size)
             return ret;
         }
     }
-    SrsCodecAudio acodec = (SrsCodecAudio)codec->audio_codec_id;
+    
+    return write_audio_sample(timestamp, codec);
+}
+
+int SrsTsEncoder::write_video(int64_t timestamp, char* data, int size)
+{
+    int ret = ERROR_SUCCESS;
+    
+    sample->clear();
+    if ((ret = codec->video_avc_demux(data, size, sample)) != ERROR_SUCCESS) {
+        srs_error("http: ts codec demux video failed. ret=%d", ret);
+        return ret;
+    }
+    
+    return write_video_sample(timestamp, codec);
+}
+
+int SrsTsEncoder::write_audio_frame(int64_t timestamp, SrsCodecFrame* frame)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if ((ret = frame->error) != ERROR_SUCCESS) {
+        srs_error("http: ts demux audio failed. ret=%d", ret);
+        return ret;
+    }
+    
+    sample->clear();
+    frame->to_sample(sample);
+    
+    return write_audio_sample(timestamp, frame->codec->codec);
+}
+
+int SrsTsEncoder::write_video_frame(int64_t timestamp, SrsCodecFrame* frame)
+{
+    int ret = ERROR_SUCCESS;
+    
+    if ((ret = frame->error) != ERROR_SUCCESS) {
+        srs_error("http: ts demux video failed. ret=%d", ret);
+        return ret;
+    }
+    
+    sample->clear();
+    frame->to_sample(sample);
+    
+    return write_video_sample(timestamp, frame->codec->codec);
+}
+
+int SrsTsEncoder::write_audio_sample(int64_t timestamp, SrsAvcAacCodec* c)
+{
+    int ret = ERROR_SUCCESS;
+    
+    SrsCodecAudio acodec = (SrsCodecAudio)c->audio_codec_id;
     
     // ts support audio codec: aac/mp3
     if (acodec != SrsCodecAudioAAC && acodec != SrsCodecAudioMP3) {
@@ -3162,7 +3411,7 @@ int SrsTsEncoder::write_audio(int64_t timestamp, char* data, int size)
     int64_t dts = timestamp * 90;
     
     // write audio to cache.
-    if ((ret = cache->cache_audio(codec, dts, sample)) != ERROR_SUCCESS) {
+    if ((ret = cache->cache_audio(c, dts, sample)) != ERROR_SUCCESS) {
         return ret;
     }
     
@@ -3173,23 +3422,17 @@ int SrsTsEncoder::write_audio(int64_t timestamp, char* data, int size)
     return flush_audio();
 }
 
-int SrsTsEncoder::write_video(int64_t timestamp, char* data, int size)
+int SrsTsEncoder::write_video_sample(int64_t timestamp, SrsAvcAacCodec* c)
 {
     int ret = ERROR_SUCCESS;
     
-    sample->clear();
-    if ((ret = codec->video_avc_demux(data, size, sample)) != ERROR_SUCCESS) {
-        srs_error("http: ts codec demux video failed. ret=%d", ret);
-        return ret;
-    }
-    
     // ignore info frame,
     // @see https://github.com/ossrs/srs/issues/288#issuecomment-69863909
     if (sample->frame_type == SrsCodecVideoAVCFrameVideoInfoFrame) {
         return ret;
     }
     
-    if (codec->video_codec_id != SrsCodecVideoAVC) {
+    if (c->video_codec_id != SrsCodecVideoAVC) {
         return ret;
     }
     
@@ -3202,7 +3445,7 @@ int SrsTsEncoder::write_video(int64_t timestamp, char* data, int size)
     int64_t dts = timestamp * 90;
     
     // write video to cache.
-    if ((ret = cache->cache_video(codec, dts, sample)) != ERROR_SUCCESS) {
+    if ((ret = cache->cache_video(c, dts, sample)) != ERROR_SUCCESS) {
         return ret;
     }
 
@@ -43,6 +43,7 @@ class SrsTSMuxer;
 class SrsFileWriter;
 class SrsFileReader;
 class SrsAvcAacCodec;
+class SrsCodecFrame;
 class SrsCodecSample;
 class SrsSimpleBuffer;
 class SrsTsAdaptationField;
@@ -178,6 +179,9 @@ struct SrsTsChannel
     SrsTsStream stream;
     SrsTsMessage* msg;
     SrsTsContext* context;
+    // for decoder, the payload of the reaped msg,
+    // reused by the next msg of pid to reassemble the PES without realloc.
+    SrsSimpleBuffer* spare;
     // for encoder.
     u_int8_t continuity_counter;
 
@@ -355,11 +359,18 @@ private:
 private:
     std::map<int, SrsTsChannel*> pids;
     bool pure_audio;
+    // the reused packet to decode the PSI and the unit start PES,
+    // the continuous PES packets are parsed in place without it.
+    SrsTsPacket* packet;
 // encoder
 private:
     // when any codec changed, write the PAT/PMT.
     SrsCodecVideo vcodec;
     SrsCodecAudio acodec;
+    // the reused buffer to packetize the PES,
+    // all ts packets of a PES are written to writer at once.
+    char* pes_packets;
+    int nb_pes_packets;
 public:
     SrsTsContext();
     virtual ~SrsTsContext();
@@ -394,8 +405,18 @@ public:
     * the stream contains only one ts packet.
     * @param handler the ts message handler to process the msg.
     * @remark we will consume all bytes in stream.
+    * @remark the payload of msg is the reassemble buffer of pid, which is
+    *       reused by the next PES of pid, so it's only valid in handler,
+    *       use msg->detach() to keep it.
     */
     virtual int decode(SrsStream* stream, ISrsTsHandler* handler);
+private:
+    /**
+    * parse the continuous PES packet in place, append the payload to msg of pid,
+    * without the object model of packet.
+    * @return true if packet consumed; false to decode it by the packet.
+    */
+    virtual bool decode_continuous(SrsStream* stream);
 // encode methods
 public:
     /**
@@ -408,6 +429,14 @@ public:
 private:
     virtual int encode_pat_pmt(SrsFileWriter* writer, int16_t vpid, SrsTsStream vs, int16_t apid, SrsTsStream as);
     virtual int encode_pes(SrsFileWriter* writer, SrsTsMessage* msg, int16_t pid, SrsTsStream sid, bool pure_audio);
+    /**
+    * encode the ts header, the af with pcr and stuffings, and the PES header for the first packet,
+    * which is byte-identical to the SrsTsPacket created by create_pes_first or create_pes_continue.
+    * @param buf the ts packet to write to, at least SRS_TS_PACKET_SIZE bytes.
+    * @param nb_af the size of af, 0 for no af.
+    */
+    virtual void encode_pes_header(char* buf, SrsTsMessage* msg, int16_t pid, u_int8_t continuity_counter, bool first, int64_t pcr, int nb_af);
+    virtual void encode_33bits_dts_pts(char* p, u_int8_t fb, int64_t v);
 };
 
 /**
@@ -1665,7 +1694,14 @@ public:
     */
     virtual int write_audio(int64_t timestamp, char* data, int size);
     virtual int write_video(int64_t timestamp, char* data, int size);
+    /**
+    * write audio/video frame demuxed by source, never demux it again.
+    */
+    virtual int write_audio_frame(int64_t timestamp, SrsCodecFrame* frame);
+    virtual int write_video_frame(int64_t timestamp, SrsCodecFrame* frame);
 private:
+    virtual int write_audio_sample(int64_t timestamp, SrsAvcAacCodec* c);
+    virtual int write_video_sample(int64_t timestamp, SrsAvcAacCodec* c);
     virtual int flush_audio();
     virtual int flush_video();
 };
@@ -35,6 +35,11 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <sys/stat.h>
 #include <fcntl.h>
 
+// the SSE2 is always supported by x86_64.
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 #include <srs_kernel_log.hpp>
@@ -453,6 +458,96 @@ bool srs_avc_startswith_annexb(SrsStream* stream, int* pnb_start_code)
     return false;
 }
 
+char* srs_avc_find_annexb(char* p, char* end, int* pnb_start_code)
+{
+    char* start = p;
+    char* found = end;
+    
+#if defined(__SSE2__)
+    // match the 00 00 01 at each of 16 bytes, the 18 bytes is required.
+    __m128i zero = _mm_setzero_si128();
+    __m128i one = _mm_set1_epi8(1);
+    while (end - p >= 18) {
+        __m128i v0 = _mm_loadu_si128((__m128i*)p);
+        __m128i v1 = _mm_loadu_si128((__m128i*)(p + 1));
+        __m128i v2 = _mm_loadu_si128((__m128i*)(p + 2));
+        
+        __m128i m = _mm_and_si128(_mm_cmpeq_epi8(v0, zero), _mm_cmpeq_epi8(v1, zero));
+        m = _mm_and_si128(m, _mm_cmpeq_epi8(v2, one));
+        
+        int mask = _mm_movemask_epi8(m);
+        if (mask) {
+            int i = 0;
+            while (!(mask & (1 << i))) {
+                i++;
+            }
+            found = p + i;
+            break;
+        }
+        
+        p += 16;
+    }
+#endif
+    
+    // the bytes not in 16 bytes block, or SSE2 not supported.
+    if (found == end) {
+        for (; end - p >= 3; p++) {
+            if (p[2] == (char)0x01 && p[1] == (char)0x00 && p[0] == (char)0x00) {
+                found = p;
+                break;
+            }
+        }
+    }
+    
+    if (found == end) {
+        return end;
+    }
+    
+    // the leading zeros belongs to the start code.
+    p = found;
+    while (p > start && p[-1] == (char)0x00) {
+        p--;
+    }
+    
+    if (pnb_start_code) {
+        *pnb_start_code = (int)(found - p) + 3;
+    }
+    
+    return p;
+}
+
+bool srs_avc_split_annexb(char* bytes, int size, vector<SrsAnnexbNalu>& nalus)
+{
+    char* end = bytes + size;
+    
+    // must starts with the start code N[00] 00 00 01.
+    char* p = bytes;
+    while (p < end && *p == (char)0x00) {
+        p++;
+    }
+    if (p - bytes < 2 || p >= end || *p != (char)0x01) {
+        return false;
+    }
+    
+    int nb_start_code = (int)(p - bytes) + 1;
+    p = bytes;
+    
+    while (p < end) {
+        char* nalu = p + nb_start_code;
+        p = srs_avc_find_annexb(nalu, end, &nb_start_code);
+        
+        // ignore the empty NALU.
+        if (p > nalu) {
+            SrsAnnexbNalu v;
+            v.bytes = nalu;
+            v.size = (int)(p - nalu);
+            nalus.push_back(v);
+        }
+    }
+    
+    return true;
+}
+
 bool srs_aac_startswith_adts(SrsStream* stream)
 {
     char* bytes = stream->data() + stream->pos();
@@ -31,6 +31,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_core.hpp>
 
 #include <string>
+#include <vector>
 
 class SrsStream;
 class SrsBitStream;
@@ -96,6 +97,33 @@ extern std::string srs_path_basename(std::string path);
 */
 extern bool srs_avc_startswith_annexb(SrsStream* stream, int* pnb_start_code = NULL);
 
+/**
+* find the first avc "AnnexB" start code in bytes [p, end),
+* the start code is "N[00] 00 00 01" where N>=0, the leading zeros
+* belongs to the start code, the same as srs_avc_startswith_annexb.
+* @param pnb_start_code output the size of start code, must >=3.
+*       NULL to ignore.
+* @return the start of start code, end if not found.
+* @remark use SSE2 to compare 16 bytes a time when supported.
+*/
+extern char* srs_avc_find_annexb(char* p, char* end, int* pnb_start_code = NULL);
+
+/**
+* the NALU of avc "AnnexB" bytes, without the start code.
+*/
+struct SrsAnnexbNalu
+{
+    char* bytes;
+    int size;
+};
+
+/**
+* split the avc "AnnexB" bytes to NALUs in one pass, ignore the empty NALU.
+* @param nalus output the NALUs, which point to the bytes.
+* @return false if bytes not starts with the start code.
+*/
+extern bool srs_avc_split_annexb(char* bytes, int size, std::vector<SrsAnnexbNalu>& nalus);
+
 /**
 * whether stream starts with the aac ADTS 
 * from aac-mp4a-format-ISO_IEC_14496-3+2001.pdf, page 75, 1.A.2.2 ADTS.
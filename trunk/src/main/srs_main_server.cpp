@@ -42,6 +42,7 @@ using namespace std;
 #include <srs_app_log.hpp>
 #include <srs_kernel_utility.hpp>
 #include <srs_core_performance.hpp>
+#include <srs_app_worker.hpp>
 
 // pre-declare
 int run();
@@ -383,6 +384,24 @@ int run_master()
 {
     int ret = ERROR_SUCCESS;
     
+    // for workers mode, the master hold the pid file and fork workers,
+    // st is initialized in each worker after fork.
+    if (_srs_config->get_workers_enabled()) {
+        if ((ret = _srs_server->acquire_pid_file()) != ERROR_SUCCESS) {
+            return ret;
+        }
+        
+        SrsWorkerMaster master;
+        if ((ret = master.cycle()) != ERROR_SUCCESS) {
+            return ret;
+        }
+        
+        // all workers quit.
+        if (srs_worker_index() < 0) {
+            return 0;
+        }
+    }
+    
     if ((ret = _srs_server->initialize_st()) != ERROR_SUCCESS) {
         return ret;
     }
@@ -391,7 +410,7 @@ int run_master()
         return ret;
     }
     
-    if ((ret = _srs_server->acquire_pid_file()) != ERROR_SUCCESS) {
+    if (srs_worker_index() < 0 && (ret = _srs_server->acquire_pid_file()) != ERROR_SUCCESS) {
         return ret;
     }
     
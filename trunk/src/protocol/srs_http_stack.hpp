@@ -202,6 +202,11 @@ public:
      * @see https://github.com/ossrs/srs/issues/405
      */
     virtual int writev(iovec* iov, int iovcnt, ssize_t* pnwrite) = 0;
+    /**
+     * send the size bytes of file from offset, without copy to user space.
+     * @remark it never change the position of fd.
+     */
+    virtual int sendfile(int fd, int64_t offset, int size) = 0;
     
     // WriteHeader sends an HTTP response header with status code.
     // If WriteHeader is not called explicitly, the first call to Write
@@ -28,6 +28,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_kernel_error.hpp>
 #include <srs_kernel_log.hpp>
 #include <srs_kernel_utility.hpp>
+#include <srs_kernel_slab.hpp>
 #include <srs_core_performance.hpp>
 
 // the default recv buffer size, 128KB.
@@ -59,14 +60,24 @@ SrsFastBuffer::SrsFastBuffer()
     _handler = NULL;
 #endif
     
-    nb_buffer = SRS_DEFAULT_RECV_BUFFER_SIZE;
+    nb_buffer = SRS_PERF_RECV_BUFFER_MIN;
     buffer = (char*)malloc(nb_buffer);
     p = end = buffer;
+    slab = NULL;
+    
+    nb_target = SRS_DEFAULT_RECV_BUFFER_SIZE;
+    busy = idle = false;
+    period_at = srs_get_system_time_ms();
+    nb_period_bytes = 0;
 }
 
 SrsFastBuffer::~SrsFastBuffer()
 {
-    free(buffer);
+    if (slab) {
+        slab->release();
+    } else {
+        free(buffer);
+    }
     buffer = NULL;
 }
 
@@ -80,6 +91,11 @@ char* SrsFastBuffer::bytes()
     return p;
 }
 
+int SrsFastBuffer::capacity()
+{
+    return nb_buffer;
+}
+
 void SrsFastBuffer::set_buffer(int buffer_size)
 {
     // never exceed the max size.
@@ -92,18 +108,39 @@ void SrsFastBuffer::set_buffer(int buffer_size)
     int nb_resize_buf = srs_min(buffer_size, SRS_MAX_SOCKET_BUFFER);
 
     // only realloc when buffer changed bigger
-    if (nb_resize_buf <= nb_buffer) {
+    if (nb_resize_buf <= nb_target) {
         return;
     }
+    nb_target = nb_resize_buf;
     
-    // realloc for buffer change bigger.
-    int start = (int)(p - buffer);
+    // grow lazily, or realloc when already grown.
+    if (nb_buffer > SRS_PERF_RECV_BUFFER_MIN) {
+        resize(nb_target);
+    }
+}
+
+void SrsFastBuffer::enable_slab()
+{
+    if (slab) {
+        return;
+    }
+    
+    char* previous = buffer;
     int nb_bytes = (int)(end - p);
     
-    buffer = (char*)realloc(buffer, nb_resize_buf);
-    nb_buffer = nb_resize_buf;
-    p = buffer + start;
+    slab = SrsSlabAllocator::instance()->alloc(nb_buffer);
+    buffer = slab->data;
+    
+    memcpy(buffer, p, nb_bytes);
+    p = buffer;
     end = p + nb_bytes;
+    
+    free(previous);
+}
+
+SrsSlab* SrsFastBuffer::get_slab()
+{
+    return slab;
 }
 
 char SrsFastBuffer::read_1byte()
@@ -142,21 +179,32 @@ int SrsFastBuffer::grow(ISrsBufferReader* reader, int required_size)
 
     // must be positive.
     srs_assert(required_size > 0);
-
-    // the free space of buffer, 
-    //      buffer = consumed_bytes + exists_bytes + free_space.
-    int nb_free_space = (int)(buffer + nb_buffer - end);
     
     // the bytes already in buffer
     int nb_exists_bytes = (int)(end - p);
     srs_assert(nb_exists_bytes >= 0);
     
+    if (nb_buffer < nb_target && (busy || required_size > nb_buffer)) {
+        // grow to the large one when peer is streaming, or not enough.
+        resize(nb_target);
+    } else if (nb_buffer > SRS_PERF_RECV_BUFFER_MIN && idle && !nb_exists_bytes) {
+        // shrink to the small one when peer is idle, never hold it when wait.
+        resize(SRS_PERF_RECV_BUFFER_MIN);
+    }
+
+    // the free space of buffer, 
+    //      buffer = consumed_bytes + exists_bytes + free_space.
+    int nb_free_space = (int)(buffer + nb_buffer - end);
+    
     // resize the space when no left space.
     if (nb_free_space < required_size - nb_exists_bytes) {
         srs_verbose("move fast buffer %d bytes", nb_exists_bytes);
 
         // reset or move to get more space.
-        if (!nb_exists_bytes) {
+        if (slab && slab->shared()) {
+            // the messages point to the buffer, never overwrite it.
+            renew_slab(nb_buffer);
+        } else if (!nb_exists_bytes) {
             // reset when buffer is empty.
             p = end = buffer;
             srs_verbose("all consumed, reset fast buffer");
@@ -202,6 +250,18 @@ int SrsFastBuffer::grow(ISrsBufferReader* reader, int required_size)
         srs_assert((int)nread > 0);
         end += nread;
         nb_free_space -= nread;
+        
+        // peer is streaming when fill the buffer, and idle when
+        // got few bytes in a period.
+        busy = !nb_free_space;
+        nb_period_bytes += (int)nread;
+        
+        int64_t now = srs_get_system_time_ms();
+        if (busy || now - period_at >= SRS_PERF_RECV_BUFFER_IDLE_MS) {
+            idle = !busy && nb_period_bytes < SRS_PERF_RECV_BUFFER_MIN;
+            period_at = now;
+            nb_period_bytes = 0;
+        }
     }
     
     return ret;
@@ -215,3 +275,45 @@ void SrsFastBuffer::set_merge_read(bool v, IMergeReadHandler* handler)
 }
 #endif
 
+void SrsFastBuffer::resize(int size)
+{
+    int nb_bytes = (int)(end - p);
+    srs_assert(nb_bytes <= size);
+    
+    // never realloc the slab, for the messages maybe point to it.
+    if (slab) {
+        renew_slab(size);
+        return;
+    }
+    
+    // move the bytes to start of buffer, then realloc.
+    if (p > buffer) {
+        memmove(buffer, p, nb_bytes);
+    }
+    
+    buffer = (char*)realloc(buffer, size);
+    nb_buffer = size;
+    p = buffer;
+    end = p + nb_bytes;
+    srs_verbose("resize fast buffer, size=%d, bytes=%d", size, nb_bytes);
+}
+
+void SrsFastBuffer::renew_slab(int size)
+{
+    srs_assert(slab);
+    
+    SrsSlab* previous = slab;
+    int nb_bytes = (int)(end - p);
+    
+    slab = SrsSlabAllocator::instance()->alloc(size);
+    buffer = slab->data;
+    nb_buffer = size;
+    
+    memcpy(buffer, p, nb_bytes);
+    p = buffer;
+    end = p + nb_bytes;
+    
+    previous->release();
+    srs_verbose("renew slab of fast buffer, size=%d, bytes=%d", size, nb_bytes);
+}
+
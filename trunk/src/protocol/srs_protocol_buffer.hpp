@@ -34,6 +34,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_core_performance.hpp>
 #include <srs_kernel_buffer.hpp>
 
+class SrsSlab;
+
 #ifdef SRS_PERF_MERGED_READ
 /**
 * to improve read performance, merge some packets then read,
@@ -87,6 +89,18 @@ private:
     char* buffer;
     // the size of buffer.
     int nb_buffer;
+    // the slab of buffer, NULL when buffer alloc by malloc.
+    SrsSlab* slab;
+    // the size of large buffer, the buffer grows to it lazily.
+    // @see SRS_PERF_RECV_BUFFER_MIN
+    int nb_target;
+    // whether the last read fill the buffer, that is, peer is streaming.
+    bool busy;
+    // whether got less than SRS_PERF_RECV_BUFFER_MIN bytes in last period.
+    bool idle;
+    // the start time and bytes of current period, to detect the idle.
+    int64_t period_at;
+    int nb_period_bytes;
 public:
     SrsFastBuffer();
     virtual ~SrsFastBuffer();
@@ -102,13 +116,29 @@ public:
     */
     virtual char* bytes();
     /**
+    * get the size of buffer, the small one or the large one.
+    */
+    virtual int capacity();
+    /**
     * create buffer with specifeid size.
     * @param buffer the size of buffer. ignore when smaller than SRS_MAX_SOCKET_BUFFER.
     * @remark when MR(SRS_PERF_MERGED_READ) disabled, always set to 8K.
     * @remark when buffer changed, the previous ptr maybe invalid.
+    * @remark the buffer grows to the size lazily, when peer is streaming.
     * @see https://github.com/ossrs/srs/issues/241
     */
     virtual void set_buffer(int buffer_size);
+    /**
+    * use slab for buffer, then the message in one chunk can point to the buffer
+    * without copy, and the buffer is moved to a new slab when referenced.
+    * @remark the previous ptr maybe invalid.
+    */
+    virtual void enable_slab();
+    /**
+    * get the slab of buffer, NULL when slab not enabled.
+    * @remark user should retain the slab when point to the bytes in it.
+    */
+    virtual SrsSlab* get_slab();
 public:
     /**
     * read 1byte from buffer, move to next bytes.
@@ -137,6 +167,8 @@ public:
     * @param required_size, loop to fill to ensure buffer size to required. 
     * @return an int error code, error if required_size negative.
     * @remark, we actually maybe read more than required_size, maybe 4k for example.
+    * @remark, the buffer grows to the large one when peer is streaming or required,
+    *       and shrinks to the small one when buffer is empty and peer is idle.
     */
     virtual int grow(ISrsBufferReader* reader, int required_size);
 public:
@@ -152,6 +184,16 @@ public:
     */
     virtual void set_merge_read(bool v, IMergeReadHandler* handler);
 #endif
+private:
+    /**
+    * resize the buffer, the bytes in buffer is kept.
+    * @remark assert the bytes in buffer not exceed the size.
+    */
+    virtual void resize(int size);
+    /**
+    * move the bytes to a new slab in size, release the previous one.
+    */
+    virtual void renew_slab(int size);
 };
 
 #endif
@@ -42,6 +42,93 @@ using namespace _srs_internal;
 #include <openssl/hmac.h>
 // for openssl_generate_key
 #include <openssl/dh.h>
+// for the locks of openssl
+#include <openssl/crypto.h>
+
+// the HMAC_CTX and DH are opaque since openssl 1.1, use the accessors
+// and polyfill them for the openssl-1.0.1f of srs.
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+static HMAC_CTX* HMAC_CTX_new()
+{
+    HMAC_CTX* ctx = new HMAC_CTX();
+    HMAC_CTX_init(ctx);
+    return ctx;
+}
+
+static void HMAC_CTX_free(HMAC_CTX* ctx)
+{
+    if (ctx != NULL) {
+        HMAC_CTX_cleanup(ctx);
+        delete ctx;
+    }
+}
+
+static void DH_get0_key(const DH* dh, const BIGNUM** pub_key, const BIGNUM** priv_key)
+{
+    if (pub_key != NULL) {
+        *pub_key = dh->pub_key;
+    }
+    if (priv_key != NULL) {
+        *priv_key = dh->priv_key;
+    }
+}
+
+static int DH_set0_pqg(DH* dh, BIGNUM* p, BIGNUM* q, BIGNUM* g)
+{
+    // the p and g must not be NULL, q is optional.
+    if (p == NULL || g == NULL) {
+        return 0;
+    }
+    
+    BN_free(dh->p);
+    BN_free(dh->q);
+    BN_free(dh->g);
+    dh->p = p;
+    dh->q = q;
+    dh->g = g;
+    
+    return 1;
+}
+
+static int DH_set_length(DH* dh, long length)
+{
+    dh->length = length;
+    return 1;
+}
+
+// the locks for openssl used in multiple threads, for the DH keys are
+// generated in native thread, @see ./crypto/threads/mttest.c
+static pthread_mutex_t* srs_openssl_locks = NULL;
+
+static void srs_openssl_lock(int mode, int n, const char* /*file*/, int /*line*/)
+{
+    if (mode & CRYPTO_LOCK) {
+        pthread_mutex_lock(&srs_openssl_locks[n]);
+    } else {
+        pthread_mutex_unlock(&srs_openssl_locks[n]);
+    }
+}
+
+static void srs_openssl_init_locks()
+{
+    // user already set the locks.
+    if (srs_openssl_locks != NULL || CRYPTO_get_locking_callback() != NULL) {
+        return;
+    }
+    
+    int nb_locks = CRYPTO_num_locks();
+    srs_openssl_locks = new pthread_mutex_t[nb_locks];
+    for (int i = 0; i < nb_locks; i++) {
+        pthread_mutex_init(&srs_openssl_locks[i], NULL);
+    }
+    CRYPTO_set_locking_callback(srs_openssl_lock);
+}
+#else
+// the openssl 1.1+ is thread safe.
+static void srs_openssl_init_locks()
+{
+}
+#endif
 
 namespace _srs_internal
 {
@@ -74,12 +161,12 @@ namespace _srs_internal
     {
         int ret = ERROR_SUCCESS;
         
-        if (HMAC_Update(ctx, (unsigned char *) data, data_size) < 0) {
+        if (HMAC_Update(ctx, (unsigned char *) data, data_size) != 1) {
             ret = ERROR_OpenSslSha256Update;
             return ret;
         }
     
-        if (HMAC_Final(ctx, (unsigned char *) digest, digest_size) < 0) {
+        if (HMAC_Final(ctx, (unsigned char *) digest, digest_size) != 1) {
             ret = ERROR_OpenSslSha256Final;
             return ret;
         }
@@ -100,29 +187,46 @@ namespace _srs_internal
         unsigned char* temp_key = (unsigned char*)key;
         unsigned char* temp_digest = (unsigned char*)digest;
         
+        // the cached context of genuine key, to reuse the key schedule.
+        HMAC_CTX* cached = SrsHandshakeKeys::instance()->hmac(key, key_size);
+        
         if (key == NULL) {
             // use data to digest.
             // @see ./crypto/sha/sha256t.c
             // @see ./crypto/evp/digest.c
-            if (EVP_Digest(data, data_size, temp_digest, &digest_size, EVP_sha256(), NULL) < 0)
+            if (EVP_Digest(data, data_size, temp_digest, &digest_size, EVP_sha256(), NULL) != 1)
             {
                 ret = ERROR_OpenSslSha256EvpDigest;
                 return ret;
             }
+        } else if (cached) {
+            // reset the context to the key.
+            if (HMAC_Init_ex(cached, NULL, 0, NULL, NULL) != 1) {
+                ret = ERROR_OpenSslSha256Init;
+                return ret;
+            }
+            
+            if ((ret = do_openssl_HMACsha256(cached, data, data_size, temp_digest, &digest_size)) != ERROR_SUCCESS) {
+                return ret;
+            }
         } else {
             // use key-data to digest.
-            HMAC_CTX ctx;
-            
             // @remark, if no key, use EVP_Digest to digest,
             // for instance, in python, hashlib.sha256(data).digest().
-            HMAC_CTX_init(&ctx);
-            if (HMAC_Init_ex(&ctx, temp_key, key_size, EVP_sha256(), NULL) < 0) {
+            HMAC_CTX* ctx = HMAC_CTX_new();
+            if (ctx == NULL) {
                 ret = ERROR_OpenSslSha256Init;
                 return ret;
             }
             
-            ret = do_openssl_HMACsha256(&ctx, data, data_size, temp_digest, &digest_size);
-            HMAC_CTX_cleanup(&ctx);
+            if (HMAC_Init_ex(ctx, temp_key, key_size, EVP_sha256(), NULL) != 1) {
+                HMAC_CTX_free(ctx);
+                ret = ERROR_OpenSslSha256Init;
+                return ret;
+            }
+            
+            ret = do_openssl_HMACsha256(ctx, data, data_size, temp_digest, &digest_size);
+            HMAC_CTX_free(ctx);
             
             if (ret != ERROR_SUCCESS) {
                 return ret;
@@ -157,15 +261,8 @@ namespace _srs_internal
     
     void SrsDH::close()
     {
+        // the p and g are freed by DH.
         if (pdh != NULL) {
-            if (pdh->p != NULL) {
-                BN_free(pdh->p);
-                pdh->p = NULL;
-            }
-            if (pdh->g != NULL) {
-                BN_free(pdh->g);
-                pdh->g = NULL;
-            }
             DH_free(pdh);
             pdh = NULL;
         }
@@ -181,7 +278,9 @@ namespace _srs_internal
             }
             
             if (ensure_128bytes_public_key) {
-                int32_t key_size = BN_num_bytes(pdh->pub_key);
+                const BIGNUM* pub_key = NULL;
+                DH_get0_key(pdh, &pub_key, NULL);
+                int32_t key_size = BN_num_bytes(pub_key);
                 if (key_size != 128) {
                     srs_warn("regenerate 128B key, current=%dB", key_size);
                     continue;
@@ -198,15 +297,18 @@ namespace _srs_internal
     {
         int ret = ERROR_SUCCESS;
         
+        const BIGNUM* pub_key = NULL;
+        DH_get0_key(pdh, &pub_key, NULL);
+        
         // copy public key to bytes.
         // sometimes, the key_size is 127, seems ok.
-        int32_t key_size = BN_num_bytes(pdh->pub_key);
+        int32_t key_size = BN_num_bytes(pub_key);
         srs_assert(key_size > 0);
         
         // maybe the key_size is 127, but dh will write all 128bytes pkey,
         // so, donot need to set/initialize the pkey.
         // @see https://github.com/ossrs/srs/issues/165
-        key_size = BN_bn2bin(pdh->pub_key, (unsigned char*)pkey);
+        key_size = BN_bn2bin(pub_key, (unsigned char*)pkey);
         srs_assert(key_size > 0);
         
         // output the size of public key.
@@ -265,39 +367,255 @@ namespace _srs_internal
         }
     
         //2. Create his internal p and g
-        if ((pdh->p = BN_new()) == NULL) {
+        BIGNUM* p = NULL;
+        BIGNUM* g = NULL;
+        if ((ret = do_create_pg(&p, &g)) != ERROR_SUCCESS) {
+            BN_free(p);
+            BN_free(g);
+            return ret;
+        }
+        
+        // the p and g are owned by DH.
+        if (!DH_set0_pqg(pdh, p, NULL, g)) {
+            BN_free(p);
+            BN_free(g);
+            ret = ERROR_OpenSslCreateDH;
+            return ret;
+        }
+    
+        // 4. Set the key length, the private key must be less than p,
+        // openssl 3 fails when it's the bits of p, @see ./crypto/dh/dh_key.c
+        if (!DH_set_length(pdh, bits_count - 1)) {
+            ret = ERROR_OpenSslCreateDH;
+            return ret;
+        }
+    
+        // 5. Generate private and public key
+        // @see ./test/dhtest.c:152
+        if (!DH_generate_key(pdh)) {
+            ret = ERROR_OpenSslGenerateDHKeys;
+            return ret;
+        }
+        
+        return ret;
+    }
+    
+    int SrsDH::do_create_pg(BIGNUM** pp, BIGNUM** pg)
+    {
+        int ret = ERROR_SUCCESS;
+        
+        if ((*pp = BN_new()) == NULL) {
             ret = ERROR_OpenSslCreateP; 
             return ret;
         }
-        if ((pdh->g = BN_new()) == NULL) {
+        if ((*pg = BN_new()) == NULL) {
             ret = ERROR_OpenSslCreateG; 
             return ret;
         }
     
         //3. initialize p and g, @see ./test/ectest.c:260
-        if (!BN_hex2bn(&pdh->p, RFC2409_PRIME_1024)) {
+        if (!BN_hex2bn(pp, RFC2409_PRIME_1024)) {
             ret = ERROR_OpenSslParseP1024; 
             return ret;
         }
         // @see ./test/bntest.c:1764
-        if (!BN_set_word(pdh->g, 2)) {
+        if (!BN_set_word(*pg, 2)) {
             ret = ERROR_OpenSslSetG;
             return ret;
         }
+        
+        return ret;
+    }
     
-        // 4. Set the key length
-        pdh->length = bits_count;
+    SrsHandshakeKeys* SrsHandshakeKeys::_instance = new SrsHandshakeKeys();
     
-        // 5. Generate private and public key
-        // @see ./test/dhtest.c:152
-        if (!DH_generate_key(pdh)) {
-            ret = ERROR_OpenSslGenerateDHKeys;
+    SrsHandshakeKeys::SrsHandshakeKeys()
+    {
+        initialized = false;
+        max_keys = 0;
+        overload = false;
+        nb_misses = 0;
+        nb_overloads = 0;
+        pthread_mutex_init(&lock, NULL);
+        
+        for (int i = 0; i < SRS_GENUINE_HMAC_KEYS; i++) {
+            hmacs[i] = NULL;
+        }
+        hmac_keys[0] = SrsGenuineFPKey;
+        hmac_key_sizes[0] = 30;
+        hmac_keys[1] = SrsGenuineFPKey;
+        hmac_key_sizes[1] = 62;
+        hmac_keys[2] = SrsGenuineFMSKey;
+        hmac_key_sizes[2] = 36;
+        hmac_keys[3] = SrsGenuineFMSKey;
+        hmac_key_sizes[3] = 68;
+    }
+    
+    SrsHandshakeKeys::~SrsHandshakeKeys()
+    {
+        std::vector<SrsDH*>::iterator it;
+        for (it = keys.begin(); it != keys.end(); ++it) {
+            SrsDH* dh = *it;
+            srs_freep(dh);
+        }
+        keys.clear();
+        
+        for (int i = 0; i < SRS_GENUINE_HMAC_KEYS; i++) {
+            HMAC_CTX_free(hmacs[i]);
+            hmacs[i] = NULL;
+        }
+        
+        pthread_mutex_destroy(&lock);
+    }
+    
+    SrsHandshakeKeys* SrsHandshakeKeys::instance()
+    {
+        return _instance;
+    }
+    
+    int SrsHandshakeKeys::initialize(int pool, bool o)
+    {
+        int ret = ERROR_SUCCESS;
+        
+        pthread_mutex_lock(&lock);
+        max_keys = pool;
+        overload = o;
+        pthread_mutex_unlock(&lock);
+        
+        if (initialized) {
             return ret;
         }
         
+        // before the refiller starts.
+        srs_openssl_init_locks();
+        
+        for (int i = 0; i < SRS_GENUINE_HMAC_KEYS; i++) {
+            if (hmacs[i] == NULL && (hmacs[i] = HMAC_CTX_new()) == NULL) {
+                ret = ERROR_OpenSslSha256Init;
+                srs_error("handshake: create hmac of genuine key %d failed. ret=%d", i, ret);
+                return ret;
+            }
+            if (HMAC_Init_ex(hmacs[i], hmac_keys[i], hmac_key_sizes[i], EVP_sha256(), NULL) != 1) {
+                ret = ERROR_OpenSslSha256Init;
+                srs_error("handshake: init hmac of genuine key %d failed. ret=%d", i, ret);
+                return ret;
+            }
+        }
+        initialized = true;
+        
+        srs_trace("handshake: keys pool=%d, overload=%d", max_keys, overload);
+        
+        return ret;
+    }
+    
+    int SrsHandshakeKeys::refill(int nb_keys)
+    {
+        int ret = ERROR_SUCCESS;
+        
+        // generate without lock, for it costs about 1ms per key.
+        for (int i = 0; i < nb_keys && !full();) {
+            SrsDH* dh = new SrsDH();
+            
+            if ((ret = dh->initialize()) != ERROR_SUCCESS) {
+                srs_freep(dh);
+                return ret;
+            }
+            
+            // ensure generate 128bytes public key, regenerate silently,
+            // for the native thread never log.
+            char pkey[128];
+            int32_t pkey_size = sizeof(pkey);
+            if ((ret = dh->copy_public_key(pkey, pkey_size)) != ERROR_SUCCESS) {
+                srs_freep(dh);
+                return ret;
+            }
+            if (pkey_size != 128) {
+                srs_freep(dh);
+                continue;
+            }
+            
+            pthread_mutex_lock(&lock);
+            keys.push_back(dh);
+            pthread_mutex_unlock(&lock);
+            i++;
+        }
+        
         return ret;
     }
     
+    SrsDH* SrsHandshakeKeys::fetch()
+    {
+        SrsDH* dh = NULL;
+        
+        pthread_mutex_lock(&lock);
+        if (!keys.empty()) {
+            dh = keys.back();
+            keys.pop_back();
+        } else if (max_keys > 0) {
+            nb_misses++;
+        }
+        pthread_mutex_unlock(&lock);
+        
+        return dh;
+    }
+    
+    bool SrsHandshakeKeys::overloaded()
+    {
+        pthread_mutex_lock(&lock);
+        bool used_up = overload && max_keys > 0 && keys.empty();
+        pthread_mutex_unlock(&lock);
+        
+        if (!used_up) {
+            return false;
+        }
+        
+        nb_overloads++;
+        return true;
+    }
+    
+    HMAC_CTX* SrsHandshakeKeys::hmac(const void* key, int key_size)
+    {
+        if (!initialized) {
+            return NULL;
+        }
+        
+        for (int i = 0; i < SRS_GENUINE_HMAC_KEYS; i++) {
+            if (key == hmac_keys[i] && key_size == hmac_key_sizes[i]) {
+                return hmacs[i];
+            }
+        }
+        
+        return NULL;
+    }
+    
+    bool SrsHandshakeKeys::full()
+    {
+        pthread_mutex_lock(&lock);
+        bool is_full = (int)keys.size() >= max_keys;
+        pthread_mutex_unlock(&lock);
+        
+        return is_full;
+    }
+    
+    int SrsHandshakeKeys::size()
+    {
+        pthread_mutex_lock(&lock);
+        int nb_keys = (int)keys.size();
+        pthread_mutex_unlock(&lock);
+        
+        return nb_keys;
+    }
+    
+    int64_t SrsHandshakeKeys::misses()
+    {
+        return nb_misses;
+    }
+    
+    int64_t SrsHandshakeKeys::overloads()
+    {
+        return nb_overloads;
+    }
+    
     key_block::key_block()
     {
         offset = (int32_t)rand();
@@ -524,17 +842,22 @@ namespace _srs_internal
     {
         int ret = ERROR_SUCCESS;
 
-        SrsDH dh;
+        // use the pre-generated key in pool.
+        SrsDH* dh = SrsHandshakeKeys::instance()->fetch();
+        SrsAutoFree(SrsDH, dh);
         
         // ensure generate 128bytes public key.
-        if ((ret = dh.initialize(true)) != ERROR_SUCCESS) {
-            return ret;
+        if (!dh) {
+            dh = new SrsDH();
+            if ((ret = dh->initialize(true)) != ERROR_SUCCESS) {
+                return ret;
+            }
         }
         
         // directly generate the public key.
         // @see: https://github.com/ossrs/srs/issues/148
         int pkey_size = 128;
-        if ((ret = dh.copy_shared_key(c1->get_key(), 128, key.key, pkey_size)) != ERROR_SUCCESS) {
+        if ((ret = dh->copy_shared_key(c1->get_key(), 128, key.key, pkey_size)) != ERROR_SUCCESS) {
             srs_error("calc s1 key failed. ret=%d", ret);
             return ret;
         }
@@ -1212,6 +1535,14 @@ int SrsComplexHandshake::handshake_with_client(SrsHandshakeBytes* hs_bytes, ISrs
         return ret;
     }
     
+    // for lots of clients reconnect, the DH keys is used up,
+    // use simple handshake to avoid to generate key.
+    if (SrsHandshakeKeys::instance()->overloaded()) {
+        ret = ERROR_RTMP_TRY_SIMPLE_HS;
+        srs_info("dh keys used up, try simple handshake. ret=%d", ret);
+        return ret;
+    }
+    
     // decode c1
     c1s1 c1;
     // try schema0.
@@ -30,6 +30,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <srs_core.hpp>
 
+#include <vector>
+
 class ISrsProtocolReaderWriter;
 class SrsComplexHandshake;
 class SrsHandshakeBytes;
@@ -39,6 +41,8 @@ class SrsStream;
 
 // for openssl.
 #include <openssl/hmac.h>
+// for the pool of DH keys, refilled by native thread.
+#include <pthread.h>
 
 namespace _srs_internal
 {
@@ -89,6 +93,83 @@ namespace _srs_internal
         virtual int copy_shared_key(const char* ppkey, int32_t ppkey_size, char* skey, int32_t& skey_size);
     private:
         virtual int do_initialize();
+        virtual int do_create_pg(BIGNUM** pp, BIGNUM** pg);
+    };
+    
+    // the genuine keys to cache the HMAC context, FP30, FP62, FMS36 and FMS68.
+    #define SRS_GENUINE_HMAC_KEYS 4
+    
+    /**
+    * the keys for complex handshake of server, which costs lots of CPU to
+    * generate the DH key and HMAC when lots of clients reconnect at the same
+    * time, for example, the failover of CDN:
+    *       the pool of pre-generated DH keys, refilled by server in idle time.
+    *       the HMAC contexts of genuine FMS/FP keys, to reuse the key schedule.
+    *       the overload mode, use simple handshake when pool is used up.
+    * @remark it's disabled until initialize, for the librtmp maybe used in multiple threads.
+    * @remark the pool is refilled by native thread and fetched by st, so the
+    *       refill never use any st or log api.
+    */
+    class SrsHandshakeKeys
+    {
+    private:
+        static SrsHandshakeKeys* _instance;
+    private:
+        bool initialized;
+        // the max number of DH keys in pool, 0 to disable the pool.
+        int max_keys;
+        bool overload;
+        // lock the pool and max keys, for the refiller is native thread.
+        pthread_mutex_t lock;
+        std::vector<SrsDH*> keys;
+        // the number of handshakes which generate key when pool is empty,
+        // and which use simple handshake for overload.
+        int64_t nb_misses;
+        int64_t nb_overloads;
+    private:
+        // the HMAC contexts initialized by the genuine keys.
+        const void* hmac_keys[SRS_GENUINE_HMAC_KEYS];
+        int hmac_key_sizes[SRS_GENUINE_HMAC_KEYS];
+        HMAC_CTX* hmacs[SRS_GENUINE_HMAC_KEYS];
+    private:
+        SrsHandshakeKeys();
+    public:
+        virtual ~SrsHandshakeKeys();
+    public:
+        static SrsHandshakeKeys* instance();
+    public:
+        /**
+        * initialize the HMAC contexts, and the pool of DH keys.
+        * @param pool the max DH keys in pool, 0 to disable the pool.
+        * @param overload whether use simple handshake when pool is used up.
+        */
+        virtual int initialize(int pool, bool overload);
+        /**
+        * generate some DH keys to pool, ignore when pool is full.
+        * @param nb_keys the max number of keys to generate.
+        * @remark thread safe, user can refill in native thread.
+        */
+        virtual int refill(int nb_keys);
+        /**
+        * fetch a pre-generated DH key, user must free it.
+        * @return NULL when pool is empty or disabled, user should generate it.
+        */
+        virtual SrsDH* fetch();
+        /**
+        * whether overload, the pool is used up and should use simple handshake.
+        */
+        virtual bool overloaded();
+        /**
+        * get the cached HMAC context of genuine key,
+        * user should reset it by HMAC_Init_ex without key and md.
+        * @return NULL when key is not genuine or not initialized.
+        */
+        virtual HMAC_CTX* hmac(const void* key, int key_size);
+    public:
+        virtual bool full();
+        virtual int size();
+        virtual int64_t misses();
+        virtual int64_t overloads();
     };
     /**
     * the schema type.
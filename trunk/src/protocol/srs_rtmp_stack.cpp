@@ -228,7 +228,9 @@ SrsProtocol::SrsProtocol(ISrsProtocolReaderWriter* io)
     srs_assert(nb_out_iovs >= 2);
     
     warned_c0c3_cache_dry = false;
+    send_aggregate = false;
     auto_response_when_recv = true;
+    recv_slab = false;
     show_debug_info = true;
     in_buffer_length = 0;
     
@@ -325,6 +327,22 @@ void SrsProtocol::set_recv_buffer(int buffer_size)
 }
 #endif
 
+void SrsProtocol::set_send_aggregate(bool v)
+{
+    send_aggregate = v;
+}
+
+#ifdef SRS_PERF_RECV_SLAB
+void SrsProtocol::set_recv_slab(bool v)
+{
+    recv_slab = v;
+    
+    if (v) {
+        in_buffer->enable_slab();
+    }
+}
+#endif
+
 void SrsProtocol::set_recv_timeout(int64_t timeout_us)
 {
     return skt->set_recv_timeout(timeout_us);
@@ -460,57 +478,38 @@ int SrsProtocol::do_send_messages(SrsSharedPtrMessage** msgs, int nb_msgs)
             srs_info("ignore empty message.");
             continue;
         }
-    
-        // p set to current write position,
-        // it's ok when payload is NULL and size is 0.
-        char* p = msg->payload;
-        char* pend = msg->payload + msg->size;
         
-        // always write the header event payload is empty.
-        while (p < pend) {
-            // always has header
-            int nb_cache = SRS_CONSTS_C0C3_HEADERS_MAX - c0c3_cache_index;
-            int nbh = msg->chunk_header(c0c3_cache, nb_cache, p == msg->payload);
-            srs_assert(nbh > 0);
-            
-            // header iov
-            iovs[0].iov_base = c0c3_cache;
-            iovs[0].iov_len = nbh;
-            
-            // payload iov
-            int payload_size = srs_min(out_chunk_size, (int)(pend - p));
-            iovs[1].iov_base = p;
-            iovs[1].iov_len = payload_size;
-            
-            // consume sendout bytes.
-            p += payload_size;
-            
-            // realloc the iovs if exceed,
-            // for we donot know how many messges maybe to send entirely,
-            // we just alloc the iovs, it's ok.
-            if (iov_index >= nb_out_iovs - 2) {
-                srs_warn("resize iovs %d => %d, max_msgs=%d", 
-                    nb_out_iovs, nb_out_iovs + SRS_CONSTS_IOVS_MAX, 
-                    SRS_PERF_MW_MSGS);
-                    
-                nb_out_iovs += SRS_CONSTS_IOVS_MAX;
-                int realloc_size = sizeof(iovec) * nb_out_iovs;
-                out_iovs = (iovec*)realloc(out_iovs, realloc_size);
-            }
-            
-            // to next pair of iovs
-            iov_index += 2;
-            iovs = out_iovs + iov_index;
-
-            // to next c0c3 header cache
-            c0c3_cache_index += nbh;
-            c0c3_cache = out_c0c3_caches + c0c3_cache_index;
-            
+        // pack the consecutive audio/video messages in an aggregate message,
+        // which use the flv tags shared by all players as the sub headers.
+        int nb_aggregate = 0;
+        int aggregate_size = 0;
+        if (send_aggregate) {
+            nb_aggregate = aggregate_messages(msgs + i, nb_msgs - i, &aggregate_size);
+        }
+        
+        // the c0 header for the first chunk, and c3 for the others,
+        // use the headers shared by all players when possible.
+        char* c0 = NULL;
+        int nb_c0 = 0;
+        char* c3 = NULL;
+        int nb_c3 = 0;
+        
+        // @remark the c3 is shared by the players of any timestamp, while the c0
+        //      is shared only when the timestamp not corrected by jitter.
+        SrsSharedChunkHeader* sh = (nb_aggregate > 1)? NULL : msg->shared_chunk_header();
+        if (sh) {
+            c3 = sh->c3;
+            nb_c3 = sh->nb_c3;
+        }
+        if (sh && sh->timestamp == msg->timestamp) {
+            c0 = sh->c0;
+            nb_c0 = sh->nb_c0;
+        } else {
             // the cache header should never be realloc again,
             // for the ptr is set to iovs, so we just warn user to set larger
             // and use another loop to send again.
             int c0c3_left = SRS_CONSTS_C0C3_HEADERS_MAX - c0c3_cache_index;
-            if (c0c3_left < SRS_CONSTS_RTMP_MAX_FMT0_HEADER_SIZE) {
+            if (c0c3_left < SRS_CONSTS_RTMP_MAX_FMT0_HEADER_SIZE + SRS_CONSTS_RTMP_MAX_FMT3_HEADER_SIZE) {
                 // only warn once for a connection.
                 if (!warned_c0c3_cache_dry) {
                     srs_warn("c0c3 cache header too small, recoment to %d", 
@@ -531,7 +530,82 @@ int SrsProtocol::do_send_messages(SrsSharedPtrMessage** msgs, int nb_msgs)
                 
                 c0c3_cache_index = 0;
                 c0c3_cache = out_c0c3_caches + c0c3_cache_index;
+                c0c3_left = SRS_CONSTS_C0C3_HEADERS_MAX;
+            }
+            
+            // build the c0 and c3 once for all chunks of message.
+            c0 = c0c3_cache;
+            if (nb_aggregate > 1) {
+                // the timestamp of aggregate is the first sub message.
+                u_int32_t timestamp = (u_int32_t)(msg->timestamp & 0x7fffffff);
+                nb_c0 = srs_chunk_header_c0(RTMP_CID_Video, timestamp, aggregate_size,
+                    RTMP_MSG_AggregateMessage, msg->stream_id, c0, c0c3_left);
+                srs_assert(nb_c0 > 0);
+                
+                c3 = c0 + nb_c0;
+                nb_c3 = srs_chunk_header_c3(RTMP_CID_Video, timestamp, c3, c0c3_left - nb_c0);
+                srs_assert(nb_c3 > 0);
+            } else {
+                nb_c0 = msg->chunk_header(c0, c0c3_left, true);
+                srs_assert(nb_c0 > 0);
+                
+                if (!sh) {
+                    c3 = c0 + nb_c0;
+                    nb_c3 = msg->chunk_header(c3, c0c3_left - nb_c0, false);
+                    srs_assert(nb_c3 > 0);
+                }
+            }
+            
+            // to next c0c3 header cache
+            c0c3_cache_index += nb_c0 + (sh? 0 : nb_c3);
+            c0c3_cache = out_c0c3_caches + c0c3_cache_index;
+        }
+        
+        if (nb_aggregate > 1) {
+            aggregate_iovs(msgs + i, nb_aggregate, c0, nb_c0, c3, nb_c3, iov_index);
+            iovs = out_iovs + iov_index;
+            
+            // the messages in aggregate are sent.
+            i += nb_aggregate - 1;
+            continue;
+        }
+    
+        // p set to current write position,
+        // it's ok when payload is NULL and size is 0.
+        char* p = msg->payload;
+        char* pend = msg->payload + msg->size;
+        
+        // always write the header event payload is empty.
+        while (p < pend) {
+            // header iov
+            if (p == msg->payload) {
+                iovs[0].iov_base = c0;
+                iovs[0].iov_len = nb_c0;
+            } else {
+                iovs[0].iov_base = c3;
+                iovs[0].iov_len = nb_c3;
+            }
+            
+            // payload iov
+            int payload_size = srs_min(out_chunk_size, (int)(pend - p));
+            iovs[1].iov_base = p;
+            iovs[1].iov_len = payload_size;
+            
+            // consume sendout bytes.
+            p += payload_size;
+            
+            // realloc the iovs if exceed,
+            // for we donot know how many messges maybe to send entirely,
+            // we just alloc the iovs, it's ok.
+            // @remark ensure the next pair of iovs, for the aggregate
+            //       maybe consume odd iovs.
+            if (iov_index + 4 > nb_out_iovs) {
+                grow_out_iovs();
             }
+            
+            // to next pair of iovs
+            iov_index += 2;
+            iovs = out_iovs + iov_index;
         }
     }
     
@@ -559,6 +633,33 @@ int SrsProtocol::do_send_messages(SrsSharedPtrMessage** msgs, int nb_msgs)
             srs_info("ignore empty message.");
             continue;
         }
+        
+        // the c0 header for the first chunk, and c3 for the others,
+        // use the headers shared by all players when possible.
+        char* c0 = NULL;
+        int nb_c0 = 0;
+        char* c3 = NULL;
+        int nb_c3 = 0;
+        
+        SrsSharedChunkHeader* sh = msg->shared_chunk_header();
+        if (sh) {
+            c3 = sh->c3;
+            nb_c3 = sh->nb_c3;
+        }
+        if (sh && sh->timestamp == msg->timestamp) {
+            c0 = sh->c0;
+            nb_c0 = sh->nb_c0;
+        } else {
+            c0 = out_c0c3_caches;
+            nb_c0 = msg->chunk_header(c0, SRS_CONSTS_C0C3_HEADERS_MAX, true);
+            srs_assert(nb_c0 > 0);
+            
+            if (!sh) {
+                c3 = c0 + nb_c0;
+                nb_c3 = msg->chunk_header(c3, SRS_CONSTS_C0C3_HEADERS_MAX - nb_c0, false);
+                srs_assert(nb_c3 > 0);
+            }
+        }
     
         // p set to current write position,
         // it's ok when payload is NULL and size is 0.
@@ -569,16 +670,15 @@ int SrsProtocol::do_send_messages(SrsSharedPtrMessage** msgs, int nb_msgs)
         while (p < pend) {
             // for simple send, send each chunk one by one
             iovec* iovs = out_iovs;
-            char* c0c3_cache = out_c0c3_caches;
-            int nb_cache = SRS_CONSTS_C0C3_HEADERS_MAX;
-            
-            // always has header
-            int nbh = msg->chunk_header(c0c3_cache, nb_cache, p == msg->payload);
-            srs_assert(nbh > 0);
             
             // header iov
-            iovs[0].iov_base = c0c3_cache;
-            iovs[0].iov_len = nbh;
+            if (p == msg->payload) {
+                iovs[0].iov_base = c0;
+                iovs[0].iov_len = nb_c0;
+            } else {
+                iovs[0].iov_base = c3;
+                iovs[0].iov_len = nb_c3;
+            }
             
             // payload iov
             int payload_size = srs_min(out_chunk_size, pend - p);
@@ -601,6 +701,103 @@ int SrsProtocol::do_send_messages(SrsSharedPtrMessage** msgs, int nb_msgs)
 #endif   
 }
 
+int SrsProtocol::aggregate_messages(SrsSharedPtrMessage** msgs, int nb_msgs, int* psize)
+{
+    int size = 0;
+    
+    int i = 0;
+    for (; i < nb_msgs; i++) {
+        SrsSharedPtrMessage* msg = msgs[i];
+        
+        // only the audio/video message with payload.
+        if (!msg || !msg->payload || msg->size <= 0 || !msg->is_av()) {
+            break;
+        }
+        
+        // the payload length of aggregate is 3bytes.
+        int tag_size = SRS_FLV_TAG_HEADER_SIZE + msg->size + SRS_FLV_PREVIOUS_TAG_SIZE;
+        if (size + tag_size > 0xFFFFFF) {
+            break;
+        }
+        
+        // the sub message header must be the shared flv tag,
+        // send the message directly when the tags cache is full.
+        if (!msg->shared_flv_tag()) {
+            break;
+        }
+        
+        size += tag_size;
+    }
+    
+    *psize = size;
+    
+    return i;
+}
+
+void SrsProtocol::aggregate_iovs(SrsSharedPtrMessage** msgs, int nb_msgs, char* c0, int nb_c0, char* c3, int nb_c3, int& iov_index)
+{
+    // the bytes left in current chunk, 0 to start a new chunk.
+    int left = 0;
+    bool first = true;
+    
+    for (int i = 0; i < nb_msgs; i++) {
+        SrsSharedPtrMessage* msg = msgs[i];
+        SrsSharedFlvTag* tag = msg->shared_flv_tag();
+        srs_assert(tag);
+        
+        // the sub message is the flv tag, header, data and previous tag size.
+        char* bytes[3] = {tag->header, msg->payload, tag->pts};
+        int sizes[3] = {SRS_FLV_TAG_HEADER_SIZE, msg->size, SRS_FLV_PREVIOUS_TAG_SIZE};
+        
+        for (int j = 0; j < 3; j++) {
+            char* p = bytes[j];
+            char* pend = p + sizes[j];
+            
+            while (p < pend) {
+                // the header for each chunk.
+                if (left == 0) {
+                    if (iov_index >= nb_out_iovs) {
+                        grow_out_iovs();
+                    }
+                    out_iovs[iov_index].iov_base = first? c0 : c3;
+                    out_iovs[iov_index].iov_len = first? nb_c0 : nb_c3;
+                    iov_index++;
+                    
+                    left = out_chunk_size;
+                    first = false;
+                }
+                
+                int size = srs_min(left, (int)(pend - p));
+                if (iov_index >= nb_out_iovs) {
+                    grow_out_iovs();
+                }
+                out_iovs[iov_index].iov_base = p;
+                out_iovs[iov_index].iov_len = size;
+                iov_index++;
+                
+                p += size;
+                left -= size;
+            }
+        }
+    }
+    
+    // ensure the next pair of iovs.
+    if (iov_index + 2 > nb_out_iovs) {
+        grow_out_iovs();
+    }
+}
+
+void SrsProtocol::grow_out_iovs()
+{
+    srs_warn("resize iovs %d => %d, max_msgs=%d", 
+        nb_out_iovs, nb_out_iovs + SRS_CONSTS_IOVS_MAX, 
+        SRS_PERF_MW_MSGS);
+        
+    nb_out_iovs += SRS_CONSTS_IOVS_MAX;
+    int realloc_size = sizeof(iovec) * nb_out_iovs;
+    out_iovs = (iovec*)realloc(out_iovs, realloc_size);
+}
+
 int SrsProtocol::do_iovs_send(iovec* iovs, int size)
 {
     return srs_write_large_iovs(skt, iovs, size);
@@ -1420,11 +1617,6 @@ int SrsProtocol::read_message_payload(SrsChunkStream* chunk, SrsCommonMessage**
     srs_verbose("chunk payload size is %d, message_size=%d, received_size=%d, in_chunk_size=%d", 
         payload_size, chunk->header.payload_length, chunk->msg->size, in_chunk_size);
 
-    // create msg payload if not initialized
-    if (!chunk->msg->payload) {
-        chunk->msg->create_payload(chunk->header.payload_length);
-    }
-    
     // read payload to buffer
     if ((ret = in_buffer->grow(skt, payload_size)) != ERROR_SUCCESS) {
         if (ret != ERROR_SOCKET_TIMEOUT && !srs_is_client_gracefully_close(ret)) {
@@ -1432,8 +1624,24 @@ int SrsProtocol::read_message_payload(SrsChunkStream* chunk, SrsCommonMessage**
         }
         return ret;
     }
-    memcpy(chunk->msg->payload + chunk->msg->size, in_buffer->read_slice(payload_size), payload_size);
-    chunk->msg->size += payload_size;
+    
+    // the entire message in one chunk, point to the receive buffer without copy.
+    // @remark only when chunk size is large, @see SRS_PERF_RECV_ZERO_COPY_CHUNK_SIZE
+    if (recv_slab && !chunk->msg->payload && payload_size == chunk->header.payload_length
+        && in_chunk_size >= SRS_PERF_RECV_ZERO_COPY_CHUNK_SIZE
+    ) {
+        chunk->msg->attach_slab_payload(in_buffer->get_slab(), in_buffer->read_slice(payload_size), payload_size);
+    } else {
+        // create msg payload if not initialized
+        if (!chunk->msg->payload && recv_slab) {
+            chunk->msg->create_slab_payload(chunk->header.payload_length);
+        } else if (!chunk->msg->payload) {
+            chunk->msg->create_payload(chunk->header.payload_length);
+        }
+        
+        memcpy(chunk->msg->payload + chunk->msg->size, in_buffer->read_slice(payload_size), payload_size);
+        chunk->msg->size += payload_size;
+    }
     
     srs_verbose("chunk payload read completed. payload_size=%d", payload_size);
     
@@ -1973,6 +2181,13 @@ SrsRtmpClient::~SrsRtmpClient()
     srs_freep(hs_bytes);
 }
 
+#ifdef SRS_PERF_RECV_SLAB
+void SrsRtmpClient::set_recv_slab(bool v)
+{
+    protocol->set_recv_slab(v);
+}
+#endif
+
 void SrsRtmpClient::set_recv_timeout(int64_t timeout_us)
 {
     protocol->set_recv_timeout(timeout_us);
@@ -2376,6 +2591,7 @@ SrsRtmpServer::SrsRtmpServer(ISrsProtocolReaderWriter* skt)
     io = skt;
     protocol = new SrsProtocol(skt);
     hs_bytes = new SrsHandshakeBytes();
+    hs_complex = false;
 }
 
 SrsRtmpServer::~SrsRtmpServer()
@@ -2401,6 +2617,18 @@ void SrsRtmpServer::set_recv_buffer(int buffer_size)
 }
 #endif
 
+void SrsRtmpServer::set_send_aggregate(bool v)
+{
+    protocol->set_send_aggregate(v);
+}
+
+#ifdef SRS_PERF_RECV_SLAB
+void SrsRtmpServer::set_recv_slab(bool v)
+{
+    protocol->set_recv_slab(v);
+}
+#endif
+
 void SrsRtmpServer::set_recv_timeout(int64_t timeout_us)
 {
     protocol->set_recv_timeout(timeout_us);
@@ -2474,10 +2702,16 @@ int SrsRtmpServer::handshake()
     }
     
     srs_freep(hs_bytes);
+    hs_complex = true;
     
     return ret;
 }
 
+bool SrsRtmpServer::is_complex_handshake()
+{
+    return hs_complex;
+}
+
 int SrsRtmpServer::connect_app(SrsRequest* req)
 {
     int ret = ERROR_SUCCESS;
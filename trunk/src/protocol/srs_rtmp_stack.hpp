@@ -251,6 +251,11 @@ private:
     * when not auto response message, manual flush the messages in queue.
     */
     std::vector<SrsPacket*> manual_response_queue;
+    /**
+    * whether receive the payload in slab.
+    * @see SRS_PERF_RECV_SLAB
+    */
+    bool recv_slab;
 // peer out
 private:
     /**
@@ -272,6 +277,11 @@ private:
     // whether warned user to increase the c0c3 header cache.
     bool warned_c0c3_cache_dry;
     /**
+    * whether pack the consecutive audio/video messages in aggregate message.
+    * @see set_send_aggregate()
+    */
+    bool send_aggregate;
+    /**
     * output chunk size, default to 128, set by config.
     */
     int32_t out_chunk_size;
@@ -311,6 +321,23 @@ public:
     * @see https://github.com/ossrs/srs/issues/241
     */
     virtual void set_recv_buffer(int buffer_size);
+#endif
+    /**
+    * pack the consecutive audio/video messages of send_and_free_messages
+    * in the RTMP aggregate message, the sub messages are the flv tags,
+    * so the player parse one message for each batch of messages.
+    * @param v true to send in aggregate messages.
+    * @remark only for SRS_PERF_COMPLEX_SEND, and never for metadata.
+    */
+    virtual void set_send_aggregate(bool v);
+#ifdef SRS_PERF_RECV_SLAB
+    /**
+    * receive the payload of message in slab, and point the message
+    * in one chunk to the receive buffer without copy.
+    * @param v true to receive in slab.
+    * @remark user should never detach the payload of message received in slab.
+    */
+    virtual void set_recv_slab(bool v);
 #endif
 public:
     /**
@@ -445,6 +472,22 @@ private:
     */
     virtual int do_iovs_send(iovec* iovs, int size);
     /**
+    * get the number of consecutive audio/video messages to pack in
+    * an aggregate message.
+    * @param psize output the payload size of aggregate message.
+    */
+    virtual int aggregate_messages(SrsSharedPtrMessage** msgs, int nb_msgs, int* psize);
+    /**
+    * append the chunks of aggregate message to iovs, the sub message
+    * headers point to the flv tags shared by all players.
+    * @param iov_index the index of iovs, increased for the appended iovs.
+    */
+    virtual void aggregate_iovs(SrsSharedPtrMessage** msgs, int nb_msgs, char* c0, int nb_c0, char* c3, int nb_c3, int& iov_index);
+    /**
+    * realloc the iovs for more chunks.
+    */
+    virtual void grow_out_iovs();
+    /**
     * underlayer api for send and free packet.
     */
     virtual int do_send_and_free_packet(SrsPacket* packet, int stream_id);
@@ -680,6 +723,13 @@ public:
     virtual ~SrsRtmpClient();
     // protocol methods proxy
 public:
+#ifdef SRS_PERF_RECV_SLAB
+    /**
+     * receive the payload of message in slab.
+     * @see SrsProtocol::set_recv_slab()
+     */
+    virtual void set_recv_slab(bool v);
+#endif
     /**
      * set the recv timeout in us.
      * if timeout, recv/send message return ERROR_SOCKET_TIMEOUT.
@@ -829,6 +879,8 @@ class SrsRtmpServer
 {
 private:
     SrsHandshakeBytes* hs_bytes;
+    // whether the handshake with client is complex.
+    bool hs_complex;
     SrsProtocol* protocol;
     ISrsProtocolReaderWriter* io;
 public:
@@ -860,6 +912,18 @@ public:
      * @see https://github.com/ossrs/srs/issues/241
      */
     virtual void set_recv_buffer(int buffer_size);
+#endif
+    /**
+     * send the audio/video messages in aggregate messages.
+     * @see SrsProtocol::set_send_aggregate()
+     */
+    virtual void set_send_aggregate(bool v);
+#ifdef SRS_PERF_RECV_SLAB
+    /**
+     * receive the payload of message in slab.
+     * @see SrsProtocol::set_recv_slab()
+     */
+    virtual void set_recv_slab(bool v);
 #endif
     /**
      * set/get the recv timeout in us.
@@ -928,6 +992,10 @@ public:
      * handshake with client, try complex then simple.
      */
     virtual int handshake();
+    /**
+     * whether the handshake with client is complex, false for simple.
+     */
+    virtual bool is_complex_handshake();
     /**
      * do connect app with client, to discovery tcUrl.
      */
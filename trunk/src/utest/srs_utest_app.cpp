@@ -0,0 +1,2485 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013-2015 SRS(ossrs)
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <srs_utest_app.hpp>
+
+using namespace std;
+
+#include <srs_kernel_error.hpp>
+#include <srs_kernel_utility.hpp>
+#include <srs_app_worker.hpp>
+#include <srs_app_async_io.hpp>
+#include <srs_core_autofree.hpp>
+#include <srs_app_source.hpp>
+#include <srs_app_statistic.hpp>
+#include <srs_app_config.hpp>
+#include <srs_kernel_flv.hpp>
+#include <srs_rtmp_msg_array.hpp>
+#include <srs_app_hls.hpp>
+#include <srs_app_hls_store.hpp>
+#include <srs_core_performance.hpp>
+#include <srs_app_http_hooks.hpp>
+#include <srs_app_http_client.hpp>
+#include <srs_app_st.hpp>
+#include <srs_app_edge.hpp>
+#include <srs_app_listener.hpp>
+#include <srs_app_mpegts_udp.hpp>
+#include <srs_kernel_ts.hpp>
+#include <srs_app_http_conn.hpp>
+#include <srs_app_http_static.hpp>
+#include <srs_app_rtmp_conn.hpp>
+#include <srs_app_http_stream.hpp>
+#include <srs_utest_config.hpp>
+#include <srs_utest_kernel.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <st.h>
+
+// the max pending bytes of async io pool in utest.
+#define _UTEST_AIO_MAX_PENDING 1024
+
+// the pool is never destroyed, so start it once for all cases.
+SrsAsyncIo* _utest_async_io()
+{
+    st_init();
+    
+    SrsAsyncIo* aio = SrsAsyncIo::instance();
+    if (aio->initialize(2, _UTEST_AIO_MAX_PENDING) != ERROR_SUCCESS) {
+        return NULL;
+    }
+    return aio;
+}
+
+// open the temp file to write in async io.
+int _utest_aio_open(const char* path)
+{
+    return ::open(path, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+}
+
+// read all data of file, the size of data if less than nb_buf.
+int _utest_aio_read(const char* path, char* buf, int nb_buf)
+{
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int nread = (int)::read(fd, buf, nb_buf);
+    ::close(fd);
+    return nread;
+}
+
+VOID TEST(AppWorkerTest, OwnerSingle)
+{
+    EXPECT_EQ(0, srs_worker_owner("/live/livestream", 0));
+    EXPECT_EQ(0, srs_worker_owner("/live/livestream", 1));
+    EXPECT_EQ(0, srs_worker_owner("", 1));
+}
+
+VOID TEST(AppWorkerTest, OwnerStable)
+{
+    // the owner only depends on the url and count.
+    for (int count = 2; count <= 8; count++) {
+        for (int i = 0; i < 100; i++) {
+            char url[64];
+            snprintf(url, sizeof(url), "/live/stream%d", i);
+            
+            int owner = srs_worker_owner(url, count);
+            EXPECT_TRUE(owner >= 0 && owner < count);
+            EXPECT_EQ(owner, srs_worker_owner(url, count));
+            EXPECT_EQ(owner, srs_worker_owner(string(url), count));
+        }
+    }
+    
+    // the owner is crc32 of url.
+    EXPECT_EQ((int)(srs_crc32("/live/livestream", 16) % 4), srs_worker_owner("/live/livestream", 4));
+}
+
+VOID TEST(AppWorkerTest, OwnerDistribution)
+{
+    const int nb_streams = 10000;
+    
+    for (int count = 2; count <= 8; count *= 2) {
+        int owners[8];
+        memset(owners, 0, sizeof(owners));
+        
+        for (int i = 0; i < nb_streams; i++) {
+            char url[64];
+            snprintf(url, sizeof(url), "/live/stream%d", i);
+            owners[srs_worker_owner(url, count)]++;
+        }
+        
+        // each worker owns about 1/count streams, in 10%.
+        int expect = nb_streams / count;
+        for (int i = 0; i < count; i++) {
+            EXPECT_NEAR(expect, owners[i], expect / 10);
+        }
+    }
+}
+
+
+VOID TEST(AppAsyncIoTest, SubmitAndComplete)
+{
+    SrsAsyncIo* aio = _utest_async_io();
+    ASSERT_TRUE(aio != NULL);
+    ASSERT_TRUE(aio->enabled());
+    
+    const char* path = "/tmp/srs_utest_aio_submit.data";
+    int fd = _utest_aio_open(path);
+    ASSERT_TRUE(fd > 0);
+    
+    SrsAsyncIoFile* file = aio->open(fd);
+    
+    // the tasks of file execute in order.
+    char hello[] = "hello", world[] = ", world";
+    iovec iovs[2];
+    iovs[0].iov_base = hello;
+    iovs[0].iov_len = 5;
+    iovs[1].iov_base = world;
+    iovs[1].iov_len = 7;
+    EXPECT_EQ(ERROR_SUCCESS, aio->writev(file, iovs, 2, true));
+    EXPECT_EQ(12, file->pending_bytes);
+    
+    // the data is copied, the user can reuse it.
+    memcpy(hello, "HELLO", 5);
+    EXPECT_EQ(ERROR_SUCCESS, aio->seek(file, 0));
+    EXPECT_EQ(ERROR_SUCCESS, aio->writev(file, iovs, 1, true));
+    EXPECT_EQ(3, file->pending_tasks);
+    
+    // wait for the first task, the write of 12 bytes.
+    aio->wait(file, 2);
+    EXPECT_TRUE(file->pending_tasks <= 2);
+    
+    EXPECT_EQ(ERROR_SUCCESS, aio->close(file, true));
+    
+    char buf[64];
+    EXPECT_EQ(12, _utest_aio_read(path, buf, sizeof(buf)));
+    EXPECT_TRUE(!memcmp("HELLO, world", buf, 12));
+    
+    ::unlink(path);
+}
+
+VOID TEST(AppAsyncIoTest, DrainWhenQuit)
+{
+    SrsAsyncIo* aio = _utest_async_io();
+    ASSERT_TRUE(aio != NULL);
+    
+    // nothing to drain.
+    EXPECT_EQ(0, aio->drain(100));
+    
+    const char* paths[] = {"/tmp/srs_utest_aio_drain0.data", "/tmp/srs_utest_aio_drain1.data"};
+    for (int i = 0; i < 2; i++) {
+        int fd = _utest_aio_open(paths[i]);
+        ASSERT_TRUE(fd > 0);
+        
+        SrsAsyncIoFile* file = aio->open(fd);
+        
+        char data[100];
+        memset(data, 'a' + i, sizeof(data));
+        iovec iov;
+        iov.iov_base = data;
+        iov.iov_len = sizeof(data);
+        for (int j = 0; j < 5; j++) {
+            EXPECT_EQ(ERROR_SUCCESS, aio->writev(file, &iov, 1, false));
+        }
+        
+        // never wait, like the logs when quit.
+        EXPECT_EQ(ERROR_SUCCESS, aio->close(file, false));
+    }
+    
+    // all data written and files closed after drain.
+    EXPECT_EQ(0, aio->drain(3000));
+    
+    for (int i = 0; i < 2; i++) {
+        char buf[1024];
+        EXPECT_EQ(500, _utest_aio_read(paths[i], buf, sizeof(buf)));
+        EXPECT_EQ('a' + i, buf[0]);
+        EXPECT_EQ('a' + i, buf[499]);
+        ::unlink(paths[i]);
+    }
+}
+
+VOID TEST(AppAsyncIoTest, OverflowDropped)
+{
+    SrsAsyncIo* aio = _utest_async_io();
+    ASSERT_TRUE(aio != NULL);
+    
+    const char* path = "/tmp/srs_utest_aio_overflow.data";
+    int fd = _utest_aio_open(path);
+    ASSERT_TRUE(fd > 0);
+    
+    SrsAsyncIoFile* file = aio->open(fd);
+    
+    char data[_UTEST_AIO_MAX_PENDING / 2 + 1];
+    memset(data, 'x', sizeof(data));
+    iovec iov;
+    iov.iov_base = data;
+    iov.iov_len = sizeof(data);
+    
+    // the completed tasks are consumed in st, so the pending never
+    // decrease until yield, the second write exceed the max pending.
+    EXPECT_EQ(ERROR_SUCCESS, aio->writev(file, &iov, 1, false));
+    EXPECT_EQ(ERROR_SYSTEM_ASYNC_IO_FULL, aio->writev(file, &iov, 1, false));
+    EXPECT_EQ(ERROR_SYSTEM_ASYNC_IO_FULL, aio->writev(file, &iov, 1, false));
+    EXPECT_EQ(2, file->nb_dropped);
+    EXPECT_EQ((int)sizeof(data), file->pending_bytes);
+    
+    // the write larger than max pending is allowed when nothing pending.
+    aio->wait(file, 0);
+    char large[_UTEST_AIO_MAX_PENDING * 2];
+    memset(large, 'y', sizeof(large));
+    iov.iov_base = large;
+    iov.iov_len = sizeof(large);
+    EXPECT_EQ(ERROR_SUCCESS, aio->writev(file, &iov, 1, false));
+    EXPECT_EQ(2, file->nb_dropped);
+    
+    // the write wait for the pending when full.
+    iov.iov_base = data;
+    iov.iov_len = sizeof(data);
+    EXPECT_EQ(ERROR_SUCCESS, aio->writev(file, &iov, 1, true));
+    EXPECT_EQ(2, file->nb_dropped);
+    
+    EXPECT_EQ(ERROR_SUCCESS, aio->close(file, true));
+    
+    char buf[_UTEST_AIO_MAX_PENDING * 4];
+    EXPECT_EQ((int)(sizeof(data) * 2 + sizeof(large)), _utest_aio_read(path, buf, sizeof(buf)));
+    
+    ::unlink(path);
+}
+
+// create the message of flv tag, the first two bytes of payload are specified.
+SrsSharedPtrMessage* _utest_ring_msg(bool video, int64_t timestamp, char b0, char b1)
+{
+    char* payload = new char[5];
+    memset(payload, 0, 5);
+    payload[0] = b0;
+    payload[1] = b1;
+    
+    SrsMessageHeader h;
+    if (video) {
+        h.initialize_video(5, (u_int32_t)timestamp, 1);
+    } else {
+        h.initialize_audio(5, (u_int32_t)timestamp, 1);
+    }
+    
+    SrsSharedPtrMessage* msg = new SrsSharedPtrMessage();
+    msg->create(&h, payload, 5);
+    return msg;
+}
+
+// the avc sequence header, keyframe, inter frame and disposable frame.
+#define _UTEST_VSH(ts) _utest_ring_msg(true, ts, 0x17, 0x00)
+#define _UTEST_KEY(ts) _utest_ring_msg(true, ts, 0x17, 0x01)
+#define _UTEST_INTER(ts) _utest_ring_msg(true, ts, 0x27, 0x01)
+#define _UTEST_DISPOSABLE(ts) _utest_ring_msg(true, ts, 0x37, 0x01)
+// the aac sequence header and raw data.
+#define _UTEST_ASH(ts) _utest_ring_msg(false, ts, (char)0xaf, 0x00)
+#define _UTEST_AUDIO(ts) _utest_ring_msg(false, ts, (char)0xaf, 0x01)
+
+// enqueue to ring, which copy the message.
+void _utest_ring_enqueue(SrsMessageRing* ring, SrsSharedPtrMessage* msg)
+{
+    ring->enqueue(msg, false, SrsRtmpJitterAlgorithmOFF);
+    srs_freep(msg);
+}
+
+class MockSrsSourceHandler : public ISrsSourceHandler
+{
+public:
+    MockSrsSourceHandler() {
+    }
+    virtual ~MockSrsSourceHandler() {
+    }
+public:
+    virtual int on_publish(SrsSource* /*s*/, SrsRequest* /*r*/) {
+        return ERROR_SUCCESS;
+    }
+    virtual void on_unpublish(SrsSource* /*s*/, SrsRequest* /*r*/) {
+    }
+};
+
+/**
+* the source for consumers of ring, which only notified when consumer destroy,
+* the source use the config, so mock the global config.
+*/
+class MockSrsRingSource
+{
+public:
+    MockSrsConfig conf;
+    MockSrsSourceHandler handler;
+    SrsRequest req;
+    SrsSource* source;
+    SrsMessageRing ring;
+public:
+    MockSrsRingSource()
+    {
+        // the source maybe start st threads.
+        st_init();
+        
+        _srs_config = &conf;
+        conf.parse(_MIN_OK_CONF);
+        
+        req.vhost = SRS_CONSTS_RTMP_DEFAULT_VHOST;
+        req.app = "live";
+        req.stream = "livestream";
+        
+        source = new SrsSource();
+        source->initialize(&req, &handler);
+        ring.set_queue_size(10);
+    }
+    virtual ~MockSrsRingSource()
+    {
+        srs_freep(source);
+        _srs_config = NULL;
+    }
+public:
+    SrsConsumer* create_consumer(double queue_size, bool smart)
+    {
+        // the source use the same queue size for ring and consumers.
+        ring.set_queue_size(queue_size);
+        
+        SrsConsumer* consumer = new SrsConsumer(source, &ring, NULL);
+        consumer->set_queue_size(queue_size);
+        consumer->set_smart_shrink(smart, NULL);
+        return consumer;
+    }
+};
+
+// dump all messages of consumer, return the timestamps.
+vector<int64_t> _utest_ring_dump(SrsConsumer* consumer)
+{
+    vector<int64_t> times;
+    
+    SrsMessageArray msgs(128);
+    int count = 0;
+    if (consumer->dump_packets(&msgs, count) != ERROR_SUCCESS) {
+        return times;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        times.push_back(msgs.msgs[i]->timestamp);
+    }
+    msgs.free(count);
+    
+    return times;
+}
+
+class MockSrsWakable : public ISrsWakable
+{
+public:
+    int nb_wakeups;
+public:
+    MockSrsWakable() {
+        nb_wakeups = 0;
+    }
+    virtual ~MockSrsWakable() {
+    }
+public:
+    virtual void wakeup() {
+        nb_wakeups++;
+    }
+};
+
+VOID TEST(AppMessageRingTest, EnqueueDumpCursors)
+{
+    MockSrsRingSource ms;
+    SrsMessageRing* ring = &ms.ring;
+    
+    SrsConsumer* c0 = ms.create_consumer(10, false);
+    SrsAutoFree(SrsConsumer, c0);
+    EXPECT_EQ(0, c0->get_cursor());
+    
+    SrsSharedPtrMessage* msg = _UTEST_KEY(0);
+    ring->enqueue(msg, false, SrsRtmpJitterAlgorithmOFF);
+    EXPECT_EQ(1, msg->count());
+    srs_freep(msg);
+    for (int i = 1; i < 5; i++) {
+        _utest_ring_enqueue(ring, _UTEST_INTER(i * 40));
+    }
+    
+    // the consumer start at the end of ring.
+    SrsConsumer* c1 = ms.create_consumer(10, false);
+    SrsAutoFree(SrsConsumer, c1);
+    EXPECT_EQ(5, c1->get_cursor());
+    
+    for (int i = 5; i < 10; i++) {
+        _utest_ring_enqueue(ring, _UTEST_INTER(i * 40));
+    }
+    EXPECT_EQ(0, ring->begin());
+    EXPECT_EQ(10, ring->end());
+    EXPECT_EQ(360, ring->duration(0));
+    
+    // each consumer read from its cursor.
+    vector<int64_t> t0 = _utest_ring_dump(c0);
+    ASSERT_EQ(10, (int)t0.size());
+    EXPECT_EQ(0, t0.at(0));
+    EXPECT_EQ(360, t0.at(9));
+    EXPECT_EQ(10, c0->get_cursor());
+    
+    vector<int64_t> t1 = _utest_ring_dump(c1);
+    ASSERT_EQ(5, (int)t1.size());
+    EXPECT_EQ(200, t1.at(0));
+    EXPECT_EQ(360, t1.at(4));
+    EXPECT_EQ(10, c1->get_cursor());
+    
+    // nothing more, and the messages still in ring.
+    EXPECT_EQ(0, (int)_utest_ring_dump(c0).size());
+    EXPECT_EQ(10, ring->end() - ring->begin());
+    
+    // the consumer read the message enqueued after.
+    _utest_ring_enqueue(ring, _UTEST_INTER(400));
+    t0 = _utest_ring_dump(c0);
+    ASSERT_EQ(1, (int)t0.size());
+    EXPECT_EQ(400, t0.at(0));
+}
+
+VOID TEST(AppMessageRingTest, SlowConsumerJump)
+{
+    MockSrsRingSource ms;
+    SrsMessageRing* ring = &ms.ring;
+    
+    SrsConsumer* c0 = ms.create_consumer(1, false);
+    SrsAutoFree(SrsConsumer, c0);
+    SrsConsumer* c1 = ms.create_consumer(1, true);
+    SrsAutoFree(SrsConsumer, c1);
+    
+    // 3s stream, gop is 1s, the sequence header at 0.
+    _utest_ring_enqueue(ring, _UTEST_VSH(0));
+    for (int i = 1; i < 75; i++) {
+        if ((i % 25) == 1) {
+            _utest_ring_enqueue(ring, _UTEST_KEY(i * 40));
+        } else {
+            _utest_ring_enqueue(ring, _UTEST_INTER(i * 40));
+        }
+    }
+    EXPECT_EQ(2960, ring->duration(0));
+    
+    // the normal consumer jump to the end, resend the sequence header.
+    vector<int64_t> t0 = _utest_ring_dump(c0);
+    ASSERT_EQ(1, (int)t0.size());
+    EXPECT_EQ(75, c0->get_cursor());
+    
+    // the smart consumer resume at the keyframe in queue size, the 51th.
+    vector<int64_t> t1 = _utest_ring_dump(c1);
+    ASSERT_EQ(1 + 24, (int)t1.size());
+    EXPECT_EQ(51 * 40, t1.at(1));
+    EXPECT_EQ(74 * 40, t1.at(24));
+    EXPECT_EQ(75, c1->get_cursor());
+    
+    // the ring never drop the messages read by nobody.
+    EXPECT_EQ(0, ring->begin());
+}
+
+VOID TEST(AppMessageRingTest, SlowConsumerWaitKeyframe)
+{
+    MockSrsRingSource ms;
+    SrsMessageRing* ring = &ms.ring;
+    
+    SrsConsumer* c0 = ms.create_consumer(1, true);
+    SrsAutoFree(SrsConsumer, c0);
+    
+    // 3s stream, only one keyframe at start.
+    _utest_ring_enqueue(ring, _UTEST_VSH(0));
+    _utest_ring_enqueue(ring, _UTEST_KEY(40));
+    for (int i = 2; i < 75; i++) {
+        _utest_ring_enqueue(ring, _UTEST_INTER(i * 40));
+        _utest_ring_enqueue(ring, _UTEST_AUDIO(i * 40));
+    }
+    
+    // no keyframe in queue size, keep the audio in queue size,
+    // drop the video util keyframe.
+    vector<int64_t> t0 = _utest_ring_dump(c0);
+    ASSERT_TRUE(t0.size() > 1);
+    EXPECT_EQ(0, t0.at(0));
+    for (int i = 1; i < (int)t0.size(); i++) {
+        EXPECT_TRUE(t0.at(i) >= 2960 - 1000);
+    }
+    int nb_audios = (int)t0.size() - 1;
+    
+    // resume the video at keyframe.
+    _utest_ring_enqueue(ring, _UTEST_INTER(3000));
+    _utest_ring_enqueue(ring, _UTEST_KEY(3040));
+    _utest_ring_enqueue(ring, _UTEST_INTER(3080));
+    t0 = _utest_ring_dump(c0);
+    ASSERT_EQ(2, (int)t0.size());
+    EXPECT_EQ(3040, t0.at(0));
+    EXPECT_EQ(3080, t0.at(1));
+    EXPECT_TRUE(nb_audios > 0);
+}
+
+VOID TEST(AppMessageRingTest, ReclaimAfterTeardown)
+{
+    MockSrsRingSource ms;
+    SrsMessageRing* ring = &ms.ring;
+    
+    SrsConsumer* c0 = ms.create_consumer(10, false);
+    SrsAutoFree(SrsConsumer, c0);
+    SrsConsumer* c1 = ms.create_consumer(10, false);
+    
+    // fill the ring, the source keep a message to check the shared count.
+    SrsSharedPtrMessage* first = _UTEST_KEY(0);
+    SrsAutoFree(SrsSharedPtrMessage, first);
+    ring->enqueue(first, false, SrsRtmpJitterAlgorithmOFF);
+    for (int i = 1; !ring->full(); i++) {
+        _utest_ring_enqueue(ring, _UTEST_INTER(i * 10));
+    }
+    int64_t end = ring->end();
+    EXPECT_EQ(1, first->count());
+    
+    // c0 read all, c1 never read.
+    while (c0->get_cursor() < end) {
+        ASSERT_TRUE(_utest_ring_dump(c0).size() > 0);
+    }
+    EXPECT_EQ(end, c0->get_cursor());
+    EXPECT_EQ(0, c1->get_cursor());
+    
+    // reclaim by the slowest consumer, nothing freed.
+    ring->reclaim(srs_min(c0->get_cursor(), c1->get_cursor()));
+    EXPECT_EQ(0, ring->begin());
+    EXPECT_TRUE(ring->full());
+    
+    // teardown the slowest consumer, the messages read by others freed.
+    srs_freep(c1);
+    ring->reclaim(c0->get_cursor());
+    EXPECT_EQ(end, ring->begin());
+    EXPECT_FALSE(ring->full());
+    EXPECT_EQ(0, first->count());
+    
+    // the message after reclaim is ok.
+    _utest_ring_enqueue(ring, _UTEST_INTER(end * 10));
+    vector<int64_t> t0 = _utest_ring_dump(c0);
+    ASSERT_EQ(1, (int)t0.size());
+    EXPECT_EQ(end * 10, t0.at(0));
+}
+
+VOID TEST(AppMessageRingTest, SequenceHeaderLateJoiner)
+{
+    MockSrsRingSource ms;
+    SrsMessageRing* ring = &ms.ring;
+    
+    SrsConsumer* c0 = ms.create_consumer(1, false);
+    SrsAutoFree(SrsConsumer, c0);
+    
+    _utest_ring_enqueue(ring, _UTEST_VSH(0));
+    _utest_ring_enqueue(ring, _UTEST_ASH(0));
+    _utest_ring_enqueue(ring, _UTEST_KEY(0));
+    
+    // the late joiner start at the end of ring, the sequence headers
+    // are sent by source from cache, in the queue of consumer.
+    SrsConsumer* c1 = ms.create_consumer(1, false);
+    SrsAutoFree(SrsConsumer, c1);
+    SrsSharedPtrMessage* ash = _UTEST_ASH(0);
+    SrsAutoFree(SrsSharedPtrMessage, ash);
+    SrsSharedPtrMessage* vsh = _UTEST_VSH(0);
+    SrsAutoFree(SrsSharedPtrMessage, vsh);
+    EXPECT_EQ(ERROR_SUCCESS, c1->enqueue(ash, false, SrsRtmpJitterAlgorithmOFF));
+    EXPECT_EQ(ERROR_SUCCESS, c1->enqueue(vsh, false, SrsRtmpJitterAlgorithmOFF));
+    
+    _utest_ring_enqueue(ring, _UTEST_INTER(40));
+    
+    // the queue dumped before the ring.
+    vector<int64_t> t1 = _utest_ring_dump(c1);
+    ASSERT_EQ(3, (int)t1.size());
+    EXPECT_EQ(40, t1.at(2));
+    
+    // the new sequence header when lagging, the consumer jump over it, resend the last one.
+    for (int i = 2; i < 50; i++) {
+        if (i == 10) {
+            _utest_ring_enqueue(ring, _UTEST_VSH(i * 40));
+        }
+        _utest_ring_enqueue(ring, _UTEST_INTER(i * 40));
+    }
+    vector<int64_t> t0 = _utest_ring_dump(c0);
+    ASSERT_EQ(2, (int)t0.size());
+    EXPECT_EQ(400, t0.at(0));
+    EXPECT_EQ(0, t0.at(1));
+    
+    // the c1 also lagging, the sequence header resent once.
+    t1 = _utest_ring_dump(c1);
+    ASSERT_EQ(1, (int)t1.size());
+    EXPECT_EQ(400, t1.at(0));
+}
+
+VOID TEST(AppMessageRingTest, WakeupOwnThreshold)
+{
+    SrsMessageRing ring;
+    ring.set_queue_size(10);
+    
+    MockSrsWakable w0, w1, w2;
+    
+    // w0 wait for 1 msg, w1 wait for 10 msgs, w2 wait for 300ms.
+    ring.wait(&w0, 0, 1, 0);
+    ring.wait(&w1, 0, 10, 0);
+    ring.wait(&w2, 0, 1, 300);
+    EXPECT_EQ(3, ring.nb_waiters());
+    
+    _utest_ring_enqueue(&ring, _UTEST_KEY(0));
+    EXPECT_EQ(0, w0.nb_wakeups);
+    EXPECT_EQ(3, ring.nb_waiters());
+    
+    // only w0 is ok.
+    _utest_ring_enqueue(&ring, _UTEST_INTER(100));
+    EXPECT_EQ(1, w0.nb_wakeups);
+    EXPECT_EQ(0, w1.nb_wakeups);
+    EXPECT_EQ(0, w2.nb_wakeups);
+    EXPECT_EQ(2, ring.nb_waiters());
+    
+    // w2 is ok.
+    for (int i = 2; i < 5; i++) {
+        _utest_ring_enqueue(&ring, _UTEST_INTER(i * 100));
+    }
+    EXPECT_EQ(1, w0.nb_wakeups);
+    EXPECT_EQ(0, w1.nb_wakeups);
+    EXPECT_EQ(1, w2.nb_wakeups);
+    EXPECT_EQ(1, ring.nb_waiters());
+    
+    // w1 is ok.
+    for (int i = 5; i < 11; i++) {
+        _utest_ring_enqueue(&ring, _UTEST_INTER(i * 100));
+    }
+    EXPECT_EQ(1, w1.nb_wakeups);
+    EXPECT_EQ(0, ring.nb_waiters());
+    
+    // the consumer wakeup by others remove itself.
+    ring.wait(&w0, 11, 1, 0);
+    ring.wait(&w1, 11, 1, 0);
+    ring.unwait(&w0);
+    EXPECT_EQ(1, ring.nb_waiters());
+    _utest_ring_enqueue(&ring, _UTEST_INTER(1100));
+    _utest_ring_enqueue(&ring, _UTEST_INTER(1200));
+    EXPECT_EQ(1, w0.nb_wakeups);
+    EXPECT_EQ(2, w1.nb_wakeups);
+    
+    ring.clear();
+}
+
+VOID TEST(AppMessageRingTest, ShrinkPolicy)
+{
+    SrsShrinkPolicy policy;
+    policy.set_queue_size(1);
+    
+    // never drop when not smart.
+    EXPECT_FALSE(policy.drop_video(false, false, true, 1000, NULL));
+    policy.on_shrink(false, true, 10);
+    EXPECT_FALSE(policy.waiting_keyframe());
+    
+    policy.set_smart_shrink(true, NULL);
+    
+    // drop the disposable frame when congested.
+    int reasons[SrsStatisticDropReasonMax];
+    memset(reasons, 0, sizeof(reasons));
+    EXPECT_FALSE(policy.drop_video(false, false, true, 500, reasons));
+    EXPECT_TRUE(policy.drop_video(false, false, true, 501, reasons));
+    EXPECT_FALSE(policy.drop_video(false, false, false, 900, reasons));
+    EXPECT_EQ(1, reasons[SrsStatisticDropReasonDisposable]);
+    
+    // resume at keyframe, never wait.
+    policy.on_shrink(true, true, 10);
+    EXPECT_FALSE(policy.waiting_keyframe());
+    
+    // no video dropped, never wait.
+    policy.on_shrink(false, false, 10);
+    EXPECT_FALSE(policy.waiting_keyframe());
+    
+    // drop the video util keyframe, but not the sequence header.
+    policy.on_shrink(false, true, 10);
+    EXPECT_TRUE(policy.waiting_keyframe());
+    EXPECT_TRUE(policy.drop_video(false, false, false, 0, reasons));
+    EXPECT_FALSE(policy.drop_video(true, false, false, 0, reasons));
+    EXPECT_EQ(1, reasons[SrsStatisticDropReasonWaitKeyframe]);
+    EXPECT_FALSE(policy.drop_video(false, true, false, 0, reasons));
+    EXPECT_FALSE(policy.waiting_keyframe());
+    
+    // reset when disable smart shrink.
+    policy.on_shrink(false, true, 10);
+    policy.set_smart_shrink(false, NULL);
+    EXPECT_FALSE(policy.waiting_keyframe());
+}
+
+VOID TEST(AppMessageRingTest, QueueSmartShrink)
+{
+    SrsMessageQueue queue;
+    queue.set_queue_size(1);
+    queue.set_smart_shrink(true, NULL);
+    
+    // 3s stream, gop is 1s.
+    queue.enqueue(_UTEST_VSH(0));
+    queue.enqueue(_UTEST_ASH(0));
+    bool overflow = false;
+    for (int i = 1; i < 75; i++) {
+        if ((i % 25) == 1) {
+            queue.enqueue(_UTEST_KEY(i * 40), &overflow);
+        } else {
+            queue.enqueue(_UTEST_INTER(i * 40), &overflow);
+        }
+    }
+    EXPECT_TRUE(overflow);
+    EXPECT_TRUE(queue.duration() <= 1000);
+    
+    // the sequence headers are kept, and resume at the keyframe.
+    SrsSharedPtrMessage* msgs[128];
+    int count = 0;
+    EXPECT_EQ(ERROR_SUCCESS, queue.dump_packets(128, msgs, count));
+    ASSERT_TRUE(count > 3);
+    EXPECT_TRUE(msgs[0]->is_video());
+    EXPECT_TRUE(msgs[1]->is_audio());
+    EXPECT_EQ(51 * 40, msgs[2]->timestamp);
+    EXPECT_EQ(74 * 40, msgs[count - 1]->timestamp);
+    for (int i = 0; i < count; i++) {
+        srs_freep(msgs[i]);
+    }
+}
+
+VOID TEST(AppMessageRingTest, QueueSmartShrinkAudio)
+{
+    SrsMessageQueue queue;
+    queue.set_queue_size(1);
+    queue.set_smart_shrink(true, NULL);
+    
+    // 3s stream, gop is 1s, audio is interleaved.
+    queue.enqueue(_UTEST_VSH(0));
+    queue.enqueue(_UTEST_ASH(0));
+    for (int i = 1; i < 75; i++) {
+        if ((i % 25) == 1) {
+            queue.enqueue(_UTEST_KEY(i * 40));
+        } else {
+            queue.enqueue(_UTEST_INTER(i * 40));
+        }
+        queue.enqueue(_UTEST_AUDIO(i * 40 + 20));
+    }
+    EXPECT_TRUE(queue.duration() <= 1000);
+    
+    SrsSharedPtrMessage* msgs[256];
+    int count = 0;
+    EXPECT_EQ(ERROR_SUCCESS, queue.dump_packets(256, msgs, count));
+    ASSERT_TRUE(count > 3);
+    
+    // the audio before the keyframe is kept, and never gap.
+    int64_t first_audio = -1;
+    int64_t last_audio = -1;
+    int64_t first_video = -1;
+    for (int i = 2; i < count; i++) {
+        SrsSharedPtrMessage* msg = msgs[i];
+        if (msg->is_audio()) {
+            if (last_audio >= 0) {
+                EXPECT_EQ(last_audio + 40, msg->timestamp);
+            }
+            first_audio = (first_audio < 0)? msg->timestamp : first_audio;
+            last_audio = msg->timestamp;
+        } else if (first_video < 0) {
+            first_video = msg->timestamp;
+            EXPECT_TRUE(SrsFlvCodec::video_is_keyframe(msg->payload, msg->size));
+        }
+    }
+    EXPECT_EQ(51 * 40, first_video);
+    EXPECT_TRUE(first_audio < first_video);
+    EXPECT_TRUE(first_audio >= last_audio - 1000);
+    EXPECT_EQ(74 * 40 + 20, last_audio);
+    
+    for (int i = 0; i < count; i++) {
+        srs_freep(msgs[i]);
+    }
+}
+
+/**
+* mock the global config, for the app use the config directly.
+*/
+class MockSrsGlobalConfig
+{
+public:
+    MockSrsConfig conf;
+public:
+    MockSrsGlobalConfig(std::string buf)
+    {
+        _srs_config = &conf;
+        conf.parse(buf);
+    }
+    virtual ~MockSrsGlobalConfig()
+    {
+        _srs_config = NULL;
+    }
+};
+
+#ifdef SRS_AUTO_HLS
+
+// the bytes of buffer, joined by iovs.
+string _utest_hls_ram_bytes(SrsHlsRamBuffer* buffer)
+{
+    vector<iovec> iovs(buffer->nb_chunks() + 1);
+    int nb_iovs = buffer->to_iovs(&iovs[0]);
+    
+    string bytes;
+    for (int i = 0; i < nb_iovs; i++) {
+        bytes.append((char*)iovs[i].iov_base, iovs[i].iov_len);
+    }
+    return bytes;
+}
+
+// create the buffer of size bytes, filled with c.
+SrsHlsRamBuffer* _utest_hls_ram_buffer(int size, char c)
+{
+    SrsHlsRamBuffer* buffer = new SrsHlsRamBuffer();
+    string bytes(size, c);
+    buffer->append(bytes.data(), size);
+    return buffer;
+}
+
+VOID TEST(AppHlsRamTest, BufferChunks)
+{
+    SrsHlsRamBuffer buffer;
+    EXPECT_EQ(0, buffer.length());
+    EXPECT_EQ(0, buffer.nb_chunks());
+    EXPECT_EQ(0, buffer.capacity());
+    
+    // append in small pieces, across the chunk.
+    string expect;
+    for (int i = 0; i < SRS_PERF_HLS_RAM_CHUNK_SIZE / 188 + 10; i++) {
+        string ts(188, (char)i);
+        buffer.append(ts.data(), (int)ts.length());
+        expect.append(ts);
+    }
+    EXPECT_EQ((int)expect.length(), buffer.length());
+    EXPECT_EQ(2, buffer.nb_chunks());
+    EXPECT_EQ(2 * SRS_PERF_HLS_RAM_CHUNK_SIZE, buffer.capacity());
+    
+    // the first iov is a full chunk, the last is the left bytes.
+    iovec iovs[2];
+    EXPECT_EQ(2, buffer.to_iovs(iovs));
+    EXPECT_EQ(SRS_PERF_HLS_RAM_CHUNK_SIZE, (int)iovs[0].iov_len);
+    EXPECT_EQ((int)expect.length() - SRS_PERF_HLS_RAM_CHUNK_SIZE, (int)iovs[1].iov_len);
+    EXPECT_TRUE(expect == _utest_hls_ram_bytes(&buffer));
+    
+    // append a large one, exactly fill the chunks.
+    SrsHlsRamBuffer large;
+    string bytes(SRS_PERF_HLS_RAM_CHUNK_SIZE * 3, 'x');
+    large.append(bytes.data(), (int)bytes.length());
+    EXPECT_EQ(3, large.nb_chunks());
+    EXPECT_EQ(large.capacity(), large.length());
+    EXPECT_TRUE(bytes == _utest_hls_ram_bytes(&large));
+}
+
+VOID TEST(AppHlsRamTest, BufferShared)
+{
+    SrsHlsRamBuffer* buffer = _utest_hls_ram_buffer(SRS_PERF_HLS_RAM_CHUNK_SIZE + 1, 'a');
+    
+    // the copies share the chunks.
+    SrsHlsRamBuffer* c0 = buffer->copy();
+    SrsHlsRamBuffer* c1 = c0->copy();
+    iovec i0[2], i1[2];
+    c0->to_iovs(i0);
+    c1->to_iovs(i1);
+    EXPECT_TRUE(i0[0].iov_base == i1[0].iov_base);
+    EXPECT_TRUE(i0[1].iov_base == i1[1].iov_base);
+    
+    // the chunks are alive until all copies freed.
+    srs_freep(buffer);
+    srs_freep(c0);
+    EXPECT_EQ(SRS_PERF_HLS_RAM_CHUNK_SIZE + 1, c1->length());
+    EXPECT_TRUE(string(SRS_PERF_HLS_RAM_CHUNK_SIZE + 1, 'a') == _utest_hls_ram_bytes(c1));
+    
+    // the chunks are reused by pool.
+    srs_freep(c1);
+    SrsHlsRamBuffer* reuse = _utest_hls_ram_buffer(1, 'b');
+    SrsAutoFree(SrsHlsRamBuffer, reuse);
+    iovec iov;
+    reuse->to_iovs(&iov);
+    EXPECT_TRUE(iov.iov_base == i1[0].iov_base || iov.iov_base == i1[1].iov_base);
+}
+
+VOID TEST(AppHlsRamTest, StoreUpdateFetch)
+{
+    MockSrsGlobalConfig mc(_MIN_OK_CONF"vhost utest.hls.store{hls{hls_ram_budget 64;}}");
+    SrsHlsRamStore* store = SrsHlsRamStore::instance();
+    
+    string vhost = "utest.hls.store";
+    EXPECT_TRUE(NULL == store->fetch(vhost, "/utest/store.m3u8"));
+    EXPECT_EQ(0, store->bytes(vhost));
+    
+    store->update(vhost, "/utest/store.m3u8", _utest_hls_ram_buffer(100, '0'));
+    store->update(vhost, "/utest/store-0.ts", _utest_hls_ram_buffer(SRS_PERF_HLS_RAM_CHUNK_SIZE + 1, 't'));
+    EXPECT_EQ(3 * SRS_PERF_HLS_RAM_CHUNK_SIZE, store->bytes(vhost));
+    
+    // the player fetch a copy, which is alive even the store updated.
+    SrsHlsRamBuffer* m3u8 = store->fetch(vhost, "/utest/store.m3u8");
+    ASSERT_TRUE(NULL != m3u8);
+    SrsAutoFree(SrsHlsRamBuffer, m3u8);
+    
+    store->update(vhost, "/utest/store.m3u8", _utest_hls_ram_buffer(200, '1'));
+    EXPECT_EQ(3 * SRS_PERF_HLS_RAM_CHUNK_SIZE, store->bytes(vhost));
+    EXPECT_TRUE(string(100, '0') == _utest_hls_ram_bytes(m3u8));
+    
+    SrsHlsRamBuffer* updated = store->fetch(vhost, "/utest/store.m3u8");
+    ASSERT_TRUE(NULL != updated);
+    SrsAutoFree(SrsHlsRamBuffer, updated);
+    EXPECT_TRUE(string(200, '1') == _utest_hls_ram_bytes(updated));
+    
+    // remove the segment, ignore the not found.
+    SrsHlsRamBuffer* ts = store->fetch(vhost, "/utest/store-0.ts");
+    ASSERT_TRUE(NULL != ts);
+    SrsAutoFree(SrsHlsRamBuffer, ts);
+    store->remove(vhost, "/utest/store-0.ts");
+    store->remove(vhost, "/utest/store-0.ts");
+    EXPECT_TRUE(NULL == store->fetch(vhost, "/utest/store-0.ts"));
+    EXPECT_EQ(SRS_PERF_HLS_RAM_CHUNK_SIZE, store->bytes(vhost));
+    EXPECT_EQ(SRS_PERF_HLS_RAM_CHUNK_SIZE + 1, ts->length());
+    
+    store->remove(vhost, "/utest/store.m3u8");
+    EXPECT_EQ(0, store->bytes(vhost));
+}
+
+VOID TEST(AppHlsRamTest, StoreBudgetEvict)
+{
+    MockSrsGlobalConfig mc(_MIN_OK_CONF"vhost utest.hls.budget{hls{hls_ram_budget 1;}} vhost utest.hls.other{}");
+    SrsHlsRamStore* store = SrsHlsRamStore::instance();
+    
+    // 1MB is 64 chunks, the other vhost never evicted.
+    string vhost = "utest.hls.budget";
+    store->update("utest.hls.other", "/utest/other.ts", _utest_hls_ram_buffer(1, 'o'));
+    
+    int nb_chunks = 1024 * 1024 / SRS_PERF_HLS_RAM_CHUNK_SIZE;
+    for (int i = 0; i < nb_chunks + 10; i++) {
+        char url[64];
+        snprintf(url, sizeof(url), "/utest/budget-%d.ts", i);
+        store->update(vhost, url, _utest_hls_ram_buffer(1, 'b'));
+        EXPECT_TRUE(store->bytes(vhost) <= 1024 * 1024);
+    }
+    EXPECT_EQ(1024 * 1024, store->bytes(vhost));
+    
+    // the oldest evicted.
+    for (int i = 0; i < 10; i++) {
+        char url[64];
+        snprintf(url, sizeof(url), "/utest/budget-%d.ts", i);
+        EXPECT_TRUE(NULL == store->fetch(vhost, url));
+    }
+    SrsHlsRamBuffer* last = store->fetch(vhost, "/utest/budget-10.ts");
+    EXPECT_TRUE(NULL != last);
+    srs_freep(last);
+    
+    // the updated entry is the newest.
+    store->update(vhost, "/utest/budget-10.ts", _utest_hls_ram_buffer(1, 'n'));
+    store->update(vhost, "/utest/budget-new.ts", _utest_hls_ram_buffer(1, 'n'));
+    last = store->fetch(vhost, "/utest/budget-10.ts");
+    EXPECT_TRUE(NULL != last);
+    srs_freep(last);
+    last = store->fetch(vhost, "/utest/budget-11.ts");
+    EXPECT_TRUE(NULL == last);
+    
+    // the entry larger than budget is kept, until next update.
+    store->update(vhost, "/utest/budget-large.ts", _utest_hls_ram_buffer(2 * 1024 * 1024, 'l'));
+    EXPECT_EQ(2 * 1024 * 1024, store->bytes(vhost));
+    
+    store->remove(vhost, "/utest/budget-large.ts");
+    store->remove("utest.hls.other", "/utest/other.ts");
+    EXPECT_EQ(0, store->bytes(vhost));
+    EXPECT_EQ(0, store->bytes("utest.hls.other"));
+}
+
+/**
+* the vhosts publish the same stream, never share the hls in ram.
+*/
+VOID TEST(AppHlsRamTest, StoreVhosts)
+{
+    MockSrsGlobalConfig mc(_MIN_OK_CONF"vhost utest.hls.a{} vhost utest.hls.b{}");
+    SrsHlsRamStore* store = SrsHlsRamStore::instance();
+    
+    store->update("utest.hls.a", "/live/livestream.m3u8", _utest_hls_ram_buffer(10, 'a'));
+    store->update("utest.hls.a", "/live/livestream-0.ts", _utest_hls_ram_buffer(10, 'a'));
+    
+    // the update of vhost b never remove the same url of vhost a.
+    store->update("utest.hls.b", "/live/livestream.m3u8", _utest_hls_ram_buffer(20, 'b'));
+    
+    SrsHlsRamBuffer* a = store->fetch("utest.hls.a", "/live/livestream.m3u8");
+    ASSERT_TRUE(NULL != a);
+    SrsAutoFree(SrsHlsRamBuffer, a);
+    EXPECT_TRUE(string(10, 'a') == _utest_hls_ram_bytes(a));
+    
+    SrsHlsRamBuffer* b = store->fetch("utest.hls.b", "/live/livestream.m3u8");
+    ASSERT_TRUE(NULL != b);
+    SrsAutoFree(SrsHlsRamBuffer, b);
+    EXPECT_TRUE(string(20, 'b') == _utest_hls_ram_bytes(b));
+    
+    EXPECT_TRUE(NULL == store->fetch("utest.hls.b", "/live/livestream-0.ts"));
+    
+#ifdef SRS_AUTO_HTTP_SERVER
+    // the http player is served by the vhost of its host.
+    SrsHlsRamStream stream;
+    http_parser header;
+    memset(&header, 0, sizeof(http_parser));
+    
+    vector<SrsHttpHeaderField> headers;
+    headers.push_back(SrsHttpHeaderField("Host", "utest.hls.a"));
+    SrsHttpMessage ma(NULL, NULL);
+    ASSERT_EQ(ERROR_SUCCESS, ma.update("/live/livestream-0.ts", &header, NULL, headers));
+    EXPECT_TRUE(stream.can_serve(&ma));
+    
+    headers.clear();
+    headers.push_back(SrsHttpHeaderField("Host", "utest.hls.b"));
+    SrsHttpMessage mb(NULL, NULL);
+    ASSERT_EQ(ERROR_SUCCESS, mb.update("/live/livestream-0.ts", &header, NULL, headers));
+    EXPECT_FALSE(stream.can_serve(&mb));
+    
+    // no default vhost, the unknown host is never served.
+    headers.clear();
+    headers.push_back(SrsHttpHeaderField("Host", "utest.hls.unknown"));
+    SrsHttpMessage mu(NULL, NULL);
+    ASSERT_EQ(ERROR_SUCCESS, mu.update("/live/livestream.m3u8", &header, NULL, headers));
+    EXPECT_FALSE(stream.can_serve(&mu));
+#endif
+    
+    store->remove("utest.hls.a", "/live/livestream.m3u8");
+    store->remove("utest.hls.a", "/live/livestream-0.ts");
+    store->remove("utest.hls.b", "/live/livestream.m3u8");
+    EXPECT_EQ(0, store->bytes("utest.hls.a"));
+    EXPECT_EQ(0, store->bytes("utest.hls.b"));
+}
+
+VOID TEST(AppHlsRamTest, CacheWriterDetach)
+{
+    MockSrsGlobalConfig mc(_MIN_OK_CONF);
+    
+    // the ram only writer never write file.
+    SrsHlsCacheWriter writer(true, false);
+    EXPECT_EQ(ERROR_SUCCESS, writer.open("/utest/never/exists/writer.ts"));
+    EXPECT_TRUE(NULL == writer.cache());
+    
+    ssize_t nwrite = 0;
+    EXPECT_EQ(ERROR_SUCCESS, writer.write((void*)"hello", 5, &nwrite));
+    EXPECT_EQ(ERROR_SUCCESS, writer.write((void*)", world", 7, &nwrite));
+    
+    // the cache is detached, the writer start a new buffer.
+    SrsHlsRamBuffer* buffer = writer.cache();
+    ASSERT_TRUE(NULL != buffer);
+    SrsAutoFree(SrsHlsRamBuffer, buffer);
+    EXPECT_TRUE("hello, world" == _utest_hls_ram_bytes(buffer));
+    EXPECT_TRUE(NULL == writer.cache());
+    
+    // the bytes of previous segment dropped when open.
+    EXPECT_EQ(ERROR_SUCCESS, writer.write((void*)"dropped", 7, &nwrite));
+    EXPECT_EQ(ERROR_SUCCESS, writer.open("/utest/never/exists/writer.ts"));
+    EXPECT_TRUE(NULL == writer.cache());
+}
+
+#endif
+
+#ifdef SRS_AUTO_HTTP_CALLBACK
+
+/**
+* the http hooks server in st, to count the connections and requests.
+*/
+class MockSrsHooksServer
+{
+public:
+    int port;
+    // the body of response, for example, 0.
+    string answer;
+    // whether close the connection after response, but answer keep-alive.
+    bool close_after_response;
+    int nb_connections;
+    int nb_requests;
+    // the action of each request.
+    vector<string> actions;
+private:
+    int fd;
+    st_netfd_t stfd;
+    bool disposed;
+    // the alive st threads of server.
+    int nb_threads;
+    struct MockSrsHooksConn
+    {
+        MockSrsHooksServer* server;
+        st_netfd_t stfd;
+    };
+public:
+    MockSrsHooksServer()
+    {
+        port = 0;
+        answer = "0";
+        close_after_response = false;
+        nb_connections = nb_requests = 0;
+        fd = -1;
+        stfd = NULL;
+        disposed = false;
+        nb_threads = 0;
+    }
+    virtual ~MockSrsHooksServer()
+    {
+        disposed = true;
+        while (nb_threads > 0) {
+            st_usleep(10 * 1000);
+        }
+        srs_close_stfd(stfd);
+    }
+public:
+    int listen()
+    {
+        st_init();
+        
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = 0;
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        if (bind(fd, (const sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(fd, 10) < 0) {
+            ::close(fd);
+            return ERROR_SOCKET_BIND;
+        }
+        
+        socklen_t len = sizeof(addr);
+        getsockname(fd, (sockaddr*)&addr, &len);
+        port = ntohs(addr.sin_port);
+        
+        if ((stfd = st_netfd_open_socket(fd)) == NULL) {
+            ::close(fd);
+            return ERROR_ST_OPEN_SOCKET;
+        }
+        
+        nb_threads++;
+        st_thread_create(accept_cycle, this, 0, 0);
+        
+        return ERROR_SUCCESS;
+    }
+    string url()
+    {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "http://127.0.0.1:%d/api/v1/hooks", port);
+        return buf;
+    }
+    // wait for the requests in ms.
+    void wait(int nb_msgs, int timeout_ms)
+    {
+        for (int i = 0; i < timeout_ms / 10 && nb_requests < nb_msgs; i++) {
+            st_usleep(10 * 1000);
+        }
+    }
+private:
+    static void* accept_cycle(void* arg)
+    {
+        MockSrsHooksServer* server = (MockSrsHooksServer*)arg;
+        while (!server->disposed) {
+            st_netfd_t client = st_accept(server->stfd, NULL, NULL, 100 * 1000);
+            if (!client) {
+                continue;
+            }
+            
+            server->nb_connections++;
+            server->nb_threads++;
+            
+            MockSrsHooksConn* conn = new MockSrsHooksConn();
+            conn->server = server;
+            conn->stfd = client;
+            st_thread_create(conn_cycle, conn, 0, 0);
+        }
+        server->nb_threads--;
+        return NULL;
+    }
+    static void* conn_cycle(void* arg)
+    {
+        MockSrsHooksConn* conn = (MockSrsHooksConn*)arg;
+        MockSrsHooksServer* server = conn->server;
+        
+        string buf;
+        while (!server->disposed) {
+            char data[4096];
+            ssize_t nread = st_read(conn->stfd, data, sizeof(data), 100 * 1000);
+            if (nread < 0 && errno == ETIME) {
+                continue;
+            }
+            if (nread <= 0) {
+                break;
+            }
+            buf.append(data, nread);
+            
+            // the request is header and body of content-length.
+            size_t pos = buf.find("\r\n\r\n");
+            if (pos == string::npos) {
+                continue;
+            }
+            size_t cl = buf.find("Content-Length: ");
+            int size = (cl == string::npos)? 0 : ::atoi(buf.c_str() + cl + 16);
+            if (buf.length() < pos + 4 + size) {
+                continue;
+            }
+            string body = buf.substr(pos + 4, size);
+            buf = buf.substr(pos + 4 + size);
+            
+            server->nb_requests++;
+            size_t action = body.find("\"action\":");
+            if (action != string::npos) {
+                size_t start = body.find("\"", action + 9) + 1;
+                server->actions.push_back(body.substr(start, body.find("\"", start) - start));
+            }
+            
+            char header[128];
+            snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", (int)server->answer.length());
+            string res = string(header) + server->answer;
+            if (st_write(conn->stfd, res.data(), res.length(), ST_UTIME_NO_TIMEOUT) != (ssize_t)res.length()) {
+                break;
+            }
+            
+            if (server->close_after_response) {
+                break;
+            }
+        }
+        
+        srs_close_stfd(conn->stfd);
+        srs_freep(conn);
+        server->nb_threads--;
+        return NULL;
+    }
+};
+
+// the request of hooks.
+void _utest_hooks_req(SrsRequest* req, string ip)
+{
+    req->ip = ip;
+    req->vhost = "utest.hooks";
+    req->app = "live";
+    req->stream = "livestream";
+    req->tcUrl = "rtmp://127.0.0.1/live";
+}
+
+VOID TEST(AppHttpHooksTest, KeepAliveReuse)
+{
+    MockSrsGlobalConfig mc(_MIN_OK_CONF);
+    
+    MockSrsHooksServer server;
+    ASSERT_EQ(ERROR_SUCCESS, server.listen());
+    
+    SrsRequest req;
+    _utest_hooks_req(&req, "10.0.0.1");
+    
+    // the hooks reuse the connection.
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(ERROR_SUCCESS, SrsHttpHooks::on_connect(server.url(), &req));
+    }
+    EXPECT_EQ(1, server.nb_connections);
+    EXPECT_EQ(3, server.nb_requests);
+    
+    // the server deny it.
+    server.answer = "{\"code\": 100}";
+    EXPECT_EQ(ERROR_RESPONSE_CODE, SrsHttpHooks::on_connect(server.url(), &req));
+    server.answer = "";
+    EXPECT_EQ(ERROR_HTTP_DATA_INVALID, SrsHttpHooks::on_connect(server.url(), &req));
+    EXPECT_EQ(1, server.nb_connections);
+    EXPECT_EQ(5, server.nb_requests);
+}
+
+VOID TEST(AppHttpHooksTest, RetryClosedConnection)
+{
+    MockSrsGlobalConfig mc(_MIN_OK_CONF);
+    
+    MockSrsHooksServer server;
+    ASSERT_EQ(ERROR_SUCCESS, server.listen());
+    server.close_after_response = true;
+    
+    SrsRequest req;
+    _utest_hooks_req(&req, "10.0.0.1");
+    
+    // the reused connection is closed by server, retry once in new connection.
+    EXPECT_EQ(ERROR_SUCCESS, SrsHttpHooks::on_connect(server.url(), &req));
+    st_usleep(10 * 1000);
+    EXPECT_EQ(ERROR_SUCCESS, SrsHttpHooks::on_connect(server.url(), &req));
+    EXPECT_EQ(2, server.nb_connections);
+    EXPECT_EQ(2, server.nb_requests);
+}
+
+VOID TEST(AppHttpHooksTest, OnPlayCache)
+{
+    MockSrsGlobalConfig mc(_MIN_OK_CONF"vhost utest.hooks{http_hooks{enabled on; on_play_cache_ttl 10;}}");
+    
+    MockSrsHooksServer server;
+    ASSERT_EQ(ERROR_SUCCESS, server.listen());
+    
+    SrsRequest r0, r1;
+    _utest_hooks_req(&r0, "10.0.0.1");
+    _utest_hooks_req(&r1, "10.0.0.2");
+    
+    // the answer of same client is cached.
+    EXPECT_EQ(ERROR_SUCCESS, SrsHttpHooks::on_play(server.url(), &r0));
+    EXPECT_EQ(ERROR_SUCCESS, SrsHttpHooks::on_play(server.url(), &r0));
+    EXPECT_EQ(1, server.nb_requests);
+    
+    // the denied answer is also cached.
+    server.answer = "{\"code\": 100}";
+    EXPECT_EQ(ERROR_RESPONSE_CODE, SrsHttpHooks::on_play(server.url(), &r1));
+    server.answer = "0";
+    EXPECT_EQ(ERROR_RESPONSE_CODE, SrsHttpHooks::on_play(server.url(), &r1));
+    EXPECT_EQ(2, server.nb_requests);
+    
+    // the param is in key.
+    r0.param = "?token=xxx";
+    EXPECT_EQ(ERROR_SUCCESS, SrsHttpHooks::on_play(server.url(), &r0));
+    EXPECT_EQ(3, server.nb_requests);
+    
+    // the answer expired.
+    SrsHttpHooksDispatcher* dispatcher = SrsHttpHooksDispatcher::instance();
+    int ret = ERROR_SUCCESS;
+    dispatcher->cache_answer("utest.expired", ERROR_RESPONSE_CODE, -1000);
+    EXPECT_FALSE(dispatcher->fetch_answer("utest.expired", &ret));
+    dispatcher->cache_answer("utest.expired", ERROR_RESPONSE_CODE, 10000);
+    EXPECT_TRUE(dispatcher->fetch_answer("utest.expired", &ret));
+    EXPECT_EQ(ERROR_RESPONSE_CODE, ret);
+    
+    // never cache when ttl disabled.
+    MockSrsGlobalConfig disabled(_MIN_OK_CONF"vhost utest.hooks{http_hooks{enabled on;}}");
+    r1.param = "?disabled";
+    EXPECT_EQ(ERROR_SUCCESS, SrsHttpHooks::on_play(server.url(), &r1));
+    EXPECT_EQ(ERROR_SUCCESS, SrsHttpHooks::on_play(server.url(), &r1));
+    EXPECT_EQ(5, server.nb_requests);
+}
+
+/**
+* release the connection of pool in another st thread.
+*/
+struct MockSrsHooksReleaser
+{
+    SrsHttpHooksPool* pool;
+    SrsHttpClient* client;
+    static void* cycle(void* arg)
+    {
+        MockSrsHooksReleaser* r = (MockSrsHooksReleaser*)arg;
+        st_usleep(10 * 1000);
+        r->pool->release(r->client, true);
+        return NULL;
+    }
+};
+
+VOID TEST(AppHttpHooksTest, PoolMaxConnections)
+{
+    st_init();
+    
+    SrsHttpHooksPool pool("127.0.0.1", 1, 1);
+    
+    SrsHttpClient* c0 = NULL;
+    bool reused = true;
+    EXPECT_EQ(ERROR_SUCCESS, pool.acquire(&c0, &reused));
+    EXPECT_FALSE(reused);
+    
+    // release the busy one in another thread.
+    MockSrsHooksReleaser releaser;
+    releaser.pool = &pool;
+    releaser.client = c0;
+    st_thread_create(MockSrsHooksReleaser::cycle, &releaser, 0, 0);
+    
+    // wait for the busy connection released, reuse it.
+    SrsHttpClient* c1 = NULL;
+    EXPECT_EQ(ERROR_SUCCESS, pool.acquire(&c1, &reused));
+    EXPECT_TRUE(reused);
+    EXPECT_TRUE(c0 == c1);
+    
+    // the connection not keep-alive is freed.
+    pool.release(c1, false);
+    EXPECT_EQ(ERROR_SUCCESS, pool.acquire(&c1, &reused));
+    EXPECT_FALSE(reused);
+    pool.release(c1, true);
+}
+
+VOID TEST(AppHttpHooksTest, NotifyInBackground)
+{
+    MockSrsGlobalConfig mc(_MIN_OK_CONF);
+    
+    MockSrsHooksServer server;
+    ASSERT_EQ(ERROR_SUCCESS, server.listen());
+    
+    SrsRequest req;
+    _utest_hooks_req(&req, "10.0.0.1");
+    
+    // send in the client thread when not async.
+    SrsHttpHooks::on_close(server.url(), &req, 0, 0);
+    EXPECT_EQ(1, server.nb_requests);
+    
+    // send in background, the client never wait.
+    EXPECT_EQ(ERROR_SUCCESS, SrsHttpHooksDispatcher::instance()->initialize(10, true));
+    SrsHttpHooks::on_stop(server.url(), &req);
+    SrsHttpHooks::on_unpublish(server.url(), &req);
+    SrsHttpHooks::on_close(server.url(), &req, 0, 0);
+    EXPECT_EQ(1, server.nb_requests);
+    
+    // the notifies are sent in order, one post each.
+    server.wait(4, 3000);
+    ASSERT_EQ(4, server.nb_requests);
+    EXPECT_STREQ("on_close", server.actions.at(0).c_str());
+    EXPECT_STREQ("on_stop", server.actions.at(1).c_str());
+    EXPECT_STREQ("on_unpublish", server.actions.at(2).c_str());
+    EXPECT_STREQ("on_close", server.actions.at(3).c_str());
+}
+
+#endif
+
+// the origins of edge vhost, the endpoints must be unique for each test,
+// for the origins pool is global.
+#define _UTEST_EDGE_CONF(select, origins) _MIN_OK_CONF"vhost utest.edge{mode remote; origin " origins "; origin_select " select ";}"
+
+/**
+* the round robin select the origins in turn, ignore the stat.
+*/
+VOID TEST(AppEdgeOriginTest, RoundRobin)
+{
+    MockSrsGlobalConfig mock(_UTEST_EDGE_CONF("round_robin", "rr.a:1935 rr.b:1935 rr.c:1935"));
+    SrsConfDirective* conf = mock.conf.get_vhost_edge_origin("utest.edge");
+    ASSERT_TRUE(NULL != conf);
+    
+    SrsEdgeOriginPool* pool = SrsEdgeOriginPool::instance();
+    pool->on_failure("rr.b:1935");
+    pool->on_failure("rr.b:1935");
+    pool->on_failure("rr.b:1935");
+    
+    int index = 0;
+    EXPECT_STREQ("rr.a:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    EXPECT_STREQ("rr.b:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    EXPECT_STREQ("rr.c:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    EXPECT_STREQ("rr.a:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    EXPECT_EQ(1, index);
+}
+
+/**
+* the latency probe the never connected origins in turn,
+* then prefer the least srtt weighted by active streams.
+*/
+VOID TEST(AppEdgeOriginTest, LatencyLeastCost)
+{
+    MockSrsGlobalConfig mock(_UTEST_EDGE_CONF("latency", "lt.a:1935 lt.b:1935 lt.c:1935"));
+    SrsConfDirective* conf = mock.conf.get_vhost_edge_origin("utest.edge");
+    ASSERT_TRUE(NULL != conf);
+    
+    SrsEdgeOriginPool* pool = SrsEdgeOriginPool::instance();
+    
+    int index = 0;
+    EXPECT_STREQ("lt.a:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    pool->on_connected("lt.a:1935", 100);
+    EXPECT_STREQ("lt.b:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    pool->on_connected("lt.b:1935", 10);
+    EXPECT_STREQ("lt.c:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    pool->on_connected("lt.c:1935", 50);
+    
+    // cost: a=100*2, b=10*2, c=50*2
+    EXPECT_STREQ("lt.b:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    
+    // cost: b=10*11, c=50*2
+    for (int i = 0; i < 9; i++) {
+        pool->on_connected("lt.b:1935", 10);
+    }
+    EXPECT_STREQ("lt.c:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    
+    // cost: b=10*2, c=50*2
+    for (int i = 0; i < 9; i++) {
+        pool->on_close("lt.b:1935", 0);
+    }
+    EXPECT_STREQ("lt.b:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    
+    // srtt smoothed by 1/8.
+    pool->on_connected("lt.a:1935", 20);
+    std::stringstream ss;
+    EXPECT_EQ(ERROR_SUCCESS, pool->dumps(ss));
+    EXPECT_TRUE(ss.str().find("\"endpoint\":\"lt.a:1935\",\"circuit\":\"closed\",\"open_ms\":0,\"srtt\":90,") != string::npos);
+}
+
+/**
+* the origin fails continuously is skipped, the circuit opens after 3 failures,
+* half-open when expired to try it once, and closes again when connected.
+*/
+VOID TEST(AppEdgeOriginTest, CircuitBreaker)
+{
+    MockSrsGlobalConfig mock(_UTEST_EDGE_CONF("latency", "cb.a:1935 cb.b:1935"));
+    SrsConfDirective* conf = mock.conf.get_vhost_edge_origin("utest.edge");
+    ASSERT_TRUE(NULL != conf);
+    
+    SrsEdgeOriginPool* pool = SrsEdgeOriginPool::instance();
+    pool->on_connected("cb.a:1935", 10);
+    pool->on_close("cb.a:1935", 0);
+    pool->on_connected("cb.b:1935", 100);
+    pool->on_close("cb.b:1935", 0);
+    
+    // the failures under the threshold never change the order.
+    int index = 0;
+    pool->on_failure("cb.a:1935");
+    EXPECT_STREQ("cb.a:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    
+    // the circuit open is skipped.
+    pool->on_failure("cb.a:1935");
+    pool->on_failure("cb.a:1935");
+    EXPECT_STREQ("cb.b:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+    
+    std::stringstream ss;
+    EXPECT_EQ(ERROR_SUCCESS, pool->dumps(ss));
+    EXPECT_TRUE(ss.str().find("\"endpoint\":\"cb.a:1935\",\"circuit\":\"open\",") != string::npos);
+    EXPECT_TRUE(ss.str().find("\"streak\":3,\"failures\":3,") != string::npos);
+    
+    // half-open when expired, try it once, others are selected during the trial.
+    int64_t now = srs_get_system_time_ms() + 6000;
+    EXPECT_STREQ("cb.a:1935", pool->select("utest.edge", conf, "/live/livestream", &index, now).c_str());
+    EXPECT_STREQ("cb.b:1935", pool->select("utest.edge", conf, "/live/livestream", &index, now).c_str());
+    
+    // open again when the trial failed, the open time doubled.
+    pool->on_failure("cb.a:1935");
+    EXPECT_STREQ("cb.b:1935", pool->select("utest.edge", conf, "/live/livestream", &index, now).c_str());
+    
+    // the circuit closes when the trial connected.
+    now = srs_get_system_time_ms() + 11000;
+    EXPECT_STREQ("cb.a:1935", pool->select("utest.edge", conf, "/live/livestream", &index, now).c_str());
+    pool->on_connected("cb.a:1935", 10);
+    pool->on_close("cb.a:1935", 0);
+    EXPECT_STREQ("cb.a:1935", pool->select("utest.edge", conf, "/live/livestream", &index, now).c_str());
+    EXPECT_STREQ("cb.a:1935", pool->select("utest.edge", conf, "/live/livestream", &index, now).c_str());
+    
+    // all open, use the one closes soonest, the open time doubled for more failures.
+    for (int i = 0; i < 4; i++) {
+        pool->on_failure("cb.a:1935");
+    }
+    for (int i = 0; i < 3; i++) {
+        pool->on_failure("cb.b:1935");
+    }
+    EXPECT_STREQ("cb.b:1935", pool->select("utest.edge", conf, "/live/livestream", &index).c_str());
+}
+
+/**
+* the hash stick to the origin of stream, util its circuit opens.
+*/
+VOID TEST(AppEdgeOriginTest, HashStick)
+{
+    MockSrsGlobalConfig mock(_UTEST_EDGE_CONF("hash", "hs.a:1935 hs.b:1935 hs.c:1935"));
+    SrsConfDirective* conf = mock.conf.get_vhost_edge_origin("utest.edge");
+    ASSERT_TRUE(NULL != conf);
+    
+    SrsEdgeOriginPool* pool = SrsEdgeOriginPool::instance();
+    
+    string url = "/live/livestream";
+    string expect = conf->args.at(srs_crc32(url.data(), (int)url.length()) % 3);
+    
+    int index = 0;
+    for (int i = 0; i < 3; i++) {
+        EXPECT_STREQ(expect.c_str(), pool->select("utest.edge", conf, url, &index).c_str());
+    }
+    EXPECT_EQ(0, index);
+    
+    // even the other origins are better.
+    for (int i = 0; i < 3; i++) {
+        pool->on_connected(conf->args.at(i), (conf->args.at(i) == expect)? 100 : 10);
+    }
+    EXPECT_STREQ(expect.c_str(), pool->select("utest.edge", conf, url, &index).c_str());
+    
+    // stick even failed, util the circuit opens.
+    pool->on_failure(expect);
+    EXPECT_STREQ(expect.c_str(), pool->select("utest.edge", conf, url, &index).c_str());
+    
+    // fallback to the latency when the circuit opens.
+    pool->on_failure(expect);
+    pool->on_failure(expect);
+    string selected = pool->select("utest.edge", conf, url, &index);
+    EXPECT_STRNE(expect.c_str(), selected.c_str());
+    
+    // try it when half-open, others are selected during the trial.
+    int64_t now = srs_get_system_time_ms() + 6000;
+    EXPECT_STREQ(expect.c_str(), pool->select("utest.edge", conf, url, &index, now).c_str());
+    EXPECT_STRNE(expect.c_str(), pool->select("utest.edge", conf, url, &index, now).c_str());
+    
+    // stick again when the trial connected.
+    pool->on_connected(expect, 100);
+    EXPECT_STREQ(expect.c_str(), pool->select("utest.edge", conf, url, &index, now).c_str());
+    EXPECT_STREQ(expect.c_str(), pool->select("utest.edge", conf, url, &index).c_str());
+}
+
+/**
+* the kbps of origin is sampled every 10s.
+*/
+VOID TEST(AppEdgeOriginTest, SampleKbps)
+{
+    SrsEdgeOrigin o("sp.a:1935");
+    
+    o.sample(1000);
+    o.nb_bytes += 125000;
+    o.sample(5000);
+    EXPECT_EQ(0, o.kbps);
+    
+    o.sample(11000);
+    EXPECT_EQ(100, o.kbps);
+    
+    o.sample(21000);
+    EXPECT_EQ(0, o.kbps);
+    
+    // the empty endpoint is ignored.
+    SrsEdgeOriginPool* pool = SrsEdgeOriginPool::instance();
+    pool->on_bytes("", 1000);
+    pool->on_failure("");
+    std::stringstream ss;
+    EXPECT_EQ(ERROR_SUCCESS, pool->dumps(ss));
+    EXPECT_TRUE(ss.str().find("\"endpoint\":\"\"") == string::npos);
+}
+
+/**
+* the udp handler, record the batches and packets.
+*/
+class MockSrsUdpHandler : public ISrsUdpHandler
+{
+public:
+    std::vector<int> batches;
+    std::vector<std::string> packets;
+    std::vector<int> ports;
+public:
+    MockSrsUdpHandler()
+    {
+    }
+    virtual ~MockSrsUdpHandler()
+    {
+    }
+public:
+    virtual int on_udp_packet(sockaddr_in* from, char* buf, int nb_buf)
+    {
+        packets.push_back(std::string(buf, nb_buf));
+        ports.push_back(ntohs(from->sin_port));
+        return ERROR_SUCCESS;
+    }
+    virtual int on_udp_packets(SrsUdpPacket* pkts, int nb_pkts)
+    {
+        batches.push_back(nb_pkts);
+        return ISrsUdpHandler::on_udp_packets(pkts, nb_pkts);
+    }
+    // wait for the listener thread to handle the packets.
+    virtual void wait(int nb_pkts)
+    {
+        for (int i = 0; i < 1000 && (int)packets.size() < nb_pkts; i++) {
+            st_usleep(1 * 1000);
+        }
+        // ensure no more packets.
+        st_usleep(10 * 1000);
+    }
+};
+
+/**
+* the udp peer to send packets to listener.
+*/
+class MockSrsUdpPeer
+{
+public:
+    int fd;
+    sockaddr_in to;
+    int port;
+public:
+    MockSrsUdpPeer(SrsUdpListener* listener)
+    {
+        sockaddr_in addr;
+        socklen_t nb_addr = sizeof(sockaddr_in);
+        getsockname(listener->fd(), (sockaddr*)&addr, &nb_addr);
+        
+        to.sin_family = AF_INET;
+        to.sin_port = addr.sin_port;
+        to.sin_addr.s_addr = inet_addr("127.0.0.1");
+        
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in local;
+        local.sin_family = AF_INET;
+        local.sin_port = 0;
+        local.sin_addr.s_addr = inet_addr("127.0.0.1");
+        bind(fd, (sockaddr*)&local, sizeof(sockaddr_in));
+        getsockname(fd, (sockaddr*)&local, &nb_addr);
+        port = ntohs(local.sin_port);
+    }
+    virtual ~MockSrsUdpPeer()
+    {
+        ::close(fd);
+    }
+public:
+    // send the packet of size, filled with c.
+    virtual int send(int size, char c)
+    {
+        std::string bytes(size, c);
+        return (int)sendto(fd, bytes.data(), size, 0, (sockaddr*)&to, sizeof(sockaddr_in));
+    }
+};
+
+/**
+* the listener recv the packets in batch, the handler got each packet.
+*/
+VOID TEST(AppUdpListenerTest, RecvBatch)
+{
+    st_init();
+    MockSrsGlobalConfig mock(_MIN_OK_CONF);
+    
+    MockSrsUdpHandler handler;
+    SrsUdpListener listener(&handler, "127.0.0.1", 0);
+    ASSERT_EQ(ERROR_SUCCESS, listener.listen());
+    
+    MockSrsUdpPeer peer(&listener);
+    for (int i = 0; i < 20; i++) {
+        ASSERT_EQ(1316, peer.send(1316, (char)i));
+    }
+    handler.wait(20);
+    
+    ASSERT_EQ(20, (int)handler.packets.size());
+    for (int i = 0; i < 20; i++) {
+        EXPECT_TRUE(std::string(1316, (char)i) == handler.packets[i]) << "packet=" << i;
+        EXPECT_EQ(peer.port, handler.ports[i]);
+    }
+    EXPECT_EQ(20, listener.get_packets());
+    
+#ifdef SRS_PERF_UDP_RECV_BATCH
+    // all packets are ready, recv in batches.
+    ASSERT_EQ(2, (int)handler.batches.size());
+    EXPECT_EQ(SRS_PERF_UDP_RECV_BATCH, handler.batches[0]);
+    EXPECT_EQ(20 - SRS_PERF_UDP_RECV_BATCH, handler.batches[1]);
+    EXPECT_EQ(2, listener.get_batches());
+    EXPECT_EQ(SRS_PERF_UDP_RECV_BATCH, listener.get_max_batch());
+#else
+    EXPECT_EQ(20, listener.get_batches());
+    EXPECT_EQ(1, listener.get_max_batch());
+#endif
+}
+
+#ifdef SRS_PERF_UDP_RECV_BATCH
+/**
+* the packet larger than the slot is dropped, and the others in batch are compacted.
+*/
+VOID TEST(AppUdpListenerTest, RecvTruncated)
+{
+    st_init();
+    MockSrsGlobalConfig mock(_MIN_OK_CONF);
+    
+    MockSrsUdpHandler handler;
+    SrsUdpListener listener(&handler, "127.0.0.1", 0);
+    ASSERT_EQ(ERROR_SUCCESS, listener.listen());
+    
+    MockSrsUdpPeer peer(&listener);
+    ASSERT_EQ(100, peer.send(100, 'a'));
+    ASSERT_EQ(SRS_PERF_UDP_RECV_PACKET_SIZE + 1, peer.send(SRS_PERF_UDP_RECV_PACKET_SIZE + 1, 'b'));
+    ASSERT_EQ(SRS_PERF_UDP_RECV_PACKET_SIZE, peer.send(SRS_PERF_UDP_RECV_PACKET_SIZE, 'c'));
+    ASSERT_EQ(30000, peer.send(30000, 'd'));
+    ASSERT_EQ(200, peer.send(200, 'e'));
+    handler.wait(3);
+    
+    ASSERT_EQ(1, (int)handler.batches.size());
+    ASSERT_EQ(3, handler.batches[0]);
+    EXPECT_TRUE(std::string(100, 'a') == handler.packets[0]);
+    EXPECT_TRUE(std::string(SRS_PERF_UDP_RECV_PACKET_SIZE, 'c') == handler.packets[1]);
+    EXPECT_TRUE(std::string(200, 'e') == handler.packets[2]);
+    
+    EXPECT_EQ(5, listener.get_packets());
+    EXPECT_EQ(2, listener.get_truncated());
+    EXPECT_EQ(0, listener.get_drops());
+}
+
+#ifdef SO_RXQ_OVFL
+/**
+* the packets dropped by kernel when socket buffer full,
+* which is got by the next packet queued.
+*/
+VOID TEST(AppUdpListenerTest, RecvKernelDrops)
+{
+    st_init();
+    MockSrsGlobalConfig mock(_MIN_OK_CONF);
+    
+    MockSrsUdpHandler handler;
+    SrsUdpListener listener(&handler, "127.0.0.1", 0);
+    ASSERT_EQ(ERROR_SUCCESS, listener.listen());
+    
+    // the min socket buffer, only several packets queued.
+    int rcvbuf = 1;
+    ASSERT_EQ(0, setsockopt(listener.fd(), SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(int)));
+    
+    MockSrsUdpPeer peer(&listener);
+    for (int i = 0; i < 64; i++) {
+        ASSERT_EQ(1000, peer.send(1000, 'a'));
+    }
+    handler.wait(64);
+    
+    int nb_queued = (int)handler.packets.size();
+    EXPECT_LT(0, nb_queued);
+    EXPECT_GT(64, nb_queued);
+    
+    // the queued packets before drops carry no drops.
+    EXPECT_EQ(0, listener.get_drops());
+    
+    ASSERT_EQ(1000, peer.send(1000, 'b'));
+    handler.wait(nb_queued + 1);
+    
+    ASSERT_EQ(nb_queued + 1, (int)handler.packets.size());
+    EXPECT_EQ(64 - nb_queued, listener.get_drops());
+    EXPECT_EQ(65, listener.get_packets() + listener.get_drops());
+}
+#endif
+#endif
+
+#ifdef SRS_AUTO_STREAM_CASTER
+/**
+* the mpegts over udp caster, record the ts messages, never publish to rtmp.
+*/
+class MockSrsMpegtsOverUdp : public SrsMpegtsOverUdp
+{
+public:
+    std::vector<int> pids;
+    std::vector<std::string> payloads;
+public:
+    MockSrsMpegtsOverUdp(SrsConfDirective* c) : SrsMpegtsOverUdp(c)
+    {
+    }
+    virtual ~MockSrsMpegtsOverUdp()
+    {
+    }
+public:
+    virtual int on_ts_message(SrsTsMessage* msg)
+    {
+        pids.push_back(msg->channel->pid);
+        payloads.push_back(std::string(msg->payload->bytes(), msg->payload->length()));
+        return ERROR_SUCCESS;
+    }
+};
+
+/**
+* the ts packets splited to udp packets, the size not modulus by 188.
+*/
+void _utest_mpegts_udp_packets(MockSrsFileWriter* fw, std::vector<std::string>& videos, std::vector<SrsUdpPacket>& pkts)
+{
+    SrsTsContext ctx;
+    SrsTSMuxer muxer(fw, &ctx, SrsCodecAudioAAC, SrsCodecVideoAVC);
+    EXPECT_EQ(ERROR_SUCCESS, muxer.open(""));
+    
+    for (int i = 0; i < 10; i++) {
+        SrsTsMessage video;
+        video.sid = SrsTsPESStreamIdVideoCommon;
+        video.dts = video.pts = i * 3600;
+        for (int j = 0; j < 1000 + i * 997; j++) {
+            char v = (char)(i + j);
+            video.payload->append(&v, 1);
+        }
+        videos.push_back(std::string(video.payload->bytes(), video.payload->length()));
+        EXPECT_EQ(ERROR_SUCCESS, muxer.write_video(&video));
+    }
+    
+    sockaddr_in from;
+    from.sin_family = AF_INET;
+    from.sin_port = htons(10000);
+    from.sin_addr.s_addr = inet_addr("127.0.0.1");
+    
+    for (int pos = 0, i = 0; pos < fw->offset; i++) {
+        SrsUdpPacket pkt;
+        pkt.from = from;
+        pkt.bytes = fw->data + pos;
+        pkt.size = srs_min(fw->offset - pos, (i % 3 == 0)? 100 : 7 * SRS_TS_PACKET_SIZE);
+        pkts.push_back(pkt);
+        pos += pkt.size;
+    }
+}
+
+/**
+* the caster parse the batch of udp packets in a time,
+* the ts messages are the same to parse each packet.
+*/
+VOID TEST(AppUdpListenerTest, MpegtsOverUdpPackets)
+{
+    MockSrsGlobalConfig mock(_MIN_OK_CONF"stream_caster{enabled on; caster mpegts_over_udp; output rtmp://127.0.0.1/live/livestream; listen 8935;}");
+    std::vector<SrsConfDirective*> casters = mock.conf.get_stream_casters();
+    ASSERT_EQ(1, (int)casters.size());
+    
+    MockSrsFileWriter fw;
+    std::vector<std::string> videos;
+    std::vector<SrsUdpPacket> pkts;
+    _utest_mpegts_udp_packets(&fw, videos, pkts);
+    
+    // parse each packet.
+    MockSrsMpegtsOverUdp single(casters[0]);
+    for (int i = 0; i < (int)pkts.size(); i++) {
+        ASSERT_EQ(ERROR_SUCCESS, single.on_udp_packet(&pkts[i].from, pkts[i].bytes, pkts[i].size));
+    }
+    
+    // parse in batches.
+    MockSrsMpegtsOverUdp batch(casters[0]);
+    for (int i = 0; i < (int)pkts.size(); i += 5) {
+        int nb_pkts = srs_min(5, (int)pkts.size() - i);
+        ASSERT_EQ(ERROR_SUCCESS, batch.on_udp_packets(&pkts[i], nb_pkts));
+    }
+    
+    // the last PES is reaped by the next unit start.
+    ASSERT_EQ((int)videos.size() - 1, (int)single.payloads.size());
+    ASSERT_EQ(single.payloads.size(), batch.payloads.size());
+    for (int i = 0; i < (int)single.payloads.size(); i++) {
+        EXPECT_EQ(0x100, batch.pids[i]);
+        EXPECT_TRUE(videos[i] == single.payloads[i]) << "video=" << i;
+        EXPECT_TRUE(videos[i] == batch.payloads[i]) << "video=" << i;
+    }
+}
+#endif
+
+/**
+* the file of bytes to sendfile, removed when destroy.
+*/
+class MockSrsSendfileFile
+{
+public:
+    int fd;
+    std::string bytes;
+    char path[64];
+public:
+    MockSrsSendfileFile(int size)
+    {
+        for (int i = 0; i < size; i++) {
+            bytes.append(1, (char)(i * 7 + i / 251));
+        }
+        
+        snprintf(path, sizeof(path), "/tmp/srs-utest-sendfile-XXXXXX");
+        fd = mkstemp(path);
+        if (fd >= 0) {
+            EXPECT_EQ(size, (int)::write(fd, bytes.data(), size));
+            ::lseek(fd, 0, SEEK_SET);
+        }
+    }
+    virtual ~MockSrsSendfileFile()
+    {
+        ::close(fd);
+        ::unlink(path);
+    }
+};
+
+/**
+* the connected sockets, the writer sendfile to the reader,
+* the reader recv slowly, so the writer fill the send buffer.
+*/
+class MockSrsSendfilePeer
+{
+public:
+    SrsStSocket* skt;
+    // the bytes recv by reader.
+    std::string recv;
+    int expect;
+private:
+    st_netfd_t wfd;
+    st_netfd_t rfd;
+    bool done;
+public:
+    MockSrsSendfilePeer()
+    {
+        st_init();
+        
+        int fds[2];
+        EXPECT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+        
+        // the min send buffer, the sendfile writes partially.
+        int sndbuf = 1;
+        setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(int));
+        
+        wfd = st_netfd_open_socket(fds[0]);
+        rfd = st_netfd_open_socket(fds[1]);
+        skt = new SrsStSocket(wfd);
+        skt->set_send_timeout(3 * 1000 * 1000LL);
+        expect = 0;
+        done = false;
+    }
+    virtual ~MockSrsSendfilePeer()
+    {
+        srs_freep(skt);
+        srs_close_stfd(wfd);
+        srs_close_stfd(rfd);
+    }
+public:
+    // start the reader thread, util got the expect bytes,
+    // or the writer closed when expect is -1.
+    void start(int nb_expect)
+    {
+        expect = nb_expect;
+        st_thread_create(read_cycle, this, 0, 0);
+    }
+    // close the writer, the reader got EOF.
+    void close()
+    {
+        srs_close_stfd(wfd);
+    }
+    // wait for the reader thread done.
+    void wait()
+    {
+        for (int i = 0; i < 3000 && !done; i++) {
+            st_usleep(1 * 1000);
+        }
+    }
+private:
+    static void* read_cycle(void* arg)
+    {
+        MockSrsSendfilePeer* peer = (MockSrsSendfilePeer*)arg;
+        while (peer->expect < 0 || (int)peer->recv.length() < peer->expect) {
+            char buf[16 * 1024];
+            ssize_t nread = st_read(peer->rfd, buf, sizeof(buf), 3 * 1000 * 1000LL);
+            if (nread <= 0) {
+                break;
+            }
+            peer->recv.append(buf, nread);
+            st_usleep(100);
+        }
+        peer->done = true;
+        return NULL;
+    }
+};
+
+/**
+* the sendfile send the range of file in partial writes,
+* wait in st when the send buffer is full.
+*/
+VOID TEST(AppHttpSendfileTest, SocketPartialWrite)
+{
+    MockSrsSendfileFile file(1024 * 1024);
+    ASSERT_TRUE(file.fd >= 0);
+    
+    MockSrsSendfilePeer peer;
+    peer.start(700 * 1000);
+    
+    ssize_t nwrite = 0;
+    EXPECT_EQ(ERROR_SUCCESS, peer.skt->sendfile(file.fd, 1000, 700 * 1000, &nwrite));
+    EXPECT_EQ(700 * 1000, nwrite);
+    EXPECT_EQ(700 * 1000, peer.skt->get_send_bytes());
+    peer.wait();
+    
+    ASSERT_EQ(700 * 1000, (int)peer.recv.length());
+    EXPECT_TRUE(file.bytes.substr(1000, 700 * 1000) == peer.recv);
+    
+    // the position of file never changed.
+    EXPECT_EQ(0, ::lseek(file.fd, 0, SEEK_CUR));
+}
+
+/**
+* the file is truncated, the sendfile send the left bytes.
+*/
+VOID TEST(AppHttpSendfileTest, SocketFileTruncated)
+{
+    MockSrsSendfileFile file(10 * 1024);
+    ASSERT_TRUE(file.fd >= 0);
+    
+    MockSrsSendfilePeer peer;
+    peer.start(1024);
+    
+    ssize_t nwrite = 0;
+    EXPECT_EQ(ERROR_SYSTEM_FILE_EOF, peer.skt->sendfile(file.fd, 9 * 1024, 2 * 1024, &nwrite));
+    EXPECT_EQ(1024, nwrite);
+    peer.wait();
+    
+    EXPECT_TRUE(file.bytes.substr(9 * 1024) == peer.recv);
+}
+
+#ifdef SRS_AUTO_HTTP_CORE
+/**
+* the response writer sendfile the body in content-length,
+* exceed the content length is error.
+*/
+VOID TEST(AppHttpSendfileTest, WriterContentLength)
+{
+    MockSrsSendfileFile file(300 * 1024);
+    ASSERT_TRUE(file.fd >= 0);
+    
+    MockSrsSendfilePeer peer;
+    peer.start(-1);
+    
+    SrsHttpResponseWriter w(peer.skt);
+    w.header()->set_content_length(250 * 1024);
+    
+    EXPECT_EQ(ERROR_SUCCESS, w.sendfile(file.fd, 10 * 1024, 200 * 1024));
+    EXPECT_EQ(ERROR_SUCCESS, w.sendfile(file.fd, 0, 50 * 1024));
+    EXPECT_EQ(ERROR_HTTP_CONTENT_LENGTH, w.sendfile(file.fd, 0, 1));
+    
+    peer.close();
+    peer.wait();
+    
+    size_t pos = peer.recv.find("\r\n\r\n");
+    ASSERT_TRUE(pos != string::npos);
+    std::string header = peer.recv.substr(0, pos);
+    EXPECT_TRUE(header.find("HTTP/1.1 200 OK") == 0);
+    EXPECT_TRUE(header.find("Content-Length: 256000") != string::npos);
+    EXPECT_TRUE(header.find("chunked") == string::npos);
+    
+    std::string body = peer.recv.substr(pos + 4);
+    EXPECT_TRUE(file.bytes.substr(10 * 1024, 200 * 1024) + file.bytes.substr(0, 50 * 1024) == body);
+}
+
+/**
+* the response writer sendfile the body in chunked,
+* each sendfile is a chunk.
+*/
+VOID TEST(AppHttpSendfileTest, WriterChunked)
+{
+    MockSrsSendfileFile file(100 * 1024);
+    ASSERT_TRUE(file.fd >= 0);
+    
+    MockSrsSendfilePeer peer;
+    peer.start(-1);
+    
+    SrsHttpResponseWriter w(peer.skt);
+    
+    EXPECT_EQ(ERROR_SUCCESS, w.sendfile(file.fd, 100, 0x10000));
+    EXPECT_EQ(ERROR_SUCCESS, w.sendfile(file.fd, 0x10100, 0x20));
+    EXPECT_EQ(ERROR_SUCCESS, w.final_request());
+    
+    peer.close();
+    peer.wait();
+    
+    size_t pos = peer.recv.find("\r\n\r\n");
+    ASSERT_TRUE(pos != string::npos);
+    EXPECT_TRUE(peer.recv.substr(0, pos).find("Transfer-Encoding: chunked") != string::npos);
+    
+    std::string expect = "10000\r\n" + file.bytes.substr(100, 0x10000) + "\r\n"
+        + "20\r\n" + file.bytes.substr(0x10100, 0x20) + "\r\n" + "0\r\n\r\n";
+    EXPECT_TRUE(expect == peer.recv.substr(pos + 4));
+}
+#endif
+
+#if defined(SRS_AUTO_HTTP_SERVER) && defined(SRS_PERF_HTTP_SENDFILE)
+/**
+* the response writer record the header and sendfile.
+*/
+class MockSrsSendfileWriter : public ISrsHttpResponseWriter
+{
+public:
+    SrsHttpHeader hdr;
+    int status;
+    std::string bytes;
+    // the offset and size of each sendfile.
+    std::vector<int64_t> offsets;
+    std::vector<int> sizes;
+public:
+    MockSrsSendfileWriter()
+    {
+        status = 0;
+    }
+    virtual ~MockSrsSendfileWriter()
+    {
+    }
+public:
+    virtual int final_request()
+    {
+        return ERROR_SUCCESS;
+    }
+    virtual SrsHttpHeader* header()
+    {
+        return &hdr;
+    }
+    virtual int write(char* data, int size)
+    {
+        bytes.append(data, size);
+        return ERROR_SUCCESS;
+    }
+    virtual int writev(iovec* iov, int iovcnt, ssize_t* pnwrite)
+    {
+        ssize_t nwrite = 0;
+        for (int i = 0; i < iovcnt; i++) {
+            bytes.append((char*)iov[i].iov_base, iov[i].iov_len);
+            nwrite += iov[i].iov_len;
+        }
+        if (pnwrite) {
+            *pnwrite = nwrite;
+        }
+        return ERROR_SUCCESS;
+    }
+    virtual int sendfile(int fd, int64_t offset, int size)
+    {
+        offsets.push_back(offset);
+        sizes.push_back(size);
+        
+        std::string buf(size, 0);
+        if (pread(fd, (char*)buf.data(), size, offset) != size) {
+            return ERROR_SYSTEM_FILE_EOF;
+        }
+        bytes.append(buf);
+        return ERROR_SUCCESS;
+    }
+    virtual void write_header(int code)
+    {
+        status = code;
+    }
+};
+
+/**
+* expose the mp4 range of vod stream.
+*/
+class MockSrsVodStream : public SrsVodStream
+{
+public:
+    MockSrsVodStream() : SrsVodStream("/tmp")
+    {
+    }
+    virtual ~MockSrsVodStream()
+    {
+    }
+public:
+    virtual int serve_mp4_stream(ISrsHttpResponseWriter* w, ISrsHttpMessage* r, std::string fullpath, int start, int end)
+    {
+        return SrsVodStream::serve_mp4_stream(w, r, fullpath, start, end);
+    }
+};
+
+/**
+* the vod stream sendfile the range of mp4 in chunks.
+*/
+VOID TEST(AppHttpSendfileTest, VodStreamRange)
+{
+    MockSrsGlobalConfig mock(_MIN_OK_CONF);
+    MockSrsSendfileFile file(1024 * 1024);
+    ASSERT_TRUE(file.fd >= 0);
+    
+    MockSrsVodStream vod;
+    
+    if (true) {
+        MockSrsSendfileWriter w;
+        EXPECT_EQ(ERROR_SUCCESS, vod.serve_mp4_stream(&w, NULL, file.path, 1000, 600000));
+        EXPECT_EQ(SRS_CONSTS_HTTP_PartialContent, w.status);
+        EXPECT_EQ(599001, w.hdr.content_length());
+        EXPECT_STREQ("bytes 1000-600000/1048576", w.hdr.get("Content-Range").c_str());
+        
+        ASSERT_EQ(3, (int)w.sizes.size());
+        EXPECT_EQ(1000, w.offsets[0]);
+        EXPECT_EQ(SRS_PERF_HTTP_SENDFILE_CHUNK, w.sizes[0]);
+        EXPECT_EQ(1000 + SRS_PERF_HTTP_SENDFILE_CHUNK, w.offsets[1]);
+        EXPECT_EQ(SRS_PERF_HTTP_SENDFILE_CHUNK, w.sizes[1]);
+        EXPECT_EQ(1000 + 2 * SRS_PERF_HTTP_SENDFILE_CHUNK, w.offsets[2]);
+        EXPECT_EQ(599001 - 2 * SRS_PERF_HTTP_SENDFILE_CHUNK, w.sizes[2]);
+        EXPECT_TRUE(file.bytes.substr(1000, 599001) == w.bytes);
+    }
+    
+    // the open range to the last byte of file.
+    if (true) {
+        MockSrsSendfileWriter w;
+        EXPECT_EQ(ERROR_SUCCESS, vod.serve_mp4_stream(&w, NULL, file.path, 1048000, -1));
+        EXPECT_EQ(576, w.hdr.content_length());
+        EXPECT_STREQ("bytes 1048000-1048575/1048576", w.hdr.get("Content-Range").c_str());
+        EXPECT_TRUE(file.bytes.substr(1048000) == w.bytes);
+    }
+    
+    // the end exceed the file is clamped to the last byte.
+    if (true) {
+        MockSrsSendfileWriter w;
+        EXPECT_EQ(ERROR_SUCCESS, vod.serve_mp4_stream(&w, NULL, file.path, 1048000, 2097152));
+        EXPECT_EQ(576, w.hdr.content_length());
+        EXPECT_STREQ("bytes 1048000-1048575/1048576", w.hdr.get("Content-Range").c_str());
+        EXPECT_TRUE(file.bytes.substr(1048000) == w.bytes);
+    }
+    
+    // the start exceed the end or file.
+    if (true) {
+        MockSrsSendfileWriter w;
+        EXPECT_EQ(ERROR_HTTP_REMUX_OFFSET_OVERFLOW, vod.serve_mp4_stream(&w, NULL, file.path, 100, 99));
+        EXPECT_EQ(ERROR_HTTP_REMUX_OFFSET_OVERFLOW, vod.serve_mp4_stream(&w, NULL, file.path, 1048576, 2097152));
+        EXPECT_TRUE(w.sizes.empty());
+    }
+}
+#endif
+
+/**
+* feed the mw controller by the batches sent in steady,
+* the outq is the stub sample of socket send buffer.
+*/
+void _utest_mw_feed(SrsMwController* mw, int64_t& timestamp, int nb_batches, int count, int bytes, int duration, int elapsed, int outq)
+{
+    for (int i = 0; i < nb_batches; i++) {
+        timestamp += duration;
+        mw->on_send(count, bytes, timestamp, elapsed, outq);
+    }
+}
+
+/**
+* the mw controller use the target util the stream is measured,
+* then converge to the bitrate and msgs rate of stream.
+*/
+VOID TEST(AppMwControllerTest, Converge)
+{
+    SrsMwController mw;
+    mw.initialize(350, false);
+    
+    // not measured, use the target.
+    EXPECT_EQ(350, mw.wait());
+    EXPECT_EQ(SRS_PERF_MW_MIN_MSGS, mw.msgs());
+    
+    // the first batch has no duration, the empty batch is ignored.
+    int64_t timestamp = 0;
+    _utest_mw_feed(&mw, timestamp, 1, 10, 12500, 100, 1000, 0);
+    mw.on_send(0, 0, timestamp + 100, 1000, 0);
+    EXPECT_EQ(0, mw.kbps());
+    EXPECT_EQ(350, mw.wait());
+    
+    // 1Mbps, 10 msgs every 100ms, sent in 1ms.
+    _utest_mw_feed(&mw, timestamp, 10, 10, 12500, 100, 1000, 0);
+    EXPECT_EQ(1000, mw.kbps());
+    EXPECT_EQ(10, mw.batch());
+    EXPECT_EQ(12500, mw.batch_size());
+    EXPECT_EQ(1000, mw.send_latency());
+    // target minus the send latency.
+    EXPECT_EQ(349, mw.wait());
+    EXPECT_EQ(SRS_PERF_MW_MIN_MSGS, mw.msgs());
+    
+    // the bitrate doubled, converge in about 20 batches.
+    int kbps = mw.kbps();
+    for (int i = 0; i < 20; i++) {
+        _utest_mw_feed(&mw, timestamp, 1, 10, 25000, 100, 1000, 0);
+        EXPECT_GT(mw.kbps(), kbps);
+        kbps = mw.kbps();
+    }
+    EXPECT_GE(kbps, 1980);
+    EXPECT_LE(kbps, 2000);
+    
+    // the timestamp jump for republish is ignored.
+    _utest_mw_feed(&mw, timestamp, 1, 10, 1000000, 10000, 1000, 0);
+    EXPECT_EQ(kbps, mw.kbps());
+    mw.on_send(10, 1000000, timestamp - 1000, 1000, 0);
+    EXPECT_EQ(kbps, mw.kbps());
+}
+
+/**
+* the wait of mw controller is clamped in [min sleep, target],
+* and never merge more msgs than a write.
+*/
+VOID TEST(AppMwControllerTest, Clamp)
+{
+    int64_t timestamp = 0;
+    
+    // the send is slow, never wait less than the min sleep.
+    if (true) {
+        SrsMwController mw;
+        mw.initialize(350, false);
+        _utest_mw_feed(&mw, timestamp, 2, 10, 12500, 100, 500 * 1000, 0);
+        EXPECT_EQ(SRS_PERF_MW_MIN_SLEEP, mw.wait());
+        EXPECT_EQ(1, mw.msgs());
+    }
+    
+    // the target less than the min sleep.
+    if (true) {
+        SrsMwController mw;
+        mw.initialize(5, false);
+        _utest_mw_feed(&mw, timestamp, 2, 10, 12500, 100, 1000, 0);
+        EXPECT_EQ(5, mw.wait());
+        EXPECT_EQ(1, mw.msgs());
+    }
+    
+    // the msgs rate is high, never merge more than SRS_PERF_MW_MSGS.
+    if (true) {
+        SrsMwController mw;
+        mw.initialize(350, false);
+        _utest_mw_feed(&mw, timestamp, 2, 200, 125000, 100, 1000, 0);
+        EXPECT_EQ((int)(SRS_PERF_MW_MSGS / 2.0), mw.wait());
+        EXPECT_EQ(SRS_PERF_MW_MIN_MSGS, mw.msgs());
+    }
+    
+    // the audio only stream never wait for the min msgs.
+    if (true) {
+        SrsMwController mw;
+        mw.initialize(350, false);
+        _utest_mw_feed(&mw, timestamp, 2, 1, 1000, 100, 1000, 0);
+        EXPECT_EQ(349, mw.wait());
+        EXPECT_EQ(1, mw.msgs());
+    }
+    
+    // for realtime, send when got msgs.
+    if (true) {
+        SrsMwController mw;
+        mw.initialize(350, true);
+        EXPECT_EQ(0, mw.msgs());
+        _utest_mw_feed(&mw, timestamp, 2, 10, 12500, 100, 1000, 0);
+        EXPECT_EQ(349, mw.wait());
+        EXPECT_EQ(0, mw.msgs());
+    }
+}
+
+/**
+* the bytes queued in socket send buffer consume the latency target,
+* but the backlogged player still writes atleast SRS_PERF_MW_MIN_BYTES.
+*/
+VOID TEST(AppMwControllerTest, SocketBacklog)
+{
+    int64_t timestamp = 0;
+    SrsMwController mw;
+    mw.initialize(350, false);
+    
+    // 125 bytes per ms, 10 msgs every 100ms.
+    _utest_mw_feed(&mw, timestamp, 2, 10, 12500, 100, 1000, 0);
+    EXPECT_EQ(349, mw.wait());
+    
+    // 100ms queued.
+    int min_wait = (int)(SRS_PERF_MW_MIN_BYTES / 125.0);
+    _utest_mw_feed(&mw, timestamp, 1, 10, 12500, 100, 1000, 12500);
+    EXPECT_EQ(249, mw.wait());
+    EXPECT_EQ(SRS_PERF_MW_MIN_MSGS, mw.msgs());
+    
+    // 300ms queued, write the min bytes.
+    _utest_mw_feed(&mw, timestamp, 1, 10, 12500, 100, 1000, 37500);
+    EXPECT_EQ(min_wait, mw.wait());
+    EXPECT_EQ(srs_min(SRS_PERF_MW_MIN_MSGS, (int)(0.1 * min_wait / 2)), mw.msgs());
+    
+    // far behind, still the min bytes.
+    _utest_mw_feed(&mw, timestamp, 1, 10, 12500, 100, 1000, 10 * 1000 * 1000);
+    EXPECT_EQ(min_wait, mw.wait());
+    
+    // the queue drained, back to the target.
+    _utest_mw_feed(&mw, timestamp, 1, 10, 12500, 100, 1000, 0);
+    EXPECT_EQ(349, mw.wait());
+}
+
+#if defined(SRS_AUTO_HTTP_SERVER) && defined(SRS_AUTO_HTTP_CALLBACK) && defined(__INGEST_DYNAMIC__)
+/**
+* the http flv player holds the source of stream like the rtmp player,
+* creates it when not exists, and releases it when done.
+* @remark the on_play is rejected, so the player never serves the stream.
+*/
+VOID TEST(AppHttpStreamTest, PlayerHoldSource)
+{
+    st_init();
+    
+    MockSrsHooksServer hooks;
+    hooks.answer = "1";
+    ASSERT_EQ(ERROR_SUCCESS, hooks.listen());
+    MockSrsGlobalConfig mock(string(_MIN_OK_CONF) + "vhost utest.flv{http_hooks{enabled on; on_play " + hooks.url() + ";}}");
+    
+    SrsRequest req;
+    req.vhost = "utest.flv";
+    req.app = "live";
+    req.stream = "livestream";
+    
+    http_parser header;
+    memset(&header, 0, sizeof(http_parser));
+    vector<SrsHttpHeaderField> headers;
+    headers.push_back(SrsHttpHeaderField("Host", "utest.flv"));
+    SrsHttpMessage msg(NULL, NULL);
+    ASSERT_EQ(ERROR_SUCCESS, msg.update("/live/livestream.flv", &header, NULL, headers));
+    
+    MockSrsSourceHandler handler;
+    SrsLiveStream stream(NULL, &req, NULL, &handler);
+    
+    // the source is not in pool.
+    string url = req.get_stream_url();
+    ASSERT_EQ(-1, SrsSource::close_source_client(url));
+    
+    // no publisher, the player creates the source, then releases it.
+    int ret = stream.serve_http(NULL, &msg);
+    EXPECT_NE(ERROR_SUCCESS, ret);
+    EXPECT_NE(ERROR_SOURCE_NOT_FOUND, ret);
+    ASSERT_EQ(1, (int)hooks.actions.size());
+    EXPECT_STREQ("on_play", hooks.actions[0].c_str());
+    EXPECT_EQ(-1, SrsSource::close_source_client(url));
+    
+    // the publisher holds the source, the player never changes the ref.
+    SrsSource* source = NULL;
+    ASSERT_EQ(ERROR_SUCCESS, SrsSource::fetch_or_create(&req, &handler, &source));
+    EXPECT_NE(ERROR_SUCCESS, stream.serve_http(NULL, &msg));
+    EXPECT_EQ(2, (int)hooks.actions.size());
+    
+    // the publisher releases the last ref.
+    EXPECT_EQ(0, SrsSource::unfetch_or_remove(source));
+    EXPECT_EQ(-1, SrsSource::close_source_client(url));
+}
+#endif
+
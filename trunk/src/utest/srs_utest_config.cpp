@@ -1831,5 +1831,204 @@ VOID TEST(ConfigMainTest, CheckConf_vhost_ingest_id)
     EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"vhost v{ingest{} ingest{}}"));
 }
 
-#endif
+VOID TEST(ConfigMainTest, CheckConf_hls_storage)
+{
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"vhost v{hls{hls_storage ram; hls_ram_budget 64;}}"));
+        EXPECT_STREQ("ram", conf.get_hls_storage("v").c_str());
+        EXPECT_EQ(64, conf.get_hls_ram_budget("v"));
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"vhost v{hls{hls_storage memory;}}"));
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"vhost v{hls{hls_ram_budget 0;}}"));
+    }
+}
+
+VOID TEST(ConfigMainTest, CheckConf_hooks_pool)
+{
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"hooks_pool{max_connections 4; async_notify off;}"));
+        EXPECT_EQ(4, conf.get_hooks_pool_max_connections());
+        EXPECT_FALSE(conf.get_hooks_pool_async_notify());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"hooks_pool{max_connections 0;}"));
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"vhost v{http_hooks{on_play_cache_ttl 10;}}"));
+        EXPECT_EQ(10, conf.get_vhost_on_play_cache_ttl("v"));
+        EXPECT_EQ(0, conf.get_vhost_on_play_cache_ttl("none"));
+    }
+}
+
+VOID TEST(ConfigMainTest, CheckConf_dns_resolver)
+{
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF));
+        EXPECT_TRUE(conf.get_dns_resolver_enabled());
+        EXPECT_EQ(3000, conf.get_dns_resolver_timeout());
+        EXPECT_EQ(300, conf.get_dns_resolver_max_ttl());
+        EXPECT_EQ(5, conf.get_dns_resolver_negative_ttl());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"dns_resolver{enabled off; timeout 500; max_ttl 60; negative_ttl 0;}"));
+        EXPECT_FALSE(conf.get_dns_resolver_enabled());
+        EXPECT_EQ(500, conf.get_dns_resolver_timeout());
+        EXPECT_EQ(60, conf.get_dns_resolver_max_ttl());
+        EXPECT_EQ(0, conf.get_dns_resolver_negative_ttl());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"dns_resolver{timeout 0;}"));
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"dns_resolver{ttl 10;}"));
+    }
+}
+
+VOID TEST(ConfigMainTest, CheckConf_handshake)
+{
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF));
+        EXPECT_EQ(512, conf.get_handshake_dh_pool());
+        EXPECT_FALSE(conf.get_handshake_overload());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"handshake{dh_pool 0; overload on;}"));
+        EXPECT_EQ(0, conf.get_handshake_dh_pool());
+        EXPECT_TRUE(conf.get_handshake_overload());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"handshake{dh_pool -1;}"));
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"handshake{pool 10;}"));
+    }
+}
+
+VOID TEST(ConfigMainTest, CheckConf_origin_select)
+{
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"vhost v{mode remote; origin 127.0.0.1:1935;}"));
+        EXPECT_STREQ("latency", conf.get_vhost_edge_origin_select("v").c_str());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"vhost v{mode remote; origin 127.0.0.1:1935; origin_select hash;}"));
+        EXPECT_STREQ("hash", conf.get_vhost_edge_origin_select("v").c_str());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"vhost v{origin_select round_robin;}"));
+        EXPECT_STREQ("round_robin", conf.get_vhost_edge_origin_select("v").c_str());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"vhost v{origin_select random;}"));
+    }
+}
+
+VOID TEST(ConfigMainTest, CheckConf_mw_aggregate)
+{
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"vhost v{mw_latency 350;}"));
+        EXPECT_FALSE(conf.get_mw_aggregate("v"));
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"vhost v{mw_aggregate on;}"));
+        EXPECT_TRUE(conf.get_mw_aggregate("v"));
+    }
+}
+
+VOID TEST(ConfigMainTest, CheckConf_mw_adaptive)
+{
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"vhost v{mw_latency 350;}"));
+        EXPECT_FALSE(conf.get_mw_adaptive("v"));
+        EXPECT_EQ(350, conf.get_mw_sleep_ms("v"));
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"vhost v{mw_latency 100; mw_adaptive on;}"));
+        EXPECT_TRUE(conf.get_mw_adaptive("v"));
+        EXPECT_EQ(100, conf.get_mw_sleep_ms("v"));
+    }
+}
+
+VOID TEST(ConfigMainTest, CheckConf_workers)
+{
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF));
+        EXPECT_FALSE(conf.get_workers_enabled());
+        EXPECT_EQ(4, conf.get_workers_count());
+        EXPECT_EQ(19350, conf.get_workers_port());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"workers{enabled on; count 8; port 20000;}"));
+        EXPECT_TRUE(conf.get_workers_enabled());
+        EXPECT_EQ(8, conf.get_workers_count());
+        EXPECT_EQ(20000, conf.get_workers_port());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"workers{enabled off; count 0;}"));
+        EXPECT_FALSE(conf.get_workers_enabled());
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"workers{enabled on; count 0;}"));
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"workers{enabled on; count 257;}"));
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"workers{enabled on; count 4; port 65533;}"));
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"workers{enabled on; threads 4;}"));
+    }
+    
+    if (true) {
+        MockSrsConfig conf;
+        EXPECT_TRUE(ERROR_SUCCESS != conf.parse(_MIN_OK_CONF"asprocess on; workers{enabled on;}"));
+    }
+}
 
+#endif
@@ -30,6 +30,10 @@ using namespace std;
 #include <srs_kernel_utility.hpp>
 #include <srs_rtmp_utility.hpp>
 #include <srs_kernel_stream.hpp>
+#include <srs_kernel_ts.hpp>
+#include <srs_kernel_slab.hpp>
+#include <srs_core_autofree.hpp>
+#include <srs_app_log.hpp>
 
 #define MAX_MOCK_DATA_SIZE 1024 * 1024
 
@@ -199,6 +203,23 @@ int MockBufferReader::read(void* buf, size_t size, ssize_t* nread)
     return ERROR_SUCCESS;
 }
 
+MockTsHandler::MockTsHandler()
+{
+}
+
+MockTsHandler::~MockTsHandler()
+{
+}
+
+int MockTsHandler::on_ts_message(SrsTsMessage* msg)
+{
+    pids.push_back(msg->channel->pid);
+    dtses.push_back(msg->dts);
+    payloads.push_back(std::string(msg->payload->bytes(), msg->payload->length()));
+    
+    return ERROR_SUCCESS;
+}
+
 #ifdef ENABLE_UTEST_KERNEL
 
 VOID TEST(KernelBufferTest, DefaultObject)
@@ -282,6 +303,47 @@ VOID TEST(KernelFastBufferTest, Grow)
     EXPECT_EQ('w', b.read_1byte());
 }
 
+/**
+* the buffer starts small, grows when peer is streaming or required.
+*/
+VOID TEST(KernelFastBufferTest, GrowLazily)
+{
+    if (true) {
+        SrsFastBuffer b;
+        MockBufferReader r("winlin");
+        EXPECT_EQ(SRS_PERF_RECV_BUFFER_MIN, b.capacity());
+        
+        // few bytes, keep the small one.
+        b.grow(&r, 1);
+        b.read_slice(6);
+        b.grow(&r, 1);
+        EXPECT_EQ(SRS_PERF_RECV_BUFFER_MIN, b.capacity());
+        
+        // required more bytes, grow to the large one.
+        EXPECT_TRUE(ERROR_SUCCESS == b.grow(&r, SRS_PERF_RECV_BUFFER_MIN + 1));
+        EXPECT_LT(SRS_PERF_RECV_BUFFER_MIN, b.capacity());
+        EXPECT_EQ('w', b.read_1byte());
+    }
+    
+    if (true) {
+        SrsFastBuffer b;
+        string data(SRS_PERF_RECV_BUFFER_MIN, 'x');
+        MockBufferReader r(data.c_str());
+        
+        // fill the buffer, peer is streaming, grow to the large one.
+        b.grow(&r, 1);
+        EXPECT_EQ(SRS_PERF_RECV_BUFFER_MIN, b.capacity());
+        b.read_slice(SRS_PERF_RECV_BUFFER_MIN);
+        
+        b.grow(&r, 1);
+        EXPECT_LT(SRS_PERF_RECV_BUFFER_MIN, b.capacity());
+        
+        // the large one is set by user.
+        b.set_buffer(200 * 1024);
+        EXPECT_EQ(200 * 1024, b.capacity());
+    }
+}
+
 /**
 * test the codec,
 * whether H.264 keyframe
@@ -384,6 +446,225 @@ VOID TEST(KernelCodecTest, IsAudioSequenceHeader)
     EXPECT_FALSE(SrsFlvCodec::video_is_sequence_header((char*)pp, 2));
 }
 
+/**
+* test the codec,
+* disposable video frame
+*/
+VOID TEST(KernelCodecTest, IsDisposable)
+{
+    // flv disposable inter frame.
+    char data = 0x37;
+    EXPECT_TRUE(SrsFlvCodec::video_is_disposable(&data, 1, 0));
+    EXPECT_FALSE(SrsFlvCodec::video_is_disposable(&data, 0, 0));
+    
+    // avc inter frame, with nal_ref_idc 0 non-IDR and a SEI.
+    char nalus[] = {
+        0x27, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x02, 0x06, 0x05,
+        0x00, 0x00, 0x00, 0x03, 0x01, (char)0x9a, 0x00
+    };
+    EXPECT_TRUE(SrsFlvCodec::video_is_disposable(nalus, sizeof(nalus), 4));
+    
+    // never disposable when NALU length unknown or mismatch.
+    EXPECT_FALSE(SrsFlvCodec::video_is_disposable(nalus, sizeof(nalus), 0));
+    EXPECT_FALSE(SrsFlvCodec::video_is_disposable(nalus, sizeof(nalus), 2));
+    
+    // truncated NALU.
+    EXPECT_FALSE(SrsFlvCodec::video_is_disposable(nalus, sizeof(nalus) - 1, 4));
+    
+    // the reference frame, nal_ref_idc 2.
+    nalus[15] = 0x41;
+    EXPECT_FALSE(SrsFlvCodec::video_is_disposable(nalus, sizeof(nalus), 4));
+    
+    // keyframe never disposable.
+    nalus[15] = 0x01;
+    nalus[0] = 0x17;
+    EXPECT_FALSE(SrsFlvCodec::video_is_disposable(nalus, sizeof(nalus), 4));
+    
+    // no VCL NALU.
+    char sei[] = {
+        0x27, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x02, 0x06, 0x05
+    };
+    EXPECT_FALSE(SrsFlvCodec::video_is_disposable(sei, sizeof(sei), 4));
+    
+    // the NALU length is 2bytes.
+    char nalus2[] = {
+        0x27, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x02, 0x06, 0x05,
+        0x00, 0x03, 0x01, (char)0x9a, 0x00
+    };
+    EXPECT_TRUE(SrsFlvCodec::video_is_disposable(nalus2, sizeof(nalus2), 2));
+    EXPECT_FALSE(SrsFlvCodec::video_is_disposable(nalus2, sizeof(nalus2), 4));
+    nalus2[11] = 0x41;
+    EXPECT_FALSE(SrsFlvCodec::video_is_disposable(nalus2, sizeof(nalus2), 2));
+    
+    // the NALU length is 1byte.
+    char nalus1[] = {
+        0x27, 0x01, 0x00, 0x00, 0x00,
+        0x02, 0x06, 0x05,
+        0x03, 0x01, (char)0x9a, 0x00
+    };
+    EXPECT_TRUE(SrsFlvCodec::video_is_disposable(nalus1, sizeof(nalus1), 1));
+}
+
+/**
+* test the codec,
+* the NALU length size from the avc sequence header.
+*/
+VOID TEST(KernelCodecTest, NalLengthSize)
+{
+    // avc sequence header, version, profile, compatibility, level, lengthSizeMinusOne.
+    char sh[] = {
+        0x17, 0x00, 0x00, 0x00, 0x00,
+        0x01, 0x64, 0x00, 0x1f, (char)0xff
+    };
+    EXPECT_EQ(4, SrsFlvCodec::video_nal_length_size(sh, sizeof(sh)));
+    
+    sh[9] = (char)0xfd;
+    EXPECT_EQ(2, SrsFlvCodec::video_nal_length_size(sh, sizeof(sh)));
+    
+    sh[9] = (char)0xfc;
+    EXPECT_EQ(1, SrsFlvCodec::video_nal_length_size(sh, sizeof(sh)));
+    
+    // 3bytes is invalid.
+    sh[9] = (char)0xfe;
+    EXPECT_EQ(0, SrsFlvCodec::video_nal_length_size(sh, sizeof(sh)));
+    
+    // truncated or not sequence header.
+    sh[9] = (char)0xff;
+    EXPECT_EQ(0, SrsFlvCodec::video_nal_length_size(sh, sizeof(sh) - 1));
+    sh[1] = 0x01;
+    EXPECT_EQ(0, SrsFlvCodec::video_nal_length_size(sh, sizeof(sh)));
+}
+
+/**
+* test the codec demuxer,
+* the frame demuxed once, with the codec when demux it.
+*/
+VOID TEST(KernelCodecTest, DemuxerFrame)
+{
+    SrsCodecDemuxer demuxer;
+    SrsCodecSample sample;
+    
+    // aac sequence header, LC, 44100HZ, stereo.
+    char sh[] = { (char)0xaf, 0x00, 0x12, 0x10 };
+    SrsCodecFrame* f0 = demuxer.demux_audio(sh, sizeof(sh));
+    SrsAutoFree(SrsCodecFrame, f0);
+    EXPECT_TRUE(ERROR_SUCCESS == f0->error);
+    EXPECT_EQ(SrsAacObjectTypeAacLC, f0->codec->codec->aac_object);
+    EXPECT_EQ(4, f0->codec->codec->aac_sample_rate);
+    
+    // aac raw data, use the same codec.
+    char raw[] = { (char)0xaf, 0x01, 0x21, 0x10, 0x04 };
+    SrsCodecFrame* f1 = demuxer.demux_audio(raw, sizeof(raw));
+    SrsAutoFree(SrsCodecFrame, f1);
+    EXPECT_TRUE(ERROR_SUCCESS == f1->error);
+    EXPECT_TRUE(f0->codec == f1->codec);
+    
+    f1->to_sample(&sample);
+    EXPECT_FALSE(sample.is_video);
+    EXPECT_EQ(SrsCodecAudioAAC, sample.acodec);
+    EXPECT_EQ(SrsCodecAudioTypeRawData, sample.aac_packet_type);
+    ASSERT_EQ(1, sample.nb_sample_units);
+    EXPECT_TRUE(raw + 2 == sample.sample_units[0].bytes);
+    EXPECT_EQ(3, sample.sample_units[0].size);
+    
+    // new sequence header, 48000HZ, the previous frames never changed.
+    sh[2] = 0x11; sh[3] = (char)0x90;
+    SrsCodecFrame* f2 = demuxer.demux_audio(sh, sizeof(sh));
+    SrsAutoFree(SrsCodecFrame, f2);
+    EXPECT_TRUE(f1->codec != f2->codec);
+    EXPECT_EQ(3, f2->codec->codec->aac_sample_rate);
+    EXPECT_EQ(4, f1->codec->codec->aac_sample_rate);
+    
+    // mp3 raw data.
+    char mp3[] = { 0x2f, (char)0xff, (char)0xfb };
+    SrsCodecFrame* f3 = demuxer.demux_audio(mp3, sizeof(mp3));
+    SrsAutoFree(SrsCodecFrame, f3);
+    EXPECT_TRUE(ERROR_SUCCESS == f3->error);
+    EXPECT_EQ(SrsCodecAudioMP3, f3->codec->codec->audio_codec_id);
+    
+    sample.clear();
+    f3->to_sample(&sample);
+    ASSERT_EQ(1, sample.nb_sample_units);
+    EXPECT_EQ(2, sample.sample_units[0].size);
+    
+    // speex is not supported.
+    char speex[] = { (char)0xb6, 0x00 };
+    SrsCodecFrame* f4 = demuxer.demux_audio(speex, sizeof(speex));
+    SrsAutoFree(SrsCodecFrame, f4);
+    EXPECT_TRUE(ERROR_HLS_DECODE_ERROR == f4->error);
+}
+
+/**
+* test the codec frame,
+* the units are copied by field, for the unit is not trivially copyable,
+* and the demuxer sample is reused for the next frame.
+*/
+VOID TEST(KernelCodecTest, DemuxerFrameUnits)
+{
+    SrsCodecDemuxer demuxer;
+    
+    // avc sequence header, the NALU length size is 4 bytes.
+    char sh[] = {
+        0x17, 0x00, 0x00, 0x00, 0x00,
+        0x01, 0x42, 0x00, 0x1e, (char)0xff,
+        (char)0xe1, 0x00, 0x04, 0x67, 0x42, 0x00, 0x1e,
+        0x01, 0x00, 0x04, 0x68, (char)0xce, 0x38, (char)0x80
+    };
+    SrsCodecFrame* f0 = demuxer.demux_video(sh, sizeof(sh), false);
+    SrsAutoFree(SrsCodecFrame, f0);
+    EXPECT_TRUE(ERROR_SUCCESS == f0->error);
+    
+    // keyframe, AUD, IDR and SEI.
+    char key[] = {
+        0x17, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x02, 0x09, (char)0xf0,
+        0x00, 0x00, 0x00, 0x03, 0x65, (char)0x88, (char)0x84,
+        0x00, 0x00, 0x00, 0x02, 0x06, 0x05
+    };
+    SrsCodecFrame* f1 = demuxer.demux_video(key, sizeof(key), false);
+    SrsAutoFree(SrsCodecFrame, f1);
+    EXPECT_TRUE(ERROR_SUCCESS == f1->error);
+    
+    // inter frame, the sample of demuxer is reused.
+    char inter[] = {
+        0x27, 0x01, 0x00, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x02, 0x41, (char)0x9a
+    };
+    SrsCodecFrame* f2 = demuxer.demux_video(inter, sizeof(inter), false);
+    SrsAutoFree(SrsCodecFrame, f2);
+    EXPECT_TRUE(ERROR_SUCCESS == f2->error);
+    
+    // the units of previous frame never changed.
+    SrsCodecSample sample;
+    f1->to_sample(&sample);
+    EXPECT_TRUE(sample.is_video);
+    EXPECT_TRUE(sample.has_idr);
+    EXPECT_TRUE(sample.has_aud);
+    ASSERT_EQ(3, sample.nb_sample_units);
+    EXPECT_TRUE(key + 9 == sample.sample_units[0].bytes);
+    EXPECT_EQ(2, sample.sample_units[0].size);
+    EXPECT_TRUE(key + 15 == sample.sample_units[1].bytes);
+    EXPECT_EQ(3, sample.sample_units[1].size);
+    EXPECT_TRUE(key + 22 == sample.sample_units[2].bytes);
+    EXPECT_EQ(2, sample.sample_units[2].size);
+    
+    // restore to a used sample, the left units are not used.
+    sample.clear();
+    f2->to_sample(&sample);
+    EXPECT_FALSE(sample.has_idr);
+    ASSERT_EQ(1, sample.nb_sample_units);
+    EXPECT_TRUE(inter + 9 == sample.sample_units[0].bytes);
+    EXPECT_EQ(2, sample.sample_units[0].size);
+    
+    // the sequence header has no unit.
+    sample.clear();
+    f0->to_sample(&sample);
+    EXPECT_EQ(0, sample.nb_sample_units);
+}
+
 /**
 * test the flv encoder,
 * exception: file stream not open
@@ -547,6 +828,64 @@ VOID TEST(KernelFlvTest, FlvEncoderSizeTag)
     EXPECT_EQ(11+4+0, SrsFlvEncoder::size_tag(0));
 }
 
+/**
+* test the flv encoder,
+* the tags of shared ptr message are shared by all copies,
+* and write_tags got the same bytes as write each tag.
+*/
+VOID TEST(KernelFlvTest, FlvEncoderWriteSharedTags)
+{
+    SrsMessageHeader vh;
+    vh.initialize_video(8, 0x01234567, 1);
+    SrsSharedPtrMessage video;
+    ASSERT_TRUE(ERROR_SUCCESS == video.create(&vh, new char[8], 8));
+    memset(video.payload, 0x0f, video.size);
+    
+    SrsMessageHeader ah;
+    ah.initialize_audio(4, 0x30, 1);
+    SrsSharedPtrMessage audio;
+    ASSERT_TRUE(ERROR_SUCCESS == audio.create(&ah, new char[4], 4));
+    memset(audio.payload, 0xaf, audio.size);
+    
+    SrsMessageHeader mh;
+    mh.initialize_amf0_script(6, 1);
+    SrsSharedPtrMessage metadata;
+    ASSERT_TRUE(ERROR_SUCCESS == metadata.create(&mh, new char[6], 6));
+    memset(metadata.payload, 0x02, metadata.size);
+    
+    // the copy with same timestamp reuse the tag.
+    SrsSharedFlvTag* tag = video.shared_flv_tag();
+    ASSERT_TRUE(NULL != tag);
+    if (true) {
+        SrsSharedPtrMessage* copy = video.copy();
+        SrsAutoFree(SrsSharedPtrMessage, copy);
+        EXPECT_TRUE(tag == copy->shared_flv_tag());
+        
+        copy->timestamp++;
+        EXPECT_TRUE(tag != copy->shared_flv_tag());
+    }
+    
+    // the tags equals to the tags built by encoder.
+    MockSrsFileWriter fs0;
+    SrsFlvEncoder enc0;
+    ASSERT_TRUE(ERROR_SUCCESS == fs0.open(""));
+    ASSERT_TRUE(ERROR_SUCCESS == enc0.initialize(&fs0));
+    EXPECT_TRUE(ERROR_SUCCESS == enc0.write_video(video.timestamp, video.payload, video.size));
+    EXPECT_TRUE(ERROR_SUCCESS == enc0.write_audio(audio.timestamp, audio.payload, audio.size));
+    EXPECT_TRUE(ERROR_SUCCESS == enc0.write_metadata(SrsCodecFlvTagScript, metadata.payload, metadata.size));
+    
+    MockSrsFileWriter fs1;
+    SrsFlvEncoder enc1;
+    ASSERT_TRUE(ERROR_SUCCESS == fs1.open(""));
+    ASSERT_TRUE(ERROR_SUCCESS == enc1.initialize(&fs1));
+    SrsSharedPtrMessage* msgs[] = { &video, &audio, &metadata };
+    EXPECT_TRUE(ERROR_SUCCESS == enc1.write_tags(msgs, 3));
+    
+    ASSERT_EQ(11 + 8 + 4 + 11 + 4 + 4 + 11 + 6 + 4, fs0.offset);
+    ASSERT_EQ(fs0.offset, fs1.offset);
+    EXPECT_TRUE(srs_bytes_equals(fs0.data, fs1.data, fs0.offset));
+}
+
 /**
 * test the flv decoder,
 * exception: file stream not open.
@@ -1532,5 +1871,615 @@ VOID TEST(KernelUtilityTest, UtilityString)
     EXPECT_TRUE(srs_string_ends_with("Hello", "lo"));
 }
 
-#endif
+/**
+* find the annexb start code and split the NALUs.
+*/
+VOID TEST(KernelUtilityTest, AvcAnnexbSplit)
+{
+    int nb_start_code = 0;
+    
+    // the start code at the end of 16 bytes block.
+    if (true) {
+        char bytes[40];
+        memset(bytes, 0x09, sizeof(bytes));
+        bytes[15] = 0x00; bytes[16] = 0x00; bytes[17] = 0x01;
+        EXPECT_TRUE(bytes + 15 == srs_avc_find_annexb(bytes, bytes + sizeof(bytes), &nb_start_code));
+        EXPECT_EQ(3, nb_start_code);
+        
+        // the start code in the tail bytes.
+        EXPECT_TRUE(bytes + 15 == srs_avc_find_annexb(bytes, bytes + 18, &nb_start_code));
+        EXPECT_TRUE(bytes + 17 == srs_avc_find_annexb(bytes, bytes + 17, &nb_start_code));
+        
+        // the leading zeros, but never before the start.
+        bytes[13] = 0x00; bytes[14] = 0x00;
+        EXPECT_TRUE(bytes + 13 == srs_avc_find_annexb(bytes, bytes + sizeof(bytes), &nb_start_code));
+        EXPECT_EQ(5, nb_start_code);
+        EXPECT_TRUE(bytes + 14 == srs_avc_find_annexb(bytes + 14, bytes + sizeof(bytes), &nb_start_code));
+        EXPECT_EQ(4, nb_start_code);
+        
+        // not found.
+        memset(bytes, 0x00, sizeof(bytes));
+        EXPECT_TRUE(bytes + sizeof(bytes) == srs_avc_find_annexb(bytes, bytes + sizeof(bytes), &nb_start_code));
+    }
+    
+    // split the NALUs.
+    if (true) {
+        char bytes[] = {
+            0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1e,
+            0x00, 0x00, 0x01, 0x68, (char)0xce,
+            0x00, 0x00, 0x01, 0x00, 0x00, 0x01, 0x65, (char)0x88, 0x00, 0x00
+        };
+        std::vector<SrsAnnexbNalu> nalus;
+        EXPECT_TRUE(srs_avc_split_annexb(bytes, sizeof(bytes), nalus));
+        ASSERT_EQ(3, (int)nalus.size());
+        EXPECT_TRUE(bytes + 4 == nalus[0].bytes);
+        EXPECT_EQ(4, nalus[0].size);
+        EXPECT_TRUE(bytes + 11 == nalus[1].bytes);
+        EXPECT_EQ(2, nalus[1].size);
+        EXPECT_TRUE(bytes + 19 == nalus[2].bytes);
+        EXPECT_EQ(4, nalus[2].size);
+        
+        nalus.clear();
+        EXPECT_FALSE(srs_avc_split_annexb(bytes + 4, sizeof(bytes) - 4, nalus));
+        EXPECT_FALSE(srs_avc_split_annexb(bytes + 1, 2, nalus));
+    }
+}
+
+/**
+* the throughput of annexb scanner, compare to the byte by byte demux.
+*/
+VOID TEST(KernelUtilityTest, AvcAnnexbBenchmark)
+{
+    // about 16MB frames, the NALUs of random size.
+    const int size = 16 * 1024 * 1024;
+    char* bytes = new char[size];
+    SrsAutoFreeA(char, bytes);
+    
+    srand(0);
+    int nb_nalus = 0;
+    for (int pos = 0; pos < size;) {
+        int nb_nalu = srs_min(size - pos, 16 + rand() % 4096);
+        for (int i = 0; i < nb_nalu; i++) {
+            bytes[pos + i] = (char)(1 + rand() % 255);
+        }
+        if (nb_nalu >= 8) {
+            bytes[pos] = 0x00; bytes[pos + 1] = 0x00; bytes[pos + 2] = 0x00; bytes[pos + 3] = 0x01;
+            nb_nalus++;
+        }
+        pos += nb_nalu;
+    }
+    
+    // the byte by byte demux.
+    int64_t starttime = srs_update_system_time_ms();
+    int nb_old = 0;
+    if (true) {
+        SrsStream stream;
+        ASSERT_TRUE(ERROR_SUCCESS == stream.initialize(bytes, size));
+        while (!stream.empty()) {
+            int nb_start_code = 0;
+            if (!srs_avc_startswith_annexb(&stream, &nb_start_code)) {
+                break;
+            }
+            stream.skip(nb_start_code);
+            while (!stream.empty()) {
+                if (srs_avc_startswith_annexb(&stream, NULL)) {
+                    break;
+                }
+                stream.skip(1);
+            }
+            nb_old++;
+        }
+    }
+    int64_t elapsed_old = srs_update_system_time_ms() - starttime;
+    
+    // the scanner.
+    starttime = srs_update_system_time_ms();
+    std::vector<SrsAnnexbNalu> nalus;
+    EXPECT_TRUE(srs_avc_split_annexb(bytes, size, nalus));
+    int64_t elapsed = srs_update_system_time_ms() - starttime;
+    
+    EXPECT_EQ(nb_nalus, nb_old);
+    EXPECT_EQ(nb_nalus, (int)nalus.size());
+    
+    printf("annexb %d MB %d NALUs, byte by byte %d ms, scanner %d ms, %d MB/s\n",
+        size / 1024 / 1024, (int)nalus.size(), (int)elapsed_old, (int)elapsed,
+        (int)(size / 1024 / 1024 * 1000 / srs_max(1, elapsed)));
+}
 
+/**
+* the golden PES encoder, packetize the msg by the SrsTsPacket object model,
+* to check the fast packetizer of SrsTsContext is byte-identical.
+*/
+int mock_ts_encode_pes(SrsTsContext* ctx, SrsFileWriter* writer, SrsTsMessage* msg, int16_t pid, u_int8_t& cc, bool write_pcr)
+{
+    int ret = ERROR_SUCCESS;
+    
+    char* start = msg->payload->bytes();
+    char* end = start + msg->payload->length();
+    char* p = start;
+    
+    while (p < end) {
+        SrsTsPacket* pkt = NULL;
+        if (p == start) {
+            int64_t pcr = write_pcr? msg->dts : -1;
+            pkt = SrsTsPacket::create_pes_first(ctx, 
+                pid, msg->sid, cc++, msg->is_discontinuity,
+                pcr, msg->dts, msg->pts, msg->payload->length()
+            );
+        } else {
+            pkt = SrsTsPacket::create_pes_continue(ctx, pid, msg->sid, cc++);
+        }
+        SrsAutoFree(SrsTsPacket, pkt);
+        
+        char buf[SRS_TS_PACKET_SIZE];
+        
+        int nb_buf = pkt->size();
+        int left = (int)srs_min(end - p, SRS_TS_PACKET_SIZE - nb_buf);
+        int nb_stuffings = SRS_TS_PACKET_SIZE - nb_buf - left;
+        if (nb_stuffings > 0) {
+            memset(buf, 0xFF, SRS_TS_PACKET_SIZE);
+            pkt->padding(nb_stuffings);
+            
+            nb_buf = pkt->size();
+            left = (int)srs_min(end - p, SRS_TS_PACKET_SIZE - nb_buf);
+        }
+        memcpy(buf + nb_buf, p, left);
+        p += left;
+        
+        SrsStream stream;
+        if ((ret = stream.initialize(buf, nb_buf)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        if ((ret = pkt->encode(&stream)) != ERROR_SUCCESS) {
+            return ret;
+        }
+        if ((ret = writer->write(buf, SRS_TS_PACKET_SIZE, NULL)) != ERROR_SUCCESS) {
+            return ret;
+        }
+    }
+    
+    return ret;
+}
+
+/**
+* the sizes around the boundaries of ts packets, with and without af(pcr) and dts.
+*/
+int mock_ts_payload_sizes[] = {
+    1, 2, 3, 100, 150, 155, 156, 157, 158, 159, 160, 161, 162, 163, 164, 165, 166, 167,
+    168, 169, 170, 182, 183, 184, 185, 186, 340, 341, 342, 343, 344, 345, 346, 347, 348, 349,
+    350, 351, 352, 1000, 4096, 65515, 65520, 65535, 65536, 70000
+};
+
+VOID TEST(KernelTSTest, MuxerVideoGolden)
+{
+    MockSrsFileWriter fw;
+    SrsTsContext ctx;
+    SrsTSMuxer muxer(&fw, &ctx, SrsCodecAudioAAC, SrsCodecVideoAVC);
+    ASSERT_EQ(ERROR_SUCCESS, muxer.open(""));
+    
+    MockSrsFileWriter golden;
+    SrsTsContext golden_ctx;
+    ASSERT_EQ(ERROR_SUCCESS, golden.open(""));
+    u_int8_t vcc = 0;
+    
+    int nb_sizes = (int)(sizeof(mock_ts_payload_sizes) / sizeof(int));
+    for (int i = 0; i < nb_sizes * 4; i++) {
+        int size = mock_ts_payload_sizes[i % nb_sizes];
+        
+        SrsTsMessage msg;
+        msg.sid = SrsTsPESStreamIdVideoCommon;
+        msg.dts = 90000 * 3600 * 26LL + i * 3600;
+        msg.pts = msg.dts + ((i / nb_sizes) % 2) * 7200;
+        msg.write_pcr = (i / nb_sizes) >= 2;
+        msg.is_discontinuity = (i % 3) == 0;
+        for (int j = 0; j < size; j++) {
+            char v = (char)(i + j);
+            msg.payload->append(&v, 1);
+        }
+        
+        fw.mock_reset_offset();
+        EXPECT_EQ(ERROR_SUCCESS, muxer.write_video(&msg));
+        
+        golden.mock_reset_offset();
+        EXPECT_EQ(ERROR_SUCCESS, mock_ts_encode_pes(&golden_ctx, &golden, &msg, 0x100, vcc, msg.write_pcr));
+        
+        // the first frame is prefixed by PAT and PMT.
+        int nb_psi = (i == 0)? 2 * SRS_TS_PACKET_SIZE : 0;
+        ASSERT_EQ(golden.offset + nb_psi, fw.offset) << "size=" << size;
+        EXPECT_TRUE(memcmp(golden.data, fw.data + nb_psi, golden.offset) == 0) << "size=" << size;
+    }
+}
+
+VOID TEST(KernelTSTest, MuxerPureAudioGolden)
+{
+    MockSrsFileWriter fw;
+    SrsTsContext ctx;
+    SrsTSMuxer muxer(&fw, &ctx, SrsCodecAudioAAC, SrsCodecVideoDisabled);
+    ASSERT_EQ(ERROR_SUCCESS, muxer.open(""));
+    
+    MockSrsFileWriter golden;
+    SrsTsContext golden_ctx;
+    ASSERT_EQ(ERROR_SUCCESS, golden.open(""));
+    u_int8_t acc = 0;
+    
+    int nb_sizes = (int)(sizeof(mock_ts_payload_sizes) / sizeof(int));
+    for (int i = 0; i < nb_sizes; i++) {
+        int size = mock_ts_payload_sizes[i];
+        
+        SrsTsMessage msg;
+        msg.sid = SrsTsPESStreamIdAudioCommon;
+        msg.dts = msg.pts = i * 1920;
+        for (int j = 0; j < size; j++) {
+            char v = (char)(i * j);
+            msg.payload->append(&v, 1);
+        }
+        
+        fw.mock_reset_offset();
+        EXPECT_EQ(ERROR_SUCCESS, muxer.write_audio(&msg));
+        
+        // pure audio always write pcr.
+        golden.mock_reset_offset();
+        EXPECT_EQ(ERROR_SUCCESS, mock_ts_encode_pes(&golden_ctx, &golden, &msg, 0x101, acc, true));
+        
+        int nb_psi = (i == 0)? 2 * SRS_TS_PACKET_SIZE : 0;
+        ASSERT_EQ(golden.offset + nb_psi, fw.offset) << "size=" << size;
+        EXPECT_TRUE(memcmp(golden.data, fw.data + nb_psi, golden.offset) == 0) << "size=" << size;
+    }
+}
+
+/**
+* test the slab allocator, the slabs in class are reused.
+*/
+VOID TEST(KernelSlabTest, AllocReuse)
+{
+    SrsSlabAllocator* allocator = SrsSlabAllocator::instance();
+    int64_t cached = allocator->cached();
+    
+    int used_slabs = allocator->used_slabs();
+    int64_t used = allocator->used();
+    
+    SrsSlab* slab = allocator->alloc(1000);
+    EXPECT_EQ(used_slabs + 1, allocator->used_slabs());
+    EXPECT_EQ(used + slab->capacity, allocator->used());
+    EXPECT_TRUE(slab->capacity >= 1000);
+    EXPECT_TRUE(slab->capacity < 1250);
+    EXPECT_FALSE(slab->shared());
+    
+    char* data = slab->data;
+    EXPECT_TRUE(slab == slab->retain());
+    EXPECT_TRUE(slab->shared());
+    
+    slab->release();
+    EXPECT_FALSE(slab->shared());
+    EXPECT_EQ(cached, allocator->cached());
+    
+    int capacity = slab->capacity;
+    slab->release();
+    EXPECT_EQ(cached + capacity, allocator->cached());
+    EXPECT_EQ(used_slabs, allocator->used_slabs());
+    EXPECT_EQ(used, allocator->used());
+    
+    // the same class is reused.
+    slab = allocator->alloc(capacity);
+    EXPECT_TRUE(data == slab->data);
+    EXPECT_EQ(cached, allocator->cached());
+    slab->release();
+    
+    // the huge slab is never cached.
+    cached = allocator->cached();
+    slab = allocator->alloc(1024 * 1024);
+    EXPECT_EQ(1024 * 1024, slab->capacity);
+    slab->release();
+    EXPECT_EQ(cached, allocator->cached());
+}
+
+/**
+* the message payload in slab, shared by the shared ptr message.
+*/
+VOID TEST(KernelSlabTest, MessagePayload)
+{
+    SrsSlab* slab = SrsSlabAllocator::instance()->alloc(4096);
+    
+    SrsCommonMessage* msg = new SrsCommonMessage();
+    msg->header.initialize_video(100, 0, 1);
+    msg->attach_slab_payload(slab, slab->data + 10, 100);
+    EXPECT_TRUE(slab->shared());
+    EXPECT_TRUE(msg->payload == slab->data + 10);
+    EXPECT_EQ(100, msg->size);
+    
+    SrsSharedPtrMessage* sm = new SrsSharedPtrMessage();
+    EXPECT_TRUE(ERROR_SUCCESS == sm->create(msg));
+    srs_freep(msg);
+    EXPECT_TRUE(slab->shared());
+    
+    SrsSharedPtrMessage* copy = sm->copy();
+    srs_freep(sm);
+    EXPECT_TRUE(slab->shared());
+    EXPECT_TRUE(copy->payload == slab->data + 10);
+    
+    srs_freep(copy);
+    EXPECT_FALSE(slab->shared());
+    slab->release();
+}
+
+/**
+* the object pool reuse the freed objects in the size of pool.
+*/
+VOID TEST(KernelSlabTest, ObjectPool)
+{
+    SrsObjectPool::enable();
+    
+    SrsObjectPool pool("utest.pool", 64, 1);
+    EXPECT_EQ(0, pool.used());
+    EXPECT_EQ(0, pool.cached());
+    
+    void* p = pool.alloc(64);
+    EXPECT_EQ(1, pool.used());
+    EXPECT_EQ(1, pool.allocs());
+    EXPECT_EQ(0, pool.hits());
+    
+    pool.free(p, 64);
+    EXPECT_EQ(0, pool.used());
+    EXPECT_EQ(1, pool.cached());
+    
+    // reuse the cached.
+    void* p2 = pool.alloc(64);
+    EXPECT_TRUE(p == p2);
+    EXPECT_EQ(1, pool.hits());
+    EXPECT_EQ(0, pool.cached());
+    
+    // the max cached is 1, the second is freed.
+    void* p3 = pool.alloc(64);
+    pool.free(p2, 64);
+    pool.free(p3, 64);
+    EXPECT_EQ(1, pool.cached());
+    EXPECT_EQ(0, pool.used());
+    
+    // the object in other size use system.
+    void* p4 = pool.alloc(128);
+    EXPECT_EQ(0, pool.used());
+    EXPECT_EQ(3, pool.allocs());
+    pool.free(p4, 128);
+    EXPECT_EQ(1, pool.cached());
+}
+
+/**
+* the fan-out of a frame to players, copy the shared ptr message for each
+* player and free when sent, the wrappers are reused from the pool.
+*/
+VOID TEST(KernelSlabTest, MessageFanoutBenchmark)
+{
+    const int nb_players = 500;
+    const int nb_msgs = 1000;
+    
+    SrsObjectPool::enable();
+    
+    SrsSharedPtrMessage* queue[nb_players];
+    
+    int64_t allocs = 0;
+    int64_t hits = 0;
+    std::vector<SrsObjectPool*>& pools = SrsObjectPool::pools();
+    for (int i = 0; i < (int)pools.size(); i++) {
+        allocs -= pools[i]->allocs();
+        hits -= pools[i]->hits();
+    }
+    
+    int64_t starttime = srs_update_system_time_ms();
+    
+    for (int i = 0; i < nb_msgs; i++) {
+        SrsMessageHeader header;
+        header.initialize_video(1024, i * 40, 1);
+        
+        SrsSharedPtrMessage* msg = new SrsSharedPtrMessage();
+        ASSERT_TRUE(ERROR_SUCCESS == msg->create(&header, new char[1024], 1024));
+        
+        for (int j = 0; j < nb_players; j++) {
+            queue[j] = msg->copy();
+        }
+        srs_freep(msg);
+        
+        for (int j = 0; j < nb_players; j++) {
+            srs_freep(queue[j]);
+        }
+    }
+    
+    int64_t elapsed = srs_update_system_time_ms() - starttime;
+    
+    for (int i = 0; i < (int)pools.size(); i++) {
+        allocs += pools[i]->allocs();
+        hits += pools[i]->hits();
+    }
+    
+    printf("fanout copy %d msgs to %d players, %d ms, %d allocs, %d%% from pools\n",
+        nb_msgs, nb_players, (int)elapsed, (int)allocs, (int)(allocs > 0? hits * 100 / allocs : 0));
+    EXPECT_TRUE(hits * 100 > allocs * 99);
+}
+
+/**
+* parse the fmt to types of args for binary log.
+*/
+VOID TEST(KernelLogTest, BinaryLogParse)
+{
+    string types;
+    
+    EXPECT_TRUE(srs_binary_log_parse("no args 100%%", types));
+    EXPECT_STREQ("", types.c_str());
+    
+    EXPECT_TRUE(srs_binary_log_parse("%s %d %"PRId64" %.2f %p %*d %% %5.*s %-08x %c", types));
+    EXPECT_STREQ("siIdpiiisii", types.c_str());
+    
+    EXPECT_TRUE(srs_binary_log_parse("%lld %llu %zu %hd", types));
+    EXPECT_STREQ("IIIi", types.c_str());
+    
+    EXPECT_FALSE(srs_binary_log_parse("%Lf", types));
+    EXPECT_FALSE(srs_binary_log_parse("%n", types));
+    EXPECT_FALSE(srs_binary_log_parse("%ls", types));
+}
+
+/**
+* encode the binary log record.
+*/
+VOID TEST(KernelLogTest, BinaryLogEncode)
+{
+    char buf[64];
+    string types = "siId";
+    
+    int size = SrsBinaryLog::encode_logf(buf, sizeof(buf), types, 0x0102030405060708LL, 7, 0, 100, 5, 11,
+        "hello", 3, (int64_t)-1, 1.5);
+    EXPECT_EQ(28 + 2 + 5 + 4 + 8 + 8, size);
+    
+    SrsStream stream;
+    EXPECT_TRUE(ERROR_SUCCESS == stream.initialize(buf, size));
+    EXPECT_EQ(size, stream.read_2bytes());
+    EXPECT_EQ(SrsBinaryLogRecordLog, stream.read_1bytes());
+    EXPECT_EQ(5, stream.read_1bytes());
+    EXPECT_EQ(0x0102030405060708LL, stream.read_8bytes());
+    EXPECT_EQ(7, stream.read_4bytes());
+    EXPECT_EQ(0, stream.read_4bytes());
+    EXPECT_EQ(100, stream.read_4bytes());
+    EXPECT_EQ(11, stream.read_4bytes());
+    
+    EXPECT_EQ(5, stream.read_2bytes());
+    EXPECT_STREQ("hello", stream.read_string(5).c_str());
+    EXPECT_EQ(3, stream.read_4bytes());
+    EXPECT_EQ(-1, stream.read_8bytes());
+    
+    int64_t bits = stream.read_8bytes();
+    double v = 0;
+    memcpy(&v, &bits, 8);
+    EXPECT_EQ(1.5, v);
+    EXPECT_TRUE(stream.empty());
+    
+    // the string is truncated to fit the buffer.
+    types = "s";
+    string large(100, 'x');
+    size = SrsBinaryLog::encode_logf(buf, sizeof(buf), types, 0, 7, 0, 100, 3, 0, large.c_str());
+    EXPECT_EQ((int)sizeof(buf), size);
+    
+    // the args not fit.
+    types = "iiiiiiiiii";
+    size = SrsBinaryLog::encode_logf(buf, 48, types, 0, 7, 0, 100, 3, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10);
+    EXPECT_EQ(0, size);
+}
+
+/**
+* mux the video and audio by muxer, then demux the ts packets,
+* the packets are duplicated sometimes, which should be dropped.
+*/
+VOID TEST(KernelTSTest, DemuxerMuxed)
+{
+    MockSrsFileWriter fw;
+    SrsTsContext ctx;
+    SrsTSMuxer muxer(&fw, &ctx, SrsCodecAudioAAC, SrsCodecVideoAVC);
+    ASSERT_EQ(ERROR_SUCCESS, muxer.open(""));
+    
+    std::vector<std::string> videos;
+    std::vector<std::string> audios;
+    
+    int nb_sizes = (int)(sizeof(mock_ts_payload_sizes) / sizeof(int));
+    for (int i = 0; i < nb_sizes; i++) {
+        SrsTsMessage video;
+        video.sid = SrsTsPESStreamIdVideoCommon;
+        video.dts = video.pts = i * 3600;
+        video.write_pcr = (i % 2) == 0;
+        for (int j = 0; j < mock_ts_payload_sizes[i]; j++) {
+            char v = (char)(i + j);
+            video.payload->append(&v, 1);
+        }
+        videos.push_back(std::string(video.payload->bytes(), video.payload->length()));
+        EXPECT_EQ(ERROR_SUCCESS, muxer.write_video(&video));
+        
+        SrsTsMessage audio;
+        audio.sid = SrsTsPESStreamIdAudioCommon;
+        audio.dts = audio.pts = i * 1920;
+        for (int j = 0; j < 10 + i * 7; j++) {
+            char v = (char)(i * j);
+            audio.payload->append(&v, 1);
+        }
+        audios.push_back(std::string(audio.payload->bytes(), audio.payload->length()));
+        EXPECT_EQ(ERROR_SUCCESS, muxer.write_audio(&audio));
+    }
+    ASSERT_EQ(0, fw.offset % SRS_TS_PACKET_SIZE);
+    
+    MockTsHandler handler;
+    SrsTsContext demuxer;
+    int nb_packets = fw.offset / SRS_TS_PACKET_SIZE;
+    for (int i = 0; i < nb_packets; i++) {
+        char* p = fw.data + i * SRS_TS_PACKET_SIZE;
+        
+        // duplicate some packets which payload_unit_start_indicator is 0.
+        bool duplicated = (i % 5) == 3 && (p[1] & 0x40) == 0;
+        for (int j = 0; j < (duplicated? 2 : 1); j++) {
+            SrsStream stream;
+            ASSERT_EQ(ERROR_SUCCESS, stream.initialize(p, SRS_TS_PACKET_SIZE));
+            ASSERT_EQ(ERROR_SUCCESS, demuxer.decode(&stream, &handler)) << "packet=" << i << ", duplicated=" << j;
+        }
+    }
+    
+    // the last PES of pid is reaped by the next unit start.
+    size_t nb_videos = 0, nb_audios = 0;
+    for (int i = 0; i < (int)handler.pids.size(); i++) {
+        if (handler.pids[i] == 0x100) {
+            ASSERT_TRUE(nb_videos < videos.size());
+            EXPECT_EQ((int64_t)nb_videos * 3600, handler.dtses[i]);
+            EXPECT_TRUE(videos[nb_videos++] == handler.payloads[i]) << "video=" << nb_videos;
+        } else {
+            ASSERT_TRUE(nb_audios < audios.size());
+            EXPECT_EQ((int64_t)nb_audios * 1920, handler.dtses[i]);
+            EXPECT_TRUE(audios[nb_audios++] == handler.payloads[i]) << "audio=" << nb_audios;
+        }
+    }
+    EXPECT_EQ(videos.size() - 1, nb_videos);
+    EXPECT_GE(nb_audios, audios.size() - 1);
+}
+
+/**
+* the throughput of demuxer, about 1MB of 720p video.
+*/
+VOID TEST(KernelTSTest, DemuxerBenchmark)
+{
+    MockSrsFileWriter fw;
+    SrsTsContext ctx;
+    SrsTSMuxer muxer(&fw, &ctx, SrsCodecAudioAAC, SrsCodecVideoAVC);
+    ASSERT_EQ(ERROR_SUCCESS, muxer.open(""));
+    
+    int nb_frames = 0;
+    while (fw.offset < 1000 * 1000 - 64 * 1024) {
+        SrsTsMessage video;
+        video.sid = SrsTsPESStreamIdVideoCommon;
+        video.dts = video.pts = nb_frames * 3600;
+        int size = (nb_frames % 25) == 0? 60 * 1024 : 12 * 1024;
+        for (int j = 0; j < size; j++) {
+            char v = (char)(nb_frames + j);
+            video.payload->append(&v, 1);
+        }
+        EXPECT_EQ(ERROR_SUCCESS, muxer.write_video(&video));
+        nb_frames++;
+    }
+    int nb_packets = fw.offset / SRS_TS_PACKET_SIZE;
+    
+    int nb_loops = 100;
+    int nb_msgs = 0;
+    
+    srs_update_system_time_ms();
+    int64_t starttime = srs_update_system_time_ms();
+    for (int i = 0; i < nb_loops; i++) {
+        MockTsHandler handler;
+        SrsTsContext demuxer;
+        for (int j = 0; j < nb_packets; j++) {
+            SrsStream stream;
+            ASSERT_EQ(ERROR_SUCCESS, stream.initialize(fw.data + j * SRS_TS_PACKET_SIZE, SRS_TS_PACKET_SIZE));
+            ASSERT_EQ(ERROR_SUCCESS, demuxer.decode(&stream, &handler));
+        }
+        nb_msgs += (int)handler.pids.size();
+    }
+    int64_t elapsed = srs_update_system_time_ms() - starttime;
+    
+    EXPECT_EQ((nb_frames - 1) * nb_loops, nb_msgs);
+    
+    printf("ts demux %d MB %d frames, %d ms, %d Mbps\n",
+        fw.offset * nb_loops / 1000 / 1000, nb_frames * nb_loops, (int)elapsed,
+        (int)((int64_t)fw.offset * nb_loops * 8 / 1000 / srs_max(1, elapsed)));
+}
+
+#endif
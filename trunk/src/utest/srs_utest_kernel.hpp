@@ -30,7 +30,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <srs_utest.hpp>
 
 #include <string>
+#include <vector>
 #include <srs_kernel_file.hpp>
+#include <srs_kernel_ts.hpp>
 #include <srs_protocol_buffer.hpp>
 
 class MockBufferReader: public ISrsBufferReader
@@ -92,5 +94,19 @@ public:
     void mock_reset_offset();
 };
 
+class MockTsHandler : public ISrsTsHandler
+{
+public:
+    // the pid, dts and payload of the got messages.
+    std::vector<int> pids;
+    std::vector<int64_t> dtses;
+    std::vector<std::string> payloads;
+public:
+    MockTsHandler();
+    virtual ~MockTsHandler();
+public:
+    virtual int on_ts_message(SrsTsMessage* msg);
+};
+
 #endif
 
@@ -22,6 +22,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 #include <srs_utest_protocol.hpp>
 
+#include <unistd.h>
+
 using namespace std;
 
 #include <srs_kernel_error.hpp>
@@ -32,6 +34,10 @@ using namespace std;
 #include <srs_kernel_utility.hpp>
 #include <srs_app_st.hpp>
 #include <srs_rtmp_amf0.hpp>
+#include <srs_kernel_slab.hpp>
+#include <srs_kernel_stream.hpp>
+#include <srs_app_dns.hpp>
+#include <srs_core_performance.hpp>
 #include <srs_rtmp_stack.hpp>
 
 MockEmptyIO::MockEmptyIO()
@@ -370,6 +376,110 @@ VOID TEST(ProtocolHandshakeTest, ComplexHandshake)
     }
 }
 
+// the pool of DH keys and the cached HMAC of genuine keys.
+VOID TEST(ProtocolHandshakeTest, HandshakeKeys)
+{
+    char data[1504];
+    srs_random_generate(data, sizeof(data));
+    
+    // the digest by the copy of genuine key, never cached.
+    char key[68];
+    memcpy(key, SrsGenuineFMSKey, 68);
+    char expect_digest[SRS_OpensslHashSize];
+    ASSERT_EQ(ERROR_SUCCESS, openssl_HMACsha256(key, 36, data, sizeof(data), expect_digest));
+    
+    SrsHandshakeKeys* keys = SrsHandshakeKeys::instance();
+    ASSERT_EQ(ERROR_SUCCESS, keys->initialize(2, true));
+    EXPECT_TRUE(keys->hmac(SrsGenuineFMSKey, 36) != NULL);
+    EXPECT_TRUE(keys->hmac(key, 36) == NULL);
+    
+    // the cached context is reused for each digest.
+    for (int i = 0; i < 3; i++) {
+        char digest[SRS_OpensslHashSize];
+        ASSERT_EQ(ERROR_SUCCESS, openssl_HMACsha256(SrsGenuineFMSKey, 36, data, sizeof(data), digest));
+        EXPECT_TRUE(srs_bytes_equals(digest, expect_digest, 32));
+    }
+    
+    // the pool is full after refill.
+    ASSERT_EQ(ERROR_SUCCESS, keys->refill(10));
+    EXPECT_EQ(2, keys->size());
+    EXPECT_TRUE(keys->full());
+    EXPECT_FALSE(keys->overloaded());
+    
+    SrsDH* dh0 = keys->fetch();
+    SrsAutoFree(SrsDH, dh0);
+    SrsDH* dh1 = keys->fetch();
+    SrsAutoFree(SrsDH, dh1);
+    ASSERT_TRUE(dh0 != NULL && dh1 != NULL);
+    
+    char pub_key0[128];
+    int pkey_size = 128;
+    EXPECT_TRUE(ERROR_SUCCESS == dh0->copy_public_key(pub_key0, pkey_size));
+    char pub_key1[128];
+    EXPECT_TRUE(ERROR_SUCCESS == dh1->copy_public_key(pub_key1, pkey_size));
+    EXPECT_FALSE(srs_bytes_equals(pub_key0, pub_key1, 128));
+    
+    // used up, overload.
+    int64_t nb_misses = keys->misses();
+    EXPECT_TRUE(keys->fetch() == NULL);
+    EXPECT_EQ(nb_misses + 1, keys->misses());
+    EXPECT_TRUE(keys->overloaded());
+    
+    // disable the pool, the HMAC is still cached.
+    ASSERT_EQ(ERROR_SUCCESS, keys->initialize(0, false));
+    EXPECT_FALSE(keys->overloaded());
+}
+
+// refill the pool in native thread, like the handshakes of server.
+static void* _utest_handshake_refill(void* arg)
+{
+    int* pret = (int*)arg;
+    *pret = SrsHandshakeKeys::instance()->refill(8);
+    return NULL;
+}
+
+/**
+* the pool is refilled by native thread, while the st fetch keys.
+*/
+VOID TEST(ProtocolHandshakeTest, HandshakeKeysRefillThread)
+{
+    SrsHandshakeKeys* keys = SrsHandshakeKeys::instance();
+    ASSERT_EQ(ERROR_SUCCESS, keys->initialize(8, false));
+    
+    int refill_ret = -1;
+    pthread_t tid;
+    ASSERT_EQ(0, pthread_create(&tid, NULL, _utest_handshake_refill, &refill_ret));
+    
+    // fetch and use the keys while refilling.
+    std::vector<SrsDH*> fetched;
+    for (int i = 0; i < 1000 && fetched.size() < 4; i++) {
+        SrsDH* dh = keys->fetch();
+        if (!dh) {
+            usleep(1000);
+            continue;
+        }
+        fetched.push_back(dh);
+        
+        char pub_key[128];
+        int pkey_size = 128;
+        EXPECT_TRUE(ERROR_SUCCESS == dh->copy_public_key(pub_key, pkey_size));
+        EXPECT_EQ(128, pkey_size);
+    }
+    ASSERT_EQ(0, pthread_join(tid, NULL));
+    EXPECT_EQ(ERROR_SUCCESS, refill_ret);
+    
+    // all generated keys are either fetched or in pool.
+    EXPECT_EQ(8, (int)fetched.size() + keys->size());
+    
+    for (int i = 0; i < (int)fetched.size(); i++) {
+        srs_freep(fetched[i]);
+    }
+    for (SrsDH* dh = keys->fetch(); dh != NULL; dh = keys->fetch()) {
+        srs_freep(dh);
+    }
+    ASSERT_EQ(ERROR_SUCCESS, keys->initialize(0, false));
+}
+
 #endif
 
 VOID TEST(ProtocolHandshakeTest, SimpleHandshake)
@@ -740,6 +850,63 @@ VOID TEST(ProtocolStackTest, ProtocolRecvMessage)
     ASSERT_TRUE(NULL != spkt);
 }
 
+#ifdef SRS_PERF_RECV_SLAB
+/**
+* recv the payload in slab, copied when chunk size is small,
+* zero-copy point to the receive buffer when chunk size is large.
+*/
+VOID TEST(ProtocolStackTest, ProtocolRecvMessageSlab)
+{
+    MockBufferIO bio;
+    SrsProtocol proto(&bio);
+    proto.set_recv_slab(true);
+    
+    char data[] = {
+        // fmt=0, cid=4, timestamp=0, payload_length=4, message_type=8(audio), stream_id=1
+        (char)0x04, (char)0x00, (char)0x00, (char)0x00, (char)0x00, (char)0x00, (char)0x04, (char)0x08, (char)0x01, (char)0x00, (char)0x00, (char)0x00,
+        (char)0xaf, (char)0x01, (char)0x02, (char)0x03,
+        // fmt=0, cid=2, set chunk size to 65536.
+        (char)0x02, (char)0x00, (char)0x00, (char)0x00, (char)0x00, (char)0x00, (char)0x04, (char)0x01, (char)0x00, (char)0x00, (char)0x00, (char)0x00,
+        (char)0x00, (char)0x01, (char)0x00, (char)0x00,
+        // fmt=1, cid=4, timestamp delta=0, payload_length=4, message_type=8(audio)
+        (char)0x44, (char)0x00, (char)0x00, (char)0x00, (char)0x00, (char)0x00, (char)0x04, (char)0x08,
+        (char)0xaf, (char)0x01, (char)0x04, (char)0x05
+    };
+    bio.in_buffer.append(data, sizeof(data));
+    
+    if (true) {
+        SrsCommonMessage* msg = NULL;
+        ASSERT_TRUE(ERROR_SUCCESS == proto.recv_message(&msg));
+        SrsAutoFree(SrsCommonMessage, msg);
+        
+        // copied to the slab of message.
+        ASSERT_TRUE(NULL != msg->slab);
+        EXPECT_FALSE(msg->slab->shared());
+        EXPECT_EQ(4, msg->size);
+        EXPECT_EQ((char)0x03, msg->payload[3]);
+    }
+    
+    if (true) {
+        SrsCommonMessage* msg = NULL;
+        ASSERT_TRUE(ERROR_SUCCESS == proto.recv_message(&msg));
+        SrsAutoFree(SrsCommonMessage, msg);
+        EXPECT_TRUE(msg->header.is_set_chunk_size());
+    }
+    
+    if (true) {
+        SrsCommonMessage* msg = NULL;
+        ASSERT_TRUE(ERROR_SUCCESS == proto.recv_message(&msg));
+        SrsAutoFree(SrsCommonMessage, msg);
+        
+        // point to the receive buffer, shared with it.
+        ASSERT_TRUE(NULL != msg->slab);
+        EXPECT_TRUE(msg->slab->shared());
+        EXPECT_EQ(4, msg->size);
+        EXPECT_EQ((char)0x05, msg->payload[3]);
+    }
+}
+#endif
+
 // for librtmp, if ping, it will send a fresh stream with fmt=1,
 // 0x42             where: fmt=1, cid=2, protocol contorl user-control message
 // 0x00 0x00 0x00   where: timestamp=0
@@ -5491,6 +5658,270 @@ VOID TEST(ProtocolStackTest, ProtocolExcpectMessage)
     ASSERT_TRUE(NULL != pkt);
 }
 
+/**
+* the chunk headers are shared by all copies of message.
+*/
+VOID TEST(ProtocolStackTest, ProtocolSendSharedChunkHeader)
+{
+    SrsMessageHeader header;
+    header.initialize_video(4096, 0x1234, 1);
+    
+    SrsSharedPtrMessage msg;
+    ASSERT_TRUE(ERROR_SUCCESS == msg.create(&header, new char[4096], 4096));
+    memset(msg.payload, 0x0f, msg.size);
+    
+    // the shared headers equals to the headers built by message.
+    SrsSharedChunkHeader* sh = msg.shared_chunk_header();
+    ASSERT_TRUE(NULL != sh);
+    
+    char c0c3[SRS_CONSTS_RTMP_MAX_FMT0_HEADER_SIZE];
+    EXPECT_EQ(sh->nb_c0, msg.chunk_header(c0c3, sizeof(c0c3), true));
+    EXPECT_TRUE(0 == memcmp(sh->c0, c0c3, sh->nb_c0));
+    EXPECT_EQ(sh->nb_c3, msg.chunk_header(c0c3, sizeof(c0c3), false));
+    EXPECT_TRUE(0 == memcmp(sh->c3, c0c3, sh->nb_c3));
+    
+    // the copy with same timestamp and stream id reuse the headers.
+    if (true) {
+        SrsSharedPtrMessage* copy = msg.copy();
+        SrsAutoFree(SrsSharedPtrMessage, copy);
+        EXPECT_TRUE(sh == copy->shared_chunk_header());
+        
+        // the c3 is shared by the copy of other timestamp.
+        copy->timestamp++;
+        EXPECT_TRUE(sh == copy->shared_chunk_header());
+        
+        // the c3 of extended timestamp contains the timestamp.
+        copy->timestamp = RTMP_EXTENDED_TIMESTAMP;
+        SrsSharedChunkHeader* esh = copy->shared_chunk_header();
+        ASSERT_TRUE(NULL != esh);
+        EXPECT_TRUE(sh != esh);
+        EXPECT_EQ(5, esh->nb_c3);
+        EXPECT_TRUE(esh == copy->shared_chunk_header());
+        
+        copy->timestamp++;
+        EXPECT_TRUE(esh != copy->shared_chunk_header());
+    }
+    
+    // the players got the same bytes.
+    MockBufferIO bio0;
+    SrsProtocol proto0(&bio0);
+    EXPECT_TRUE(ERROR_SUCCESS == proto0.send_and_free_message(msg.copy(), 1));
+    
+    MockBufferIO bio1;
+    SrsProtocol proto1(&bio1);
+    EXPECT_TRUE(ERROR_SUCCESS == proto1.send_and_free_message(msg.copy(), 1));
+    
+    ASSERT_EQ(bio0.out_buffer.length(), bio1.out_buffer.length());
+    EXPECT_TRUE(0 == memcmp(bio0.out_buffer.bytes(), bio1.out_buffer.bytes(), bio0.out_buffer.length()));
+    
+    // the player can decode the message.
+    bio0.in_buffer.append(bio0.out_buffer.bytes(), bio0.out_buffer.length());
+    
+    SrsCommonMessage* pmsg = NULL;
+    ASSERT_TRUE(ERROR_SUCCESS == proto0.recv_message(&pmsg));
+    SrsAutoFree(SrsCommonMessage, pmsg);
+    EXPECT_TRUE(pmsg->header.is_video());
+    EXPECT_EQ(0x1234, pmsg->header.timestamp);
+    EXPECT_EQ(4096, pmsg->size);
+    EXPECT_TRUE(0 == memcmp(msg.payload, pmsg->payload, msg.size));
+}
+
+/**
+* the players must got the right message when the shared headers is full.
+*/
+VOID TEST(ProtocolStackTest, ProtocolSendSharedChunkHeaderFull)
+{
+    SrsMessageHeader header;
+    header.initialize_audio(300, 0, 1);
+    
+    SrsSharedPtrMessage msg;
+    ASSERT_TRUE(ERROR_SUCCESS == msg.create(&header, new char[300], 300));
+    memset(msg.payload, 0x0f, msg.size);
+    
+    for (int i = 0; i < SRS_PERF_CHUNK_HEADER_CACHE + 2; i++) {
+        MockBufferIO bio;
+        SrsProtocol proto(&bio);
+        
+        SrsSharedPtrMessage* copy = msg.copy();
+        copy->timestamp = 100 + i;
+        EXPECT_TRUE(ERROR_SUCCESS == proto.send_and_free_message(copy, 1));
+        
+        bio.in_buffer.append(bio.out_buffer.bytes(), bio.out_buffer.length());
+        
+        SrsCommonMessage* pmsg = NULL;
+        ASSERT_TRUE(ERROR_SUCCESS == proto.recv_message(&pmsg));
+        SrsAutoFree(SrsCommonMessage, pmsg);
+        EXPECT_TRUE(pmsg->header.is_audio());
+        EXPECT_EQ(100 + i, pmsg->header.timestamp);
+        EXPECT_EQ(300, pmsg->size);
+    }
+}
+
+/**
+* send the audio/video messages in aggregate message,
+* the sub messages are flv tags, and cross the chunks.
+*/
+VOID TEST(ProtocolStackTest, ProtocolSendAggregate)
+{
+    MockBufferIO bio;
+    SrsProtocol proto(&bio);
+    proto.set_send_aggregate(true);
+    
+    int sizes[3] = {100, 300, 100};
+    int64_t timestamps[3] = {10, 20, 33};
+    
+    SrsSharedPtrMessage* msgs[3];
+    for (int i = 0; i < 3; i++) {
+        SrsMessageHeader header;
+        if (i == 1) {
+            header.initialize_video(sizes[i], (u_int32_t)timestamps[i], 1);
+        } else {
+            header.initialize_audio(sizes[i], (u_int32_t)timestamps[i], 1);
+        }
+        
+        msgs[i] = new SrsSharedPtrMessage();
+        ASSERT_TRUE(ERROR_SUCCESS == msgs[i]->create(&header, new char[sizes[i]], sizes[i]));
+        memset(msgs[i]->payload, i + 1, sizes[i]);
+    }
+    EXPECT_TRUE(ERROR_SUCCESS == proto.send_and_free_messages(msgs, 3, 1));
+    
+    bio.in_buffer.append(bio.out_buffer.bytes(), bio.out_buffer.length());
+    bio.out_buffer.erase(bio.out_buffer.length());
+    
+    SrsCommonMessage* pmsg = NULL;
+    ASSERT_TRUE(ERROR_SUCCESS == proto.recv_message(&pmsg));
+    SrsAutoFree(SrsCommonMessage, pmsg);
+    EXPECT_TRUE(pmsg->header.is_aggregate());
+    EXPECT_EQ(10, pmsg->header.timestamp);
+    EXPECT_EQ(1, pmsg->header.stream_id);
+    EXPECT_EQ(3 * 15 + 500, pmsg->size);
+    
+    SrsStream stream;
+    ASSERT_TRUE(ERROR_SUCCESS == stream.initialize(pmsg->payload, pmsg->size));
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ((i == 1)? 9 : 8, stream.read_1bytes());
+        EXPECT_EQ(sizes[i], stream.read_3bytes());
+        EXPECT_EQ(timestamps[i], stream.read_3bytes());
+        EXPECT_EQ(0, stream.read_1bytes());
+        EXPECT_EQ(0, stream.read_3bytes());
+        
+        ASSERT_TRUE(stream.require(sizes[i] + 4));
+        for (int j = 0; j < sizes[i]; j++) {
+            EXPECT_EQ(i + 1, stream.read_1bytes());
+        }
+        EXPECT_EQ(11 + sizes[i], stream.read_4bytes());
+    }
+    EXPECT_TRUE(stream.empty());
+    
+    // the single message is sent directly.
+    SrsMessageHeader header;
+    header.initialize_audio(100, 40, 1);
+    SrsSharedPtrMessage* msg = new SrsSharedPtrMessage();
+    ASSERT_TRUE(ERROR_SUCCESS == msg->create(&header, new char[100], 100));
+    EXPECT_TRUE(ERROR_SUCCESS == proto.send_and_free_message(msg, 1));
+    
+    bio.in_buffer.append(bio.out_buffer.bytes(), bio.out_buffer.length());
+    
+    SrsCommonMessage* audio = NULL;
+    ASSERT_TRUE(ERROR_SUCCESS == proto.recv_message(&audio));
+    SrsAutoFree(SrsCommonMessage, audio);
+    EXPECT_TRUE(audio->header.is_audio());
+    EXPECT_EQ(40, audio->header.timestamp);
+    EXPECT_EQ(100, audio->size);
+}
+
+/**
+* the players on the distinct timelines corrected by jitter,
+* more than the cache, share the c3 and got the right message.
+*/
+VOID TEST(ProtocolStackTest, ProtocolSendSharedChunkHeaderJitter)
+{
+    SrsMessageHeader header;
+    header.initialize_video(1000, 0, 1);
+    
+    SrsSharedPtrMessage msg;
+    ASSERT_TRUE(ERROR_SUCCESS == msg.create(&header, new char[1000], 1000));
+    for (int i = 0; i < msg.size; i++) {
+        msg.payload[i] = (char)i;
+    }
+    
+    SrsSharedChunkHeader* sh = NULL;
+    for (int i = 0; i < SRS_PERF_CHUNK_HEADER_CACHE * 4; i++) {
+        MockBufferIO bio;
+        SrsProtocol proto(&bio);
+        
+        SrsSharedPtrMessage* copy = msg.copy();
+        copy->timestamp = 1000 * i + 7;
+        
+        // all players use the same c3.
+        SrsSharedChunkHeader* csh = copy->shared_chunk_header();
+        ASSERT_TRUE(NULL != csh);
+        if (!sh) {
+            sh = csh;
+        }
+        EXPECT_TRUE(sh == csh);
+        
+        EXPECT_TRUE(ERROR_SUCCESS == proto.send_and_free_message(copy, 1));
+        
+        // 1000 bytes in 8 chunks of 128 bytes, the c0 is 12 bytes and c3 is 1 byte.
+        EXPECT_EQ(1000 + 12 + 7, bio.out_buffer.length());
+        
+        bio.in_buffer.append(bio.out_buffer.bytes(), bio.out_buffer.length());
+        
+        SrsCommonMessage* pmsg = NULL;
+        ASSERT_TRUE(ERROR_SUCCESS == proto.recv_message(&pmsg));
+        SrsAutoFree(SrsCommonMessage, pmsg);
+        EXPECT_TRUE(pmsg->header.is_video());
+        EXPECT_EQ(1000 * i + 7, pmsg->header.timestamp);
+        EXPECT_EQ(1000, pmsg->size);
+        EXPECT_TRUE(0 == memcmp(msg.payload, pmsg->payload, msg.size));
+    }
+}
+
+/**
+* benchmark for a source fan out messages to players.
+*/
+VOID TEST(ProtocolStackTest, ProtocolSendFanoutBenchmark)
+{
+    const int nb_players = 500;
+    const int nb_msgs = 100;
+    
+    MockBufferIO* bios[nb_players];
+    SrsProtocol* protos[nb_players];
+    for (int i = 0; i < nb_players; i++) {
+        bios[i] = new MockBufferIO();
+        protos[i] = new SrsProtocol(bios[i]);
+    }
+    
+    int64_t starttime = srs_update_system_time_ms();
+    int64_t nb_bytes = 0;
+    
+    for (int i = 0; i < nb_msgs; i++) {
+        SrsMessageHeader header;
+        header.initialize_video(4096, i * 40, 1);
+        
+        SrsSharedPtrMessage msg;
+        ASSERT_TRUE(ERROR_SUCCESS == msg.create(&header, new char[4096], 4096));
+        
+        for (int j = 0; j < nb_players; j++) {
+            EXPECT_TRUE(ERROR_SUCCESS == protos[j]->send_and_free_message(msg.copy(), 1));
+            
+            SrsSimpleBuffer& out = bios[j]->out_buffer;
+            nb_bytes += out.length();
+            out.erase(out.length());
+        }
+    }
+    
+    int64_t elapsed = srs_update_system_time_ms() - starttime;
+    printf("fanout %d msgs to %d players, %d KB, %d ms\n",
+        nb_msgs, nb_players, (int)(nb_bytes / 1024), (int)elapsed);
+    
+    for (int i = 0; i < nb_players; i++) {
+        srs_freep(protos[i]);
+        srs_freep(bios[i]);
+    }
+}
+
 VOID TEST(ProtocolRTMPTest, RTMPRequest)
 {
     SrsRequest req;
@@ -5563,5 +5994,90 @@ VOID TEST(ProtocolRTMPTest, RTMPHandshakeBytes)
     EXPECT_TRUE(bytes.s0s1s2 != NULL);
 }
 
-#endif
+VOID TEST(ProtocolDnsTest, PacketEncodeDecode)
+{
+    char buf[512];
+    SrsStream stream;
+    
+    // the query of www.ossrs.net
+    char query[] = {
+        (char)0x12, (char)0x34, (char)0x01, (char)0x00, (char)0x00, (char)0x01, (char)0x00, (char)0x00,
+        (char)0x00, (char)0x00, (char)0x00, (char)0x00,
+        (char)0x03, 'w', 'w', 'w', (char)0x05, 'o', 's', 's', 'r', 's', (char)0x03, 'n', 'e', 't', (char)0x00,
+        (char)0x00, (char)0x01, (char)0x00, (char)0x01
+    };
+    if (true) {
+        SrsDnsPacket pkt;
+        pkt.id = 0x1234;
+        pkt.host = "www.ossrs.net.";
+        EXPECT_TRUE(ERROR_SUCCESS == stream.initialize(buf, sizeof(buf)));
+        EXPECT_TRUE(ERROR_SUCCESS == pkt.encode(&stream));
+        EXPECT_EQ((int)sizeof(query), stream.pos());
+        EXPECT_TRUE(0 == memcmp(query, buf, sizeof(query)));
+    }
+    
+    // invalid host.
+    if (true) {
+        SrsDnsPacket pkt;
+        pkt.host = "www..net";
+        EXPECT_TRUE(ERROR_SUCCESS == stream.initialize(buf, sizeof(buf)));
+        EXPECT_TRUE(ERROR_SUCCESS != pkt.encode(&stream));
+    }
+    
+    // the answer with CNAME and two A records, the name is compressed.
+    if (true) {
+        string answer(query, sizeof(query));
+        answer[2] = (char)0x81; answer[3] = (char)0x80; answer[7] = (char)0x03;
+        char cname[] = {
+            (char)0xc0, (char)0x0c, (char)0x00, (char)0x05, (char)0x00, (char)0x01,
+            (char)0x00, (char)0x00, (char)0x02, (char)0x58, (char)0x00, (char)0x02, (char)0xc0, (char)0x10
+        };
+        char a0[] = {
+            (char)0xc0, (char)0x10, (char)0x00, (char)0x01, (char)0x00, (char)0x01,
+            (char)0x00, (char)0x00, (char)0x00, (char)0x3c, (char)0x00, (char)0x04, (char)1, (char)2, (char)3, (char)4
+        };
+        char a1[] = {
+            (char)0xc0, (char)0x10, (char)0x00, (char)0x01, (char)0x00, (char)0x01,
+            (char)0x00, (char)0x00, (char)0x00, (char)0x1e, (char)0x00, (char)0x04, (char)5, (char)6, (char)7, (char)8
+        };
+        answer.append(cname, sizeof(cname));
+        answer.append(a0, sizeof(a0));
+        answer.append(a1, sizeof(a1));
+        
+        SrsDnsPacket pkt;
+        EXPECT_TRUE(ERROR_SUCCESS == stream.initialize((char*)answer.data(), (int)answer.length()));
+        EXPECT_TRUE(ERROR_SUCCESS == pkt.decode(&stream));
+        EXPECT_EQ(0x1234, pkt.id);
+        EXPECT_EQ(0, pkt.rcode);
+        ASSERT_EQ(2, (int)pkt.ips.size());
+        EXPECT_STREQ("1.2.3.4", pkt.ips.at(0).c_str());
+        EXPECT_STREQ("5.6.7.8", pkt.ips.at(1).c_str());
+        EXPECT_EQ(30, pkt.ttl);
+        
+        // the truncated answer.
+        SrsDnsPacket truncated;
+        EXPECT_TRUE(ERROR_SUCCESS == stream.initialize((char*)answer.data(), (int)answer.length() - 2));
+        EXPECT_TRUE(ERROR_SUCCESS != truncated.decode(&stream));
+    }
+    
+    // the NXDOMAIN answer.
+    if (true) {
+        string answer(query, sizeof(query));
+        answer[2] = (char)0x81; answer[3] = (char)0x83;
+        
+        SrsDnsPacket pkt;
+        EXPECT_TRUE(ERROR_SUCCESS == stream.initialize((char*)answer.data(), (int)answer.length()));
+        EXPECT_TRUE(ERROR_SUCCESS == pkt.decode(&stream));
+        EXPECT_EQ(3, pkt.rcode);
+        EXPECT_TRUE(pkt.ips.empty());
+    }
+    
+    // the query is not answer.
+    if (true) {
+        SrsDnsPacket pkt;
+        EXPECT_TRUE(ERROR_SUCCESS == stream.initialize(query, sizeof(query)));
+        EXPECT_TRUE(ERROR_SUCCESS != pkt.decode(&stream));
+    }
+}
 
+#endif
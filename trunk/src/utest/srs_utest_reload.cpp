@@ -943,5 +943,49 @@ VOID TEST(ConfigReloadTest, ReloadVhostIngestUpdated)
     handler.reset();
 }
 
+VOID TEST(ConfigVhostSettingsTest, CompileAndReload)
+{
+    MockSrsReloadConfig conf;
+    EXPECT_TRUE(ERROR_SUCCESS == conf.parse(_MIN_OK_CONF"vhost __defaultVhost__{atc on;} vhost a{reduce_sequence_header on; hls{hls_on_error disconnect;}} vhost a{atc on;}"));
+    
+    // the first vhost win when duplicated.
+    SrsVhostSettings* a = conf.get_vhost_settings("a");
+    EXPECT_TRUE(a->enabled);
+    EXPECT_TRUE(a->reduce_sequence_header);
+    EXPECT_FALSE(a->atc);
+    EXPECT_STREQ("disconnect", a->hls_on_error.c_str());
+    EXPECT_TRUE(a == conf.get_vhost_settings("a"));
+    
+    // the vhost not found use the settings of default vhost.
+    SrsVhostSettings* d = conf.get_vhost_settings(SRS_CONSTS_RTMP_DEFAULT_VHOST);
+    SrsVhostSettings* b = conf.get_vhost_settings("b");
+    EXPECT_TRUE(d == b);
+    EXPECT_TRUE(b->atc);
+    EXPECT_FALSE(b->reduce_sequence_header);
+    
+    // never compile settings for the unknown vhosts.
+    for (int i = 0; i < 100; i++) {
+        char vhost[32];
+        snprintf(vhost, sizeof(vhost), "192.168.1.%d", i);
+        EXPECT_TRUE(d == conf.get_vhost_settings(vhost));
+    }
+    
+    // the settings is updated in place when reload.
+    EXPECT_TRUE(ERROR_SUCCESS == conf.reload(_MIN_OK_CONF"vhost b{reduce_sequence_header on;}"));
+    EXPECT_TRUE(a == conf.get_vhost_settings("a"));
+    EXPECT_FALSE(a->reduce_sequence_header);
+    EXPECT_FALSE(a->atc);
+    EXPECT_STREQ("continue", a->hls_on_error.c_str());
+    EXPECT_TRUE(d == conf.get_vhost_settings(SRS_CONSTS_RTMP_DEFAULT_VHOST));
+    EXPECT_FALSE(d->atc);
+    EXPECT_FALSE(d->reduce_sequence_header);
+    
+    // the vhost added by reload got its settings.
+    b = conf.get_vhost_settings("b");
+    EXPECT_TRUE(d != b);
+    EXPECT_TRUE(b->reduce_sequence_header);
+    EXPECT_FALSE(b->atc);
+}
+
 #endif
 